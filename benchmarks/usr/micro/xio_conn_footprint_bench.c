@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/prctl.h>
+
+#include <libxio.h>
+
+/*
+ * Reports what a server pays per connection. A server is forked and the
+ * parent opens N sessions against it. The server's resident set is
+ * sampled after a warm up batch, after all N connections are up and
+ * idle, and again after a single request went over every connection.
+ * Warm up absorbs the per context costs (pools, shared scratch) so the
+ * reported numbers are the slope only. The vm columns count what was
+ * reserved whether touched or not, such as receive rings. Sessions of a
+ * context to the same portal share one transport connection, so every
+ * session connects to its own loopback address.
+ */
+
+#define DEF_CONNS_NR		1000
+#define DEF_PORT		2090
+#define LOOP_TIMEOUT_MS		60000
+#define CONNECT_BURST		2	/* two sockets each, backlog is 4 */
+
+struct bench_conn {
+	struct xio_session	*session;
+	struct xio_connection	*conn;
+	struct xio_msg		req;
+};
+
+struct bench_client {
+	struct xio_context	*ctx;
+	struct bench_conn	*conns;
+	const char		*proto;
+	int			port;
+	int			target;
+	int			established;
+	int			responses;
+	int			teardowns;
+	int			pad;
+};
+
+struct bench_server {
+	struct xio_context	*ctx;
+	struct xio_msg		*rsp_ring;
+	int			rsp_ring_sz;
+	int			rsp_cnt;
+};
+
+/*---------------------------------------------------------------------------*/
+/* statm_bytes								     */
+/*---------------------------------------------------------------------------*/
+static int statm_bytes(pid_t pid, long *vm, long *rss)
+{
+	char	path[64];
+	FILE	*fp;
+	long	size = 0, resident = 0;
+	int	retval = 0;
+
+	sprintf(path, "/proc/%d/statm", (int)pid);
+	fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+	if (fscanf(fp, "%ld %ld", &size, &resident) != 2)
+		retval = -1;
+	fclose(fp);
+
+	*vm  = size * sysconf(_SC_PAGESIZE);
+	*rss = resident * sysconf(_SC_PAGESIZE);
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* server_on_session_event						     */
+/*---------------------------------------------------------------------------*/
+static int server_on_session_event(struct xio_session *session,
+				   struct xio_session_event_data *event_data,
+				   void *cb_user_context)
+{
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* server_on_new_session						     */
+/*---------------------------------------------------------------------------*/
+static int server_on_new_session(struct xio_session *session,
+				 struct xio_new_session_req *req,
+				 void *cb_user_context)
+{
+	xio_accept(session, NULL, 0, NULL, 0);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* server_on_request							     */
+/*---------------------------------------------------------------------------*/
+static int server_on_request(struct xio_session *session,
+			     struct xio_msg *req,
+			     int last_in_rxq,
+			     void *cb_user_context)
+{
+	struct bench_server *sd = (struct bench_server *)cb_user_context;
+	struct xio_msg	    *rsp = &sd->rsp_ring[sd->rsp_cnt++];
+
+	if (sd->rsp_cnt == sd->rsp_ring_sz)
+		sd->rsp_cnt = 0;
+
+	rsp->request = req;
+	xio_send_response(rsp);
+
+	return 0;
+}
+
+static struct xio_session_ops server_ops = {
+	.on_session_event		=  server_on_session_event,
+	.on_new_session			=  server_on_new_session,
+	.on_msg_send_complete		=  NULL,
+	.on_msg				=  server_on_request,
+	.on_msg_error			=  NULL
+};
+
+/*---------------------------------------------------------------------------*/
+/* run_server								     */
+/*---------------------------------------------------------------------------*/
+static int run_server(const char *url, int conns_nr, int ready_fd)
+{
+	struct bench_server	sd;
+	struct xio_server	*server;
+	char			ready = 1;
+
+	/* count touched pages, not transparent huge page rounding */
+	prctl(PR_SET_THP_DISABLE, 1, 0, 0, 0);
+
+	xio_init();
+
+	memset(&sd, 0, sizeof(sd));
+	sd.rsp_ring_sz = conns_nr;
+	sd.rsp_ring = (struct xio_msg *)calloc(conns_nr, sizeof(*sd.rsp_ring));
+	sd.ctx = xio_context_create(NULL, 0, -1);
+	if (!sd.rsp_ring || !sd.ctx)
+		return 1;
+
+	server = xio_bind(sd.ctx, &server_ops, url, NULL, 0, &sd);
+	if (!server) {
+		fprintf(stderr, "bind to %s failed\n", url);
+		return 1;
+	}
+	if (write(ready_fd, &ready, 1) != 1)
+		return 1;
+	close(ready_fd);
+
+	/* the parent kills us when it is done sampling */
+	xio_context_run_loop(sd.ctx, XIO_INFINITE);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* client_on_session_event						     */
+/*---------------------------------------------------------------------------*/
+static int client_on_session_event(struct xio_session *session,
+				   struct xio_session_event_data *event_data,
+				   void *cb_user_context)
+{
+	struct bench_client *cd = (struct bench_client *)cb_user_context;
+
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_ESTABLISHED_EVENT:
+		if (++cd->established == cd->target)
+			xio_context_stop_loop(cd->ctx);
+		break;
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		if (++cd->teardowns == cd->target)
+			xio_context_stop_loop(cd->ctx);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* client_on_response							     */
+/*---------------------------------------------------------------------------*/
+static int client_on_response(struct xio_session *session,
+			      struct xio_msg *rsp,
+			      int last_in_rxq,
+			      void *cb_user_context)
+{
+	struct bench_client *cd = (struct bench_client *)cb_user_context;
+
+	xio_release_response(rsp);
+	if (++cd->responses == cd->target)
+		xio_context_stop_loop(cd->ctx);
+
+	return 0;
+}
+
+static struct xio_session_ops client_ops = {
+	.on_session_event		=  client_on_session_event,
+	.on_session_established		=  NULL,
+	.on_msg				=  client_on_response,
+	.on_msg_error			=  NULL
+};
+
+/*---------------------------------------------------------------------------*/
+/* client_connect							     */
+/*---------------------------------------------------------------------------*/
+static int client_connect(struct bench_client *cd, int from, int to)
+{
+	struct xio_session_params	params;
+	struct xio_connection_params	cparams;
+	char				url[256];
+	int				i;
+
+	memset(&params, 0, sizeof(params));
+	params.type		= XIO_SESSION_CLIENT;
+	params.ses_ops		= &client_ops;
+	params.user_context	= cd;
+	params.uri		= url;
+
+	for (i = from; i < to; i++) {
+		sprintf(url, "%s://127.%d.%d.%d:%d", cd->proto,
+			((i + 1) >> 16) & 0xff, ((i + 1) >> 8) & 0xff,
+			(i + 1) & 0xff, cd->port);
+		cd->conns[i].session = xio_session_create(&params);
+		if (!cd->conns[i].session)
+			return -1;
+
+		memset(&cparams, 0, sizeof(cparams));
+		cparams.session			= cd->conns[i].session;
+		cparams.ctx			= cd->ctx;
+		cparams.conn_user_context	= cd;
+		cd->conns[i].conn = xio_connect(&cparams);
+		if (!cd->conns[i].conn)
+			return -1;
+
+		/* stay within the listen backlog of the server */
+		if ((i + 1 - from) % CONNECT_BURST && i + 1 < to)
+			continue;
+		cd->target = i + 1;
+		xio_context_run_loop(cd->ctx, LOOP_TIMEOUT_MS);
+		if (cd->established != i + 1)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* start_server								     */
+/*---------------------------------------------------------------------------*/
+static pid_t start_server(const char *url, int conns_nr)
+{
+	int			pipefd[2];
+	pid_t			pid;
+	char			ready;
+
+	if (pipe(pipefd))
+		return -1;
+
+	pid = fork();
+	if (pid < 0)
+		return -1;
+	if (pid == 0) {
+		close(pipefd[0]);
+		exit(run_server(url, conns_nr, pipefd[1]));
+	}
+	close(pipefd[1]);
+	if (read(pipefd[0], &ready, 1) != 1) {
+		fprintf(stderr, "server %s did not come up\n", url);
+		waitpid(pid, NULL, 0);
+		pid = -1;
+	}
+	close(pipefd[0]);
+
+	return pid;
+}
+
+/*---------------------------------------------------------------------------*/
+/* run_client								     */
+/*---------------------------------------------------------------------------*/
+static int run_client(const char *proto, int port, pid_t pid, int conns_nr)
+{
+	struct bench_client	cd;
+	int			i, warm_nr = conns_nr / 10;
+	long			rss_warm, rss_idle, rss_active;
+	long			vm_warm, vm_idle, vm_active;
+	double			idle;
+
+	memset(&cd, 0, sizeof(cd));
+	cd.ctx = xio_context_create(NULL, 0, -1);
+	cd.conns = (struct bench_conn *)calloc(conns_nr, sizeof(*cd.conns));
+	cd.proto = proto;
+	cd.port = port;
+	if (!cd.ctx || !cd.conns)
+		return -1;
+
+	if (warm_nr == 0)
+		warm_nr = 1;
+	if (client_connect(&cd, 0, warm_nr))
+		goto connect_failed;
+	usleep(200000);
+	statm_bytes(pid, &vm_warm, &rss_warm);
+
+	if (client_connect(&cd, warm_nr, conns_nr))
+		goto connect_failed;
+	usleep(200000);
+	statm_bytes(pid, &vm_idle, &rss_idle);
+
+	/* one round trip on every connection */
+	for (i = 0; i < conns_nr; i++) {
+		cd.conns[i].req.out.header.iov_base = (void *)"footprint";
+		cd.conns[i].req.out.header.iov_len = sizeof("footprint");
+		xio_send_request(cd.conns[i].conn, &cd.conns[i].req);
+	}
+	xio_context_run_loop(cd.ctx, LOOP_TIMEOUT_MS);
+	if (cd.responses != conns_nr)
+		fprintf(stderr, "only %d of %d responses\n",
+			cd.responses, conns_nr);
+	usleep(200000);
+	statm_bytes(pid, &vm_active, &rss_active);
+
+	idle = (double)(rss_idle - rss_warm) / (conns_nr - warm_nr);
+	printf("%8d %14.0f %14.0f %14.0f %14.0f\n", conns_nr, idle,
+	       idle + (double)(rss_active - rss_idle) / conns_nr,
+	       (double)(vm_idle - vm_warm) / (conns_nr - warm_nr),
+	       (double)(vm_active - vm_warm) / (conns_nr - warm_nr));
+
+	for (i = 0; i < conns_nr; i++)
+		xio_disconnect(cd.conns[i].conn);
+	cd.target = conns_nr;
+	xio_context_run_loop(cd.ctx, LOOP_TIMEOUT_MS);
+	xio_context_destroy(cd.ctx);
+	free(cd.conns);
+
+	return 0;
+
+connect_failed:
+	fprintf(stderr, "%s: established %d connections only\n",
+		proto, cd.established);
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	struct rlimit	rlim;
+	const char	*proto = "tcp";
+	char		url[256];
+	pid_t		pid;
+	int		conns_nr = DEF_CONNS_NR;
+	int		port = DEF_PORT;
+	int		retval;
+
+	if (argc > 1)
+		conns_nr = atoi(argv[1]);
+	if (argc > 2)
+		proto = argv[2];
+	if (argc > 3)
+		port = atoi(argv[3]);
+
+	/* up to two sockets per connection on each side */
+	if (!getrlimit(RLIMIT_NOFILE, &rlim)) {
+		rlim.rlim_cur = rlim.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rlim);
+	}
+
+	/* the server is forked before the library is touched here */
+	sprintf(url, "%s://0.0.0.0:%d", proto, port);
+	pid = start_server(url, conns_nr);
+	if (pid < 0)
+		return 1;
+
+	xio_init();
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	printf("%8s %14s %14s %14s %14s\n",
+	       "conns", "idle[B/conn]", "active[B/conn]",
+	       "vm idle[B/c]", "vm active[B/c]");
+	retval = run_client(proto, port, pid, conns_nr);
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+
+	xio_shutdown();
+
+	return retval ? 1 : 0;
+}
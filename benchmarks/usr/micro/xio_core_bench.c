@@ -0,0 +1,1016 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <sys/eventfd.h>
+
+#include <sys/hashtable.h>
+#include <libxio.h>
+#include <xio_os.h>
+#include "xio_log.h"
+#include "xio_common.h"
+#include "xio_protocol.h"
+#include "xio_observer.h"
+#include "xio_mbuf.h"
+#include "xio_task.h"
+#include "xio_transport.h"
+#include "xio_hash.h"
+#include "xio_sg_table.h"
+#include "xio_idr.h"
+#include "xio_msg_list.h"
+#include "xio_ev_data.h"
+#include "xio_ev_loop.h"
+#include "xio_objpool.h"
+#include "xio_workqueue.h"
+#include "xio_timers_list.h"
+#include "xio_timers_wheel.h"
+#include "xio_context.h"
+#include "xio_nexus.h"
+#include "xio_connection.h"
+#include "xio_session.h"
+#include "xio_session_priv.h"
+
+/*
+ * Single process microbenchmarks of the core building blocks - no peer
+ * and no transport. Every case is run a number of times and the best
+ * and the median ns/op are reported as JSON on stdout, so results can
+ * be kept and compared between releases. An op is one alloc/free or
+ * get/put pair, one encode or decode, one timer armed and expired or one
+ * dispatched event:
+ *
+ *	xio_core_bench [-i iterations] [-r repeats] [-t threads]
+ *		       [-f name filter]
+ */
+
+#define DEF_ITERS		1000000
+#define DEF_REPEATS		5
+#define MAX_REPEATS		64
+#define MAX_THREADS		64
+#define BATCH			32
+#define TIMERS_NR		1024
+
+struct bench_case {
+	const char	*name;
+	const char	*params;	/* JSON members */
+	/* returns ctx, NULL on failure */
+	void		*(*setup)(long arg);
+	/* runs iters iterations, returns the elapsed ns */
+	uint64_t	(*run)(void *ctx, uint64_t iters);
+	void		(*teardown)(void *ctx);
+	long		arg;
+	int		ops_per_iter;
+	int		mt;		/* runs on opt_threads threads */
+};
+
+static uint64_t			opt_iters = DEF_ITERS;
+static int			opt_repeats = DEF_REPEATS;
+static int			opt_threads = 4;
+static const char		*opt_filter;
+static int			nresults;
+static volatile uint64_t	sink;
+
+/*---------------------------------------------------------------------------*/
+/* ns_now								     */
+/*---------------------------------------------------------------------------*/
+static uint64_t ns_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------*/
+/* cmp_u64								     */
+/*---------------------------------------------------------------------------*/
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*===========================================================================*/
+/* xio_mempool								     */
+/*===========================================================================*/
+struct mempool_ctx {
+	struct xio_mempool	*pool;
+	size_t			size;
+	pthread_barrier_t	barrier;
+	uint64_t		iters;
+	uint64_t		done;	/* pairs completed by all threads */
+};
+
+struct mempool_worker {
+	struct mempool_ctx	*ctx;
+	uint64_t		start;
+	uint64_t		end;
+	pthread_t		thread;
+};
+
+/*---------------------------------------------------------------------------*/
+/* mempool_setup							     */
+/*---------------------------------------------------------------------------*/
+static void *mempool_setup(long size)
+{
+	struct mempool_ctx *ctx;
+
+	ctx = (struct mempool_ctx *)calloc(1, sizeof(*ctx));
+	if (!ctx)
+		return NULL;
+	ctx->size = size;
+	ctx->pool = xio_mempool_create(-1,
+				       XIO_MEMPOOL_FLAG_REGULAR_PAGES_ALLOC);
+	if (!ctx->pool ||
+	    xio_mempool_add_slab(ctx->pool, size, 0,
+				 MAX_THREADS * BATCH * 4, BATCH * 4, 0)) {
+		if (ctx->pool)
+			xio_mempool_destroy(ctx->pool);
+		free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+/*---------------------------------------------------------------------------*/
+/* mempool_teardown							     */
+/*---------------------------------------------------------------------------*/
+static void mempool_teardown(void *_ctx)
+{
+	struct mempool_ctx *ctx = (struct mempool_ctx *)_ctx;
+
+	xio_mempool_destroy(ctx->pool);
+	free(ctx);
+}
+
+/*---------------------------------------------------------------------------*/
+/* mempool_pairs							     */
+/*---------------------------------------------------------------------------*/
+/* returns the number of pairs done, it stops on the first failed alloc */
+static uint64_t mempool_pairs(struct mempool_ctx *ctx, uint64_t iters)
+{
+	struct xio_reg_mem	mem;
+	uint64_t		i;
+
+	for (i = 0; i < iters; i++) {
+		if (xio_mempool_alloc(ctx->pool, ctx->size, &mem))
+			break;
+		xio_mempool_free(&mem);
+	}
+
+	return i;
+}
+
+/*---------------------------------------------------------------------------*/
+/* mempool_elapsed							     */
+/*---------------------------------------------------------------------------*/
+/* charges the elapsed time to the pairs actually done, so that a failing
+ * pool does not show up as a fast one
+ */
+static uint64_t mempool_elapsed(uint64_t elapsed, uint64_t expected,
+				uint64_t done)
+{
+	if (done == expected)
+		return elapsed;
+
+	fprintf(stderr, "mempool: only %llu of %llu pairs done\n",
+		(unsigned long long)done, (unsigned long long)expected);
+
+	return done ? elapsed * expected / done : UINT64_MAX;
+}
+
+/*---------------------------------------------------------------------------*/
+/* mempool_run								     */
+/*---------------------------------------------------------------------------*/
+static uint64_t mempool_run(void *ctx, uint64_t iters)
+{
+	uint64_t start = ns_now();
+	uint64_t done = mempool_pairs((struct mempool_ctx *)ctx, iters);
+
+	return mempool_elapsed(ns_now() - start, iters, done);
+}
+
+/*---------------------------------------------------------------------------*/
+/* mempool_batch_run							     */
+/*---------------------------------------------------------------------------*/
+static uint64_t mempool_batch_run(void *_ctx, uint64_t iters)
+{
+	struct mempool_ctx	*ctx = (struct mempool_ctx *)_ctx;
+	struct xio_reg_mem	mem[BATCH];
+	uint64_t		i, start = ns_now();
+	int			j;
+
+	for (i = 0; i < iters; i++) {
+		for (j = 0; j < BATCH; j++)
+			xio_mempool_alloc(ctx->pool, ctx->size, &mem[j]);
+		for (j = 0; j < BATCH; j++)
+			xio_mempool_free(&mem[j]);
+	}
+
+	return ns_now() - start;
+}
+
+/*---------------------------------------------------------------------------*/
+/* mempool_thread							     */
+/*---------------------------------------------------------------------------*/
+static void *mempool_thread(void *_worker)
+{
+	struct mempool_worker	*worker = (struct mempool_worker *)_worker;
+	struct mempool_ctx	*ctx = worker->ctx;
+	uint64_t		done;
+
+	pthread_barrier_wait(&ctx->barrier);
+	worker->start = ns_now();
+	done = mempool_pairs(ctx, ctx->iters);
+	worker->end = ns_now();
+	__atomic_add_fetch(&ctx->done, done, __ATOMIC_RELAXED);
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* mempool_mt_run							     */
+/*---------------------------------------------------------------------------*/
+static uint64_t mempool_mt_run(void *_ctx, uint64_t iters)
+{
+	struct mempool_ctx	*ctx = (struct mempool_ctx *)_ctx;
+	struct mempool_worker	workers[MAX_THREADS];
+	uint64_t		start = UINT64_MAX, end = 0;
+	int			i;
+
+	ctx->iters = iters;
+	ctx->done = 0;
+	pthread_barrier_init(&ctx->barrier, NULL, opt_threads + 1);
+	for (i = 0; i < opt_threads; i++) {
+		workers[i].ctx = ctx;
+		pthread_create(&workers[i].thread, NULL, mempool_thread,
+			       &workers[i]);
+	}
+	pthread_barrier_wait(&ctx->barrier);
+	/* the releasing thread may be scheduled last, so the window is
+	 * taken from the workers themselves
+	 */
+	for (i = 0; i < opt_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		if (workers[i].start < start)
+			start = workers[i].start;
+		if (workers[i].end > end)
+			end = workers[i].end;
+	}
+	pthread_barrier_destroy(&ctx->barrier);
+
+	/* wall time over the pairs of all the threads */
+	return mempool_elapsed(end - start, iters * opt_threads, ctx->done);
+}
+
+/*===========================================================================*/
+/* xio_objpool								     */
+/*===========================================================================*/
+/*---------------------------------------------------------------------------*/
+/* objpool_setup							     */
+/*---------------------------------------------------------------------------*/
+static void *objpool_setup(long size)
+{
+	return xio_objpool_create(size, BATCH, BATCH);
+}
+
+/*---------------------------------------------------------------------------*/
+/* objpool_teardown							     */
+/*---------------------------------------------------------------------------*/
+static void objpool_teardown(void *ctx)
+{
+	xio_objpool_destroy((struct xio_objpool *)ctx);
+}
+
+/*---------------------------------------------------------------------------*/
+/* objpool_run								     */
+/*---------------------------------------------------------------------------*/
+static uint64_t objpool_run(void *ctx, uint64_t iters)
+{
+	struct xio_objpool	*pool = (struct xio_objpool *)ctx;
+	void			*obj[BATCH];
+	uint64_t		i, start = ns_now();
+	int			j;
+
+	for (i = 0; i < iters; i++) {
+		for (j = 0; j < BATCH; j++)
+			obj[j] = xio_objpool_alloc(pool);
+		for (j = 0; j < BATCH; j++)
+			xio_objpool_free(obj[j]);
+	}
+
+	return ns_now() - start;
+}
+
+/*===========================================================================*/
+/* xio_tasks_pool							     */
+/*===========================================================================*/
+/*---------------------------------------------------------------------------*/
+/* tasks_pool_setup							     */
+/*---------------------------------------------------------------------------*/
+static void *tasks_pool_setup(long idle_reclaim)
+{
+	struct xio_tasks_pool_params params;
+
+	memset(&params, 0, sizeof(params));
+	params.pool_name		= kstrdup("bench", GFP_KERNEL);
+	params.start_nr			= 256;
+	params.max_nr			= 1024;
+	params.alloc_nr			= 256;
+	params.idle_reclaim_ticks	= idle_reclaim;
+
+	return xio_tasks_pool_create(&params);
+}
+
+/*---------------------------------------------------------------------------*/
+/* tasks_pool_teardown							     */
+/*---------------------------------------------------------------------------*/
+static void tasks_pool_teardown(void *ctx)
+{
+	xio_tasks_pool_destroy((struct xio_tasks_pool *)ctx);
+}
+
+/*---------------------------------------------------------------------------*/
+/* tasks_pool_run							     */
+/*---------------------------------------------------------------------------*/
+static uint64_t tasks_pool_run(void *ctx, uint64_t iters)
+{
+	struct xio_tasks_pool	*pool = (struct xio_tasks_pool *)ctx;
+	struct xio_task		*task[BATCH];
+	uint64_t		i, start = ns_now();
+	int			j;
+
+	for (i = 0; i < iters; i++) {
+		for (j = 0; j < BATCH; j++)
+			task[j] = xio_tasks_pool_get(pool, NULL);
+		for (j = 0; j < BATCH; j++)
+			xio_tasks_pool_put(task[j]);
+	}
+
+	return ns_now() - start;
+}
+
+/*===========================================================================*/
+/* xio_mbuf / session header						     */
+/*===========================================================================*/
+struct mbuf_ctx {
+	struct xio_task		task;
+	struct xio_nexus	nexus;
+	char			buf[512];
+};
+
+/*---------------------------------------------------------------------------*/
+/* mbuf_setup								     */
+/*---------------------------------------------------------------------------*/
+static void *mbuf_setup(long arg)
+{
+	struct mbuf_ctx *ctx;
+
+	ctx = (struct mbuf_ctx *)calloc(1, sizeof(*ctx));
+	if (!ctx)
+		return NULL;
+	xio_mbuf_init(&ctx->task.mbuf, ctx->buf, sizeof(ctx->buf), 0);
+	/* the header byte order is negotiated per nexus */
+	ctx->nexus.native_hdr	= arg;
+	ctx->task.nexus		= &ctx->nexus;
+
+	return ctx;
+}
+
+/*---------------------------------------------------------------------------*/
+/* mbuf_teardown							     */
+/*---------------------------------------------------------------------------*/
+static void mbuf_teardown(void *ctx)
+{
+	free(ctx);
+}
+
+/*---------------------------------------------------------------------------*/
+/* mbuf_encode								     */
+/*---------------------------------------------------------------------------*/
+static inline void mbuf_encode(struct xio_mbuf *mbuf, uint64_t i)
+{
+	/* a setup request like tlv - a few scalars and a string */
+	xio_mbuf_reset(mbuf);
+	xio_mbuf_tlv_start(mbuf);
+	xio_mbuf_write_u16(mbuf, (uint16_t)i);
+	xio_mbuf_write_u32(mbuf, (uint32_t)i);
+	xio_mbuf_write_u64(mbuf, i);
+	xio_mbuf_write_string(mbuf, "rdma://192.168.1.1:1234", 24);
+	xio_mbuf_write_tlv(mbuf, XIO_NEXUS_SETUP_REQ,
+			   xio_mbuf_get_curr_offset(mbuf) - XIO_TLV_LEN);
+}
+
+/*---------------------------------------------------------------------------*/
+/* mbuf_encode_run							     */
+/*---------------------------------------------------------------------------*/
+static uint64_t mbuf_encode_run(void *_ctx, uint64_t iters)
+{
+	struct mbuf_ctx	*ctx = (struct mbuf_ctx *)_ctx;
+	uint64_t	i, start = ns_now();
+
+	for (i = 0; i < iters; i++)
+		mbuf_encode(&ctx->task.mbuf, i);
+
+	return ns_now() - start;
+}
+
+/*---------------------------------------------------------------------------*/
+/* mbuf_decode_run							     */
+/*---------------------------------------------------------------------------*/
+static uint64_t mbuf_decode_run(void *_ctx, uint64_t iters)
+{
+	struct mbuf_ctx	*ctx = (struct mbuf_ctx *)_ctx;
+	struct xio_mbuf	*mbuf = &ctx->task.mbuf;
+	char		str[32];
+	size_t		len;
+	uint64_t	i, v64 = 0, start;
+	uint32_t	v32 = 0;
+	uint16_t	v16 = 0;
+
+	mbuf_encode(mbuf, 1);
+	start = ns_now();
+	for (i = 0; i < iters; i++) {
+		xio_mbuf_read_first_tlv(mbuf);
+		xio_mbuf_read_u16(mbuf, &v16);
+		xio_mbuf_read_u32(mbuf, &v32);
+		xio_mbuf_read_u64(mbuf, &v64);
+		xio_mbuf_read_string(mbuf, str, sizeof(str), &len);
+		sink += v16 + v32 + v64 + len;
+	}
+
+	return ns_now() - start;
+}
+
+/*---------------------------------------------------------------------------*/
+/* session_hdr_write_run						     */
+/*---------------------------------------------------------------------------*/
+static uint64_t session_hdr_write_run(void *_ctx, uint64_t iters)
+{
+	struct mbuf_ctx		*ctx = (struct mbuf_ctx *)_ctx;
+	struct xio_session_hdr	hdr;
+	uint64_t		i, start;
+
+	memset(&hdr, 0, sizeof(hdr));
+	ctx->task.mbuf.tlv.head = ctx->buf;
+	start = ns_now();
+	for (i = 0; i < iters; i++) {
+		hdr.serial_num	= i;
+		hdr.sn		= (uint16_t)i;
+		xio_session_write_header(&ctx->task, &hdr);
+	}
+
+	return ns_now() - start;
+}
+
+/*---------------------------------------------------------------------------*/
+/* session_hdr_read_run							     */
+/*---------------------------------------------------------------------------*/
+static uint64_t session_hdr_read_run(void *_ctx, uint64_t iters)
+{
+	struct mbuf_ctx		*ctx = (struct mbuf_ctx *)_ctx;
+	struct xio_session_hdr	hdr;
+	uint64_t		i, start;
+
+	memset(&hdr, 0, sizeof(hdr));
+	ctx->task.mbuf.tlv.head = ctx->buf;
+	xio_session_write_header(&ctx->task, &hdr);
+	start = ns_now();
+	for (i = 0; i < iters; i++) {
+		xio_session_read_header(&ctx->task, &hdr);
+		sink += hdr.serial_num;
+	}
+
+	return ns_now() - start;
+}
+
+/*===========================================================================*/
+/* sg table								     */
+/*===========================================================================*/
+struct sgtbl_ctx {
+	struct xio_sg_table_ops	*ops;
+	struct xio_vmsg		src;
+	struct xio_vmsg		dst;
+	struct xio_iovec_ex	src_sgl[XIO_MAX_IOV];
+	struct xio_iovec_ex	dst_sgl[XIO_MAX_IOV];
+	char			data[4096];
+};
+
+/*---------------------------------------------------------------------------*/
+/* sgtbl_setup								     */
+/*---------------------------------------------------------------------------*/
+static void *sgtbl_setup(long nents)
+{
+	struct sgtbl_ctx	*ctx;
+	long			i;
+
+	ctx = (struct sgtbl_ctx *)calloc(1, sizeof(*ctx));
+	if (!ctx)
+		return NULL;
+	ctx->ops = (struct xio_sg_table_ops *)
+			xio_sg_table_ops_get(XIO_SGL_TYPE_IOV_PTR);
+	ctx->src.sgl_type		= XIO_SGL_TYPE_IOV_PTR;
+	ctx->src.pdata_iov.sglist	= ctx->src_sgl;
+	ctx->src.pdata_iov.max_nents	= XIO_MAX_IOV;
+	ctx->src.pdata_iov.nents	= nents;
+	ctx->dst.sgl_type		= XIO_SGL_TYPE_IOV_PTR;
+	ctx->dst.pdata_iov.sglist	= ctx->dst_sgl;
+	ctx->dst.pdata_iov.max_nents	= XIO_MAX_IOV;
+	for (i = 0; i < nents; i++) {
+		ctx->src_sgl[i].iov_base = ctx->data + i * 16;
+		ctx->src_sgl[i].iov_len	 = 16;
+	}
+
+	return ctx;
+}
+
+/*---------------------------------------------------------------------------*/
+/* sgtbl_teardown							     */
+/*---------------------------------------------------------------------------*/
+static void sgtbl_teardown(void *ctx)
+{
+	free(ctx);
+}
+
+/*---------------------------------------------------------------------------*/
+/* sgtbl_length_run							     */
+/*---------------------------------------------------------------------------*/
+static uint64_t sgtbl_length_run(void *_ctx, uint64_t iters)
+{
+	struct sgtbl_ctx	*ctx = (struct sgtbl_ctx *)_ctx;
+	void			*tbl = xio_sg_table_get(&ctx->src);
+	uint64_t		i, start = ns_now();
+
+	for (i = 0; i < iters; i++)
+		sink += tbl_length(ctx->ops, tbl);
+
+	return ns_now() - start;
+}
+
+/*---------------------------------------------------------------------------*/
+/* sgtbl_clone_run							     */
+/*---------------------------------------------------------------------------*/
+static uint64_t sgtbl_clone_run(void *_ctx, uint64_t iters)
+{
+	struct sgtbl_ctx	*ctx = (struct sgtbl_ctx *)_ctx;
+	void			*stbl = xio_sg_table_get(&ctx->src);
+	void			*dtbl = xio_sg_table_get(&ctx->dst);
+	uint64_t		i, start = ns_now();
+
+	for (i = 0; i < iters; i++)
+		tbl_clone(ctx->ops, dtbl, ctx->ops, stbl);
+
+	return ns_now() - start;
+}
+
+/*===========================================================================*/
+/* timers								     */
+/*===========================================================================*/
+struct timers_ctx {
+	xio_delayed_work_handle_t	dworks[TIMERS_NR];
+	uint64_t			durations[TIMERS_NR];
+	struct xio_timers_list		list;
+	struct xio_timers_wheel		wheel;
+};
+
+/*---------------------------------------------------------------------------*/
+/* timer_cb								     */
+/*---------------------------------------------------------------------------*/
+static void timer_cb(void *data)
+{
+	sink++;
+}
+
+/*---------------------------------------------------------------------------*/
+/* timers_setup								     */
+/*---------------------------------------------------------------------------*/
+static void *timers_setup(long arg)
+{
+	struct timers_ctx	*ctx;
+	int			i;
+
+	ctx = (struct timers_ctx *)calloc(1, sizeof(*ctx));
+	if (!ctx)
+		return NULL;
+	srand(1);
+	for (i = 0; i < TIMERS_NR; i++) {
+		ctx->dworks[i].work.function = timer_cb;
+		/* keepalive like spread, 1 msec .. 60 sec */
+		ctx->durations[i] = (1 + rand() % 60000) * XIO_NS_IN_MSEC;
+	}
+
+	return ctx;
+}
+
+/*---------------------------------------------------------------------------*/
+/* timers_teardown							     */
+/*---------------------------------------------------------------------------*/
+static void timers_teardown(void *ctx)
+{
+	free(ctx);
+}
+
+/*---------------------------------------------------------------------------*/
+/* timers_list_run							     */
+/*---------------------------------------------------------------------------*/
+/* one iteration arms TIMERS_NR timers, then expires them all */
+static uint64_t timers_list_run(void *_ctx, uint64_t iters)
+{
+	struct timers_ctx	*ctx = (struct timers_ctx *)_ctx;
+	uint64_t		i, elapsed = 0, start;
+	int			j;
+
+	for (i = 0; i < iters; i++) {
+		xio_timers_list_init(&ctx->list);
+		start = ns_now();
+		for (j = 0; j < TIMERS_NR; j++)
+			xio_timers_list_add_duration(&ctx->list,
+						     ctx->durations[j],
+						     &ctx->dworks[j].timer);
+		elapsed += ns_now() - start;
+		/* make them all due without timing it */
+		for (j = 0; j < TIMERS_NR; j++)
+			ctx->dworks[j].timer.expires = 0;
+		start = ns_now();
+		xio_timers_list_expire(&ctx->list);
+		elapsed += ns_now() - start;
+		xio_timers_list_close(&ctx->list);
+	}
+
+	return elapsed;
+}
+
+/*---------------------------------------------------------------------------*/
+/* timers_wheel_run							     */
+/*---------------------------------------------------------------------------*/
+static uint64_t timers_wheel_run(void *_ctx, uint64_t iters)
+{
+	struct timers_ctx	*ctx = (struct timers_ctx *)_ctx;
+	uint64_t		i, elapsed = 0, start;
+	int			j;
+
+	for (i = 0; i < iters; i++) {
+		xio_timers_wheel_init(&ctx->wheel);
+		start = ns_now();
+		for (j = 0; j < TIMERS_NR; j++)
+			xio_timers_wheel_add_duration(&ctx->wheel,
+						      ctx->durations[j],
+						      &ctx->dworks[j].timer);
+		elapsed += ns_now() - start;
+		/* re-arm as due without timing it */
+		for (j = 0; j < TIMERS_NR; j++) {
+			xio_timers_wheel_del(&ctx->wheel,
+					     &ctx->dworks[j].timer);
+			xio_timers_wheel_add_duration(&ctx->wheel, 0,
+						      &ctx->dworks[j].timer);
+		}
+		while (xio_timers_wheel_now_tick(&ctx->wheel) <=
+		       ctx->dworks[TIMERS_NR - 1].timer.expires)
+			;
+		start = ns_now();
+		xio_timers_wheel_expire(&ctx->wheel);
+		elapsed += ns_now() - start;
+		xio_timers_wheel_close(&ctx->wheel);
+	}
+
+	return elapsed;
+}
+
+/*===========================================================================*/
+/* xio_ev_loop								     */
+/*===========================================================================*/
+struct ev_loop_ctx {
+	void			*loop;
+	int			efd;
+	int			pad;
+	struct xio_ev_data	events[BATCH];
+};
+
+/*---------------------------------------------------------------------------*/
+/* ev_loop_fd_handler							     */
+/*---------------------------------------------------------------------------*/
+static void ev_loop_fd_handler(int fd, int events, void *data)
+{
+	eventfd_t val;
+
+	if (!eventfd_read(fd, &val))
+		sink += val;
+}
+
+/*---------------------------------------------------------------------------*/
+/* ev_loop_event_handler						     */
+/*---------------------------------------------------------------------------*/
+static void ev_loop_event_handler(void *data)
+{
+	sink++;
+}
+
+/*---------------------------------------------------------------------------*/
+/* ev_loop_setup							     */
+/*---------------------------------------------------------------------------*/
+static void *ev_loop_setup(long arg)
+{
+	struct ev_loop_ctx *ctx;
+
+	ctx = (struct ev_loop_ctx *)calloc(1, sizeof(*ctx));
+	if (!ctx)
+		return NULL;
+	ctx->loop = xio_ev_loop_create();
+	ctx->efd = eventfd(0, EFD_NONBLOCK);
+	if (!ctx->loop || ctx->efd < 0 ||
+	    xio_ev_loop_add(ctx->loop, ctx->efd, XIO_POLLIN,
+			    ev_loop_fd_handler, ctx)) {
+		if (ctx->loop)
+			xio_ev_loop_destroy(ctx->loop);
+		if (ctx->efd >= 0)
+			close(ctx->efd);
+		free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+/*---------------------------------------------------------------------------*/
+/* ev_loop_teardown							     */
+/*---------------------------------------------------------------------------*/
+static void ev_loop_teardown(void *_ctx)
+{
+	struct ev_loop_ctx *ctx = (struct ev_loop_ctx *)_ctx;
+
+	xio_ev_loop_del(ctx->loop, ctx->efd);
+	close(ctx->efd);
+	xio_ev_loop_destroy(ctx->loop);
+	free(ctx);
+}
+
+/*---------------------------------------------------------------------------*/
+/* ev_loop_fd_run							     */
+/*---------------------------------------------------------------------------*/
+/* signal an fd and dispatch its handler, one loop pass per event */
+static uint64_t ev_loop_fd_run(void *_ctx, uint64_t iters)
+{
+	struct ev_loop_ctx	*ctx = (struct ev_loop_ctx *)_ctx;
+	uint64_t		i, start = ns_now();
+
+	for (i = 0; i < iters; i++) {
+		eventfd_write(ctx->efd, 1);
+		xio_ev_loop_poll_wait(ctx->loop, 0);
+	}
+
+	return ns_now() - start;
+}
+
+/*---------------------------------------------------------------------------*/
+/* ev_loop_events_run							     */
+/*---------------------------------------------------------------------------*/
+/* queue BATCH deferred events and dispatch them in one loop pass */
+static uint64_t ev_loop_events_run(void *_ctx, uint64_t iters)
+{
+	struct ev_loop_ctx	*ctx = (struct ev_loop_ctx *)_ctx;
+	uint64_t		i, start = ns_now();
+	int			j;
+
+	for (i = 0; i < iters; i++) {
+		for (j = 0; j < BATCH; j++) {
+			ctx->events[j].handler	= ev_loop_event_handler;
+			ctx->events[j].data	= ctx;
+			xio_ev_loop_add_event(ctx->loop, &ctx->events[j]);
+		}
+		xio_ev_loop_poll_wait(ctx->loop, 0);
+	}
+
+	return ns_now() - start;
+}
+
+/*===========================================================================*/
+/* driver								     */
+/*===========================================================================*/
+static struct bench_case cases[] = {
+	{ "mempool_alloc_free", "\"size\": 64",
+	  mempool_setup, mempool_run, mempool_teardown, 64, 1, 0 },
+	{ "mempool_alloc_free", "\"size\": 4096",
+	  mempool_setup, mempool_run, mempool_teardown, 4096, 1, 0 },
+	{ "mempool_alloc_free", "\"size\": 65536",
+	  mempool_setup, mempool_run, mempool_teardown, 65536, 1, 0 },
+	{ "mempool_alloc_free_batch", "\"size\": 4096, \"batch\": 32",
+	  mempool_setup, mempool_batch_run, mempool_teardown, 4096,
+	  BATCH, 0 },
+	{ "mempool_alloc_free_mt", "\"size\": 4096",
+	  mempool_setup, mempool_mt_run, mempool_teardown, 4096, 1, 1 },
+	{ "objpool_alloc_free", "\"size\": 256, \"batch\": 32",
+	  objpool_setup, objpool_run, objpool_teardown, 256, BATCH, 0 },
+	{ "tasks_pool_get_put", "\"batch\": 32",
+	  tasks_pool_setup, tasks_pool_run, tasks_pool_teardown, 0,
+	  BATCH, 0 },
+	{ "tasks_pool_get_put", "\"batch\": 32, \"idle_reclaim\": 1",
+	  tasks_pool_setup, tasks_pool_run, tasks_pool_teardown, 1,
+	  BATCH, 0 },
+	{ "mbuf_tlv_encode", "\"fields\": 4",
+	  mbuf_setup, mbuf_encode_run, mbuf_teardown, 0, 1, 0 },
+	{ "mbuf_tlv_decode", "\"fields\": 4",
+	  mbuf_setup, mbuf_decode_run, mbuf_teardown, 0, 1, 0 },
+	{ "session_write_header", "\"native\": 0",
+	  mbuf_setup, session_hdr_write_run, mbuf_teardown, 0, 1, 0 },
+	{ "session_write_header", "\"native\": 1",
+	  mbuf_setup, session_hdr_write_run, mbuf_teardown, 1, 1, 0 },
+	{ "session_read_header", "\"native\": 0",
+	  mbuf_setup, session_hdr_read_run, mbuf_teardown, 0, 1, 0 },
+	{ "session_read_header", "\"native\": 1",
+	  mbuf_setup, session_hdr_read_run, mbuf_teardown, 1, 1, 0 },
+	{ "sg_table_length", "\"type\": \"iovptr\", \"nents\": 4",
+	  sgtbl_setup, sgtbl_length_run, sgtbl_teardown, 4, 1, 0 },
+	{ "sg_table_length", "\"type\": \"iovptr\", \"nents\": 64",
+	  sgtbl_setup, sgtbl_length_run, sgtbl_teardown, 64, 1, 0 },
+	{ "sg_table_clone", "\"type\": \"iovptr\", \"nents\": 4",
+	  sgtbl_setup, sgtbl_clone_run, sgtbl_teardown, 4, 1, 0 },
+	{ "sg_table_clone", "\"type\": \"iovptr\", \"nents\": 64",
+	  sgtbl_setup, sgtbl_clone_run, sgtbl_teardown, 64, 1, 0 },
+	{ "timers_list_arm_expire", "\"timers\": 1024",
+	  timers_setup, timers_list_run, timers_teardown, 0, TIMERS_NR, 0 },
+	{ "timers_wheel_arm_expire", "\"timers\": 1024",
+	  timers_setup, timers_wheel_run, timers_teardown, 0, TIMERS_NR, 0 },
+	{ "ev_loop_fd_dispatch", "\"fds\": 1",
+	  ev_loop_setup, ev_loop_fd_run, ev_loop_teardown, 0, 1, 0 },
+	{ "ev_loop_event_dispatch", "\"batch\": 32",
+	  ev_loop_setup, ev_loop_events_run, ev_loop_teardown, 0, BATCH, 0 },
+};
+
+/*---------------------------------------------------------------------------*/
+/* run_case								     */
+/*---------------------------------------------------------------------------*/
+static int run_case(struct bench_case *bc)
+{
+	uint64_t	samples[MAX_REPEATS];
+	uint64_t	iters, ops;
+	double		best, median;
+	void		*ctx;
+	int		i;
+
+	/* keep every case in the same ballpark of operations */
+	iters = opt_iters / bc->ops_per_iter;
+	if (iters == 0)
+		iters = 1;
+	ops = iters * bc->ops_per_iter * (bc->mt ? opt_threads : 1);
+
+	ctx = bc->setup(bc->arg);
+	if (!ctx) {
+		fprintf(stderr, "%s: setup failed\n", bc->name);
+		return -1;
+	}
+	/* warm up caches, pools and lazy allocations */
+	bc->run(ctx, iters / 10 + 1);
+	for (i = 0; i < opt_repeats; i++)
+		samples[i] = bc->run(ctx, iters);
+	bc->teardown(ctx);
+
+	qsort(samples, opt_repeats, sizeof(samples[0]), cmp_u64);
+	best	= (double)samples[0] / ops;
+	median	= (double)samples[opt_repeats / 2] / ops;
+
+	printf("%s\n    {\"name\": \"%s\", \"params\": {%s}, "
+	       "\"threads\": %d, \"ops\": %llu, \"ns_per_op_best\": %.2f, "
+	       "\"ns_per_op_median\": %.2f, \"mops\": %.2f}",
+	       nresults++ ? "," : "", bc->name, bc->params,
+	       bc->mt ? opt_threads : 1, (unsigned long long)ops,
+	       best, median, median > 0 ? 1000.0 / median : 0);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* usage								     */
+/*---------------------------------------------------------------------------*/
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n", argv0);
+	fprintf(stderr, "\t-i, --iters=<n>     operations per run "
+		"(default %d)\n", DEF_ITERS);
+	fprintf(stderr, "\t-r, --repeats=<n>   runs per case "
+		"(default %d, max %d)\n", DEF_REPEATS, MAX_REPEATS);
+	fprintf(stderr, "\t-t, --threads=<n>   threads of the mt cases "
+		"(default 4, max %d)\n", MAX_THREADS);
+	fprintf(stderr, "\t-f, --filter=<str>  run cases whose name "
+		"contains str\n");
+	fprintf(stderr, "\t-l, --list          list the cases\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	static struct option const long_options[] = {
+		{ .name = "iters",	.has_arg = 1, .val = 'i'},
+		{ .name = "repeats",	.has_arg = 1, .val = 'r'},
+		{ .name = "threads",	.has_arg = 1, .val = 't'},
+		{ .name = "filter",	.has_arg = 1, .val = 'f'},
+		{ .name = "list",	.has_arg = 0, .val = 'l'},
+		{ .name = "help",	.has_arg = 0, .val = 'h'},
+		{0, 0, 0, 0},
+	};
+	const char	*version;
+	unsigned int	i;
+	int		c, failed = 0;
+
+	while ((c = getopt_long(argc, argv, "i:r:t:f:lh",
+				long_options, NULL)) != -1) {
+		switch (c) {
+		case 'i':
+			opt_iters = strtoull(optarg, NULL, 0);
+			break;
+		case 'r':
+			opt_repeats = atoi(optarg);
+			break;
+		case 't':
+			opt_threads = atoi(optarg);
+			break;
+		case 'f':
+			opt_filter = optarg;
+			break;
+		case 'l':
+			for (i = 0; i < ARRAY_SIZE(cases); i++)
+				printf("%-26s {%s}\n", cases[i].name,
+				       cases[i].params);
+			return 0;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+	if (!opt_iters || opt_repeats < 1 || opt_repeats > MAX_REPEATS ||
+	    opt_threads < 1 || opt_threads > MAX_THREADS) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	xio_init();
+
+	/* outside of a git tree the library version has no githead */
+	version = xio_version();
+	if (!*version || version[strlen(version) - 1] == '_')
+		version = "accelio_" PACKAGE_VERSION;
+
+	printf("{\n  \"suite\": \"xio_core_bench\",\n"
+	       "  \"version\": \"%s\",\n"
+	       "  \"timestamp\": %llu,\n"
+	       "  \"cpus\": %ld,\n"
+	       "  \"iters\": %llu,\n"
+	       "  \"repeats\": %d,\n"
+	       "  \"results\": [",
+	       version, (unsigned long long)time(NULL),
+	       sysconf(_SC_NPROCESSORS_ONLN),
+	       (unsigned long long)opt_iters, opt_repeats);
+	for (i = 0; i < ARRAY_SIZE(cases); i++) {
+		if (opt_filter && !strstr(cases[i].name, opt_filter))
+			continue;
+		if (run_case(&cases[i]))
+			failed++;
+		fflush(stdout);
+	}
+	printf("\n  ]\n}\n");
+
+	xio_shutdown();
+
+	return failed ? 1 : 0;
+}
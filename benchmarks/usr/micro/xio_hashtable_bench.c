@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libxio.h>
+#include <xio_os.h>
+#include "xio_hash.h"
+#include <sys/hashtable.h>
+
+/*
+ * Compares the chained hashtable the caches used with a fixed prime
+ * size against the open addressing HT_* table. N entries sized like a
+ * session are inserted with sequential ids, then looked up in random
+ * order and the found entry is read, as xio_find_session does.
+ */
+
+#define LOOKUPS			1000000
+#define ENTRY_SZ		456
+
+struct bench_entry {
+	uint32_t					id;
+	uint32_t					pad;
+	MULTI_HT_ENTRY(bench_entry, xio_key_int32)	chain_htbl;
+	HT_ENTRY(bench_entry, xio_key_int32)		oa_htbl;
+	char						body[ENTRY_SZ];
+};
+
+/* private to libxio - the bench runs on the default allocator */
+int				allocator_assigned;
+struct xio_mem_allocator	*mem_allocator;
+
+static MULTI_HT_HEAD(, bench_entry, HASHTABLE_PRIME_SMALL)	chain;
+static HT_HEAD(, bench_entry, HASHTABLE_PRIME_SMALL)		oa;
+
+/*---------------------------------------------------------------------------*/
+/* ns_now								     */
+/*---------------------------------------------------------------------------*/
+static uint64_t ns_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------*/
+/* bench_chain								     */
+/*---------------------------------------------------------------------------*/
+static void bench_chain(struct bench_entry **entries, uint32_t *order,
+			int n, double *insert_ns, double *lookup_ns)
+{
+	struct bench_entry	*e;
+	struct xio_key_int32	key = { 0, {0} };
+	uint64_t		start, sum = 0;
+	int			i;
+
+	MULTI_HT_INIT(&chain, xio_int32_hash, xio_int32_cmp, xio_int32_cp);
+	/* keep the key callbacks indirect, as they are in the library */
+	asm volatile("" : : : "memory");
+
+	start = ns_now();
+	for (i = 0; i < n; i++) {
+		key.id = entries[i]->id;
+		MULTI_HT_INSERT(&chain, &key, entries[i], chain_htbl);
+	}
+	*insert_ns = (double)(ns_now() - start) / n;
+
+	start = ns_now();
+	for (i = 0; i < LOOKUPS; i++) {
+		key.id = order[i];
+		MULTI_HT_LOOKUP(&chain, &key, e, chain_htbl);
+		sum += e->id;
+	}
+	*lookup_ns = (double)(ns_now() - start) / LOOKUPS;
+
+	MULTI_HT_FOREACH_SAFE(e, &chain, chain_htbl)
+		MULTI_HT_REMOVE(&chain, e, bench_entry, chain_htbl);
+
+	if (sum == 0 && n > 1)
+		fprintf(stderr, "chain: lookups missed\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* bench_oa								     */
+/*---------------------------------------------------------------------------*/
+static void bench_oa(struct bench_entry **entries, uint32_t *order,
+		     int n, double *insert_ns, double *lookup_ns)
+{
+	struct bench_entry	*e;
+	struct xio_key_int32	key = { 0, {0} };
+	uint64_t		start, sum = 0;
+	int			i;
+
+	HT_INIT(&oa, xio_int32_hash, xio_int32_cmp, xio_int32_cp);
+	asm volatile("" : : : "memory");
+
+	start = ns_now();
+	for (i = 0; i < n; i++) {
+		key.id = entries[i]->id;
+		if (HT_INSERT(&oa, &key, entries[i], oa_htbl)) {
+			fprintf(stderr, "oa: insert failed\n");
+			exit(1);
+		}
+	}
+	*insert_ns = (double)(ns_now() - start) / n;
+
+	start = ns_now();
+	for (i = 0; i < LOOKUPS; i++) {
+		key.id = order[i];
+		HT_LOOKUP(&oa, &key, e, oa_htbl);
+		sum += e->id;
+	}
+	*lookup_ns = (double)(ns_now() - start) / LOOKUPS;
+
+	HT_FOREACH_SAFE(e, &oa, oa_htbl)
+		HT_REMOVE(&oa, e, bench_entry, oa_htbl);
+	if (!HT_EMPTY(&oa))
+		fprintf(stderr, "oa: table not empty\n");
+
+	if (sum == 0 && n > 1)
+		fprintf(stderr, "oa: lookups missed\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	static const int	counts[] = { 10, 100, 1000, 10000, 100000 };
+	struct bench_entry	**entries;
+	uint32_t		*order;
+	double			insert, lookup;
+	unsigned int		i;
+	int			j, n, max_n = 100000;
+
+	if (argc > 1)
+		max_n = atoi(argv[1]);
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	srand(1);
+	order = (uint32_t *)calloc(LOOKUPS, sizeof(*order));
+	if (!order) {
+		fprintf(stderr, "calloc failed\n");
+		return 1;
+	}
+	printf("%-8s %8s %14s %14s\n",
+	       "impl", "entries", "insert[ns]", "lookup[ns]");
+	for (i = 0; i < sizeof(counts)/sizeof(counts[0]); i++) {
+		n = counts[i];
+		if (n > max_n)
+			break;
+		entries = (struct bench_entry **)calloc(n, sizeof(*entries));
+		if (!entries) {
+			fprintf(stderr, "calloc failed\n");
+			return 1;
+		}
+		for (j = 0; j < n; j++) {
+			entries[j] = (struct bench_entry *)
+					calloc(1, sizeof(**entries));
+			if (!entries[j]) {
+				fprintf(stderr, "calloc failed\n");
+				return 1;
+			}
+			entries[j]->id = j;
+		}
+		for (j = 0; j < LOOKUPS; j++)
+			order[j] = rand() % n;
+
+		bench_chain(entries, order, n, &insert, &lookup);
+		printf("%-8s %8d %14.1f %14.1f\n",
+		       "chain", n, insert, lookup);
+
+		bench_oa(entries, order, n, &insert, &lookup);
+		printf("%-8s %8d %14.1f %14.1f\n",
+		       "oa", n, insert, lookup);
+
+		for (j = 0; j < n; j++)
+			free(entries[j]);
+		free(entries);
+	}
+	free(order);
+
+	return 0;
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libxio.h>
+#include <xio_os.h>
+#include "xio_workqueue_priv.h"
+#include "xio_timers_list.h"
+#include "xio_timers_wheel.h"
+
+/*
+ * Compares the sorted timers list with the timing wheel on the delayed
+ * work paths. N timers with durations spread over keepalive like ranges
+ * (1 msec .. 60 sec) are queued, then arm/cancel cost is sampled on top
+ * of them and finally N due timers are expired.
+ */
+
+#define MAX_DURATION_MS		60000
+#define SAMPLES			1000
+
+static uint64_t			fired;
+
+/*---------------------------------------------------------------------------*/
+/* timer_cb								     */
+/*---------------------------------------------------------------------------*/
+static void timer_cb(void *data)
+{
+	fired++;
+}
+
+/*---------------------------------------------------------------------------*/
+/* cmp_u64								     */
+/*---------------------------------------------------------------------------*/
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*---------------------------------------------------------------------------*/
+/* bench_list								     */
+/*---------------------------------------------------------------------------*/
+static void bench_list(xio_delayed_work_handle_t *dworks, uint64_t *durations,
+		       int n, double *arm_ns, double *cancel_ns,
+		       double *expire_ns)
+{
+	struct xio_timers_list	timers_list;
+	uint64_t		start, now;
+	int			i;
+
+	xio_timers_list_init(&timers_list);
+
+	/* durations are sorted, build the queue without the O(n^2) walk */
+	now = xio_timers_list_ns_current_get();
+	for (i = 0; i < n; i++) {
+		dworks[i].timer.expires = now + durations[i];
+		list_add_tail(&dworks[i].timer.entry,
+			      &timers_list.timers_head);
+	}
+
+	start = xio_timers_list_ns_current_get();
+	for (i = 0; i < SAMPLES; i++) {
+		xio_timers_list_lock(&timers_list);
+		xio_timers_list_add_duration(
+				&timers_list,
+				durations[(i * 7919) % n],
+				&dworks[n + i].timer);
+		xio_timers_list_unlock(&timers_list);
+	}
+	*arm_ns = (double)(xio_timers_list_ns_current_get() - start) /
+		  SAMPLES;
+
+	start = xio_timers_list_ns_current_get();
+	for (i = 0; i < SAMPLES; i++) {
+		xio_timers_list_lock(&timers_list);
+		xio_timers_list_del(&timers_list, &dworks[n + i].timer);
+		xio_timers_list_unlock(&timers_list);
+	}
+	*cancel_ns = (double)(xio_timers_list_ns_current_get() - start) /
+		     SAMPLES;
+
+	xio_timers_list_close(&timers_list);
+
+	/* all due, expire cost only */
+	now = xio_timers_list_ns_current_get();
+	for (i = 0; i < n; i++) {
+		dworks[i].work.function = timer_cb;
+		dworks[i].timer.expires = now;
+		list_add_tail(&dworks[i].timer.entry,
+			      &timers_list.timers_head);
+	}
+	fired = 0;
+	start = xio_timers_list_ns_current_get();
+	xio_timers_list_expire(&timers_list);
+	*expire_ns = (double)(xio_timers_list_ns_current_get() - start) / n;
+	if (fired != (uint64_t)n)
+		fprintf(stderr, "list: fired %llu of %d\n",
+			(unsigned long long)fired, n);
+}
+
+/*---------------------------------------------------------------------------*/
+/* bench_wheel								     */
+/*---------------------------------------------------------------------------*/
+static void bench_wheel(xio_delayed_work_handle_t *dworks, uint64_t *durations,
+			int n, double *arm_ns, double *cancel_ns,
+			double *expire_ns)
+{
+	struct xio_timers_wheel	*wheel;
+	uint64_t		start;
+	int			i;
+
+	wheel = (struct xio_timers_wheel *)calloc(1, sizeof(*wheel));
+	if (!wheel) {
+		fprintf(stderr, "calloc failed\n");
+		exit(1);
+	}
+	xio_timers_wheel_init(wheel);
+
+	for (i = 0; i < n; i++)
+		xio_timers_wheel_add_duration(wheel, durations[i],
+					      &dworks[i].timer);
+
+	start = xio_timers_wheel_ns_current_get();
+	for (i = 0; i < SAMPLES; i++) {
+		xio_timers_wheel_lock(wheel);
+		xio_timers_wheel_add_duration(wheel,
+					      durations[(i * 7919) % n],
+					      &dworks[n + i].timer);
+		xio_timers_wheel_unlock(wheel);
+	}
+	*arm_ns = (double)(xio_timers_wheel_ns_current_get() - start) /
+		  SAMPLES;
+
+	start = xio_timers_wheel_ns_current_get();
+	for (i = 0; i < SAMPLES; i++) {
+		xio_timers_wheel_lock(wheel);
+		xio_timers_wheel_del(wheel, &dworks[n + i].timer);
+		xio_timers_wheel_unlock(wheel);
+	}
+	*cancel_ns = (double)(xio_timers_wheel_ns_current_get() - start) /
+		     SAMPLES;
+
+	xio_timers_wheel_close(wheel);
+
+	/* all due, expire cost only */
+	for (i = 0; i < n; i++) {
+		dworks[i].work.function = timer_cb;
+		xio_timers_wheel_add_duration(wheel, 0, &dworks[i].timer);
+	}
+	/* let the tick pass */
+	while (xio_timers_wheel_now_tick(wheel) <= dworks[n - 1].timer.expires)
+		;
+	fired = 0;
+	start = xio_timers_wheel_ns_current_get();
+	xio_timers_wheel_expire(wheel);
+	*expire_ns = (double)(xio_timers_wheel_ns_current_get() - start) / n;
+	if (fired != (uint64_t)n)
+		fprintf(stderr, "wheel: fired %llu of %d\n",
+			(unsigned long long)fired, n);
+
+	free(wheel);
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	static const int		counts[] = { 1000, 10000, 100000 };
+	xio_delayed_work_handle_t	*dworks;
+	uint64_t			*durations;
+	double				arm, cancel, expire;
+	unsigned int			i;
+	int				j, n, max_n = 100000;
+
+	if (argc > 1)
+		max_n = atoi(argv[1]);
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	srand(1);
+	printf("%-8s %8s %14s %14s %14s\n",
+	       "impl", "timers", "arm[ns]", "cancel[ns]", "expire[ns]");
+	for (i = 0; i < sizeof(counts)/sizeof(counts[0]); i++) {
+		n = counts[i];
+		if (n > max_n)
+			break;
+		dworks = (xio_delayed_work_handle_t *)
+				calloc(n + SAMPLES, sizeof(*dworks));
+		durations = (uint64_t *)calloc(n, sizeof(*durations));
+		if (!dworks || !durations) {
+			fprintf(stderr, "calloc failed\n");
+			return 1;
+		}
+		for (j = 0; j < n; j++)
+			durations[j] = (1 + rand() % MAX_DURATION_MS) *
+				       XIO_NS_IN_MSEC;
+		qsort(durations, n, sizeof(*durations), cmp_u64);
+
+		bench_list(dworks, durations, n, &arm, &cancel, &expire);
+		printf("%-8s %8d %14.1f %14.1f %14.1f\n",
+		       "list", n, arm, cancel, expire);
+
+		bench_wheel(dworks, durations, n, &arm, &cancel, &expire);
+		printf("%-8s %8d %14.1f %14.1f %14.1f\n",
+		       "wheel", n, arm, cancel, expire);
+
+		free(durations);
+		free(dworks);
+	}
+
+	return 0;
+}
@@ -221,6 +221,14 @@ enum xio_msg_flags {
 	 */
 	XIO_MSG_FLAG_LAST_IN_BATCH	  = (1 << 4),
 
+	/** high priority. The msg is queued on the connection ahead of
+	 * normal msgs that were not transmitted yet, so a short control
+	 * request does not wait behind bulk transfers. Msgs of the same
+	 * class keep their order, the sn of overtaken requests is shifted
+	 * to follow it. See XIO_CONNECTION_ATTR_PRIORITY
+	 */
+	XIO_MSG_FLAG_HIGH_PRIORITY	  = (1 << 5),
+
 	/* [1<<10 and above - reserved for library usage] */
 };
 
@@ -309,7 +317,72 @@ struct xio_rdma_msg {
  * @brief supported context attributes to query/modify
  */
 enum xio_context_attr_mask {
-	XIO_CONTEXT_ATTR_USER_CTX		= 1 << 0
+	XIO_CONTEXT_ATTR_USER_CTX		= 1 << 0,
+	XIO_CONTEXT_ATTR_SPIN			= 1 << 1,
+	XIO_CONTEXT_ATTR_SPIN_STATS		= 1 << 2, /**< query only    */
+	XIO_CONTEXT_ATTR_EV_LOOP_TYPE		= 1 << 3, /**< query only    */
+	XIO_CONTEXT_ATTR_LATENCY_STATS		= 1 << 4  /**< modify resets */
+};
+
+/**
+ * @struct xio_context_spin_stats
+ * @brief event loop busy-poll statistics
+ */
+struct xio_context_spin_stats {
+	uint64_t		spin_hits;	/**< events found while      */
+						/**< spinning		     */
+	uint64_t		spin_misses;	/**< spin budget expired     */
+						/**< with no events	     */
+	uint64_t		blocked_us;	/**< time blocked in the     */
+						/**< event dispatcher	     */
+	uint32_t		spin_cur_us;	/**< current spin budget     */
+	uint32_t		pad;
+};
+
+/**
+ * @enum xio_latency_stage
+ * @brief stages of a request's life, as seen by the requester
+ */
+enum xio_latency_stage {
+	XIO_LATENCY_QUEUE,	/**< xio_send_request to connection xmit:  */
+				/**< send queue and flow control credits  */
+	XIO_LATENCY_NEXUS,	/**< connection xmit to transport send	   */
+	XIO_LATENCY_TRANSPORT,	/**< transport send to send completion	   */
+	XIO_LATENCY_NETWORK,	/**< transport send to response arrival,   */
+				/**< less the peer's service time	   */
+	XIO_LATENCY_PEER,	/**< peer service time, as reported in the */
+				/**< response header			   */
+	XIO_LATENCY_DELIVERY,	/**< response arrival to on_msg		   */
+	XIO_LATENCY_RELEASE,	/**< on_msg to xio_release_response	   */
+	XIO_LATENCY_TOTAL,	/**< xio_send_request to on_msg		   */
+	XIO_LATENCY_STAGE_LAST
+};
+
+/** log-linear buckets: values below 4ns map to themselves, above that
+ *  every power of two is split into 4 equal buckets, i.e. bucket
+ *  4 * (e - 1) + ((ns >> (e - 2)) & 3) where e = floor(log2(ns)).
+ *  the last bucket collects everything above ~18 minutes
+ */
+#define XIO_LATENCY_BUCKETS	160
+
+/**
+ * @struct xio_latency_hist
+ * @brief latency histogram of one stage
+ */
+struct xio_latency_hist {
+	uint64_t		count;		/**< samples		     */
+	uint64_t		sum_ns;		/**< sum of samples	     */
+	uint64_t		max_ns;		/**< largest sample	     */
+	uint64_t		bucket[XIO_LATENCY_BUCKETS];
+};
+
+/**
+ * @struct xio_latency_stats
+ * @brief per context request latency breakdown. collected while
+ *	  XIO_OPTNAME_ENABLE_LATENCY_STATS is set
+ */
+struct xio_latency_stats {
+	struct xio_latency_hist	stage[XIO_LATENCY_STAGE_LAST];
 };
 
 /**
@@ -320,6 +393,16 @@ struct xio_context_attr {
 	void			*user_context;  /**< private user context to */
 						/**< pass to connection      */
 						/**< oriented callbacks      */
+	int			spin_us;	/**< max busy-poll duration  */
+						/**< before blocking, 0 - off*/
+	int			spin_adaptive;	/**< adapt spin duration to  */
+						/**< idle/busy history	     */
+	struct xio_context_spin_stats spin_stats; /**< busy-poll counters    */
+	int			ev_loop_type;	/**< event dispatcher in use */
+						/**< (user space only)	     */
+	int			pad;
+	struct xio_latency_stats *latency_stats; /**< user buffer filled  */
+						/**< by xio_query_context    */
 };
 
 /**
@@ -403,7 +486,8 @@ enum xio_session_type {
  */
 enum xio_proto {
 	XIO_PROTO_RDMA,		/**< Infiniband's RDMA protocol		     */
-	XIO_PROTO_TCP		/**< TCP protocol - userspace only	     */
+	XIO_PROTO_TCP,		/**< TCP protocol - userspace only	     */
+	XIO_PROTO_SHM		/**< shared memory - userspace, same host    */
 };
 
 /**
@@ -432,7 +516,32 @@ enum xio_session_event {
 enum xio_session_attr_mask {
 	XIO_SESSION_ATTR_USER_CTX		= 1 << 0,
 	XIO_SESSION_ATTR_SES_OPS		= 1 << 1,
-	XIO_SESSION_ATTR_URI			= 1 << 2
+	XIO_SESSION_ATTR_URI			= 1 << 2,
+	XIO_SESSION_ATTR_LB_POLICY		= 1 << 3
+};
+
+/**
+ * @enum xio_session_lb_policy
+ * @brief connection selection policy of xio_session_send_request
+ */
+enum xio_session_lb_policy {
+	XIO_SESSION_LB_ROUND_ROBIN,	  /**< connections in turn	      */
+	XIO_SESSION_LB_LEAST_OUTSTANDING, /**< fewest requests awaiting a     */
+					  /**< response			      */
+	XIO_SESSION_LB_P2C_LATENCY	  /**< better of two random choices  */
+					  /**< by response latency and load   */
+};
+
+/**
+ * @enum xio_flow_control
+ * @brief values of XIO_OPTNAME_ENABLE_FLOW_CONTROL
+ */
+enum xio_flow_control {
+	XIO_FLOW_CONTROL_NONE,		  /**< no credits are exchanged	      */
+	XIO_FLOW_CONTROL_STATIC,	  /**< fixed window of receive queue  */
+					  /**< depth			      */
+	XIO_FLOW_CONTROL_ADAPTIVE	  /**< receiver grows or shrinks the  */
+					  /**< window by release rate	      */
 };
 
 /**
@@ -461,6 +570,9 @@ struct xio_session_attr {
 	struct xio_session_ops	*ses_ops;	/**< session's ops callbacks  */
 	void			*user_context;  /**< session user context     */
 	char			*uri;		/**< the uri		      */
+	enum xio_session_lb_policy lb_policy;	/**< xio_session_send_request */
+						/**< connection selection     */
+	int			pad;		/**< padding		      */
 };
 
 /**
@@ -752,6 +864,8 @@ enum xio_connection_attr_mask {
 	XIO_CONNECTION_ATTR_PEER_ADDR		= 1 << 3,
 	XIO_CONNECTION_ATTR_LOCAL_ADDR		= 1 << 4,
 	XIO_CONNECTION_ATTR_DISCONNECT_TIMEOUT	= 1 << 5,
+	XIO_CONNECTION_ATTR_AGGREGATION		= 1 << 6,
+	XIO_CONNECTION_ATTR_PRIORITY		= 1 << 7,
 };
 
 /**
@@ -769,6 +883,18 @@ struct xio_connection_attr {
 	enum xio_proto		proto;	        /**< protocol type           */
 	struct sockaddr_storage	peer_addr;	/**< address of peer	     */
 	struct sockaddr_storage	local_addr;	/**< address of local	     */
+	uint32_t		aggr_max_bytes; /**< pack small one way msgs */
+						/**< into frames up to this  */
+						/**< size, 0 - disabled      */
+	uint32_t		aggr_delay_ms;  /**< max time a partial frame */
+						/**< waits for more messages */
+	uint16_t		prio_weight;	/**< high priority msgs that */
+						/**< may overtake a waiting  */
+						/**< normal msg, 0 - strict  */
+	uint16_t		prio_pad;	/**< padding                 */
+	uint32_t		prio_bulk_bytes; /**< normal msgs this large */
+						/**< wait while transport is */
+						/**< backed up, 0 - disabled */
 };
 
 /**
@@ -1036,6 +1162,30 @@ struct xio_server *xio_bind(struct xio_context *ctx,
 			    uint32_t flags,
 			    void *cb_user_context);
 
+/**
+ * open one shard of a server listener. Each worker context calls
+ * xio_bind_sharded with the same tcp uri; the listeners share the address
+ * (SO_REUSEPORT), the kernel spreads incoming connections between them,
+ * and sessions are accepted on - and stay on - the context whose shard
+ * received them. Shards are torn down with xio_unbind.
+ *
+ * @param[in] ctx	The xio context handle
+ * @param[in] ops	Structure of server's event handlers
+ * @param[in] uri	tcp uri to bind - must name an explicit port
+ * @param[in] src_port  Returned listen port in host order, can be NULL
+ *			if not needed
+ * @param[in] flags	Message related flags as defined in enum xio_msg_flags
+ * @param[in] cb_user_context Private data pointer to pass to each callback
+ *
+ * @return xio server context, or NULL upon error
+ */
+struct xio_server *xio_bind_sharded(struct xio_context *ctx,
+				    struct xio_session_ops *ops,
+				    const char *uri,
+				    uint16_t *src_port,
+				    uint32_t flags,
+				    void *cb_user_context);
+
 /**
  * teardown a server
  *
@@ -1158,6 +1308,23 @@ enum xio_optname {
 	XIO_OPTNAME_ENABLE_KEEPALIVE,
 	/**< configure keep alive variables.type: struct xio_options_keepalive*/
 	XIO_OPTNAME_CONFIG_KEEPALIVE,
+	/**< enables/disables request latency breakdown, see
+	 *   XIO_CONTEXT_ATTR_LATENCY_STATS. disabled by default. type: int  */
+	XIO_OPTNAME_ENABLE_LATENCY_STATS,
+	/**< publishes per context and per connection counters in a shared
+	 *   memory segment (/dev/shm/xio-stats.<pid>) read by xio_top.
+	 *   set before creating contexts; the XIO_STATS_SHM environment
+	 *   variable overrides it. disabled by default. type: int	      */
+	XIO_OPTNAME_ENABLE_STATS_SHM,
+	/**< log asynchronously - log calls only record the format and the
+	 *   arguments in a per thread ring, a background thread formats
+	 *   them and calls the log fn. records are dropped, not waited
+	 *   for, when a ring is full. the XIO_LOG_ASYNC environment
+	 *   variable sets it too. disabled by default. type: int	      */
+	XIO_OPTNAME_LOG_ASYNC,
+	/**< get only. number of log records dropped by async logging.
+	 *   type: uint64_t						      */
+	XIO_OPTNAME_LOG_DROPPED,
 
 	/* XIO_OPTLEVEL_ACCELIO/RDMA/TCP */
 	/** message's max in iovec. This flag indicates what will be the max
@@ -1190,7 +1357,9 @@ enum xio_optname {
 	 * to process them, it can cause the server side to run out of memory.
 	 * This case is more common in one way msgs. User can configure flow
 	 * control and the msgs will stay in queues on client side. Both sides
-	 * need to configure the queue depth to be the same.
+	 * need to configure the queue depth to be the same. The value is one
+	 * of enum xio_flow_control; in adaptive mode the receiver resizes
+	 * the window it grants within the receive queue depth.
 	 */
 	XIO_OPTNAME_ENABLE_FLOW_CONTROL,
 	/** maximum tx queued msgs. Default value is 1024                     */
@@ -1286,6 +1455,39 @@ enum xio_optname {
 	 * xio_connection 2 file descriptors are used.
 	 */
 	XIO_OPTNAME_TCP_DUAL_STREAM,
+	/** zero-copy send threshold. Data sends of at least this many bytes
+	 * use MSG_ZEROCOPY (Linux 4.14 and above) and their send completion
+	 * is reported only after the kernel released the pages. The user
+	 * buffer must not be modified before then. 0 disables zero-copy,
+	 * which is the default.
+	 */
+	XIO_OPTNAME_TCP_ZEROCOPY_THRESHOLD,
+	/** zero-copy counters - get only. optval points to
+	 * struct xio_tcp_zerocopy_stats
+	 */
+	XIO_OPTNAME_TCP_ZEROCOPY_STATS,
+	/** size in bytes of the per connection receive ring. Headers, and
+	 * on single stream connections small payloads, are read from the
+	 * socket in bulk into the ring and parsed from there, so a burst
+	 * of small messages costs a single recv. Rings of 2MB and above
+	 * are backed by huge pages when available. 0 reverts single stream
+	 * connections to one recvmsg per header and payload.
+	 */
+	XIO_OPTNAME_TCP_RX_RING_SIZE,
+};
+
+/**
+ * @struct xio_tcp_zerocopy_stats
+ * @brief process wide tcp send counters (XIO_OPTNAME_TCP_ZEROCOPY_STATS)
+ */
+struct xio_tcp_zerocopy_stats {
+	uint64_t		zerocopy_bytes;	/**< bytes sent with	     */
+						/**< MSG_ZEROCOPY	     */
+	uint64_t		copied_bytes;	/**< bytes sent through the  */
+						/**< copying path	     */
+	uint64_t		zerocopy_sends;	/**< MSG_ZEROCOPY sends	     */
+	uint64_t		deferred_copies;/**< zero-copy sends the     */
+						/**< kernel copied anyway    */
 };
 
 /**
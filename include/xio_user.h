@@ -235,6 +235,16 @@ static inline void xio_reinit_msg(struct xio_msg *msg)
  */
 #define XIO_INFINITE			-1
 
+/**
+ * @enum xio_ev_loop_type
+ * @brief internal event dispatcher implementation
+ */
+enum xio_ev_loop_type {
+	XIO_EV_LOOP_EPOLL		= 0,	/**< epoll (default)	     */
+	XIO_EV_LOOP_IO_URING		= 1	/**< io_uring, falls back to */
+						/**< epoll if unsupported    */
+};
+
 /**
  * @struct xio_context_params
  * @brief context creation parameters structure
@@ -257,6 +267,19 @@ struct xio_context_params {
 	* pass 0 if want the depth to remain default (XIO_MAX_IOV + constant) */
 	int                     rq_depth;
 
+	/**< busy-poll the event loop up to spin_us microseconds before    */
+	/**< blocking. 0 - always block (default)			       */
+	int			spin_us;
+
+	/**< adapt the spin duration to the recent idle/busy history	       */
+	int			spin_adaptive;
+
+	/**< event dispatcher implementation (enum xio_ev_loop_type)	       */
+	int			ev_loop_type;
+
+	/**< free task slabs that stayed idle for about tasks_pool_idle_ms  */
+	/**< milliseconds. 0 - task pools never shrink (default)	       */
+	int			tasks_pool_idle_ms;
 };
 
 
@@ -404,6 +427,95 @@ void xio_context_stop_loop(struct xio_context *ctx);
  */
 int xio_context_poll_wait(struct xio_context *ctx, int timeout_ms);
 
+/*---------------------------------------------------------------------------*/
+/* cross thread submission						     */
+/*---------------------------------------------------------------------------*/
+
+/**
+ * post a work item to be run by the thread that runs the context's loop
+ *
+ * may be called from any thread. posts are queued in a lock-free ring
+ * and drained in batches by the loop; wakeups are coalesced so a burst
+ * of posts costs at most one system call
+ *
+ * @param[in] ctx	The xio context handle
+ * @param[in] function	function to call on the loop thread
+ * @param[in] data	user data passed to function
+ *
+ * @return 0 on success, or -1 on error (EAGAIN if the queue is full).
+ *	    If an error occurs, call xio_errno function to get the failure
+ *	    reason.
+ */
+int xio_context_post_work(struct xio_context *ctx,
+			  void (*function)(void *data), void *data);
+
+/**
+ * post a request to be sent by the connection's context loop thread
+ *
+ * may be called from any thread. the request is sent with
+ * xio_send_request on the loop thread; if that fails the error is
+ * reported through the session's on_msg_error callback
+ *
+ * @param[in] conn	The xio connection handle
+ * @param[in] req	request message to send
+ *
+ * @return 0 on success, or -1 on error (EAGAIN if the queue is full).
+ *	    If an error occurs, call xio_errno function to get the failure
+ *	    reason.
+ */
+int xio_post_request(struct xio_connection *conn, struct xio_msg *req);
+
+/**
+ * post a response to be sent by the connection's context loop thread
+ *
+ * may be called from any thread, see xio_post_request
+ *
+ * @param[in] rsp	Response to send
+ *
+ * @return 0 on success, or -1 on error (EAGAIN if the queue is full).
+ *	    If an error occurs, call xio_errno function to get the failure
+ *	    reason.
+ */
+int xio_post_response(struct xio_msg *rsp);
+
+/**
+ * post a one way message to be sent by the connection's context loop
+ * thread
+ *
+ * may be called from any thread, see xio_post_request
+ *
+ * @param[in] conn	The xio connection handle
+ * @param[in] msg	The message to send
+ *
+ * @return 0 on success, or -1 on error (EAGAIN if the queue is full).
+ *	    If an error occurs, call xio_errno function to get the failure
+ *	    reason.
+ */
+int xio_post_msg(struct xio_connection *conn, struct xio_msg *msg);
+
+/**
+ * send request to responder on a connection picked by the session's load
+ * balancing policy (see XIO_SESSION_ATTR_LB_POLICY)
+ *
+ * may be called from any thread. if the picked connection runs on ctx
+ * the request is sent in place, otherwise it is posted to the
+ * connection's context as with xio_post_request. a list of requests
+ * chained by next goes to a single connection. a connection may be
+ * destroyed concurrently: the pick keeps its memory until the posted
+ * request ran, and a request that reaches a closed connection is
+ * dropped and logged
+ *
+ * @param[in] session	The xio session handle
+ * @param[in] ctx	The context run by the calling thread, or NULL
+ * @param[in] req	request message to send
+ *
+ * @return 0 on success, or -1 on error.  If an error occurs, call
+ *	    xio_errno function to get the failure reason.
+ */
+int xio_session_send_request(struct xio_session *session,
+			     struct xio_context *ctx,
+			     struct xio_msg *req);
+
 
 /*---------------------------------------------------------------------------*/
 /* library initialization routines					     */
@@ -513,7 +625,12 @@ enum xio_mempool_flag {
 	/**< do not allocate buffers from larger slabs,
 	 *   if the smallest slab is empty
 	 */
-	XIO_MEMPOOL_FLAG_USE_SMALLEST_SLAB	= 0x0016
+	XIO_MEMPOOL_FLAG_USE_SMALLEST_SLAB	= 0x0016,
+	/**< keep one slab set per numa node, serve allocations from the
+	 *   caller's current node and return blocks to their home node.
+	 *   implies XIO_MEMPOOL_FLAG_NUMA_ALLOC, nodeid is ignored
+	 */
+	XIO_MEMPOOL_FLAG_PER_NODE		= 0x0020
 };
 
 /**
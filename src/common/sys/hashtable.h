@@ -1,6 +1,8 @@
 #ifndef SYS_HASHTABLE_H
 #define SYS_HASHTABLE_H
 
+#include <xio_os.h>
+
 typedef unsigned int hash_func_t(const void *key);
 typedef int key_cmp_func_t (const void *key1, const void *key2);
 typedef void key_cp_func_t(void *keydst, const void *keysrc);
@@ -9,6 +11,7 @@ typedef void key_cp_func_t(void *keydst, const void *keysrc);
  * Generic hashtable template
  */
 
+#define HASHTABLE_PRIME_MINI	7
 #define HASHTABLE_PRIME_TINY	49
 #define HASHTABLE_PRIME_SMALL	149
 #define HASHTABLE_PRIME_MEDIUM	977
@@ -125,44 +128,328 @@ for ((head)->tmp_i = 0;							\
 		if ((h)->cmpfunc(k, &d->f.keycopy))
 
 /*
- * Hashtable definitions
+ * Open addressing hashtable
+ *
+ * Keys of up to 8 bytes are copied inline next to the entry pointer in a
+ * power of two slot array, so a probe sequence stays within one or two
+ * cache lines and only the matching entry is dereferenced. Keys are
+ * normalized by the copy function into a zeroed word and compared as
+ * such, so only keys that compare bitwise (integers, pointers) may be
+ * used. Collisions are resolved by linear probing and removal leaves a
+ * tombstone. When the array is half used a new one is allocated and the
+ * old one is drained a few slots on every insert. Lookups do not change
+ * the table and search both arrays until the old one is empty, removal
+ * only leaves a tombstone, so HT_FOREACH sees every entry exactly once
+ * as long as nothing is inserted inside the loop. The old array is freed
+ * when its last entry is moved or removed, and the table when its last
+ * entry is removed.
+ *
+ * Inserts run under the callers spinlocks, so in the kernel the arrays
+ * are allocated atomically. If that fails the table keeps filling the
+ * current array and the insert fails only when it has no room left.
  */
 
+#define HASHTABLE_OA_MIN_SIZE	8
+#define HASHTABLE_OA_MIGRATE_NR	8
+#define HASHTABLE_OA_TOMB	((void *)1)
+
+#ifdef GFP_ATOMIC
+#define HASHTABLE_OA_GFP	GFP_ATOMIC
+#else
+#define HASHTABLE_OA_GFP	GFP_KERNEL
+#endif
+
+struct hashtable_oa_slot {
+	uint64_t			key;
+	void				*entry; /* NULL - free */
+};
+
+struct hashtable_oa {
+	struct hashtable_oa_slot	*slots;
+	struct hashtable_oa_slot	*old_slots; /* being drained */
+	unsigned int			mask;
+	unsigned int			old_mask;
+	unsigned int			used;	/* live and tombstones */
+	unsigned int			migrate_i;
+	int				count;
+	int				old_count; /* live in old_slots */
+	hash_func_t			*hfunc;
+	key_cp_func_t			*cpfunc;
+};
+
+static inline void hashtable_oa_init(struct hashtable_oa *t,
+				     hash_func_t *hfunc,
+				     key_cp_func_t *cpfunc)
+{
+	memset(t, 0, sizeof(*t));
+	t->hfunc = hfunc;
+	t->cpfunc = cpfunc;
+}
+
+static inline uint64_t hashtable_oa_key(const struct hashtable_oa *t,
+					const void *key)
+{
+	uint64_t k = 0;
+
+	t->cpfunc(&k, key);
+
+	return k;
+}
+
+static inline void hashtable_oa_destroy(struct hashtable_oa *t)
+{
+	kfree(t->slots);
+	kfree(t->old_slots);
+	t->slots = NULL;
+	t->old_slots = NULL;
+	t->mask = 0;
+	t->used = 0;
+	t->count = 0;
+	t->old_count = 0;
+}
+
+static inline void hashtable_oa_old_free(struct hashtable_oa *t)
+{
+	kfree(t->old_slots);
+	t->old_slots = NULL;
+	t->old_count = 0;
+}
+
+static inline struct hashtable_oa_slot *hashtable_oa_probe(
+		struct hashtable_oa_slot *slots, unsigned int mask,
+		unsigned int hash, uint64_t k, const void *entry)
+{
+	struct hashtable_oa_slot *s;
+	unsigned int i = hash & mask;
+
+	while (1) {
+		s = &slots[i];
+		if (!s->entry)
+			return NULL;
+		if (s->key == k && s->entry != HASHTABLE_OA_TOMB &&
+		    (!entry || s->entry == entry))
+			return s;
+		i = (i + 1) & mask;
+	}
+}
+
+static inline struct hashtable_oa_slot *hashtable_oa_find(
+		const struct hashtable_oa *t, const void *key,
+		const void *entry)
+{
+	struct hashtable_oa_slot *s;
+	unsigned int hash;
+	uint64_t k;
+
+	if (!t->count)
+		return NULL;
+
+	k = hashtable_oa_key(t, key);
+	hash = t->hfunc(&k);
+	s = hashtable_oa_probe(t->slots, t->mask, hash, k, entry);
+	if (!s && t->old_slots)
+		s = hashtable_oa_probe(t->old_slots, t->old_mask,
+				       hash, k, entry);
+	return s;
+}
+
+
+/* returns 1 if a free slot was consumed, 0 if a tombstone was reused */
+static inline int hashtable_oa_place(struct hashtable_oa *t,
+				     uint64_t k, void *entry)
+{
+	struct hashtable_oa_slot *s;
+	unsigned int i = t->hfunc(&k) & t->mask;
+
+	while (1) {
+		s = &t->slots[i];
+		if (!s->entry || s->entry == HASHTABLE_OA_TOMB)
+			break;
+		i = (i + 1) & t->mask;
+	}
+	s->key = k;
+	if (s->entry) {
+		s->entry = entry;
+		return 0;
+	}
+	s->entry = entry;
+
+	return 1;
+}
 
-#define _HT_LFIELD	mpfld
+static inline void hashtable_oa_migrate(struct hashtable_oa *t,
+					unsigned int nr)
+{
+	struct hashtable_oa_slot *s;
+
+	while (t->old_slots && nr--) {
+		s = &t->old_slots[t->migrate_i];
+		if (s->entry && s->entry != HASHTABLE_OA_TOMB) {
+			t->used += hashtable_oa_place(t, s->key, s->entry);
+			s->entry = HASHTABLE_OA_TOMB;
+			t->old_count--;
+		}
+		if (t->migrate_i++ == t->old_mask || !t->old_count)
+			hashtable_oa_old_free(t);
+	}
+}
+
+static inline void *hashtable_oa_lookup(const struct hashtable_oa *t,
+					const void *key)
+{
+	struct hashtable_oa_slot *s;
+
+	s = hashtable_oa_find(t, key, NULL);
+
+	return s ? s->entry : NULL;
+}
+
+static inline int hashtable_oa_grow(struct hashtable_oa *t)
+{
+	struct hashtable_oa_slot *slots;
+	unsigned int size = HASHTABLE_OA_MIN_SIZE;
+
+	/* let the previous resize complete first */
+	hashtable_oa_migrate(t, ~0U);
+
+	if (t->slots) {
+		size = t->mask + 1;
+		/* same size when it is mostly tombstones */
+		if ((unsigned int)t->count > size / 4)
+			size <<= 1;
+	}
+	slots = (struct hashtable_oa_slot *)
+			kcalloc(size, sizeof(*slots), HASHTABLE_OA_GFP);
+	if (!slots)
+		return -1;
+
+	t->old_slots = t->slots;
+	t->old_mask = t->mask;
+	t->old_count = t->old_slots ? t->count : 0;
+	t->migrate_i = 0;
+	t->slots = slots;
+	t->mask = size - 1;
+	t->used = 0;
+
+	return 0;
+}
+
+static inline int hashtable_oa_insert(struct hashtable_oa *t,
+				      const void *key, void *entry)
+{
+	hashtable_oa_migrate(t, HASHTABLE_OA_MIGRATE_NR);
+
+	if (!t->slots || (t->used + 1) * 2 > t->mask + 1) {
+		/* an overloaded table still works while it has room */
+		if (hashtable_oa_grow(t) &&
+		    (!t->slots || t->used >= t->mask))
+			return -1;
+	}
+	t->used += hashtable_oa_place(t, hashtable_oa_key(t, key), entry);
+	t->count++;
+
+	return 0;
+}
+
+static inline void *hashtable_oa_remove(struct hashtable_oa *t,
+					const void *key, const void *entry)
+{
+	struct hashtable_oa_slot *s = hashtable_oa_find(t, key, entry);
+	void *var;
+
+	if (!s)
+		return NULL;
+
+	var = s->entry;
+	s->entry = HASHTABLE_OA_TOMB;
+	if (--t->count == 0) {
+		hashtable_oa_destroy(t);
+	} else if (t->old_slots && s >= t->old_slots &&
+		   s <= t->old_slots + t->old_mask) {
+		if (--t->old_count == 0)
+			hashtable_oa_old_free(t);
+	}
+
+	return var;
+}
+
+static inline void *hashtable_oa_next(const struct hashtable_oa *t,
+				      unsigned int *i)
+{
+	struct hashtable_oa_slot *s;
+	unsigned int size = t->slots ? t->mask + 1 : 0;
+	unsigned int old_size = t->old_slots ? t->old_mask + 1 : 0;
+
+	while (*i < size + old_size) {
+		s = (*i < size) ? &t->slots[*i] : &t->old_slots[*i - size];
+		(*i)++;
+		if (s->entry && s->entry != HASHTABLE_OA_TOMB)
+			return s->entry;
+	}
+
+	return NULL;
+}
+
+/* keys are stored inline in the slots */
+#define HASHTABLE_OA_KEY_CHECK(key)					\
+	((void)sizeof(char[1 - 2 * (sizeof(*(key)) > sizeof(uint64_t))]))
+
+/*
+ * Hashtable definitions
+ *
+ * The prime size is kept for source compatibility, open addressing
+ * tables start small and grow with the number of entries.
+ */
 
 #define HT_HEAD(name, type, prime)					\
-	HASHTABLE_HEAD(name, type, prime)
+struct name {								\
+	struct hashtable_oa oa;						\
+	unsigned int tmp_i;						\
+	unsigned int tmp_pad;						\
+}
 
 #define HT_ENTRY(type, keytype)						\
-	HASHTABLE_ENTRY(type, keytype, _HT_LFIELD)
+struct {								\
+	struct keytype keycopy;						\
+}
 
 #define HT_KEY(var, field)						\
 	HASHTABLE_KEY(var, field)
 
 #define HT_INIT(head, _hfunc, _cmpfunc, _cpfunc)			\
-	HASHTABLE_INIT(head, _hfunc, _cmpfunc, _cpfunc)
+	hashtable_oa_init(&(head)->oa, (hash_func_t *)_hfunc,		\
+			  (key_cp_func_t *)_cpfunc)
+
+#define HT_DESTROY(head)						\
+	hashtable_oa_destroy(&(head)->oa)
 
 #define HT_EMPTY(head)							\
-	HASHTABLE_EMPTY(head)
+	((head)->oa.count == 0)
 
 #define HT_FOREACH(var, head, field)					\
-	HASHTABLE_FOREACH(var, head, field, _HT_LFIELD)
+	for ((head)->tmp_i = 0;						\
+	     ((var) = (typeof(var))hashtable_oa_next(&(head)->oa,	\
+						     &(head)->tmp_i));)
 
+/* removal leaves a tombstone, so iteration is always safe */
 #define HT_FOREACH_SAFE(var, head, field)				\
-	HASHTABLE_FOREACH_SAFE(var, head, field, _HT_LFIELD)
+	HT_FOREACH(var, head, field)
 
 #define HT_REMOVE(head, var, type, field)				\
-	HASHTABLE_REMOVE(head, var, type, field, _HT_LFIELD)
+	hashtable_oa_remove(&(head)->oa, &(var)->field.keycopy, (var))
 
 #define HT_REMOVE_BY_KEY(head, key, type, field)			\
-	HASHTABLE_REMOVE_BY_KEY(head, key, type, field, _HT_LFIELD)
+	hashtable_oa_remove(&(head)->oa, (key), NULL)
 
-#define HT_LOOKUP(head, key, var, field)				\
-	HASHTABLE_LOOKUP(head, key, var, field, _HT_LFIELD)
+#define HT_LOOKUP(head, key, var, field) do {				\
+	HASHTABLE_OA_KEY_CHECK(key);					\
+	(var) = (typeof(var))hashtable_oa_lookup(&(head)->oa, (key));	\
+} while (0)
 
 #define HT_INSERT(head, key, var, field)				\
-	HASHTABLE_INSERT(head, key, var, field, _HT_LFIELD)
+	(HASHTABLE_OA_KEY_CHECK(key),					\
+	 (head)->oa.cpfunc(&(var)->field.keycopy, (key)),		\
+	 hashtable_oa_insert(&(head)->oa, (key), (var)))
 
 /*
  * Multi hashtable definitions
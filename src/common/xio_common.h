@@ -86,6 +86,8 @@ enum xio_msg_flags_ex {
 	XIO_MSG_FLAG_EX_IMM_READ_RECEIPT  = BIT(10), /**< immediate receipt  */
 	XIO_MSG_FLAG_EX_RECEIPT_FIRST	  = BIT(11), /**< read receipt first */
 	XIO_MSG_FLAG_EX_RECEIPT_LAST	  = BIT(12), /**< read receipt last  */
+	XIO_MSG_FLAG_EX_AGGREGATED	  = BIT(13), /**< aggregated frame   */
+	XIO_MSG_FLAG_EX_REQUEUED	  = BIT(14), /**< sent, now requeued */
 };
 
 #define xio_clear_ex_flags(flag) \
@@ -200,6 +202,8 @@ struct xio_options {
 	int			inline_xio_data_align;
 	int			enable_keepalive;
 	int			transport_close_timeout;
+	int			enable_latency_stats;
+	int			enable_stats_shm;
 	int			pad;
 
 	struct xio_options_keepalive ka;
@@ -222,7 +226,8 @@ PACKED_MEMORY(struct xio_session_hdr {
 	uint16_t		sn;		/* serial number	*/
 	uint16_t		ack_sn;		/* ack serial number	*/
 	uint16_t		credits_msgs;
-	uint16_t		pad[3];
+	uint16_t		credits_stalls;	/* sender stalled on credits */
+	uint32_t		service_ns;	/* responder service time */
 	uint32_t		receipt_result;
 	uint64_t		credits_bytes;
 	uint64_t		connection;
@@ -236,17 +241,39 @@ PACKED_MEMORY(struct xio_session_hdr {
 	uint16_t		sn;		/* serial number	*/
 	uint16_t		ack_sn;		/* ack serial number	*/
 	uint16_t		credits_msgs;
-	uint16_t		pad[3];
+	uint16_t		credits_stalls;	/* sender stalled on credits */
+	uint32_t		service_ns;	/* responder service time */
 	uint32_t		receipt_result;
 	uint64_t		credits_bytes;
 });
 #endif
 
+/* record that precedes every one way message packed into an aggregated
+ * frame. the frame data is a sequence of records each followed by the
+ * message header and data bytes
+ */
+PACKED_MEMORY(struct xio_aggr_hdr {
+	uint64_t		serial_num;
+	uint32_t		hdr_len;
+	uint32_t		data_len;
+});
+
 /* setup flags */
 #define XIO_CID			1
 
 #define XIO_RECONNECT		(XIO_CID)
 
+/* sender can exchange headers in its host byte order. when both peers
+ * offer the same order the headers are copied as is, otherwise they
+ * stay in network order
+ */
+#define XIO_NATIVE_HDR_LE	2
+#define XIO_NATIVE_HDR_BE	4
+#define XIO_NATIVE_HDR_MASK	(XIO_NATIVE_HDR_LE | XIO_NATIVE_HDR_BE)
+
+#define XIO_NATIVE_HDR		(htonl(1) == 1 ? XIO_NATIVE_HDR_BE : \
+						 XIO_NATIVE_HDR_LE)
+
 PACKED_MEMORY(struct xio_nexus_setup_req {
 	uint16_t		version;
 	uint16_t		flags;
@@ -57,9 +57,17 @@
 #include "xio_session.h"
 #include "xio_connection.h"
 #include <xio_env_adv.h>
+#ifdef XIO_CFLAG_STAT_COUNTERS
+#include "xio_stats_shm.h"
+#endif
 
 #define MSG_POOL_SZ			1024
 #define XIO_IOV_THRESHOLD		20
+#define XIO_KA_SWEEP_MS			1000
+#define XIO_FC_MIN_WINDOW		4
+#define XIO_FC_ACK_DELAY_MS		1
+#define XIO_DEF_PRIO_WEIGHT		16
+#define XIO_BULK_RETRY_MS		1
 
 static struct xio_transition xio_transition_table[][2] = {
 /* INIT */	  {
@@ -121,8 +129,9 @@ static struct xio_transition xio_transition_table[][2] = {
 
 static void xio_connection_post_destroy(struct kref *kref);
 static void xio_connection_teardown_handler(void *connection_);
-static void xio_connection_keepalive_time(void *_connection);
+static void xio_connection_keepalive_sweep(void *_ctx);
 static void xio_close_time_wait(void *data);
+static int xio_connection_xmit(struct xio_connection *connection);
 
 struct xio_managed_rkey {
 	struct list_head	list_entry;
@@ -219,6 +228,7 @@ struct xio_connection *xio_connection_create(struct xio_session *session,
 		connection->cb_user_context = cb_user_context;
 
 	        connection->disconnect_timeout = XIO_DEF_CONNECTION_TIMEOUT;
+		connection->prio_weight	= XIO_DEF_PRIO_WEIGHT;
 
 		memcpy(&connection->ses_ops, &session->ses_ops,
 		       sizeof(session->ses_ops));
@@ -227,6 +237,7 @@ struct xio_connection *xio_connection_create(struct xio_session *session,
 		INIT_LIST_HEAD(&connection->io_tasks_list);
 		INIT_LIST_HEAD(&connection->post_io_tasks_list);
 		INIT_LIST_HEAD(&connection->pre_send_list);
+		INIT_LIST_HEAD(&connection->ka.ka_list_entry);
 
 		xio_msg_list_init(&connection->reqs_msgq);
 		xio_msg_list_init(&connection->rsps_msgq);
@@ -235,9 +246,13 @@ struct xio_connection *xio_connection_create(struct xio_session *session,
 		xio_msg_list_init(&connection->in_flight_rsps_msgq);
 
 		kref_init(&connection->kref);
+		kref_init(&connection->post_kref);
 		spin_lock(&ctx->ctx_list_lock);
 		list_add_tail(&connection->ctx_list_entry, &ctx->ctx_list);
 		spin_unlock(&ctx->ctx_list_lock);
+#ifdef XIO_CFLAG_STAT_COUNTERS
+		xio_stats_shm_conn_add(connection);
+#endif
 
 		return connection;
 }
@@ -280,6 +295,79 @@ static void xio_connection_set_ow_send_comp_params(struct xio_msg *msg)
 	set_bits(XIO_MSG_FLAG_IMM_SEND_COMP, &msg->flags);
 }
 
+#ifdef XIO_CFLAG_STAT_COUNTERS
+/*---------------------------------------------------------------------------*/
+/* xio_connection_service_ns						     */
+/*---------------------------------------------------------------------------*/
+static inline uint32_t xio_connection_service_ns(struct xio_task *task)
+{
+	uint64_t ns;
+
+	/* time since the request was delivered, reported to the requester */
+	if (!task->imsg.timestamp)
+		return 0;
+	ns = xio_lat_cycles_to_ns(get_cycles() - task->imsg.timestamp);
+
+	return ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_lat_account						     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_lat_account(struct xio_connection *connection,
+				       struct xio_task *task)
+{
+	struct xio_context	*ctx = connection->ctx;
+	uint64_t		*ts = task->lat_ts;
+	uint64_t		submit = task->omsg->timestamp;
+	uint64_t		wire, peer;
+
+	/* stamps are taken only while enabled - skip partial requests */
+	if (!ts[XIO_TASK_LAT_XMIT] || ts[XIO_TASK_LAT_XMIT] < submit ||
+	    ts[XIO_TASK_LAT_RSP] < ts[XIO_TASK_LAT_XMIT])
+		return;
+
+	xio_ctx_lat_record(ctx, XIO_LATENCY_QUEUE,
+			   xio_lat_cycles_to_ns(ts[XIO_TASK_LAT_XMIT] -
+						submit));
+	if (ts[XIO_TASK_LAT_TX] >= ts[XIO_TASK_LAT_XMIT] &&
+	    ts[XIO_TASK_LAT_RSP] >= ts[XIO_TASK_LAT_TX]) {
+		xio_ctx_lat_record(ctx, XIO_LATENCY_NEXUS,
+				   xio_lat_cycles_to_ns(ts[XIO_TASK_LAT_TX] -
+							ts[XIO_TASK_LAT_XMIT]));
+		if (ts[XIO_TASK_LAT_TX_COMP] >= ts[XIO_TASK_LAT_TX])
+			xio_ctx_lat_record(
+				ctx, XIO_LATENCY_TRANSPORT,
+				xio_lat_cycles_to_ns(ts[XIO_TASK_LAT_TX_COMP] -
+						     ts[XIO_TASK_LAT_TX]));
+
+		/* a peer that does not report leaves it all on the wire */
+		wire = xio_lat_cycles_to_ns(ts[XIO_TASK_LAT_RSP] -
+					    ts[XIO_TASK_LAT_TX]);
+		peer = task->lat_peer_ns;
+		if (peer && peer <= wire) {
+			xio_ctx_lat_record(ctx, XIO_LATENCY_PEER, peer);
+			wire -= peer;
+		}
+		xio_ctx_lat_record(ctx, XIO_LATENCY_NETWORK, wire);
+	}
+	if (ts[XIO_TASK_LAT_DELIVER] >= ts[XIO_TASK_LAT_RSP]) {
+		xio_ctx_lat_record(
+			ctx, XIO_LATENCY_DELIVERY,
+			xio_lat_cycles_to_ns(ts[XIO_TASK_LAT_DELIVER] -
+					     ts[XIO_TASK_LAT_RSP]));
+		xio_ctx_lat_record(
+			ctx, XIO_LATENCY_RELEASE,
+			xio_lat_cycles_to_ns(get_cycles() -
+					     ts[XIO_TASK_LAT_DELIVER]));
+		xio_ctx_lat_record(
+			ctx, XIO_LATENCY_TOTAL,
+			xio_lat_cycles_to_ns(ts[XIO_TASK_LAT_DELIVER] -
+					     submit));
+	}
+}
+#endif
+
 /*---------------------------------------------------------------------------*/
 /* xio_connection_send							     */
 /*---------------------------------------------------------------------------*/
@@ -304,7 +392,7 @@ int xio_connection_send(struct xio_connection *connection,
 	/* flow control test */
 	if (!is_control && connection->enable_flow_control) {
 		if (connection->peer_credits_msgs == 0)
-			return -EAGAIN;
+			goto credits_stall;
 
 		sgtbl	  = xio_sg_table_get(&msg->out);
 		sgtbl_ops = (struct xio_sg_table_ops *)
@@ -324,7 +412,7 @@ int xio_connection_send(struct xio_connection *connection,
 		}
 
 		if (connection->peer_credits_bytes < tx_bytes)
-			return -EAGAIN;
+			goto credits_stall;
 	}
 
 	if (IS_RESPONSE(msg->type) &&
@@ -357,6 +445,10 @@ int xio_connection_send(struct xio_connection *connection,
 			task->omsg	= msg;
 			hdr.serial_num	= task->omsg->sn;
 			is_req = 1;
+			xio_task_lat_start(task);
+			task->lb_ts = connection->session->lb_policy ==
+					XIO_SESSION_LB_P2C_LATENCY ?
+					get_cycles() : 0;
 			/* save the message "in" side */
 			if (msg->flags & XIO_MSG_FLAG_REQUEST_READ_RECEIPT)
 				memcpy(&task->in_receipt,
@@ -372,6 +464,9 @@ int xio_connection_send(struct xio_connection *connection,
 				       &connection->pre_send_list);
 
 			hdr.serial_num	= msg->request->sn;
+#ifdef XIO_CFLAG_STAT_COUNTERS
+			hdr.service_ns	= xio_connection_service_ns(task);
+#endif
 		} else {
 			ERROR_LOG("Unknown message type %u\n", msg->type);
 			return -EINVAL;
@@ -403,7 +498,8 @@ int xio_connection_send(struct xio_connection *connection,
 		xio_connection_set_ow_send_comp_params(msg);
 
 	if (msg->type != XIO_MSG_TYPE_RDMA) {
-		hdr.flags		= (uint32_t)msg->flags;
+		hdr.flags		= (uint32_t)(msg->flags &
+						     ~XIO_MSG_FLAG_EX_REQUEUED);
 		hdr.dest_session_id	= connection->session->peer_session_id;
 		if (!task->is_control || task->tlv_type == XIO_ACK_REQ) {
 			if (IS_REQUEST(msg->type)) {
@@ -424,6 +520,8 @@ int xio_connection_send(struct xio_connection *connection,
 				hdr.credits_bytes =
 						connection->credits_bytes;
 				connection->credits_bytes = 0;
+				hdr.credits_stalls = connection->fc_stalls;
+				connection->fc_stalls = 0;
 				if (!standalone_receipt) {
 					connection->peer_credits_msgs--;
 					connection->peer_credits_bytes -=
@@ -446,6 +544,7 @@ int xio_connection_send(struct xio_connection *connection,
 			if (connection->enable_flow_control) {
 				connection->credits_msgs = hdr.credits_msgs;
 				connection->credits_bytes = hdr.credits_bytes;
+				connection->fc_stalls = hdr.credits_stalls;
 				if (!standalone_receipt &&
 				    connection->enable_flow_control) {
 					connection->peer_credits_msgs++;
@@ -458,7 +557,22 @@ int xio_connection_send(struct xio_connection *connection,
 	}
 	return 0;
 
+credits_stall:
+	/* reported to the peer with the next message it is charged for */
+	if (connection->fc_stalls != 0xffff)
+		connection->fc_stalls++;
+#ifdef XIO_CFLAG_STAT_COUNTERS
+	xio_stats_shm_add(connection->shm_counters,
+			  XIO_SHM_CONN_CREDIT_STALLS, 1);
+#endif
+	return -EAGAIN;
+
 cleanup:
+#ifdef XIO_CFLAG_STAT_COUNTERS
+	if (rc == EAGAIN)
+		xio_stats_shm_add(connection->shm_counters,
+				  XIO_SHM_CONN_EAGAIN, 1);
+#endif
 	if (is_req)
 		xio_tasks_pool_put(task);
 	else
@@ -467,6 +581,52 @@ cleanup:
 	return -rc;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_connection_tx_unaccount						     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_tx_unaccount(struct xio_connection *connection,
+					struct xio_msg *pmsg)
+{
+	if (connection->enable_flow_control &&
+	    (pmsg->type == XIO_MSG_TYPE_REQ ||
+	     pmsg->type == XIO_ONE_WAY_REQ)) {
+		struct xio_sg_table_ops	*sgtbl_ops;
+		void			*sgtbl;
+		size_t			tx_bytes;
+
+		sgtbl	  = xio_sg_table_get(&pmsg->out);
+		sgtbl_ops = (struct xio_sg_table_ops *)
+			xio_sg_table_ops_get(pmsg->out.sgl_type);
+		tx_bytes  = pmsg->out.header.iov_len +
+			tbl_length(sgtbl_ops, sgtbl);
+
+		connection->tx_queued_msgs--;
+		connection->tx_bytes -= tx_bytes;
+
+		if (connection->tx_queued_msgs < 0)
+			ERROR_LOG("tx_queued_msgs:%d\n",
+				  connection->tx_queued_msgs);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_requeue_req						     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_requeue_req(struct xio_connection *connection,
+				       struct xio_msg *omsg,
+				       struct xio_msg *pmsg)
+{
+	/* keeps the sn it went out with - nothing may overtake it */
+	pmsg->flags |= XIO_MSG_FLAG_EX_REQUEUED;
+	if (omsg)
+		xio_msg_list_insert_before(omsg, pmsg, pdata);
+	else
+		xio_msg_list_insert_tail(&connection->reqs_msgq,
+					 pmsg, pdata);
+
+	xio_connection_tx_unaccount(connection, pmsg);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_connection_flush_msgs						     */
 /*---------------------------------------------------------------------------*/
@@ -480,32 +640,22 @@ static int xio_connection_flush_msgs(struct xio_connection *connection)
 				  tmp_pmsg, pdata) {
 		xio_msg_list_remove(&connection->in_flight_reqs_msgq,
 				    pmsg, pdata);
-		if (omsg)
-			xio_msg_list_insert_before(omsg, pmsg, pdata);
-		else
-			xio_msg_list_insert_tail(&connection->reqs_msgq,
-						 pmsg, pdata);
-
-		if (connection->enable_flow_control &&
-		    (pmsg->type == XIO_MSG_TYPE_REQ ||
-		     pmsg->type == XIO_ONE_WAY_REQ)) {
-			struct xio_sg_table_ops	*sgtbl_ops;
-			void			*sgtbl;
-			size_t			tx_bytes;
-
-			sgtbl	  = xio_sg_table_get(&pmsg->out);
-			sgtbl_ops = (struct xio_sg_table_ops *)
-				xio_sg_table_ops_get(pmsg->out.sgl_type);
-			tx_bytes  = pmsg->out.header.iov_len +
-				tbl_length(sgtbl_ops, sgtbl);
-
-			connection->tx_queued_msgs--;
-			connection->tx_bytes -= tx_bytes;
-
-			if (connection->tx_queued_msgs < 0)
-				ERROR_LOG("tx_queued_msgs:%d\n",
-					  connection->tx_queued_msgs);
+		if (pmsg->flags & XIO_MSG_FLAG_EX_AGGREGATED) {
+			struct xio_aggr_msg *aggr;
+			struct xio_msg	    *amsg, *tmp_amsg;
+
+			/* retransmit the packed messages one by one */
+			aggr = container_of(pmsg, struct xio_aggr_msg, msg);
+			xio_msg_list_foreach_safe(amsg, &aggr->msgs,
+						  tmp_amsg, pdata) {
+				xio_msg_list_remove(&aggr->msgs, amsg, pdata);
+				xio_connection_requeue_req(connection, omsg,
+							   amsg);
+			}
+			kfree(aggr);
+			continue;
 		}
+		xio_connection_requeue_req(connection, omsg, pmsg);
 	}
 
 	if (!xio_msg_list_empty(&connection->rsps_msgq))
@@ -517,6 +667,7 @@ static int xio_connection_flush_msgs(struct xio_connection *connection)
 				  tmp_pmsg, pdata) {
 		xio_msg_list_remove(&connection->in_flight_rsps_msgq,
 				    pmsg, pdata);
+		pmsg->flags |= XIO_MSG_FLAG_EX_REQUEUED;
 		if (omsg)
 			xio_msg_list_insert_before(omsg, pmsg, pdata);
 		else
@@ -539,6 +690,21 @@ static void xio_connection_notify_req_msgs_flush(struct xio_connection
 	xio_msg_list_foreach_safe(pmsg, &connection->reqs_msgq,
 				  tmp_pmsg, pdata) {
 		xio_msg_list_remove(&connection->reqs_msgq, pmsg, pdata);
+		if (pmsg->flags & XIO_MSG_FLAG_EX_AGGREGATED) {
+			struct xio_aggr_msg *aggr;
+			struct xio_msg	    *amsg, *tmp_amsg;
+
+			aggr = container_of(pmsg, struct xio_aggr_msg, msg);
+			xio_msg_list_foreach_safe(amsg, &aggr->msgs,
+						  tmp_amsg, pdata) {
+				xio_msg_list_remove(&aggr->msgs, amsg, pdata);
+				xio_session_notify_msg_error(
+						connection, amsg, status,
+						XIO_MSG_DIRECTION_OUT);
+			}
+			kfree(aggr);
+			continue;
+		}
 		if (!IS_APPLICATION_MSG(pmsg->type)) {
 			if (pmsg->type == XIO_FIN_REQ &&
                             connection->state != XIO_CONNECTION_STATE_DISCONNECTED) {
@@ -551,6 +717,7 @@ static void xio_connection_notify_req_msgs_flush(struct xio_connection
 			}
 			continue;
 		}
+		xio_connection_req_done(connection, pmsg);
 		xio_session_notify_msg_error(connection, pmsg,
 					     status,
 					     XIO_MSG_DIRECTION_OUT);
@@ -768,6 +935,289 @@ static int xio_connection_restart_tasks(struct xio_connection *connection)
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_connection_aggr_len						     */
+/*---------------------------------------------------------------------------*/
+static inline size_t xio_connection_aggr_len(struct xio_connection *connection,
+					     struct xio_msg *msg)
+{
+	struct xio_sg_table_ops	*sgtbl_ops;
+	void			*sgtbl;
+	size_t			len;
+
+	/* receipts and carriers are never packed */
+	if (msg->type != XIO_ONE_WAY_REQ ||
+	    msg->flags & (XIO_MSG_FLAG_REQUEST_READ_RECEIPT |
+			  XIO_MSG_FLAG_EX_AGGREGATED))
+		return 0;
+
+	sgtbl		= xio_sg_table_get(&msg->out);
+	sgtbl_ops	= (struct xio_sg_table_ops *)
+				xio_sg_table_ops_get(msg->out.sgl_type);
+	len		= sizeof(struct xio_aggr_hdr) +
+			  msg->out.header.iov_len +
+			  tbl_length(sgtbl_ops, sgtbl);
+
+	return (len <= connection->aggr_max_bytes) ? len : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_aggr_copy						     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_aggr_copy(struct xio_aggr_msg *aggr,
+				     struct xio_msg *msg)
+{
+	struct xio_aggr_hdr	hdr;
+	struct xio_sg_table_ops	*sgtbl_ops;
+	void			*sgtbl;
+	void			*sg;
+	uint8_t			*ptr = aggr->buf + aggr->len;
+	unsigned int		i;
+
+	sgtbl		= xio_sg_table_get(&msg->out);
+	sgtbl_ops	= (struct xio_sg_table_ops *)
+				xio_sg_table_ops_get(msg->out.sgl_type);
+
+	hdr.serial_num	= htonll(msg->sn);
+	hdr.hdr_len	= htonl((uint32_t)msg->out.header.iov_len);
+	hdr.data_len	= htonl((uint32_t)tbl_length(sgtbl_ops, sgtbl));
+	memcpy(ptr, &hdr, sizeof(hdr));
+	ptr += sizeof(hdr);
+
+	if (msg->out.header.iov_len) {
+		memcpy(ptr, msg->out.header.iov_base,
+		       msg->out.header.iov_len);
+		ptr += msg->out.header.iov_len;
+	}
+	for_each_sge(sgtbl, sgtbl_ops, sg, i) {
+		memcpy(ptr, sge_addr(sgtbl_ops, sg),
+		       sge_length(sgtbl_ops, sg));
+		ptr += sge_length(sgtbl_ops, sg);
+	}
+	aggr->len = ptr - aggr->buf;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_aggr_timeout						     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_aggr_timeout(void *_connection)
+{
+	struct xio_connection *connection =
+					(struct xio_connection *)_connection;
+
+	/* the partial frame waited long enough */
+	connection->aggr_expired = 1;
+	if (xio_is_connection_online(connection))
+		xio_connection_xmit(connection);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_aggr_pack						     */
+/*---------------------------------------------------------------------------*/
+static int xio_connection_aggr_pack(struct xio_connection *connection,
+				    struct xio_msg_list *msgq)
+{
+	struct xio_aggr_msg	*aggr;
+	struct xio_msg		*msg, *first = xio_msg_list_first(msgq);
+	size_t			len, total = 0;
+	int			nr = 0, last = 0;
+
+	for (msg = first; msg; msg = xio_msg_list_next(msg, pdata)) {
+		len = xio_connection_aggr_len(connection, msg);
+		if (!len || total + len > connection->aggr_max_bytes)
+			break;
+		total += len;
+		nr++;
+		/* the application marked the end of its batch */
+		if (msg->flags & XIO_MSG_FLAG_LAST_IN_BATCH) {
+			last = 1;
+			break;
+		}
+	}
+	if (!nr)
+		return 0;
+
+	/* frame is not full, nothing else waits behind it and earlier
+	 * sends are still in flight - hold it until more messages arrive,
+	 * the in flight sends complete or the delay budget expires
+	 */
+	if (!msg && !last && connection->aggr_delay_ms &&
+	    !connection->aggr_expired && !connection->disconnecting &&
+	    !xio_msg_list_empty(&connection->in_flight_reqs_msgq)) {
+		xio_ctx_add_delayed_work(connection->ctx,
+					 connection->aggr_delay_ms,
+					 connection,
+					 xio_connection_aggr_timeout,
+					 &connection->aggr_work);
+		return 1;
+	}
+	connection->aggr_expired = 0;
+	xio_ctx_del_delayed_work(connection->ctx, &connection->aggr_work);
+
+	if (nr == 1)
+		return 0;
+
+	aggr = (struct xio_aggr_msg *)kcalloc(1, sizeof(*aggr) + total,
+					      GFP_KERNEL);
+	if (!aggr)
+		return 0; /* send them one by one */
+
+	xio_msg_list_init(&aggr->msgs);
+	aggr->buf = (uint8_t *)(aggr + 1);
+	aggr->msg.timestamp = first->timestamp;
+
+	while (nr--) {
+		msg = xio_msg_list_first(msgq);
+		xio_msg_list_remove(msgq, msg, pdata);
+		xio_connection_aggr_copy(aggr, msg);
+		xio_msg_list_insert_tail(&aggr->msgs, msg, pdata);
+	}
+
+	aggr->msg.type	= XIO_ONE_WAY_REQ;
+	aggr->msg.sn	= msg->sn;
+	aggr->msg.flags	= XIO_MSG_FLAG_EX_AGGREGATED;
+	if (last)
+		aggr->msg.flags |= XIO_MSG_FLAG_LAST_IN_BATCH;
+
+	aggr->msg.out.sgl_type = XIO_SGL_TYPE_IOV;
+	aggr->msg.out.data_iov.max_nents = XIO_IOVLEN;
+	aggr->msg.out.data_iov.nents = 1;
+	aggr->msg.out.data_iov.sglist[0].iov_base = aggr->buf;
+	aggr->msg.out.data_iov.sglist[0].iov_len = aggr->len;
+
+	xio_msg_list_insert_head(msgq, &aggr->msg, pdata);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_aggr_fail						     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_aggr_fail(struct xio_connection *connection,
+				     struct xio_aggr_msg *aggr,
+				     enum xio_status status)
+{
+	struct xio_msg *amsg, *tmp_amsg;
+
+	/* the packed messages never left - report each one */
+	xio_msg_list_foreach_safe(amsg, &aggr->msgs, tmp_amsg, pdata) {
+		xio_msg_list_remove(&aggr->msgs, amsg, pdata);
+		xio_connection_tx_unaccount(connection, amsg);
+		xio_session_notify_msg_error(connection, amsg, status,
+					     XIO_MSG_DIRECTION_OUT);
+	}
+	kfree(aggr);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_queue_msg						     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_queue_msg(struct xio_connection *connection,
+				     struct xio_msg_list *msgq,
+				     struct xio_msg *msg)
+{
+	struct xio_msg	*pmsg, *prev;
+	uint64_t	sn;
+
+	/* the message may be reused after an earlier requeue */
+	msg->flags &= ~XIO_MSG_FLAG_EX_REQUEUED;
+	if (!(msg->flags & XIO_MSG_FLAG_HIGH_PRIORITY))
+		goto tail;
+
+	/* give the waiting normal messages a turn now and then */
+	if (connection->prio_weight &&
+	    connection->prio_overtakes >= connection->prio_weight)
+		goto tail;
+
+	/* behind earlier high priority messages, ahead of the rest.
+	 * messages requeued on reconnect sit at the head and keep the
+	 * sns they were sent with - they are never overtaken
+	 */
+	xio_msg_list_foreach(pmsg, msgq, pdata) {
+		if (pmsg->flags & XIO_MSG_FLAG_EX_REQUEUED)
+			continue;
+		if (IS_APPLICATION_MSG(pmsg->type) &&
+		    !(pmsg->flags & XIO_MSG_FLAG_HIGH_PRIORITY))
+			break;
+	}
+	if (!pmsg)
+		goto tail;
+
+	xio_msg_list_insert_before(pmsg, msg, pdata);
+	connection->prio_overtakes++;
+
+	if (!IS_REQUEST(msg->type))
+		return;
+
+	/* the peer drops a request whose sn is below the last one it
+	 * delivered - rotate the sns so they still ascend in queue order
+	 */
+	sn = msg->sn;
+	prev = msg;
+	for (; pmsg; pmsg = xio_msg_list_next(pmsg, pdata)) {
+		if (!IS_APPLICATION_MSG(pmsg->type) ||
+		    !IS_REQUEST(pmsg->type) ||
+		    pmsg->flags & XIO_MSG_FLAG_EX_REQUEUED)
+			continue;
+		prev->sn = pmsg->sn;
+		prev = pmsg;
+	}
+	prev->sn = sn;
+	return;
+tail:
+	xio_msg_list_insert_tail(msgq, msg, pdata);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_bulk_timeout						     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_bulk_timeout(void *_connection)
+{
+	struct xio_connection *connection =
+					(struct xio_connection *)_connection;
+
+	/* completions of other connections on the nexus do not wake us */
+	if (connection->bulk_gated && xio_is_connection_online(connection))
+		xio_connection_xmit(connection);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_bulk_gate						     */
+/*---------------------------------------------------------------------------*/
+static int xio_connection_bulk_gate(struct xio_connection *connection,
+				    struct xio_msg *msg)
+{
+	struct xio_sg_table_ops	*sgtbl_ops;
+	void			*sgtbl;
+	size_t			len;
+
+	if (!IS_APPLICATION_MSG(msg->type) ||
+	    msg->flags & XIO_MSG_FLAG_HIGH_PRIORITY)
+		return 0;
+
+	sgtbl		= xio_sg_table_get(&msg->out);
+	sgtbl_ops	= (struct xio_sg_table_ops *)
+				xio_sg_table_ops_get(msg->out.sgl_type);
+	len		= msg->out.header.iov_len +
+			  tbl_length(sgtbl_ops, sgtbl);
+	if (len < connection->prio_bulk_bytes)
+		return 0;
+
+	/* once handed to the transport a frame can not be overtaken -
+	 * keep the bulk message here until the transport catches up
+	 */
+	if (!xio_nexus_tx_backlog(connection->nexus))
+		return 0;
+
+	connection->bulk_gated = 1;
+	xio_ctx_add_delayed_work(connection->ctx,
+				 XIO_BULK_RETRY_MS,
+				 connection,
+				 xio_connection_bulk_timeout,
+				 &connection->bulk_work);
+	return 1;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_connection_xmit_inl						     */
 /*---------------------------------------------------------------------------*/
@@ -790,6 +1240,20 @@ static inline int xio_connection_xmit_inl(
 		(*retry_cnt)++;
 		return rc;
 	}
+	if (connection->aggr_max_bytes) {
+		if (xio_connection_aggr_pack(connection, msgq)) {
+			(*retry_cnt)++;
+			preempt_enable();
+			return rc;
+		}
+		msg = xio_msg_list_first(msgq);
+	}
+	if (connection->prio_bulk_bytes &&
+	    xio_connection_bulk_gate(connection, msg)) {
+		(*retry_cnt)++;
+		preempt_enable();
+		return 1;
+	}
 
 	retval = xio_connection_send(connection, msg);
 	if (retval) {
@@ -812,12 +1276,21 @@ static inline int xio_connection_xmit_inl(
 			rc = 1;
 		} else  {
 			xio_msg_list_remove(msgq, msg, pdata);
+			if (msg->flags & XIO_MSG_FLAG_EX_AGGREGATED)
+				xio_connection_aggr_fail(
+					connection,
+					container_of(msg, struct xio_aggr_msg,
+						     msg),
+					(enum xio_status)-retval);
 			rc = -1;
 		}
 	} else {
 		*retry_cnt = 0;
 		xio_msg_list_remove(msgq, msg, pdata);
+		msg->flags &= ~XIO_MSG_FLAG_EX_REQUEUED;
 		if (IS_APPLICATION_MSG(msg->type)) {
+			if (!(msg->flags & XIO_MSG_FLAG_HIGH_PRIORITY))
+				connection->prio_overtakes = 0;
 			xio_msg_list_insert_tail(
 					in_flight_msgq, msg,
 					pdata);
@@ -843,12 +1316,24 @@ static int xio_connection_xmit(struct xio_connection *connection)
 {
 	int    retval = 0;
 	int    retry_cnt = 0;
+	int    hi_req, hi_rsp;
 
+	struct xio_msg *msg;
 	struct xio_msg_list *msgq1, *in_flight_msgq1;
 	struct xio_msg_list *msgq2, *in_flight_msgq2;
 	void (*flush_msgq1)(struct xio_connection *, enum xio_status);
 	void (*flush_msgq2)(struct xio_connection *, enum xio_status);
 
+	/* serve first the queue that has a high priority message ahead */
+	msg = xio_msg_list_first(&connection->reqs_msgq);
+	hi_req = msg && (msg->flags & XIO_MSG_FLAG_HIGH_PRIORITY);
+	msg = xio_msg_list_first(&connection->rsps_msgq);
+	hi_rsp = msg && (msg->flags & XIO_MSG_FLAG_HIGH_PRIORITY);
+	if (hi_req != hi_rsp)
+		connection->send_req_toggle = hi_rsp;
+
+	connection->bulk_gated = 0;
+
 	if (connection->send_req_toggle == 0) {
 		msgq1		= &connection->reqs_msgq;
 		in_flight_msgq1	= &connection->in_flight_reqs_msgq;
@@ -902,10 +1387,11 @@ int xio_connection_remove_in_flight(struct xio_connection *connection,
 	if (!IS_APPLICATION_MSG(msg->type))
 		return 0;
 
-	if (IS_REQUEST(msg->type) || msg->type == XIO_MSG_TYPE_RDMA)
+	if (IS_REQUEST(msg->type) || msg->type == XIO_MSG_TYPE_RDMA) {
 		xio_msg_list_remove(
 			&connection->in_flight_reqs_msgq, msg, pdata);
-	else if (IS_RESPONSE(msg->type))
+		xio_connection_req_done(connection, msg);
+	} else if (IS_RESPONSE(msg->type))
 		xio_msg_list_remove(
 			&connection->in_flight_rsps_msgq, msg, pdata);
 	else {
@@ -925,10 +1411,11 @@ int xio_connection_remove_msg_from_queue(struct xio_connection *connection,
 	if (!IS_APPLICATION_MSG(msg->type))
 		return 0;
 
-	if (IS_REQUEST(msg->type) || msg->type == XIO_MSG_TYPE_RDMA)
+	if (IS_REQUEST(msg->type) || msg->type == XIO_MSG_TYPE_RDMA) {
 		xio_msg_list_remove(
 				&connection->reqs_msgq, msg, pdata);
-	else if (IS_RESPONSE(msg->type))
+		xio_connection_req_done(connection, msg);
+	} else if (IS_RESPONSE(msg->type))
 		xio_msg_list_remove(
 				&connection->rsps_msgq, msg, pdata);
 	else {
@@ -946,6 +1433,10 @@ int xio_connection_reconnect(struct xio_connection *connection)
 {
 
 	connection->close_reason = XIO_E_SESSION_DISCONNECTED;
+#ifdef XIO_CFLAG_STAT_COUNTERS
+	xio_stats_shm_add(connection->shm_counters,
+			  XIO_SHM_CONN_RECONNECTS, 1);
+#endif
 
 	/* Notify user on reconnection start */
 	xio_session_notify_reconnecting(connection->session,
@@ -1082,21 +1573,27 @@ int xio_send_request(struct xio_connection *connection,
 		pmsg->timestamp = get_cycles();
 		xio_stat_inc(stats, XIO_STAT_TX_MSG);
 		xio_stat_add(stats, XIO_STAT_TX_BYTES, tx_bytes);
+		xio_stats_shm_add(connection->shm_counters,
+				  XIO_SHM_CONN_TX_MSGS, 1);
+		xio_stats_shm_add(connection->shm_counters,
+				  XIO_SHM_CONN_TX_BYTES, tx_bytes);
 #endif
 
 		pmsg->sn = xio_session_get_sn(connection->session);
 		pmsg->type = XIO_MSG_TYPE_REQ;
+		connection->reqs_outstanding++;
 
 		if (connection->enable_flow_control) {
 			connection->tx_queued_msgs++;
 			connection->tx_bytes += tx_bytes;
 		}
 		if (nr == -1)
-			xio_msg_list_insert_tail(&connection->reqs_msgq, pmsg,
-						 pdata);
+			xio_connection_queue_msg(connection,
+						 &connection->reqs_msgq, pmsg);
 		else {
+			/* a chain is queued as a unit */
 			nr++;
-			xio_msg_list_insert_tail(&reqs_msgq, pmsg, pdata);
+			xio_connection_queue_msg(connection, &reqs_msgq, pmsg);
 		}
 		pmsg = pmsg->next;
 	}
@@ -1120,6 +1617,174 @@ send:
 }
 EXPORT_SYMBOL(xio_send_request);
 
+/*---------------------------------------------------------------------------*/
+/* xio_connection_fc_reset						     */
+/*---------------------------------------------------------------------------*/
+void xio_connection_fc_reset(struct xio_connection *connection)
+{
+	/* the peer is granted the whole receive queue at setup */
+	connection->fc_target	   =
+			(uint16_t)connection->session->rcv_queue_depth_msgs;
+	connection->fc_debt	   = 0;
+	connection->fc_held	   = 0;
+	connection->fc_held_peak   = 0;
+	connection->fc_released	   = 0;
+	connection->fc_stalls	   = 0;
+	connection->fc_peer_stalls = 0;
+	connection->fc_held_bytes  = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_fc_recv						     */
+/*---------------------------------------------------------------------------*/
+void xio_connection_fc_recv(struct xio_connection *connection,
+			    struct xio_msg *msg, uint16_t peer_stalls)
+{
+	struct xio_sg_table_ops	*sgtbl_ops;
+	void			*sgtbl;
+
+	if (connection->enable_flow_control != XIO_FLOW_CONTROL_ADAPTIVE)
+		return;
+
+	connection->fc_peer_stalls += peer_stalls;
+	if (!msg)
+		return;
+
+	/* the message holds its credit until the application releases it */
+	sgtbl		= xio_sg_table_get(&msg->in);
+	sgtbl_ops	= (struct xio_sg_table_ops *)
+				xio_sg_table_ops_get(msg->in.sgl_type);
+	connection->fc_held_bytes += msg->in.header.iov_len +
+				     tbl_length(sgtbl_ops, sgtbl);
+	connection->fc_held++;
+	if (connection->fc_held > connection->fc_held_peak)
+		connection->fc_held_peak = connection->fc_held;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_fc_adjust						     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_fc_adjust(struct xio_connection *connection)
+{
+	struct xio_session	*session = connection->session;
+	uint32_t		target = connection->fc_target;
+	uint32_t		peak = connection->fc_held_peak;
+	uint32_t		grant;
+
+	if (4 * peak >= 3 * target ||
+	    4 * connection->fc_held_bytes >=
+	    3 * session->rcv_queue_depth_bytes) {
+		/* the application releases slower than the peer sends -
+		 * halve the window and withhold the difference from the
+		 * credits released next
+		 */
+		grant = max(target / 2, (uint32_t)XIO_FC_MIN_WINDOW);
+		if (grant < target) {
+			connection->fc_debt += target - grant;
+			connection->fc_target = grant;
+		}
+	} else if (connection->fc_peer_stalls && 2 * peak < target) {
+		/* the peer ran out of credits the application keeps up
+		 * with - grow the window up to the receive queue depth
+		 */
+		grant = min(max(target / 2, 1U),
+			    (uint32_t)session->rcv_queue_depth_msgs - target);
+		connection->fc_target += grant;
+		if (grant <= connection->fc_debt) {
+			connection->fc_debt -= grant;
+		} else {
+			connection->credits_msgs += grant - connection->fc_debt;
+			connection->fc_debt = 0;
+		}
+	}
+	connection->fc_released	   = 0;
+	connection->fc_held_peak   = connection->fc_held;
+	connection->fc_peer_stalls = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_fc_release						     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_fc_release(struct xio_connection *connection,
+				      size_t bytes)
+{
+	connection->credits_bytes += bytes;
+
+	if (connection->enable_flow_control != XIO_FLOW_CONTROL_ADAPTIVE) {
+		connection->credits_msgs++;
+		return;
+	}
+	if (connection->fc_held) {
+		connection->fc_held--;
+		connection->fc_held_bytes -= min(connection->fc_held_bytes,
+						 (uint64_t)bytes);
+	}
+	/* a shrunk window keeps the credit out of circulation */
+	if (connection->fc_debt)
+		connection->fc_debt--;
+	else
+		connection->credits_msgs++;
+
+	/* the window is reconsidered every half window of releases */
+	if (++connection->fc_released >= max(connection->fc_target / 2, 1))
+		xio_connection_fc_adjust(connection);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_fc_ack_timeout					     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_fc_ack_timeout(void *_connection)
+{
+	struct xio_connection *connection =
+					(struct xio_connection *)_connection;
+
+	/* no message left in time to carry the credits */
+	if (connection->state == XIO_CONNECTION_STATE_ONLINE &&
+	    (connection->credits_msgs || connection->credits_bytes))
+		xio_send_credits_ack(connection);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_fc_ack						     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_fc_ack(struct xio_connection *connection)
+{
+	uint16_t watermark_msgs = connection->rx_queue_watermark_msgs;
+
+	if (connection->state != XIO_CONNECTION_STATE_ONLINE)
+		return;
+
+	if (connection->enable_flow_control == XIO_FLOW_CONTROL_ADAPTIVE) {
+		if (!connection->credits_msgs && !connection->credits_bytes)
+			return;
+		watermark_msgs = max(connection->fc_target / 2, 1);
+	}
+	if (connection->credits_msgs < watermark_msgs &&
+	    connection->credits_bytes < connection->rx_queue_watermark_bytes) {
+		/* give outgoing messages a chance to carry the credits */
+		if (connection->enable_flow_control ==
+		    XIO_FLOW_CONTROL_ADAPTIVE)
+			xio_ctx_add_delayed_work(connection->ctx,
+						 XIO_FC_ACK_DELAY_MS,
+						 connection,
+						 xio_connection_fc_ack_timeout,
+						 &connection->fc_ack_work);
+		return;
+	}
+	xio_ctx_del_delayed_work(connection->ctx, &connection->fc_ack_work);
+
+	/* queued messages that may be sent carry the credits anyway */
+	if (connection->enable_flow_control == XIO_FLOW_CONTROL_ADAPTIVE &&
+	    connection->peer_credits_msgs &&
+	    (!xio_msg_list_empty(&connection->reqs_msgq) ||
+	     !xio_msg_list_empty(&connection->rsps_msgq))) {
+		xio_connection_xmit(connection);
+		if (!connection->credits_msgs && !connection->credits_bytes)
+			return;
+	}
+	xio_send_credits_ack(connection);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_send_response							     */
 /*---------------------------------------------------------------------------*/
@@ -1218,6 +1883,10 @@ int xio_send_response(struct xio_msg *msg)
 
 		xio_stat_inc(stats, XIO_STAT_TX_MSG);
 		xio_stat_add(stats, XIO_STAT_TX_BYTES, bytes);
+		xio_stats_shm_add(connection->shm_counters,
+				  XIO_SHM_CONN_TX_MSGS, 1);
+		xio_stats_shm_add(connection->shm_counters,
+				  XIO_SHM_CONN_TX_BYTES, bytes);
 #endif
 		pmsg->flags |= XIO_MSG_FLAG_EX_RECEIPT_LAST;
 		if ((pmsg->request->flags &
@@ -1233,10 +1902,11 @@ int xio_send_response(struct xio_msg *msg)
 			bytes		= vmsg->header.iov_len +
 						tbl_length(sgtbl_ops, sgtbl);
 
-			connection->credits_msgs++;
-			connection->credits_bytes += bytes;
+			/* the response carries the credit */
+			xio_connection_fc_release(connection, bytes);
 		}
-		xio_msg_list_insert_tail(&connection->rsps_msgq, pmsg, pdata);
+		xio_connection_queue_msg(connection, &connection->rsps_msgq,
+					 pmsg);
 
 		pmsg = pmsg->next;
 	}
@@ -1370,6 +2040,10 @@ static int xio_send_typed_msg(struct xio_connection *connection,
 		pmsg->timestamp = get_cycles();
 		xio_stat_inc(stats, XIO_STAT_TX_MSG);
 		xio_stat_add(stats, XIO_STAT_TX_BYTES, tx_bytes);
+		xio_stats_shm_add(connection->shm_counters,
+				  XIO_SHM_CONN_TX_MSGS, 1);
+		xio_stats_shm_add(connection->shm_counters,
+				  XIO_SHM_CONN_TX_BYTES, tx_bytes);
 #endif
 		pmsg->sn = xio_session_get_sn(connection->session);
 		pmsg->type = msg_type;
@@ -1383,11 +2057,12 @@ static int xio_send_typed_msg(struct xio_connection *connection,
 				connection->tx_bytes);
 		}
 		if (nr == -1)
-			xio_msg_list_insert_tail(&connection->reqs_msgq, pmsg,
-						 pdata);
+			xio_connection_queue_msg(connection,
+						 &connection->reqs_msgq, pmsg);
 		else {
+			/* a chain is queued as a unit */
 			nr++;
-			xio_msg_list_insert_tail(&reqs_msgq, pmsg, pdata);
+			xio_connection_queue_msg(connection, &reqs_msgq, pmsg);
 		}
 
 		pmsg = pmsg->next;
@@ -1478,7 +2153,15 @@ static void xio_connection_post_close(void *_connection)
 				 &connection->fin_timeout_work);
 
 	xio_ctx_del_delayed_work(connection->ctx,
-				 &connection->ka.timer);
+				 &connection->aggr_work);
+
+	xio_ctx_del_delayed_work(connection->ctx,
+				 &connection->fc_ack_work);
+
+	xio_ctx_del_delayed_work(connection->ctx,
+				 &connection->bulk_work);
+
+	xio_connection_keepalive_stop(connection);
 
 	xio_ctx_del_work(connection->ctx, &connection->fin_work);
 
@@ -1486,9 +2169,13 @@ static void xio_connection_post_close(void *_connection)
 	spin_lock(&connection->ctx->ctx_list_lock);
 	list_del(&connection->ctx_list_entry);
 	spin_unlock(&connection->ctx->ctx_list_lock);
+#ifdef XIO_CFLAG_STAT_COUNTERS
+	xio_stats_shm_conn_remove(connection);
+#endif
 
-	kfree(connection);
-
+	/* entries posted from other threads may still point to it */
+	connection->post_closed = 1;
+	xio_connection_post_put(connection);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -1586,20 +2273,18 @@ int xio_release_response(struct xio_msg *msg)
 			bytes		= vmsg->header.iov_len +
 				tbl_length(sgtbl_ops, sgtbl);
 
-			connection->credits_msgs++;
-			connection->credits_bytes += bytes;
-
-			if (connection->state == XIO_CONNECTION_STATE_ONLINE &&
-			    ((connection->credits_msgs >=
-			      connection->rx_queue_watermark_msgs) ||
-			     (connection->credits_bytes >=
-			      connection->rx_queue_watermark_bytes)))
-				xio_send_credits_ack(connection);
+			xio_connection_fc_release(connection, bytes);
+			xio_connection_fc_ack(connection);
 		}
 
 		list_move_tail(&task->tasks_list_entry,
 			       &connection->post_io_tasks_list);
 
+#ifdef XIO_CFLAG_STAT_COUNTERS
+		if (unlikely(g_options.enable_latency_stats))
+			xio_connection_lat_account(connection,
+						   task->sender_task);
+#endif
 		xio_release_response_task(task);
 
 		pmsg = pmsg->next;
@@ -1618,6 +2303,21 @@ int xio_release_response(struct xio_msg *msg)
 }
 EXPORT_SYMBOL(xio_release_response);
 
+/*---------------------------------------------------------------------------*/
+/* xio_release_msg_task							     */
+/*---------------------------------------------------------------------------*/
+static inline struct xio_task *xio_release_msg_task(struct xio_msg *msg)
+{
+	struct xio_aggr_rx_msg *rx_msg;
+
+	if (!(msg->flags & XIO_MSG_FLAG_EX_AGGREGATED))
+		return container_of(msg, struct xio_task, imsg);
+
+	rx_msg = container_of(msg, struct xio_aggr_rx_msg, msg);
+
+	return rx_msg->rx->task;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_release_msg							     */
 /*---------------------------------------------------------------------------*/
@@ -1626,10 +2326,12 @@ int xio_release_msg(struct xio_msg *msg)
 	struct xio_task		*task;
 	struct xio_connection	*connection = NULL;
 	struct xio_msg		*pmsg = msg;
+	struct xio_msg		*next;
+	struct xio_aggr_rx	*rx;
 	int retval;
 
 #ifdef XIO_THREAD_SAFE_DEBUG
-	task = container_of(pmsg, struct xio_task, imsg);
+	task = xio_release_msg_task(pmsg);
 	xio_ctx_debug_thread_lock(task->connection->ctx);
 #endif
 
@@ -1643,7 +2345,18 @@ int xio_release_msg(struct xio_msg *msg)
 #endif
 			return -1;
 		}
-		task = container_of(pmsg, struct xio_task, imsg);
+		next = pmsg->next;
+		task = xio_release_msg_task(pmsg);
+		if (pmsg->flags & XIO_MSG_FLAG_EX_AGGREGATED) {
+			/* the frame is released with its last message */
+			rx = container_of(pmsg, struct xio_aggr_rx_msg,
+					  msg)->rx;
+			if (--rx->refcnt) {
+				pmsg = next;
+				continue;
+			}
+			kfree(rx);
+		}
 		if (unlikely(task->tlv_type != XIO_ONE_WAY_REQ)) {
 			ERROR_LOG("xio_release_msg failed. invalid type:0x%x\n",
 				  task->tlv_type);
@@ -1667,14 +2380,8 @@ int xio_release_msg(struct xio_msg *msg)
 			bytes		= vmsg->header.iov_len +
 						tbl_length(sgtbl_ops, sgtbl);
 
-			connection->credits_msgs++;
-			connection->credits_bytes += bytes;
-			if (connection->state == XIO_CONNECTION_STATE_ONLINE &&
-			    ((connection->credits_msgs >=
-			      connection->rx_queue_watermark_msgs) ||
-			     (connection->credits_bytes >=
-			      connection->rx_queue_watermark_bytes)))
-				xio_send_credits_ack(connection);
+			xio_connection_fc_release(connection, bytes);
+			xio_connection_fc_ack(connection);
 		}
 
 		list_move_tail(&task->tasks_list_entry,
@@ -1683,7 +2390,7 @@ int xio_release_msg(struct xio_msg *msg)
 		/* the rx task is returned back to pool */
 		xio_tasks_pool_put(task);
 
-		pmsg = pmsg->next;
+		pmsg = next;
 	}
 
 	if (connection && xio_is_connection_online(connection)) {
@@ -1991,6 +2698,7 @@ int xio_cancel_request(struct xio_connection *connection,
 				  req->sn);
 			xio_msg_list_remove(&connection->reqs_msgq,
 					    pmsg, pdata);
+			xio_connection_req_done(connection, pmsg);
 			xio_session_notify_cancel(
 				connection, pmsg, XIO_E_MSG_CANCELED);
 #ifdef XIO_THREAD_SAFE_DEBUG
@@ -2114,6 +2822,28 @@ int xio_modify_connection(struct xio_connection *connection,
                         connection->disconnect_timeout = XIO_DEF_CONNECTION_TIMEOUT;
                 }
         }
+	if (test_bits(XIO_CONNECTION_ATTR_PRIORITY, &attr_mask)) {
+		connection->prio_weight = attr->prio_weight;
+		connection->prio_overtakes = 0;
+		connection->prio_bulk_bytes = attr->prio_bulk_bytes;
+		/* release a bulk message held under the previous settings */
+		if (connection->bulk_gated &&
+		    !test_bits(XIO_CONNECTION_ATTR_AGGREGATION, &attr_mask) &&
+		    xio_is_connection_online(connection))
+			return xio_connection_xmit(connection);
+	}
+	if (test_bits(XIO_CONNECTION_ATTR_AGGREGATION, &attr_mask)) {
+		/* a frame must fit the inline path of the transport */
+		connection->aggr_max_bytes =
+			min(attr->aggr_max_bytes,
+			    (uint32_t)g_options.max_inline_xio_data);
+		connection->aggr_delay_ms = attr->aggr_delay_ms;
+		xio_ctx_del_delayed_work(connection->ctx,
+					 &connection->aggr_work);
+		/* release a frame held under the previous settings */
+		if (xio_is_connection_online(connection))
+			return xio_connection_xmit(connection);
+	}
 		/*
 	memset(&nattr, 0, sizeof(nattr));
 	if (test_bits(XIO_CONNECTION_ATTR_TOS, &attr_mask)) {
@@ -2168,6 +2898,16 @@ int xio_query_connection(struct xio_connection *connection,
         if (test_bits(XIO_CONNECTION_ATTR_DISCONNECT_TIMEOUT, &attr_mask))
                 attr->disconnect_timeout_secs = connection->disconnect_timeout/1000;
 
+	if (test_bits(XIO_CONNECTION_ATTR_AGGREGATION, &attr_mask)) {
+		attr->aggr_max_bytes = connection->aggr_max_bytes;
+		attr->aggr_delay_ms = connection->aggr_delay_ms;
+	}
+
+	if (test_bits(XIO_CONNECTION_ATTR_PRIORITY, &attr_mask)) {
+		attr->prio_weight = connection->prio_weight;
+		attr->prio_bulk_bytes = connection->prio_bulk_bytes;
+	}
+
 	if (attr_mask & XIO_CONNECTION_ATTR_PROTO)
 		attr->proto = (enum xio_proto)
 					xio_nexus_get_proto(connection->nexus);
@@ -2349,6 +3089,25 @@ static void xio_connection_post_destroy(struct kref *kref)
 		xio_session_init_teardown(session, ctx, close_reason);
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_connection_free							     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_free(struct kref *kref)
+{
+	struct xio_connection *connection = container_of(kref,
+							 struct xio_connection,
+							 post_kref);
+	kfree(connection);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_post_put						     */
+/*---------------------------------------------------------------------------*/
+void xio_connection_post_put(struct xio_connection *connection)
+{
+	kref_put(&connection->post_kref, xio_connection_free);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_connection_destroy						     */
 /*---------------------------------------------------------------------------*/
@@ -2423,7 +3182,12 @@ int xio_connection_destroy(struct xio_connection *connection)
 	xio_ctx_del_delayed_work(connection->ctx,
 				 &connection->fin_timeout_work);
 	xio_ctx_del_delayed_work(connection->ctx,
-				 &connection->ka.timer);
+				 &connection->aggr_work);
+	xio_ctx_del_delayed_work(connection->ctx,
+				 &connection->fc_ack_work);
+	xio_ctx_del_delayed_work(connection->ctx,
+				 &connection->bulk_work);
+	xio_connection_keepalive_stop(connection);
 
 	kref_put(&connection->kref, xio_connection_post_destroy);
 #ifdef XIO_THREAD_SAFE_DEBUG
@@ -2465,6 +3229,15 @@ int xio_connection_disconnected(struct xio_connection *connection)
 	xio_ctx_del_delayed_work(connection->ctx,
 				 &connection->fin_timeout_work);
 
+	xio_ctx_del_delayed_work(connection->ctx,
+				 &connection->aggr_work);
+
+	xio_ctx_del_delayed_work(connection->ctx,
+				 &connection->fc_ack_work);
+
+	xio_ctx_del_delayed_work(connection->ctx,
+				 &connection->bulk_work);
+
 	xio_ctx_del_work(connection->ctx, &connection->fin_work);
 
 	if (!connection->disable_notify && !connection->disconnecting) {
@@ -2879,6 +3652,7 @@ int xio_on_connection_hello_rsp_recv(struct xio_connection *connection,
 	connection->credits_msgs = 0;
 	connection->peer_credits_bytes = session->peer_rcv_queue_depth_bytes;
 	connection->credits_bytes = 0;
+	xio_connection_fc_reset(connection);
 
 	/* from now - no need to disable */
 	connection->disable_notify = 0;
@@ -2942,6 +3716,7 @@ int xio_on_connection_hello_req_recv(struct xio_connection *connection,
 		connection->peer_credits_bytes =
 				connection->session->peer_rcv_queue_depth_bytes;
 		connection->credits_bytes = 0;
+		xio_connection_fc_reset(connection);
 
 		TRACE_LOG("session state is now ONLINE. session:%p\n",
 			  connection->session);
@@ -3164,28 +3939,13 @@ int xio_connection_send_ka_rsp(struct xio_connection *connection,
 int xio_on_connection_ka_rsp_recv(struct xio_connection *connection,
 				  struct xio_task *task)
 {
-	int retval;
-
 	TRACE_LOG("recv keepalive response. session:%p, connection:%p\n",
 		  connection->session, connection);
 
-	xio_ctx_del_delayed_work(connection->ctx,
-				 &connection->ka.timer);
-
 	connection->ka.probes = 0;
 	connection->ka.req_sent = 0;
 	connection->ka.timedout = 0;
 
-	retval = xio_ctx_add_delayed_work(
-				connection->ctx,
-				1000 * g_options.ka.time, connection,
-				xio_connection_keepalive_time,
-				&connection->ka.timer);
-	if (retval != 0) {
-		ERROR_LOG("periodic keepalive failed - abort\n");
-		return -1;
-	}
-
 	xio_context_msg_pool_put(task->sender_task->omsg);
 	/* recycle the task */
 	xio_tasks_pool_put(task->sender_task);
@@ -3205,26 +3965,11 @@ int xio_on_connection_ka_req_recv(struct xio_connection *connection,
 	TRACE_LOG("recv keepalive request. session:%p, connection:%p\n",
 		  connection->session, connection);
 
+	/* the request itself refreshed last_rx, so the local sweep
+	 * will not probe this connection for another ka.time
+	 */
 	connection->ka.timedout = 0;
 
-	/* optimization: reschedule local timer if request received */
-	if (g_options.enable_keepalive && !connection->ka.probes &&
-	    !connection->ka.req_sent) {
-		int retval;
-
-		xio_ctx_del_delayed_work(connection->ctx,
-					 &connection->ka.timer);
-		retval = xio_ctx_add_delayed_work(
-				connection->ctx,
-				1000 * g_options.ka.time, connection,
-				xio_connection_keepalive_start,
-				&connection->ka.timer);
-		if (retval != 0) {
-			ERROR_LOG("periodic keepalive failed - abort\n");
-			return -1;
-		}
-	}
-
 	xio_connection_send_ka_rsp(connection, task);
 
 	return 0;
@@ -3243,101 +3988,135 @@ int xio_on_connection_ka_rsp_send_comp(struct xio_connection *connection,
 }
 
 /*---------------------------------------------------------------------------*/
-/* xio_connection_keepalive_intvl					     */
+/* xio_connection_keepalive_check					     */
 /*---------------------------------------------------------------------------*/
-void xio_connection_keepalive_intvl(void *_connection)
+static void xio_connection_keepalive_check(struct xio_connection *connection,
+					   uint32_t tick,
+					   struct list_head *expired)
 {
-	struct xio_connection *connection =
-					(struct xio_connection *)_connection;
-	int retval;
+	struct xio_ka *ka = &connection->ka;
 
-	xio_ctx_del_delayed_work(connection->ctx,
-				 &connection->ka.timer);
+	if (!ka->req_sent) {
+		/* busy connections never get past here */
+		if (tick - ka->last_rx >= (uint32_t)g_options.ka.time) {
+			ka->probe_tick = tick;
+			xio_connection_send_ka_req(connection);
+		}
+		return;
+	}
+
+	/* anything received after the probe is as good as its response */
+	if ((int32_t)(ka->last_rx - ka->probe_tick) >= 0) {
+		ka->probes = 0;
+		ka->timedout = 0;
+		ka->probe_tick = tick;
+		return;
+	}
+	if (tick - ka->probe_tick < (uint32_t)g_options.ka.intvl)
+		return;
+
+	ka->probe_tick = tick;
+	ka->timedout = 1;
+
+	if (++ka->probes == g_options.ka.probes) {
+		list_move_tail(&ka->ka_list_entry, expired);
+		return;
+	}
+	WARN_LOG("connection keepalive timeout. connection:%p probes:[%d]\n",
+		 connection, ka->probes);
+}
 
-	connection->ka.timedout = 1;
+/*---------------------------------------------------------------------------*/
+/* xio_connection_keepalive_sweep					     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_keepalive_sweep(void *_ctx)
+{
+	struct xio_context	*ctx = (struct xio_context *)_ctx;
+	struct xio_connection	*connection, *tmp;
+	uint32_t		tick;
+	int			retval;
+	LIST_HEAD(expired);
+
+	xio_ctx_del_delayed_work(ctx, &ctx->ka_sweep_work);
+
+	/* keepalive options are in seconds - one tick each */
+	tick = ++ctx->ka_tick;
+
+	list_for_each_entry_safe(connection, tmp, &ctx->ka_list,
+				 ka.ka_list_entry) {
+		if (connection->state != XIO_CONNECTION_STATE_ONLINE)
+			continue;
+		xio_connection_keepalive_check(connection, tick, &expired);
+	}
+
+	retval = xio_ctx_add_delayed_work(
+				ctx, XIO_KA_SWEEP_MS, ctx,
+				xio_connection_keepalive_sweep,
+				&ctx->ka_sweep_work);
+	if (retval != 0)
+		ERROR_LOG("keepalive sweep failed - abort\n");
+
+	/* notifications may destroy any connection - restart from the head
+	 * and put each one back on the sweep list before calling out
+	 */
+	while (!list_empty(&expired)) {
+		connection = list_entry(expired.next, struct xio_connection,
+					ka.ka_list_entry);
+		list_move_tail(&connection->ka.ka_list_entry, &ctx->ka_list);
 
-	if (++connection->ka.probes == g_options.ka.probes) {
 		ERROR_LOG("connection keepalive timeout. connection:%p probes:[%d]\n",
 			  connection, connection->ka.probes);
 		connection->ka.probes = 0;
 		connection->ka.req_sent = 0;
+		connection->ka.last_rx = tick;
 
-		retval = xio_ctx_add_delayed_work(
-				connection->ctx,
-				1000 * g_options.ka.time, connection,
-				xio_connection_keepalive_start,
-				&connection->ka.timer);
-		if (retval != 0) {
-			ERROR_LOG("periodic keepalive failed - abort\n");
-			return;
-		}
 		/* notify the application of connection error */
 		xio_session_notify_connection_error(
 				connection->session, connection, XIO_E_TIMEOUT);
 		if ((!connection->disconnecting) && (!g_options.reconnect))
 			xio_disconnect(connection);
-		return;
-	}
-	WARN_LOG("connection keepalive timeout. connection:%p probes:[%d]\n",
-		  connection, connection->ka.probes);
-	retval = xio_ctx_add_delayed_work(
-				connection->ctx,
-				1000 * g_options.ka.intvl, connection,
-				xio_connection_keepalive_intvl,
-				&connection->ka.timer);
-	if (retval != 0) {
-		ERROR_LOG("keepalive timeout failed - abort\n");
-		return;
 	}
 }
 
 /*---------------------------------------------------------------------------*/
-/* xio_connection_keepalive_time					     */
+/* xio_connection_keepalive_start					     */
 /*---------------------------------------------------------------------------*/
-static void xio_connection_keepalive_time(void *_connection)
+void xio_connection_keepalive_start(void *_connection)
 {
 	struct xio_connection *connection =
 					(struct xio_connection *)_connection;
+	struct xio_context *ctx = connection->ctx;
 	int retval;
 
-	xio_ctx_del_delayed_work(connection->ctx,
-				 &connection->ka.timer);
+	if (!g_options.enable_keepalive)
+		return;
+
+	connection->ka.last_rx = ctx->ka_tick;
+	if (list_empty(&connection->ka.ka_list_entry))
+		list_add_tail(&connection->ka.ka_list_entry, &ctx->ka_list);
 
+	/* one sweep per context covers all of its connections */
 	retval = xio_ctx_add_delayed_work(
-				connection->ctx,
-				1000 * g_options.ka.intvl, connection,
-				xio_connection_keepalive_intvl,
-				&connection->ka.timer);
+				ctx, XIO_KA_SWEEP_MS, ctx,
+				xio_connection_keepalive_sweep,
+				&ctx->ka_sweep_work);
 	if (retval != 0) {
 		ERROR_LOG("keepalive timeout failed - abort\n");
 		return;
 	}
-	xio_connection_send_ka_req(connection);
 }
 
 /*---------------------------------------------------------------------------*/
-/* xio_connection_keepalive_start					     */
+/* xio_connection_keepalive_stop					     */
 /*---------------------------------------------------------------------------*/
-void xio_connection_keepalive_start(void *_connection)
+void xio_connection_keepalive_stop(struct xio_connection *connection)
 {
-	struct xio_connection *connection =
-					(struct xio_connection *)_connection;
-	int retval;
-
-	xio_ctx_del_delayed_work(connection->ctx,
-				 &connection->ka.timer);
+	struct xio_context *ctx = connection->ctx;
 
-	if (!g_options.enable_keepalive)
+	if (list_empty(&connection->ka.ka_list_entry))
 		return;
 
-	retval = xio_ctx_add_delayed_work(
-				connection->ctx,
-				1000 * g_options.ka.time, connection,
-				xio_connection_keepalive_time,
-				&connection->ka.timer);
-	if (retval != 0) {
-		ERROR_LOG("keepalive timeout failed - abort\n");
-		return;
-	}
+	list_del_init(&connection->ka.ka_list_entry);
+	if (list_empty(&ctx->ka_list))
+		xio_ctx_del_delayed_work(ctx, &ctx->ka_sweep_work);
 }
-
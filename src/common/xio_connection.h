@@ -67,13 +67,41 @@ struct xio_transition {
 };
 
 struct xio_ka {
-	xio_delayed_work_handle_t	timer;
+	struct list_head		ka_list_entry;	/* ctx sweep list */
+	uint32_t			last_rx;	/* sweep tick */
+	uint32_t			probe_tick;	/* sweep tick */
 	int				probes;
 	int				req_sent;
 	int				timedout;
 	int				pad;
 };
 
+/* carrier of an aggregated frame - small one way messages are copied into
+ * buf and completed together once the carrier is sent
+ */
+struct xio_aggr_msg {
+	struct xio_msg			msg;	/* message sent to the peer */
+	struct xio_msg_list		msgs;	/* packed application msgs */
+	uint8_t				*buf;
+	size_t				len;
+};
+
+struct xio_aggr_rx;
+
+/* message unpacked from a received aggregated frame */
+struct xio_aggr_rx_msg {
+	struct xio_msg			msg;
+	struct xio_aggr_rx		*rx;
+};
+
+/* the carrier task is released when the last unpacked msg is released */
+struct xio_aggr_rx {
+	struct xio_task			*task;
+	int				refcnt;
+	int				nr;
+	struct xio_aggr_rx_msg		*msgs;
+};
+
 struct xio_connection {
 	struct xio_ka			ka;
 	struct xio_nexus		*nexus;
@@ -116,6 +144,37 @@ struct xio_connection {
 	struct kref			kref;
 	uint32_t			disconnect_timeout;
 
+	uint32_t			aggr_max_bytes;
+	uint32_t			aggr_delay_ms;
+	uint32_t			aggr_expired;
+	uint32_t			aggr_pad;
+
+	/* high priority msgs overtaking normal ones in the send queues */
+	uint16_t			prio_weight;
+	uint16_t			prio_overtakes; /* since last normal */
+	uint32_t			prio_bulk_bytes;
+	uint32_t			bulk_gated;	/* bulk msg held back */
+	uint32_t			prio_pad;
+
+	/* load balancing input of xio_session_send_request */
+	int32_t				reqs_outstanding; /* awaiting rsp */
+	uint32_t			lb_pad;
+	uint64_t			lb_rtt_cycles;	/* rsp latency ewma */
+
+	/* cross thread posts - keeps the memory until queued ones ran */
+	struct kref			post_kref;
+	uint32_t			post_closed;
+
+	/* adaptive flow control - window granted to the peer */
+	uint16_t			fc_target;	/* window in msgs */
+	uint16_t			fc_debt;	/* credits to withhold */
+	uint16_t			fc_held;	/* msgs not released */
+	uint16_t			fc_held_peak;
+	uint16_t			fc_released;	/* in current period */
+	uint16_t			fc_stalls;	/* to report to peer */
+	uint32_t			fc_peer_stalls;
+	uint64_t			fc_held_bytes;
+
 	struct xio_msg_list		reqs_msgq;
 	struct xio_msg_list		rsps_msgq;
 	struct xio_msg_list		in_flight_reqs_msgq;
@@ -125,6 +184,9 @@ struct xio_connection {
 	xio_work_handle_t		fin_work;
 	xio_delayed_work_handle_t	fin_delayed_work;
 	xio_delayed_work_handle_t	fin_timeout_work;
+	xio_delayed_work_handle_t	aggr_work;
+	xio_delayed_work_handle_t	fc_ack_work;
+	xio_delayed_work_handle_t	bulk_work;
 
 	struct list_head		managed_rkey_list;
 	struct list_head		io_tasks_list;
@@ -143,6 +205,7 @@ struct xio_connection {
 	struct xio_nexus_init_attr	nexus_attr;
 
 	xio_work_handle_t		teardown_work;
+	uint64_t			*shm_counters; /* stats segment slot */
 
 #ifdef XIO_SESSION_DEBUG
 	uint64_t			peer_connection;
@@ -150,6 +213,42 @@ struct xio_connection {
 #endif
 };
 
+/*---------------------------------------------------------------------------*/
+/* xio_connection_req_done						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_connection_req_done(struct xio_connection *connection,
+					   struct xio_msg *msg)
+{
+	if (msg->type == XIO_MSG_TYPE_REQ && connection->reqs_outstanding > 0)
+		connection->reqs_outstanding--;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_lb_rtt_sample						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_connection_lb_rtt_sample(
+		struct xio_connection *connection, uint64_t cycles)
+{
+	/* ewma, alpha = 1/8 */
+	if (connection->lb_rtt_cycles)
+		connection->lb_rtt_cycles += (cycles >> 3) -
+					     (connection->lb_rtt_cycles >> 3);
+	else
+		connection->lb_rtt_cycles = cycles;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_is_lb_eligible					     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_connection_is_lb_eligible(
+		struct xio_connection *connection)
+{
+	return !connection->disconnecting &&
+	       (connection->state == XIO_CONNECTION_STATE_ONLINE ||
+		connection->state == XIO_CONNECTION_STATE_ESTABLISHED ||
+		connection->state == XIO_CONNECTION_STATE_INIT);
+}
+
 struct xio_connection *xio_connection_create(
 		struct xio_session *session,
 		struct xio_context *ctx, int conn_idx,
@@ -209,6 +308,19 @@ int xio_disconnect_initial_connection(
 
 int xio_connection_disconnected(struct xio_connection *connection);
 
+/*---------------------------------------------------------------------------*/
+/* xio_connection_post_get						     */
+/*---------------------------------------------------------------------------*/
+/* pins the connection memory for an entry posted to its context from
+ * another thread. returns 0 if the connection is already freed
+ */
+static inline int xio_connection_post_get(struct xio_connection *connection)
+{
+	return kref_get_unless_zero(&connection->post_kref);
+}
+
+void xio_connection_post_put(struct xio_connection *connection);
+
 int xio_connection_refused(struct xio_connection *connection);
 
 int xio_connection_error_event(struct xio_connection *connection,
@@ -259,6 +371,11 @@ int xio_on_connection_hello_rsp_recv(struct xio_connection *connection,
 
 int xio_send_credits_ack(struct xio_connection *connection);
 
+void xio_connection_fc_reset(struct xio_connection *connection);
+
+void xio_connection_fc_recv(struct xio_connection *connection,
+			    struct xio_msg *msg, uint16_t peer_stalls);
+
 int xio_on_credits_ack_send_comp(struct xio_connection *connection,
 				 struct xio_task *task);
 
@@ -282,4 +399,6 @@ int xio_on_connection_ka_rsp_recv(struct xio_connection *connection,
 
 void xio_connection_keepalive_start(void *_connection);
 
+void xio_connection_keepalive_stop(struct xio_connection *connection);
+
 #endif /*XIO_CONNECTION_H */
@@ -41,12 +41,14 @@
 #define xio_ctx_work_t  xio_work_handle_t
 #define xio_ctx_delayed_work_t  xio_delayed_work_handle_t
 
-#define XIO_PROTO_LAST  2	/* from enum xio_proto */
+#define XIO_PROTO_LAST  3	/* from enum xio_proto */
 
 #ifdef XIO_THREAD_SAFE_DEBUG
 #define BACKTRACE_BUFFER_SIZE 2048
 #endif
 
+#define XIO_CTX_NEXUS_BUCKETS	16	/* nexus portal index, power of 2 */
+
 /*---------------------------------------------------------------------------*/
 /* enum									     */
 /*---------------------------------------------------------------------------*/
@@ -111,9 +113,12 @@ struct xio_context {
 	uint32_t			defered_destroy:1;
 	uint32_t			prealloc_xio_inline_bufs:1;
 	uint32_t			register_internal_mempool:1;
-	uint32_t			resereved:28;
+	uint32_t			cpu_hinted:1;
+	uint32_t			resereved:27;
 
 	struct xio_statistics		stats;
+	struct xio_latency_stats	*lat_stats; /* allocated on first use */
+	uint64_t			*shm_counters; /* stats segment slot */
 	void				*user_context;
 	struct xio_workqueue		*workqueue;
 	struct list_head		ctx_list;  /* per context storage */
@@ -122,11 +127,20 @@ struct xio_context {
 	struct xio_observable		observable;
 	void				*netlink_sock;
 	xio_work_handle_t               destroy_ctx_work;
+	struct list_head		ka_list;   /* keepalive connections */
+	xio_ctx_delayed_work_t		ka_sweep_work;
+	xio_ctx_delayed_work_t		tasks_reclaim_work;
+	xio_ctx_delayed_work_t		shm_sample_work;
 	spinlock_t                      ctx_list_lock;
 
 	int				max_conns_per_ctx;
 	int				rq_depth;
-	int				pad;
+	uint32_t			ka_tick;   /* keepalive sweeps */
+	int				tasks_pool_idle_ms;
+	spinlock_t			nexus_index_lock;
+
+	/* client nexuses by (portal, tos) - see xio_nexus_cache_find */
+	struct list_head		nexus_index[XIO_CTX_NEXUS_BUCKETS];
 #ifdef XIO_THREAD_SAFE_DEBUG
 	int                             nptrs;
 	int				pad1;
@@ -192,6 +206,21 @@ static inline void xio_stat_inc(struct xio_statistics *stats, int counter)
 	stats->counter[counter]++;
 }
 
+#ifdef XIO_CFLAG_STAT_COUNTERS
+/*---------------------------------------------------------------------------*/
+/* xio_lat_cycles_to_ns							     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t xio_lat_cycles_to_ns(uint64_t cycles)
+{
+	return (uint64_t)((double)cycles * 1000.0 / g_mhz);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ctx_lat_record							     */
+/*---------------------------------------------------------------------------*/
+void xio_ctx_lat_record(struct xio_context *ctx, int stage, uint64_t ns);
+#endif
+
 /*---------------------------------------------------------------------------*/
 /* xio_ctx_add_delayed_work						     */
 /*---------------------------------------------------------------------------*/
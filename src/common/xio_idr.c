@@ -132,7 +132,8 @@ int xio_idr_add_uobj(struct xio_idr *idr, void *uobj, const char *obj_name)
 
 	idr_entry->key = uobj;
 	idr_entry->name = pname;
-	HT_INSERT(&idr->cache, &key, idr_entry, idr_ht_entry);
+	if (HT_INSERT(&idr->cache, &key, idr_entry, idr_ht_entry))
+		goto exit;
 	retval = 0;
 exit:
 	spin_unlock(&idr->lock);
@@ -56,16 +56,17 @@
 #include "xio_session.h"
 #include "xio_nexus.h"
 #include <xio_env_adv.h>
+#ifdef XIO_CFLAG_STAT_COUNTERS
+#include "xio_stats_shm.h"
+#endif
 
 /*---------------------------------------------------------------------------*/
 /* private structures							     */
 /*---------------------------------------------------------------------------*/
 struct xio_observers_htbl_node {
 	struct xio_observer	*observer;
-	uint32_t		id;
-	uint32_t		pad;
-	struct list_head	observers_htbl_node;
 
+	HT_ENTRY(xio_observers_htbl_node, xio_key_int32) observers_htbl_node;
 };
 
 struct xio_event_params {
@@ -127,7 +128,8 @@ static void xio_nexus_cancel_dwork(struct xio_nexus *nexus)
 /*---------------------------------------------------------------------------*/
 static inline void xio_nexus_init_observers_htbl(struct xio_nexus *nexus)
 {
-	INIT_LIST_HEAD(&nexus->observers_htbl);
+	HT_INIT(&nexus->observers_htbl, xio_int32_hash, xio_int32_cmp,
+		xio_int32_cp);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -135,12 +137,11 @@ static inline void xio_nexus_init_observers_htbl(struct xio_nexus *nexus)
 /*---------------------------------------------------------------------------*/
 static void xio_nexus_free_observers_htbl(struct xio_nexus *nexus)
 {
-	struct xio_observers_htbl_node	*node, *next_node;
+	struct xio_observers_htbl_node	*node;
 
-	list_for_each_entry_safe(node, next_node,
-				 &nexus->observers_htbl,
-				 observers_htbl_node) {
-		list_del(&node->observers_htbl_node);
+	HT_FOREACH_SAFE(node, &nexus->observers_htbl, observers_htbl_node) {
+		HT_REMOVE(&nexus->observers_htbl, node,
+			  xio_observers_htbl_node, observers_htbl_node);
 		kfree(node);
 	}
 }
@@ -153,6 +154,10 @@ static int xio_nexus_hash_observer(struct xio_nexus *nexus,
 				   uint32_t id)
 {
 	struct xio_observers_htbl_node	*node;
+	struct xio_key_int32		key = {
+		.id = id,
+		.pad = {0},
+	};
 
 	node = (struct xio_observers_htbl_node *)
 			kcalloc(1, sizeof(*node), GFP_KERNEL);
@@ -162,10 +167,14 @@ static int xio_nexus_hash_observer(struct xio_nexus *nexus,
 		return -1;
 	}
 	node->observer	= observer;
-	node->id	= id;
 
-	list_add_tail(&node->observers_htbl_node,
-		      &nexus->observers_htbl);
+	if (HT_INSERT(&nexus->observers_htbl, &key, node,
+		      observers_htbl_node)) {
+		kfree(node);
+		xio_set_error(ENOMEM);
+		ERROR_LOG("observers table insert failed. %m\n");
+		return -1;
+	}
 
 	return 0;
 }
@@ -176,13 +185,13 @@ static int xio_nexus_hash_observer(struct xio_nexus *nexus,
 static int xio_nexus_delete_observer(struct xio_nexus *nexus,
 				     struct xio_observer *observer)
 {
-	struct xio_observers_htbl_node	*node, *next_node;
+	struct xio_observers_htbl_node	*node;
 
-	list_for_each_entry_safe(node, next_node,
-				 &nexus->observers_htbl,
-				 observers_htbl_node) {
+	HT_FOREACH_SAFE(node, &nexus->observers_htbl, observers_htbl_node) {
 		if (node->observer == observer) {
-			list_del(&node->observers_htbl_node);
+			HT_REMOVE(&nexus->observers_htbl, node,
+				  xio_observers_htbl_node,
+				  observers_htbl_node);
 			kfree(node);
 			return 0;
 		}
@@ -197,16 +206,15 @@ static int xio_nexus_delete_observer(struct xio_nexus *nexus,
 struct xio_observer *xio_nexus_observer_lookup(struct xio_nexus *nexus,
 					       uint32_t id)
 {
-	struct xio_observers_htbl_node	*node, *next_node;
+	struct xio_observers_htbl_node	*node;
+	struct xio_key_int32		key = {
+		.id = id,
+		.pad = {0},
+	};
 
-	list_for_each_entry_safe(node, next_node,
-			    &nexus->observers_htbl,
-			    observers_htbl_node) {
-		if (node->id == id)
-			return node->observer;
-	}
+	HT_LOOKUP(&nexus->observers_htbl, &key, node, observers_htbl_node);
 
-	return NULL;
+	return node ? node->observer : NULL;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -401,11 +409,11 @@ static int xio_nexus_send_setup_req(struct xio_nexus *nexus)
 	}
 	/* when reconnecting before the dup2 send is done via new handle */
 	if (nexus->state == XIO_NEXUS_STATE_RECONNECT) {
-		req.flags = XIO_RECONNECT;
+		req.flags = XIO_RECONNECT | XIO_NATIVE_HDR;
 		req.cid = nexus->server_cid;
 		trans_hndl = nexus->new_transport_hndl;
 	} else {
-		req.flags = 0;
+		req.flags = XIO_NATIVE_HDR;
 		req.cid = 0;
 		trans_hndl = nexus->transport_hndl;
 	}
@@ -613,6 +621,13 @@ static int xio_nexus_on_recv_setup_req(struct xio_nexus *new_nexus,
 	}
 
 send_response:
+	/* agree on native headers if the client runs in our byte order */
+	if (!status &&
+	    (req.flags & XIO_NATIVE_HDR_MASK) == XIO_NATIVE_HDR) {
+		nexus->native_hdr = 1;
+		flags |= XIO_NATIVE_HDR;
+	}
+
 	/* reset mbuf */
 	xio_mbuf_reset(&task->mbuf);
 
@@ -746,6 +761,8 @@ static int xio_nexus_on_recv_setup_rsp(struct xio_nexus *nexus,
 			  XIO_VERSION, rsp.version);
 		return -1;
 	}
+	nexus->native_hdr =
+		(rsp.flags & XIO_NATIVE_HDR_MASK) == XIO_NATIVE_HDR;
 	TRACE_LOG("%s: nexus:%p, trans_hndl:%p\n", __func__,
 		  nexus, nexus->transport_hndl);
 	/* recycle the tasks */
@@ -1216,6 +1233,7 @@ struct xio_nexus *xio_nexus_create(struct xio_nexus *parent_nexus,
 			  xio_on_context_event);
 
 	INIT_LIST_HEAD(&nexus->tx_queue);
+	INIT_LIST_HEAD(&nexus->index_list);
 
 	xio_context_reg_observer(transport_hndl->ctx, &nexus->ctx_observer);
 
@@ -1885,6 +1903,7 @@ struct xio_nexus *xio_nexus_open(struct xio_context *ctx,
 			  xio_nexus_on_transport_event);
 	XIO_OBSERVABLE_INIT(&nexus->observable, nexus);
 	INIT_LIST_HEAD(&nexus->tx_queue);
+	INIT_LIST_HEAD(&nexus->index_list);
 	mutex_init(&nexus->lock_connect);
 
 	xio_nexus_init_observers_htbl(nexus);
@@ -1913,6 +1932,12 @@ struct xio_nexus *xio_nexus_open(struct xio_context *ctx,
 			nexus->trans_attr.tos = init_attr->tos;
 			ptrans_init_attr = &nexus->trans_attr;
 		}
+		if (test_bits(XIO_NEXUS_ATTR_REUSEPORT, &attr_mask)) {
+			set_bits(XIO_TRANSPORT_ATTR_REUSEPORT,
+				 &nexus->trans_attr_mask);
+			nexus->trans_attr.reuseport = init_attr->reuseport;
+			ptrans_init_attr = &nexus->trans_attr;
+		}
 	}
 
 	nexus->transport_hndl = transport->open(
@@ -2075,13 +2100,14 @@ int xio_nexus_connect(struct xio_nexus *nexus, const char *portal_uri,
 		if (retval != 0)
 			goto cleanup3;
 		nexus->state = XIO_NEXUS_STATE_CONNECTING;
+		xio_nexus_cache_index(nexus);
 		break;
 	case XIO_NEXUS_STATE_CONNECTED:
 		/* moving the notification to the ctx the nexus is running on
 		 * to avoid session_setup_request from being sent on another thread
 		 */
 		work_params = (struct xio_nexus_observer_work *)
-				kmalloc(sizeof(*work_params), GFP_KERNEL);
+				kcalloc(1, sizeof(*work_params), GFP_KERNEL);
 		if (unlikely(!work_params)) {
 			ERROR_LOG("failed to allocate memory\n");
 			goto cleanup1;
@@ -2282,12 +2308,19 @@ static int xio_nexus_xmit(struct xio_nexus *nexus)
 
 		task = list_first_entry(&nexus->tx_queue,
 					struct xio_task,  tasks_list_entry);
+		xio_task_lat_stamp(task, XIO_TASK_LAT_TX);
 		retval = nexus->transport->send(nexus->transport_hndl, task);
 		if (retval != 0) {
 			union xio_nexus_event_data nexus_event_data;
 
-			if (xio_errno() == EAGAIN)
+			if (xio_errno() == EAGAIN) {
+#ifdef XIO_CFLAG_STAT_COUNTERS
+				xio_stats_shm_add(
+					nexus->transport_hndl->ctx->shm_counters,
+					XIO_SHM_CTX_TRANSPORT_EAGAIN, 1);
+#endif
 				return 0;
+			}
 
 			ERROR_LOG("transport send failed err:%d\n",
 				  xio_errno());
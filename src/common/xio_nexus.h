@@ -82,7 +82,8 @@ enum xio_nexus_state {
 };
 
 enum xio_nexus_attr_mask {
-	XIO_NEXUS_ATTR_TOS			= 1 << 0
+	XIO_NEXUS_ATTR_TOS			= 1 << 0,
+	XIO_NEXUS_ATTR_REUSEPORT		= 1 << 1
 };
 
 /*---------------------------------------------------------------------------*/
@@ -127,7 +128,8 @@ struct xio_nexus_attr {
 
 struct xio_nexus_init_attr {
 	uint8_t			tos;	 /**< type of service RFC 2474 */
-	uint8_t			pad[3];
+	uint8_t			reuseport; /**< sharded listener	     */
+	uint8_t			pad[2];
 };
 
 /**
@@ -154,13 +156,14 @@ struct xio_nexus {
 	int				srq_enabled;
 	xio_delayed_work_handle_t	close_time_hndl;
 
-	struct list_head		observers_htbl;
+	HT_HEAD(, xio_observers_htbl_node, HASHTABLE_PRIME_MINI) observers_htbl;
 	struct list_head		tx_queue;
 	struct xio_server		*server;
 
 	/* Client side for reconnect */
 	int				server_cid;
-	int				server_cid_pad;
+	/* session headers in host byte order - see XIO_NATIVE_HDR */
+	int				native_hdr;
 	struct xio_transport_base	*new_transport_hndl;
 	char				*portal_uri;
 	char				*out_if_addr;
@@ -172,6 +175,12 @@ struct xio_nexus {
 	int 				pad2;
 	struct mutex			lock_connect;      /* lock nexus connect */
 
+	/* per context portal index - see xio_nexus_cache_index */
+	struct list_head		index_list;
+	struct xio_context		*index_ctx;
+	uint32_t			index_hash;
+	int				index_pad;
+
 	HT_ENTRY(xio_nexus, xio_key_int32) nexus_htbl;
 };
 
@@ -325,6 +334,19 @@ static inline int xio_nexus_get_proto(struct xio_nexus *nexus)
 	return nexus->transport_hndl->proto;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_tx_backlog							     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_nexus_tx_backlog(struct xio_nexus *nexus)
+{
+	if (!list_empty(&nexus->tx_queue))
+		return 1;
+	if (!nexus->transport->tx_backlog)
+		return 0;
+
+	return nexus->transport->tx_backlog(nexus->transport_hndl);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_nexus_addref							     */
 /*---------------------------------------------------------------------------*/
@@ -57,6 +57,101 @@
 static HT_HEAD(, xio_nexus, HASHTABLE_PRIME_SMALL)  nexus_cache;
 static spinlock_t cs_lock;
 
+/*---------------------------------------------------------------------------*/
+/* xio_portal_host_len							     */
+/*---------------------------------------------------------------------------*/
+static inline size_t xio_portal_host_len(const char *uri)
+{
+	const char *p = strstr(uri, "://");
+	const char *end;
+
+	/* scheme and host compare case insensitive, the rest verbatim */
+	if (!p)
+		return 0;
+	end = strchr(p + 3, '/');
+
+	return end ? (size_t)(end - uri) : strlen(uri);
+}
+
+static inline char xio_portal_lower(char c)
+{
+	return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_portal_hash							     */
+/*---------------------------------------------------------------------------*/
+static uint32_t xio_portal_hash(const char *uri, int tos_enabled, uint8_t tos)
+{
+	size_t   host_len = xio_portal_host_len(uri);
+	size_t   i;
+	uint32_t key = 0;
+
+	for (i = 0; uri[i]; i++)
+		key = key * 37 + (uint32_t)(i < host_len ?
+					    xio_portal_lower(uri[i]) : uri[i]);
+	key = key * 37 + (tos_enabled ? (uint32_t)tos + 1 : 0);
+
+	return int32_hash(key);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_portal_equal							     */
+/*---------------------------------------------------------------------------*/
+static int xio_portal_equal(const char *a, const char *b)
+{
+	size_t host_len = xio_portal_host_len(a);
+	size_t i;
+
+	if (host_len != xio_portal_host_len(b))
+		return 0;
+	for (i = 0; i < host_len; i++)
+		if (xio_portal_lower(a[i]) != xio_portal_lower(b[i]))
+			return 0;
+
+	return strcmp(a + host_len, b + host_len) == 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_cache_unindex						     */
+/*---------------------------------------------------------------------------*/
+static void xio_nexus_cache_unindex(struct xio_nexus *nexus)
+{
+	struct xio_context *ctx = nexus->index_ctx;
+
+	if (!ctx)
+		return;
+
+	spin_lock(&ctx->nexus_index_lock);
+	list_del_init(&nexus->index_list);
+	nexus->index_ctx = NULL;
+	spin_unlock(&ctx->nexus_index_lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_cache_index						     */
+/*---------------------------------------------------------------------------*/
+void xio_nexus_cache_index(struct xio_nexus *nexus)
+{
+	struct xio_context *ctx = nexus->transport_hndl->ctx;
+	struct list_head   *bucket;
+
+	if (nexus->index_ctx || !nexus->portal_uri)
+		return;
+
+	nexus->index_hash = xio_portal_hash(
+			nexus->portal_uri,
+			test_bits(XIO_NEXUS_ATTR_TOS, &nexus->trans_attr_mask),
+			nexus->trans_attr.tos);
+	bucket = &ctx->nexus_index[nexus->index_hash &
+				   (XIO_CTX_NEXUS_BUCKETS - 1)];
+
+	spin_lock(&ctx->nexus_index_lock);
+	list_add(&nexus->index_list, bucket);
+	nexus->index_ctx = ctx;
+	spin_unlock(&ctx->nexus_index_lock);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_nexus_cache_add				                             */
 /*---------------------------------------------------------------------------*/
@@ -72,7 +167,8 @@ static int nexus_cache_add(struct xio_nexus *nexus, int nexus_id)
 	if (c)
 		return -1;
 
-	HT_INSERT(&nexus_cache, &key, nexus, nexus_htbl);
+	if (HT_INSERT(&nexus_cache, &key, nexus, nexus_htbl))
+		return -1;
 
 	return 0;
 }
@@ -96,6 +192,8 @@ int xio_nexus_cache_remove(int nexus_id)
 	HT_REMOVE(&nexus_cache, c, xio_nexus, nexus_htbl);
 	spin_unlock(&cs_lock);
 
+	xio_nexus_cache_unindex(c);
+
 	return 0;
 }
 
@@ -138,36 +236,39 @@ int xio_nexus_cache_add(struct xio_nexus *nexus,
 /*---------------------------------------------------------------------------*/
 struct xio_nexus *xio_nexus_cache_find(struct xio_nexus_query_params *query)
 {
-	struct xio_nexus *nexus;
-	int		  tos_enabled;
+	struct xio_context *ctx = query->ctx;
+	struct xio_nexus   *nexus;
+	struct list_head   *bucket;
+	uint32_t	   hash;
 
-	spin_lock(&cs_lock);
-	HT_FOREACH(nexus, &nexus_cache, nexus_htbl) {
-		if (nexus->transport_hndl->portal_uri) {
-			if ((strcmp(nexus->transport_hndl->portal_uri,
-				    query->portal_uri) != 0) ||
-			    (nexus->transport_hndl->ctx != query->ctx))
-				continue;
-
-			tos_enabled = test_bits(XIO_NEXUS_ATTR_TOS,
-						&nexus->trans_attr_mask);
-			if (tos_enabled != query->tos_enabled)
-				continue;
-			if (tos_enabled && nexus->trans_attr.tos != query->tos)
-				continue;
-
-			/* match found */
-			xio_nexus_addref(nexus);
-
-			TRACE_LOG("nexus: [addref] nexus:%p, refcnt:%d\n", nexus,
-				  atomic_read(&nexus->kref.refcount));
-			goto done;
-		}
+	hash = xio_portal_hash(query->portal_uri, query->tos_enabled,
+			       query->tos);
+	bucket = &ctx->nexus_index[hash & (XIO_CTX_NEXUS_BUCKETS - 1)];
+
+	spin_lock(&ctx->nexus_index_lock);
+	list_for_each_entry(nexus, bucket, index_list) {
+		if (nexus->index_hash != hash ||
+		    !nexus->transport_hndl->portal_uri)
+			continue;
+		if (!xio_portal_equal(nexus->portal_uri, query->portal_uri))
+			continue;
+		if (test_bits(XIO_NEXUS_ATTR_TOS, &nexus->trans_attr_mask) !=
+		    query->tos_enabled)
+			continue;
+		if (query->tos_enabled && nexus->trans_attr.tos != query->tos)
+			continue;
+
+		/* match found */
+		xio_nexus_addref(nexus);
+
+		TRACE_LOG("nexus: [addref] nexus:%p, refcnt:%d\n", nexus,
+			  atomic_read(&nexus->kref.refcount));
+		goto done;
 	}
 	nexus = NULL;
 
 done:
-	spin_unlock(&cs_lock);
+	spin_unlock(&ctx->nexus_index_lock);
 	return nexus;
 }
 
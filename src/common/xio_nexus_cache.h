@@ -71,5 +71,7 @@ struct xio_nexus *xio_nexus_cache_lookup(
 
 struct xio_nexus *xio_nexus_cache_find(struct xio_nexus_query_params *query);
 
+void xio_nexus_cache_index(struct xio_nexus *nexus);
+
 #endif /*XIO_NEXUS_CACHE_H */
 
@@ -61,7 +61,8 @@
 #define XIO_OPTVAL_DEF_KEEPALIVE_INTVL			20
 #define XIO_OPTVAL_DEF_KEEPALIVE_TIME			60
 #define XIO_OPTVAL_DEF_TRANSPORT_CLOSE_TIMEOUT		60000
-#define XIO_OPTVAL_DEF_PAD				0
+#define XIO_OPTVAL_DEF_ENABLE_LATENCY_STATS		0
+#define XIO_OPTVAL_DEF_ENABLE_STATS_SHM			0
 
 /* xio options */
 struct xio_options			g_options = {
@@ -79,7 +80,9 @@ struct xio_options			g_options = {
 	XIO_OPTVAL_DEF_INLINE_XIO_DATA_ALIGN,	/* inline_xio_data_align */
 	XIO_OPTVAL_DEF_ENABLE_KEEPALIVE,
 	XIO_OPTVAL_DEF_TRANSPORT_CLOSE_TIMEOUT, /* transport_close_timeout */
-	XIO_OPTVAL_DEF_PAD,
+	XIO_OPTVAL_DEF_ENABLE_LATENCY_STATS,	/* enable_latency_stats */
+	XIO_OPTVAL_DEF_ENABLE_STATS_SHM,	/* enable_stats_shm */
+	0,					/* pad */
 	{
 		XIO_OPTVAL_DEF_KEEPALIVE_PROBES,
 		XIO_OPTVAL_DEF_KEEPALIVE_TIME,
@@ -115,6 +118,10 @@ static int xio_general_set_opt(void *xio_obj, int optname,
 		if (optlen != sizeof(enum xio_log_level))
 			return -1;
 		return xio_set_log_level(*((enum xio_log_level *)optval));
+	case XIO_OPTNAME_LOG_ASYNC:
+		if (optlen != sizeof(int))
+			break;
+		return xio_set_log_async(*((int *)optval));
 	case XIO_OPTNAME_DISABLE_HUGETBL:
 		xio_disable_huge_pages(*((int *)optval));
 		return 0;
@@ -133,9 +140,9 @@ static int xio_general_set_opt(void *xio_obj, int optname,
 	case XIO_OPTNAME_MAX_IN_IOVLEN:
 		if (optlen == sizeof(int)) {
 			struct xio_transport *rdma_transport =
-						xio_get_transport("rdma");
+						xio_find_transport("rdma");
 			struct xio_transport *tcp_transport =
-						xio_get_transport("tcp");
+						xio_find_transport("tcp");
 			int retval = 0;
 
 			if (*((int *)optval) > XIO_IOVLEN &&
@@ -158,9 +165,9 @@ static int xio_general_set_opt(void *xio_obj, int optname,
 	case XIO_OPTNAME_MAX_OUT_IOVLEN:
 		if (optlen == sizeof(int)) {
 			struct xio_transport *rdma_transport =
-						xio_get_transport("rdma");
+						xio_find_transport("rdma");
 			struct xio_transport *tcp_transport =
-						xio_get_transport("tcp");
+						xio_find_transport("tcp");
 			int retval = 0;
 
 			if (*((int *)optval) > XIO_IOVLEN &&
@@ -183,9 +190,9 @@ static int xio_general_set_opt(void *xio_obj, int optname,
 	case XIO_OPTNAME_ENABLE_DMA_LATENCY:
 		if (optlen == sizeof(int)) {
 			struct xio_transport *rdma_transport =
-						xio_get_transport("rdma");
+						xio_find_transport("rdma");
 			struct xio_transport *tcp_transport =
-						xio_get_transport("tcp");
+						xio_find_transport("tcp");
 			int retval = 0;
 
 			if (rdma_transport &&
@@ -272,6 +279,16 @@ static int xio_general_set_opt(void *xio_obj, int optname,
 	case XIO_OPTNAME_ENABLE_KEEPALIVE:
 		g_options.enable_keepalive = *((int *)optval);
 		return 0;
+	case XIO_OPTNAME_ENABLE_LATENCY_STATS:
+		if (optlen != sizeof(int))
+			break;
+		g_options.enable_latency_stats = *((int *)optval);
+		return 0;
+	case XIO_OPTNAME_ENABLE_STATS_SHM:
+		if (optlen != sizeof(int))
+			break;
+		g_options.enable_stats_shm = *((int *)optval);
+		return 0;
 	case XIO_OPTNAME_CONFIG_KEEPALIVE:
 		if (optlen == sizeof(struct xio_options_keepalive)) {
 			memcpy(&g_options.ka, optval, optlen);
@@ -307,6 +324,14 @@ static int xio_general_get_opt(void  *xio_obj, int optname,
 		*((enum xio_log_level *)optval) = xio_get_log_level();
 		*optlen = sizeof(enum xio_log_level);
 		return 0;
+	case XIO_OPTNAME_LOG_ASYNC:
+		*optlen = sizeof(int);
+		*((int *)optval) = xio_get_log_async();
+		return 0;
+	case XIO_OPTNAME_LOG_DROPPED:
+		*optlen = sizeof(uint64_t);
+		*((uint64_t *)optval) = xio_get_log_dropped();
+		return 0;
 	case XIO_OPTNAME_MAX_IN_IOVLEN:
 		*optlen = sizeof(int);
 		*((int *)optval) = g_options.max_in_iovsz;
@@ -359,6 +384,14 @@ static int xio_general_get_opt(void  *xio_obj, int optname,
 		*optlen = sizeof(int);
 		*((int *)optval) = g_options.enable_keepalive;
 		return 0;
+	case XIO_OPTNAME_ENABLE_LATENCY_STATS:
+		*optlen = sizeof(int);
+		*((int *)optval) = g_options.enable_latency_stats;
+		return 0;
+	case XIO_OPTNAME_ENABLE_STATS_SHM:
+		*optlen = sizeof(int);
+		*((int *)optval) = g_options.enable_stats_shm;
+		return 0;
 	case XIO_OPTNAME_CONFIG_KEEPALIVE:
 		if (*optlen == sizeof(struct xio_options_keepalive)) {
 			memcpy(optval, &g_options.ka, *optlen);
@@ -392,7 +425,7 @@ int xio_set_opt(void *xio_obj, int level,  int optname,
 		return xio_general_set_opt(xio_obj, optname, optval, optlen);
 	case XIO_OPTLEVEL_RDMA:
 		if (!rdma_transport) {
-			rdma_transport = xio_get_transport("rdma");
+			rdma_transport = xio_find_transport("rdma");
 			if (!rdma_transport) {
 				xio_set_error(EFAULT);
 				return -1;
@@ -405,7 +438,7 @@ int xio_set_opt(void *xio_obj, int level,  int optname,
 		break;
 	case XIO_OPTLEVEL_TCP:
 		if (!tcp_transport) {
-			tcp_transport = xio_get_transport("tcp");
+			tcp_transport = xio_find_transport("tcp");
 			if (!tcp_transport) {
 				xio_set_error(EFAULT);
 				return -1;
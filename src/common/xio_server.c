@@ -309,18 +309,21 @@ static int xio_on_nexus_event(void *observer, void *notifier, int event,
 }
 
 /*---------------------------------------------------------------------------*/
-/* xio_bind								     */
+/* xio_bind_helper							     */
 /*---------------------------------------------------------------------------*/
-struct xio_server *xio_bind(struct xio_context *ctx,
-			    struct xio_session_ops *ops,
-			    const char *uri,
-			    uint16_t *src_port,
-			    uint32_t session_flags,
-			    void *cb_private_data)
+static struct xio_server *xio_bind_helper(struct xio_context *ctx,
+					  struct xio_session_ops *ops,
+					  const char *uri,
+					  uint16_t *src_port,
+					  uint32_t session_flags,
+					  void *cb_private_data,
+					  int sharded)
 {
-	struct xio_server	*server;
-	int			retval;
-	int			backlog = 4;
+	struct xio_server		*server;
+	struct xio_nexus_init_attr	attr;
+	uint32_t			attr_mask = 0;
+	int				retval;
+	int				backlog = 4;
 
 	if (!ctx  || !ops || !uri) {
 		ERROR_LOG("invalid parameters ctx:%p, ops:%p, uri:%p\n",
@@ -352,7 +355,16 @@ struct xio_server *xio_bind(struct xio_context *ctx,
 
 	XIO_OBSERVABLE_INIT(&server->nexus_observable, server);
 
-	server->listener = xio_nexus_open(ctx, uri, NULL, 0, 0, NULL);
+	if (sharded) {
+		memset(&attr, 0, sizeof(attr));
+		attr.reuseport = 1;
+		attr_mask = XIO_NEXUS_ATTR_REUSEPORT;
+		/* absorb reconnect storms - the transport picks its maximum */
+		backlog = 0;
+	}
+
+	server->listener = xio_nexus_open(ctx, uri, NULL, 0, attr_mask,
+					  attr_mask ? &attr : NULL);
 	if (!server->listener) {
 		ERROR_LOG("failed to create connection\n");
 		goto cleanup;
@@ -376,8 +388,47 @@ cleanup:
 
 	return NULL;
 }
+
+/*---------------------------------------------------------------------------*/
+/* xio_bind								     */
+/*---------------------------------------------------------------------------*/
+struct xio_server *xio_bind(struct xio_context *ctx,
+			    struct xio_session_ops *ops,
+			    const char *uri,
+			    uint16_t *src_port,
+			    uint32_t session_flags,
+			    void *cb_private_data)
+{
+	return xio_bind_helper(ctx, ops, uri, src_port, session_flags,
+			       cb_private_data, 0);
+}
 EXPORT_SYMBOL(xio_bind);
 
+/*---------------------------------------------------------------------------*/
+/* xio_bind_sharded							     */
+/*---------------------------------------------------------------------------*/
+struct xio_server *xio_bind_sharded(struct xio_context *ctx,
+				    struct xio_session_ops *ops,
+				    const char *uri,
+				    uint16_t *src_port,
+				    uint32_t session_flags,
+				    void *cb_private_data)
+{
+	char	proto[8];
+
+	if (!uri || xio_uri_get_proto(uri, proto, sizeof(proto)) != 0 ||
+	    strcmp(proto, "tcp")) {
+		ERROR_LOG("sharded bind requires a tcp uri. uri:%s\n",
+			  uri ? uri : "(null)");
+		xio_set_error(EINVAL);
+		return NULL;
+	}
+
+	return xio_bind_helper(ctx, ops, uri, src_port, session_flags,
+			       cb_private_data, 1);
+}
+EXPORT_SYMBOL(xio_bind_sharded);
+
 /*---------------------------------------------------------------------------*/
 /* xio_server_destroy							     */
 /*---------------------------------------------------------------------------*/
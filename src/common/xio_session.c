@@ -59,6 +59,9 @@
 #include "xio_session.h"
 #include "xio_session_priv.h"
 #include <xio_env_adv.h>
+#ifdef XIO_CFLAG_STAT_COUNTERS
+#include "xio_stats_shm.h"
+#endif
 
 /*---------------------------------------------------------------------------*/
 /* forward declarations							     */
@@ -208,7 +211,9 @@ struct xio_session *xio_find_session(struct xio_task *task)
 
 	xio_mbuf_pop(&task->mbuf);
 
-	dest_session_id = ntohl(tmp_hdr->dest_session_id);
+	dest_session_id = task->nexus->native_hdr ?
+				tmp_hdr->dest_session_id :
+				ntohl(tmp_hdr->dest_session_id);
 
 	observer = xio_nexus_observer_lookup(task->nexus, dest_session_id);
 	if (observer &&  observer->impl)
@@ -237,6 +242,12 @@ void xio_session_write_header(struct xio_task *task,
 	tmp_hdr =
 	     (struct xio_session_hdr *)xio_mbuf_set_session_hdr(&task->mbuf);
 
+	/* peer runs in our byte order */
+	if (task->nexus->native_hdr) {
+		memcpy(tmp_hdr, hdr, sizeof(*hdr));
+		goto done;
+	}
+
 	/* fill header */
 	PACK_LVAL(hdr, tmp_hdr,  dest_session_id);
 	PACK_LVAL(hdr, tmp_hdr, flags);
@@ -244,6 +255,8 @@ void xio_session_write_header(struct xio_task *task,
 	PACK_SVAL(hdr, tmp_hdr, sn);
 	PACK_SVAL(hdr, tmp_hdr, ack_sn);
 	PACK_SVAL(hdr, tmp_hdr, credits_msgs);
+	PACK_SVAL(hdr, tmp_hdr, credits_stalls);
+	PACK_LVAL(hdr, tmp_hdr, service_ns);
 	PACK_LVAL(hdr, tmp_hdr, receipt_result);
 	PACK_LLVAL(hdr, tmp_hdr, credits_bytes);
 #ifdef XIO_SESSION_DEBUG
@@ -251,6 +264,7 @@ void xio_session_write_header(struct xio_task *task,
 	PACK_LLVAL(hdr, tmp_hdr, session);
 #endif
 
+done:
 	xio_mbuf_inc(&task->mbuf, sizeof(struct xio_session_hdr));
 }
 
@@ -266,6 +280,12 @@ void xio_session_read_header(struct xio_task *task,
 	tmp_hdr = (struct xio_session_hdr *)
 			xio_mbuf_set_session_hdr(&task->mbuf);
 
+	/* peer runs in our byte order */
+	if (task->nexus->native_hdr) {
+		memcpy(hdr, tmp_hdr, sizeof(*hdr));
+		goto done;
+	}
+
 	/* fill request */
 	UNPACK_LVAL(tmp_hdr, hdr, dest_session_id);
 	UNPACK_LVAL(tmp_hdr, hdr, flags);
@@ -273,6 +293,8 @@ void xio_session_read_header(struct xio_task *task,
 	UNPACK_SVAL(tmp_hdr, hdr, sn);
 	UNPACK_SVAL(tmp_hdr, hdr, ack_sn);
 	UNPACK_SVAL(tmp_hdr, hdr, credits_msgs);
+	UNPACK_SVAL(tmp_hdr, hdr, credits_stalls);
+	UNPACK_LVAL(tmp_hdr, hdr, service_ns);
 	UNPACK_LVAL(tmp_hdr, hdr, receipt_result);
 	UNPACK_LLVAL(tmp_hdr, hdr, credits_bytes);
 #ifdef XIO_SESSION_DEBUG
@@ -280,6 +302,7 @@ void xio_session_read_header(struct xio_task *task,
 	UNPACK_LLVAL(tmp_hdr, hdr, session);
 #endif
 
+done:
 	xio_mbuf_inc(&task->mbuf, sizeof(struct xio_session_hdr));
 }
 
@@ -577,6 +600,118 @@ void xio_session_notify_reconnected(struct xio_session *session,
 	}
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_on_aggr_req_recv							     */
+/*---------------------------------------------------------------------------*/
+static void xio_on_aggr_req_recv(struct xio_connection *connection,
+				 struct xio_task *task)
+{
+	struct xio_aggr_hdr	hdr;
+	struct xio_aggr_rx	*rx;
+	struct xio_aggr_rx_msg	*rx_msg;
+	struct xio_msg		*msg = &task->imsg;
+	struct xio_sg_table_ops	*sgtbl_ops;
+	void			*sgtbl;
+	void			*sg;
+	uint8_t			*buf, *ptr, *end;
+	size_t			len;
+	uint64_t		sn;
+	int			nr = 0, i, repeated;
+
+	sgtbl		= xio_sg_table_get(&msg->in);
+	sgtbl_ops	= (struct xio_sg_table_ops *)
+				xio_sg_table_ops_get(msg->in.sgl_type);
+
+	/* the frame is sent inline as a single data buffer */
+	if (tbl_nents(sgtbl_ops, sgtbl) != 1)
+		goto malformed;
+
+	sg	= sge_first(sgtbl_ops, sgtbl);
+	buf	= (uint8_t *)sge_addr(sgtbl_ops, sg);
+	end	= buf + sge_length(sgtbl_ops, sg);
+
+	for (ptr = buf; ptr + sizeof(hdr) <= end; nr++) {
+		memcpy(&hdr, ptr, sizeof(hdr));
+		len = sizeof(hdr) + ntohl(hdr.hdr_len) + ntohl(hdr.data_len);
+		if (len > (size_t)(end - ptr))
+			goto malformed;
+		ptr += len;
+	}
+	if (!nr || ptr != end)
+		goto malformed;
+
+	rx = (struct xio_aggr_rx *)kcalloc(1, sizeof(*rx) +
+					   nr * sizeof(*rx_msg), GFP_KERNEL);
+	if (!rx) {
+		xio_session_notify_msg_error(connection, msg, XIO_E_NO_BUFS,
+					     XIO_MSG_DIRECTION_IN);
+		return;
+	}
+	rx->task	= task;
+	rx->refcnt	= nr;
+	rx->nr		= nr;
+	rx->msgs	= (struct xio_aggr_rx_msg *)(rx + 1);
+
+	for (i = 0, ptr = buf; i < nr; i++) {
+		rx_msg = &rx->msgs[i];
+		memcpy(&hdr, ptr, sizeof(hdr));
+		ptr += sizeof(hdr);
+
+		rx_msg->rx			= rx;
+		rx_msg->msg.type		= XIO_ONE_WAY_REQ;
+		rx_msg->msg.sn			= ntohll(hdr.serial_num);
+		rx_msg->msg.flags		= XIO_MSG_FLAG_EX_AGGREGATED;
+		rx_msg->msg.timestamp		= msg->timestamp;
+		rx_msg->msg.in.header.iov_base	= ptr;
+		rx_msg->msg.in.header.iov_len	= ntohl(hdr.hdr_len);
+		ptr += rx_msg->msg.in.header.iov_len;
+
+		rx_msg->msg.in.sgl_type		= XIO_SGL_TYPE_IOV;
+		rx_msg->msg.in.data_iov.max_nents = XIO_IOVLEN;
+		if (hdr.data_len) {
+			rx_msg->msg.in.data_iov.nents = 1;
+			rx_msg->msg.in.data_iov.sglist[0].iov_base = ptr;
+			rx_msg->msg.in.data_iov.sglist[0].iov_len =
+							ntohl(hdr.data_len);
+			ptr += ntohl(hdr.data_len);
+		}
+	}
+	if (msg->flags & XIO_MSG_FLAG_LAST_IN_BATCH)
+		set_bits(XIO_MSG_FLAG_LAST_IN_BATCH,
+			 &rx->msgs[nr - 1].msg.flags);
+
+	/* repeated msgs were already delivered and are released here */
+	for (i = 0; i < nr; i++) {
+		/* the last release frees rx - keep what is needed after */
+		rx_msg = &rx->msgs[i];
+		sn = rx_msg->msg.sn;
+		repeated = connection->latest_delivered >= sn &&
+			   connection->latest_delivered != 0;
+#ifdef XIO_THREAD_SAFE_DEBUG
+		xio_ctx_debug_thread_unlock(connection->ctx);
+#endif
+		if (repeated)
+			xio_release_msg(&rx_msg->msg);
+		else
+			connection->ses_ops.on_msg(
+					connection->session, &rx_msg->msg,
+					task->last_in_rxq && (i == nr - 1),
+					connection->cb_user_context);
+#ifdef XIO_THREAD_SAFE_DEBUG
+		xio_ctx_debug_thread_lock(connection->ctx);
+#endif
+		if (!repeated)
+			connection->latest_delivered = sn;
+	}
+	return;
+
+malformed:
+	ERROR_LOG("malformed aggregated frame. sn:%llu\n",
+		  (unsigned long long)msg->sn);
+	xio_session_notify_msg_error(connection, msg, XIO_E_MSG_INVALID,
+				     XIO_MSG_DIRECTION_IN);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_on_req_recv				                             */
 /*---------------------------------------------------------------------------*/
@@ -605,6 +740,8 @@ static int xio_on_req_recv(struct xio_connection *connection,
 		if (connection->enable_flow_control) {
 			connection->peer_credits_msgs += hdr.credits_msgs;
 			connection->peer_credits_bytes += hdr.credits_bytes;
+			xio_connection_fc_recv(connection, msg,
+					       hdr.credits_stalls);
 		}
 		connection->restarted = 0;
 	} else {
@@ -650,6 +787,9 @@ static int xio_on_req_recv(struct xio_connection *connection,
 	xio_stat_inc(stats, XIO_STAT_RX_MSG);
 	xio_stat_add(stats, XIO_STAT_RX_BYTES,
 		     vmsg->header.iov_len + tbl_length(sgtbl_ops, sgtbl));
+	xio_stats_shm_add(connection->shm_counters, XIO_SHM_CONN_RX_MSGS, 1);
+	xio_stats_shm_add(connection->shm_counters, XIO_SHM_CONN_RX_BYTES,
+			  vmsg->header.iov_len + tbl_length(sgtbl_ops, sgtbl));
 #endif
 	if (test_bits(XIO_MSG_FLAG_EX_IMM_READ_RECEIPT, &hdr.flags)) {
 		xio_task_addref(task);
@@ -663,6 +803,8 @@ static int xio_on_req_recv(struct xio_connection *connection,
 					     (enum xio_status)task->status,
 					     XIO_MSG_DIRECTION_IN);
 		task->status = 0;
+	} else if (test_bits(XIO_MSG_FLAG_EX_AGGREGATED, &hdr.flags)) {
+		xio_on_aggr_req_recv(connection, task);
 	} else {
 		/* check for repeated msgs */
 		/* repeated msgs will not be delivered to the application since they were already delivered */
@@ -736,6 +878,11 @@ static int xio_on_rsp_recv(struct xio_connection *connection,
 		if (connection->enable_flow_control) {
 			connection->peer_credits_msgs += hdr.credits_msgs;
 			connection->peer_credits_bytes += hdr.credits_bytes;
+			/* a standalone receipt is not charged by the peer */
+			xio_connection_fc_recv(connection,
+					       standalone_receipt ?
+					       NULL : &task->imsg,
+					       hdr.credits_stalls);
 		}
 	} else {
 		if (unlikely(connection->restarted)) {
@@ -766,7 +913,10 @@ static int xio_on_rsp_recv(struct xio_connection *connection,
 	xio_stat_add(stats, XIO_STAT_DELAY,
 		     get_cycles() - omsg->timestamp);
 	xio_stat_inc(stats, XIO_STAT_RX_MSG);
+	xio_stats_shm_add(connection->shm_counters, XIO_SHM_CONN_RX_MSGS, 1);
+	sender_task->lat_peer_ns = hdr.service_ns;
 #endif
+	xio_task_lat_stamp(sender_task, XIO_TASK_LAT_RSP);
 	omsg->next	= NULL;
 
 	xio_clear_ex_flags(&omsg->flags);
@@ -777,6 +927,9 @@ static int xio_on_rsp_recv(struct xio_connection *connection,
 	/* remove only if not response with "read receipt" */
 	if (!standalone_receipt) {
 		xio_connection_remove_in_flight(connection, omsg);
+		if (sender_task->lb_ts)
+			xio_connection_lb_rtt_sample(
+				connection, get_cycles() - sender_task->lb_ts);
 	} else {
 		if (task->tlv_type == XIO_ONE_WAY_RSP)
 			if (xio_app_receipt_first_request(&hdr))
@@ -885,6 +1038,10 @@ static int xio_on_rsp_recv(struct xio_connection *connection,
 			xio_stat_add(stats, XIO_STAT_RX_BYTES,
 				     vmsg->header.iov_len +
 				     tbl_length(sgtbl_ops, sgtbl));
+			xio_stats_shm_add(connection->shm_counters,
+					  XIO_SHM_CONN_RX_BYTES,
+					  vmsg->header.iov_len +
+					  tbl_length(sgtbl_ops, sgtbl));
 #endif
 			omsg->request	= msg;
 			if (task->status) {
@@ -897,6 +1054,8 @@ static int xio_on_rsp_recv(struct xio_connection *connection,
 #ifdef XIO_THREAD_SAFE_DEBUG
 				xio_ctx_debug_thread_unlock(connection->ctx);
 #endif
+				xio_task_lat_stamp(sender_task,
+						   XIO_TASK_LAT_DELIVER);
 				/*if (connection->ses_ops.on_msg) */
 					connection->ses_ops.on_msg(
 						connection->session,
@@ -980,6 +1139,7 @@ int xio_on_credits_ack_recv(struct xio_connection *connection,
 		connection->req_ack_sn = hdr.sn;
 		connection->peer_credits_msgs += hdr.credits_msgs;
 		connection->peer_credits_bytes += hdr.credits_bytes;
+		xio_connection_fc_recv(connection, NULL, hdr.credits_stalls);
 	} else {
 		ERROR_LOG("ERROR: sn expected:%d, sn arrived:%d\n",
 			  connection->req_exp_sn, hdr.sn);
@@ -995,6 +1155,50 @@ int xio_on_credits_ack_recv(struct xio_connection *connection,
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_on_aggr_req_send_comp						     */
+/*---------------------------------------------------------------------------*/
+static void xio_on_aggr_req_send_comp(struct xio_connection *connection,
+				      struct xio_msg *msg)
+{
+	struct xio_aggr_msg	*aggr;
+	struct xio_msg		*omsg, *tmp_omsg;
+	struct xio_sg_table_ops	*sgtbl_ops;
+	void			*sgtbl;
+
+	aggr = container_of(msg, struct xio_aggr_msg, msg);
+
+	/* complete every packed message as if it was sent on its own */
+	xio_msg_list_foreach_safe(omsg, &aggr->msgs, tmp_omsg, pdata) {
+		xio_msg_list_remove(&aggr->msgs, omsg, pdata);
+		if (connection->enable_flow_control) {
+			sgtbl		= xio_sg_table_get(&omsg->out);
+			sgtbl_ops	= (struct xio_sg_table_ops *)
+				xio_sg_table_ops_get(omsg->out.sgl_type);
+
+			connection->tx_queued_msgs--;
+			connection->tx_bytes -=
+				(omsg->out.header.iov_len +
+				 tbl_length(sgtbl_ops, sgtbl));
+		}
+		if (connection->ses_ops.on_ow_msg_send_complete) {
+#ifdef XIO_THREAD_SAFE_DEBUG
+			xio_ctx_debug_thread_unlock(connection->ctx);
+#endif
+			connection->ses_ops.on_ow_msg_send_complete(
+					connection->session, omsg,
+					connection->cb_user_context);
+#ifdef XIO_THREAD_SAFE_DEBUG
+			xio_ctx_debug_thread_lock(connection->ctx);
+#endif
+		}
+	}
+	kfree(aggr);
+
+	/* release a frame that was held behind this one */
+	xio_connection_xmit_msgs(connection);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_on_ow_req_send_comp				                     */
 /*---------------------------------------------------------------------------*/
@@ -1024,6 +1228,11 @@ static int xio_on_ow_req_send_comp(
 					       */
 #endif
 	xio_connection_remove_in_flight(connection, omsg);
+	if (omsg->flags & XIO_MSG_FLAG_EX_AGGREGATED) {
+		xio_on_aggr_req_send_comp(connection, omsg);
+		xio_tasks_pool_put(task);
+		goto exit;
+	}
 	omsg->flags = task->omsg_flags;
 	xio_clear_ex_flags(&omsg->flags);
 
@@ -1328,6 +1537,9 @@ int xio_on_new_message(struct xio_session *s,
 	task->session		= session;
 	task->connection	= connection;
 
+	/* any received message proves liveness to the keepalive sweep */
+	connection->ka.last_rx = connection->ctx->ka_tick;
+
 	switch (task->tlv_type) {
 	case XIO_MSG_REQ:
 	case XIO_ONE_WAY_REQ:
@@ -1403,6 +1615,11 @@ int xio_on_send_completion(struct xio_session *session,
 
 	switch (task->tlv_type) {
 	case XIO_MSG_REQ:
+		xio_task_lat_stamp(task, XIO_TASK_LAT_TX_COMP);
+		retval = 0;
+		/* the transport drained - retry a held back bulk message */
+		xmit = connection->bulk_gated;
+		break;
 	case XIO_SESSION_SETUP_REQ:
 		retval = 0;
 		break;
@@ -1899,6 +2116,9 @@ int xio_query_session(struct xio_session *session,
 	if (attr_mask & XIO_SESSION_ATTR_URI)
 		attr->uri = session->uri;
 
+	if (attr_mask & XIO_SESSION_ATTR_LB_POLICY)
+		attr->lb_policy = (enum xio_session_lb_policy)session->lb_policy;
+
 	return 0;
 }
 EXPORT_SYMBOL(xio_query_session);
@@ -1919,10 +2139,110 @@ int xio_modify_session(struct xio_session *session,
 	if (attr_mask & XIO_SESSION_ATTR_USER_CTX)
 		session->cb_user_context = attr->user_context;
 
+	if (attr_mask & XIO_SESSION_ATTR_LB_POLICY) {
+		if (attr->lb_policy != XIO_SESSION_LB_ROUND_ROBIN &&
+		    attr->lb_policy != XIO_SESSION_LB_LEAST_OUTSTANDING &&
+		    attr->lb_policy != XIO_SESSION_LB_P2C_LATENCY) {
+			xio_set_error(EINVAL);
+			ERROR_LOG("invalid lb policy %d\n", attr->lb_policy);
+			return -1;
+		}
+		session->lb_policy = (uint16_t)attr->lb_policy;
+	}
+
 	return 0;
 }
 EXPORT_SYMBOL(xio_modify_session);
 
+/*---------------------------------------------------------------------------*/
+/* xio_session_lb_cost							     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t xio_session_lb_cost(struct xio_session *session,
+					   struct xio_connection *connection)
+{
+	uint64_t outstanding = connection->reqs_outstanding;
+
+	if (session->lb_policy == XIO_SESSION_LB_LEAST_OUTSTANDING)
+		return outstanding;
+
+	/* expected wait: queue ahead times observed response latency.
+	 * connections without a sample yet cost nothing and get probed
+	 */
+	return connection->lb_rtt_cycles * (outstanding + 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_session_lb_pick							     */
+/*---------------------------------------------------------------------------*/
+struct xio_connection *xio_session_lb_pick(struct xio_session *session)
+{
+	struct xio_connection	*connection, *best = NULL;
+	uint64_t		cost, best_cost = 0;
+	uint32_t		seq, nr = 0, i = 0, a, b = 0;
+	uint32_t		idx, rank, best_rank = 0;
+
+	spin_lock(&session->connections_list_lock);
+	list_for_each_entry(connection, &session->connections_list,
+			    connections_list_entry) {
+		if (xio_connection_is_lb_eligible(connection))
+			nr++;
+	}
+	if (!nr)
+		goto exit;
+
+	/* the connection counters belong to their context threads and are
+	 * read unlocked; a stale value only skews the spread
+	 */
+	seq = session->lb_seq++;
+	if (session->lb_policy == XIO_SESSION_LB_P2C_LATENCY) {
+		/* two distinct pseudo random candidates */
+		seq *= 2654435761U;
+		a = (seq >> 8) % nr;
+		if (nr > 1) {
+			b = (seq >> 20) % (nr - 1);
+			if (b >= a)
+				b++;
+		}
+	} else {
+		a = seq % nr;
+	}
+
+	list_for_each_entry(connection, &session->connections_list,
+			    connections_list_entry) {
+		if (!xio_connection_is_lb_eligible(connection))
+			continue;
+		idx = i++;
+		if (session->lb_policy == XIO_SESSION_LB_ROUND_ROBIN) {
+			if (idx == a) {
+				best = connection;
+				break;
+			}
+			continue;
+		}
+		if (session->lb_policy == XIO_SESSION_LB_P2C_LATENCY &&
+		    idx != a && idx != b)
+			continue;
+		/* ties go to the first one after the rotating start */
+		rank = (idx + nr - a) % nr;
+		cost = xio_session_lb_cost(session, connection);
+		if (!best || cost < best_cost ||
+		    (cost == best_cost && rank < best_rank)) {
+			best	  = connection;
+			best_cost = cost;
+			best_rank = rank;
+		}
+	}
+	/* the caller owns a post reference on the picked connection, it
+	 * pins the memory only and is dropped by the loop thread
+	 */
+	if (best && !xio_connection_post_get(best))
+		best = NULL;
+exit:
+	spin_unlock(&session->connections_list_lock);
+
+	return best;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_get_connection							     */
 /*---------------------------------------------------------------------------*/
@@ -73,7 +73,8 @@ struct xio_session {
 	uint16_t			rcv_queue_depth_msgs;
 	uint16_t			peer_snd_queue_depth_msgs;
 	uint16_t			peer_rcv_queue_depth_msgs;
-	uint16_t			pad[2];
+	uint16_t			lb_policy;
+	uint16_t			pad;
 	uint64_t			snd_queue_depth_bytes;
 	uint64_t			rcv_queue_depth_bytes;
 	uint64_t			peer_snd_queue_depth_bytes;
@@ -117,7 +118,7 @@ struct xio_session {
 
 	uint32_t			teardown_reason;
 	uint32_t			reject_reason;
-	uint32_t			pad1;
+	uint32_t			lb_seq;	/* rr cursor and p2c seed */
 	struct mutex                    lock;	   /* lock open connection */
 	spinlock_t                      connections_list_lock;
 	int				disable_teardown;
@@ -175,6 +176,9 @@ int xio_session_reconnect(
 		struct xio_session  *session,
 		struct xio_connection  *connection);
 
+struct xio_connection *xio_session_lb_pick(
+		struct xio_session *session);
+
 /*---------------------------------------------------------------------------*/
 /* xio_session_is_valid_in_req						     */
 /*---------------------------------------------------------------------------*/
@@ -448,6 +448,7 @@ int xio_accept(struct xio_session *session,
 		task->connection->peer_credits_bytes =
 					session->peer_rcv_queue_depth_bytes;
 		task->connection->credits_bytes	= 0;
+		xio_connection_fc_reset(task->connection);
 
 		/* server side state is changed to ONLINE, immediately  */
 		session->state = XIO_SESSION_STATE_ONLINE;
@@ -68,7 +68,8 @@ static int sessions_cache_add(struct xio_session *session,
 	if (s)
 		return -1;
 
-	HT_INSERT(&sessions_cache, &key, session, sessions_htbl);
+	if (HT_INSERT(&sessions_cache, &key, session, sessions_htbl))
+		return -1;
 
 	return 0;
 }
@@ -51,6 +51,16 @@ enum xio_task_state {
 	XIO_TASK_STATE_CANCEL_PENDING,      /* mark for rdma read task */
 };
 
+/* request life stamps, see xio_connection_lat_account */
+enum xio_task_lat_stamp {
+	XIO_TASK_LAT_XMIT,
+	XIO_TASK_LAT_TX,
+	XIO_TASK_LAT_TX_COMP,
+	XIO_TASK_LAT_RSP,
+	XIO_TASK_LAT_DELIVER,
+	XIO_TASK_LAT_LAST
+};
+
 /*---------------------------------------------------------------------------*/
 /* forward declarations							     */
 /*---------------------------------------------------------------------------*/
@@ -78,6 +88,12 @@ struct xio_task {
 	uint32_t                magic;
 	int32_t                 status;
 	int32_t                 pad1;
+	uint64_t		lb_ts;		/* rtt start, cycles	*/
+#ifdef XIO_CFLAG_STAT_COUNTERS
+	uint64_t		lat_ts[XIO_TASK_LAT_LAST]; /* cycles	*/
+	uint32_t		lat_peer_ns;	/* peer service time	*/
+	uint32_t		lat_pad;
+#endif
 
 	void			*pool;
 	void			*slab;
@@ -135,6 +151,11 @@ struct xio_tasks_pool_params {
 	int				pool_dd_data_sz;
 	int				slab_dd_data_sz;
 	int				task_dd_data_sz;
+	/* free slabs idle for idle_reclaim_ticks reclaim sweeps.
+	 * 0 - the pool never shrinks
+	 */
+	unsigned int			idle_reclaim_ticks;
+	int				pad;
 };
 
 struct xio_tasks_slab {
@@ -146,6 +167,12 @@ struct xio_tasks_slab {
 	uint32_t			nr;
 	uint32_t			huge_alloc;
 	void				*dd_data;
+	/* shrinkable pools keep each slab's free tasks contiguous in the
+	 * stack, in slabs_list order, starting at first_free
+	 */
+	struct xio_task			*first_free;
+	uint32_t			free_nr;
+	uint32_t			idle_ticks;
 };
 
 struct xio_tasks_pool {
@@ -160,8 +187,17 @@ struct xio_tasks_pool {
 	unsigned int			pad;
 	struct list_head		slabs_list;
 	void				*dd_data;
+	uint64_t			reclaimed_slabs;
+	uint64_t			reclaimed_tasks;
 };
 
+/*---------------------------------------------------------------------------*/
+/* xio_tasks_pool_push_ordered						     */
+/*---------------------------------------------------------------------------*/
+void xio_tasks_pool_push_ordered(struct xio_tasks_pool *q,
+				 struct xio_tasks_slab *s,
+				 struct xio_task *task);
+
 /*---------------------------------------------------------------------------*/
 /* xio_task_reset							     */
 /*---------------------------------------------------------------------------*/
@@ -183,6 +219,31 @@ static inline void xio_task_reset(struct xio_task *task)
 	task->tlv_type			= 0xdead;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_task_lat_stamp							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_task_lat_stamp(struct xio_task *task, int stamp)
+{
+#ifdef XIO_CFLAG_STAT_COUNTERS
+	if (unlikely(g_options.enable_latency_stats))
+		task->lat_ts[stamp] = get_cycles();
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_task_lat_start							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_task_lat_start(struct xio_task *task)
+{
+#ifdef XIO_CFLAG_STAT_COUNTERS
+	if (unlikely(g_options.enable_latency_stats)) {
+		memset(task->lat_ts, 0, sizeof(task->lat_ts));
+		task->lat_peer_ns = 0;
+		task->lat_ts[XIO_TASK_LAT_XMIT] = get_cycles();
+	}
+#endif
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_task_addref							     */
 /*---------------------------------------------------------------------------*/
@@ -232,7 +293,12 @@ static inline void xio_task_release(struct kref *kref)
 
 	pool->curr_used--;
 
-	list_move(&task->tasks_list_entry, &pool->stack);
+	if (!pool->params.idle_reclaim_ticks) {
+		list_move(&task->tasks_list_entry, &pool->stack);
+		return;
+	}
+	xio_tasks_pool_push_ordered(pool, (struct xio_tasks_slab *)task->slab,
+				    task);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -261,6 +327,26 @@ int xio_tasks_pool_alloc_slab(struct xio_tasks_pool *q, void *context);
 /*---------------------------------------------------------------------------*/
 void xio_tasks_pool_dump_used(struct xio_tasks_pool *q);
 
+/*---------------------------------------------------------------------------*/
+/* xio_tasks_pool_reclaim						     */
+/*---------------------------------------------------------------------------*/
+int xio_tasks_pool_reclaim(struct xio_tasks_pool *q);
+
+/*---------------------------------------------------------------------------*/
+/* xio_tasks_pool_pop_ordered						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_tasks_pool_pop_ordered(struct xio_task *t)
+{
+	struct xio_tasks_slab *s = (struct xio_tasks_slab *)t->slab;
+
+	/* the slab's segment stays contiguous - advance its head */
+	if (s->first_free == t)
+		s->first_free = (s->free_nr > 1) ?
+			list_next_entry(t, tasks_list_entry) : NULL;
+	s->free_nr--;
+	s->idle_ticks = 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tasks_pool_get							     */
 /*---------------------------------------------------------------------------*/
@@ -285,6 +371,8 @@ static inline struct xio_task *xio_tasks_pool_get(
 		t = list_first_entry(&q->stack, struct xio_task,
 				     tasks_list_entry);
 	}
+	if (q->params.idle_reclaim_ticks)
+		xio_tasks_pool_pop_ordered(t);
 	list_del_init(&t->tasks_list_entry);
 	q->curr_used++;
 	if (q->curr_used > q->max_used)
@@ -72,21 +72,30 @@ void xio_unreg_transport(struct xio_transport *transport)
 EXPORT_SYMBOL(xio_unreg_transport);
 
 /*---------------------------------------------------------------------------*/
-/* xio_get_transport							     */
+/* xio_find_transport							     */
 /*---------------------------------------------------------------------------*/
-struct xio_transport *xio_get_transport(const char *name)
+struct xio_transport *xio_find_transport(const char *name)
 {
 	struct xio_transport	*transport;
-	int			found = 0;
 
 	list_for_each_entry(transport, &transports_list,
 			    transports_list_entry) {
-		if (!strcmp(name, transport->name)) {
-			found = 1;
-			break;
-		}
+		if (!strcmp(name, transport->name))
+			return transport;
 	}
-	if (!found)
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_get_transport							     */
+/*---------------------------------------------------------------------------*/
+struct xio_transport *xio_get_transport(const char *name)
+{
+	struct xio_transport	*transport;
+
+	transport = xio_find_transport(name);
+	if (!transport)
 		return NULL;
 
 	/* lazy initialization of transport */
@@ -71,6 +71,7 @@ enum xio_transport_opt {
 
 enum xio_transport_attr_mask {
 	XIO_TRANSPORT_ATTR_TOS			= 1 << 0,
+	XIO_TRANSPORT_ATTR_REUSEPORT		= 1 << 1,
 };
 
 /*---------------------------------------------------------------------------*/
@@ -124,12 +125,14 @@ struct xio_transport_base {
 
 struct xio_transport_attr {
 	uint8_t			tos;		/**< type of service RFC 2474 */
-	uint8_t			pad[3];		/**< padding		     */
+	uint8_t			reuseport;	/**< share the listen address */
+	uint8_t			pad[2];		/**< padding		     */
 };
 
 struct xio_transport_init_attr {
 	uint8_t			tos;		/**< type of service RFC 2474 */
-	uint8_t			pad[3];		/**< padding		     */
+	uint8_t			reuseport;	/**< share the listen address */
+	uint8_t			pad[2];		/**< padding		     */
 };
 
 struct xio_transport_msg_validators_cls {
@@ -270,6 +273,9 @@ struct xio_transport {
 			 struct xio_transport_attr *attr,
 			 int attr_mask);
 
+	/* frames accepted by send but not yet written out, optional */
+	int	(*tx_backlog)(struct xio_transport_base *trans_hndl);
+
 	struct list_head transports_list_entry;
 };
 
@@ -359,6 +365,11 @@ void xio_unreg_transport(struct xio_transport *transport);
 /*---------------------------------------------------------------------------*/
 struct xio_transport *xio_get_transport(const char *name);
 
+/*---------------------------------------------------------------------------*/
+/* xio_find_transport - lookup without triggering lazy initialization	     */
+/*---------------------------------------------------------------------------*/
+struct xio_transport *xio_find_transport(const char *name);
+
 int xio_rdma_cancel_req(struct xio_transport_base *transport,
 			struct xio_msg *req, uint64_t stag,
 			void *ulp_msg, size_t ulp_msg_sz);
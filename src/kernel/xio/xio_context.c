@@ -98,7 +98,7 @@ struct xio_context *xio_context_create(struct xio_context_params *ctx_params,
 	struct xio_loop_ops		*loop_ops;
 	struct task_struct		*worker;
 	struct xio_transport		*transport;
-	int				flags, cpu;
+	int				flags, cpu, i;
 
 	if (!ctx_params) {
 		xio_set_error(EINVAL);
@@ -177,6 +177,7 @@ struct xio_context *xio_context_create(struct xio_context_params *ctx_params,
 
 	XIO_OBSERVABLE_INIT(&ctx->observable, ctx);
 	INIT_LIST_HEAD(&ctx->ctx_list);
+	INIT_LIST_HEAD(&ctx->ka_list);
 
 	switch (flags) {
 	case XIO_LOOP_USER_LOOP:
@@ -224,6 +225,9 @@ struct xio_context *xio_context_create(struct xio_context_params *ctx_params,
 		}
 	}
 	spin_lock_init(&ctx->ctx_list_lock);
+	spin_lock_init(&ctx->nexus_index_lock);
+	for (i = 0; i < XIO_CTX_NEXUS_BUCKETS; i++)
+		INIT_LIST_HEAD(&ctx->nexus_index[i]);
 
 	xio_idr_add_uobj(usr_idr, ctx, "xio_context");
 	return ctx;
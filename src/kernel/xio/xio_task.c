@@ -180,6 +180,11 @@ int xio_tasks_pool_alloc_slab(struct xio_tasks_pool *q, void *context)
 	}
 	q->curr_alloced += alloc_nr;
 
+	/* the newest slab ranks last - its tasks go to the stack's tail */
+	s->first_free = s->array[0];
+	s->free_nr = alloc_nr;
+	s->idle_ticks = 0;
+
 	list_add_tail(&s->slabs_list_entry, &q->slabs_list);
 	preempt_disable();
 	list_splice_tail(&tmp_list, &q->stack);
@@ -212,6 +217,36 @@ cleanup:
 }
 EXPORT_SYMBOL(xio_tasks_pool_alloc_slab);
 
+/*---------------------------------------------------------------------------*/
+/* xio_tasks_pool_push_ordered						     */
+/*---------------------------------------------------------------------------*/
+void xio_tasks_pool_push_ordered(struct xio_tasks_pool *q,
+				 struct xio_tasks_slab *s,
+				 struct xio_task *task)
+{
+	struct xio_tasks_slab	*n = s;
+	struct list_head	*pos = &q->stack;
+
+	/* older slabs' tasks are taken first, so the newest slabs drain */
+	if (s->free_nr) {
+		pos = &s->first_free->tasks_list_entry;
+	} else {
+		list_for_each_entry_continue(n, &q->slabs_list,
+					     slabs_list_entry) {
+			if (n->free_nr) {
+				pos = &n->first_free->tasks_list_entry;
+				break;
+			}
+		}
+	}
+	/* insert in front of pos */
+	list_move_tail(&task->tasks_list_entry, pos);
+
+	s->first_free = task;
+	s->free_nr++;
+}
+EXPORT_SYMBOL(xio_tasks_pool_push_ordered);
+
 /*---------------------------------------------------------------------------*/
 /* xio_tasks_pool_create						     */
 /*---------------------------------------------------------------------------*/
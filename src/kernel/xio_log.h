@@ -92,4 +92,20 @@ static inline int xio_set_log_fn(void * /*xio_log_fn*/ fn)
 	return -1;
 }
 
+/* printk does not block the caller */
+static inline int xio_set_log_async(int enable)
+{
+	return -1;
+}
+
+static inline int xio_get_log_async(void)
+{
+	return 0;
+}
+
+static inline uint64_t xio_get_log_dropped(void)
+{
+	return 0;
+}
+
 #endif /* XIO_LOG_H */
@@ -245,6 +245,15 @@ static inline int xio_numa_run_on_node(int node)
 	return numa_run_on_node(node);
 }
 
+/*---------------------------------------------------------------------------*/
+static inline int xio_numa_max_node(void)
+{
+	if (numa_available() == -1)
+		return 0;
+
+	return numa_max_node();
+}
+
 #define XIO_HZ_DIR   "/var/tmp/accelio.d"
 #define XIO_HZ_FILE  XIO_HZ_DIR "/hz"
 
@@ -364,6 +373,16 @@ typedef pthread_once_t		thread_once_t;
 	__sync_fetch_and_add((ptr), (value))
 #define  xio_sync_fetch_and_add64(ptr, value) \
 	__sync_fetch_and_add((ptr), (value))
+#define xio_sync_bool_compare_and_swap64(ptr, oldval, newval) \
+		__sync_bool_compare_and_swap(ptr, oldval, newval)
+#define xio_sync_exchange32(ptr, value) \
+	__atomic_exchange_n((ptr), (value), __ATOMIC_SEQ_CST)
+#define xio_sync_load_relaxed64(ptr) \
+	__atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define xio_sync_load_acquire64(ptr) \
+	__atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define xio_sync_store_release64(ptr, value) \
+	__atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
 
 /*---------------------------------------------------------------------------*/
 #define XIO_F_ALWAYS_INLINE inline __attribute__((always_inline))
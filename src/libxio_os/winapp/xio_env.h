@@ -156,6 +156,19 @@ static const INIT_ONCE INIT_ONCE_RESET_VALUE = INIT_ONCE_STATIC_INIT;
 #define xio_sync_bool_compare_and_swap(ptr, oldval, newval) \
 	((long)(oldval) == InterlockedCompareExchangeAcquire(\
 	(volatile long*)(ptr), (long)(newval), (long)(oldval)))
+#define xio_sync_bool_compare_and_swap64(ptr, oldval, newval) \
+	((LONG64)(oldval) == InterlockedCompareExchange64(\
+	(volatile LONG64 *)(ptr), (LONG64)(newval), (LONG64)(oldval)))
+#define xio_sync_exchange32(ptr, value) \
+		InterlockedExchange((volatile LONG *)(ptr), (LONG)(value))
+#define xio_sync_load_relaxed64(ptr) \
+		((uint64_t)*(volatile LONG64 *)(ptr))
+#define xio_sync_load_acquire64(ptr) \
+		((uint64_t)InterlockedCompareExchangeAcquire64(\
+		(volatile LONG64 *)(ptr), 0, 0))
+#define xio_sync_store_release64(ptr, value) \
+		((void)InterlockedExchange64((volatile LONG64 *)(ptr), \
+		(LONG64)(value)))
 
 
 /* TODO: consider removing (since user already must call xio_init()?
@@ -216,6 +229,12 @@ static inline int xio_numa_run_on_node(int node)
 	return -1; /* error */
 }
 
+/*---------------------------------------------------------------------------*/
+static inline int xio_numa_max_node(void)
+{
+	return 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_pin_to_cpu - pin to specific cpu					     */
 /*---------------------------------------------------------------------------*/
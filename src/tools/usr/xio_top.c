@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define XIO_STATS_SHM_READER
+#include "xio_stats_shm.h"
+
+#define SHM_DIR		"/dev/shm"
+#define MAX_RETRIES	8
+
+struct xio_top_proc {
+	struct xio_top_proc		*next;
+	struct xio_stats_shm_hdr	*hdr;
+	size_t				size;
+	uint32_t			pid;
+	int				seen;
+	/* previous snapshot, rates are computed against it */
+	struct xio_stats_shm_ctx	*ctx_prev;
+	struct xio_stats_shm_conn	*conn_prev;
+};
+
+static struct xio_top_proc	*procs;
+static int			opt_pid;
+static int			opt_interval = 1;
+static int			opt_count = -1;
+static int			opt_conns;
+
+/*---------------------------------------------------------------------------*/
+/* usage								     */
+/*---------------------------------------------------------------------------*/
+static void usage(const char *argv0)
+{
+	printf("Usage: %s [OPTIONS]\n", argv0);
+	printf("\tshows statistics of processes running accelio with\n");
+	printf("\tXIO_STATS_SHM=1 or XIO_OPTNAME_ENABLE_STATS_SHM set\n\n");
+	printf("\t-p, --pid=<pid>         show this process only\n");
+	printf("\t-i, --interval=<sec>    refresh interval (default 1)\n");
+	printf("\t-n, --count=<num>       refresh num times and exit\n");
+	printf("\t-c, --connections       show per connection statistics\n");
+	printf("\t-h, --help              display this help and exit\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* read_slot								     */
+/*---------------------------------------------------------------------------*/
+static int read_slot(void *dst, const void *src, size_t len,
+		     const uint32_t *gen)
+{
+	uint32_t g1, g2;
+	int	 i;
+
+	/* the writer never waits on us - copy and retry if it moved */
+	for (i = 0; i < MAX_RETRIES; i++) {
+		g1 = __atomic_load_n(gen, __ATOMIC_ACQUIRE);
+		if (!(g1 & 1))
+			return -1;
+		memcpy(dst, src, len);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		g2 = __atomic_load_n(gen, __ATOMIC_RELAXED);
+		if (g1 == g2)
+			return 0;
+	}
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* proc_free								     */
+/*---------------------------------------------------------------------------*/
+static void proc_free(struct xio_top_proc *proc)
+{
+	munmap(proc->hdr, proc->size);
+	free(proc->ctx_prev);
+	free(proc->conn_prev);
+	free(proc);
+}
+
+/*---------------------------------------------------------------------------*/
+/* proc_attach								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_top_proc *proc_attach(const char *name, uint32_t pid)
+{
+	struct xio_top_proc		*proc;
+	struct xio_stats_shm_hdr	*hdr;
+	struct stat			st;
+	char				path[256];
+	int				fd;
+
+	snprintf(path, sizeof(path), "%s/%s", SHM_DIR, name);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) ||
+	    (size_t)st.st_size < sizeof(struct xio_stats_shm_hdr)) {
+		close(fd);
+		return NULL;
+	}
+	hdr = (struct xio_stats_shm_hdr *)mmap(NULL, st.st_size, PROT_READ,
+					       MAP_SHARED, fd, 0);
+	close(fd);
+	if (hdr == MAP_FAILED)
+		return NULL;
+
+	if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) !=
+	    XIO_STATS_SHM_MAGIC ||
+	    hdr->version != XIO_STATS_SHM_VERSION || hdr->pid != pid ||
+	    (size_t)st.st_size < xio_stats_shm_size(hdr->ctx_slots,
+						    hdr->conn_slots))
+		goto cleanup;
+
+	proc = (struct xio_top_proc *)calloc(1, sizeof(*proc));
+	if (!proc)
+		goto cleanup;
+	proc->hdr	= hdr;
+	proc->size	= st.st_size;
+	proc->pid	= pid;
+	proc->ctx_prev	= (struct xio_stats_shm_ctx *)
+		calloc(hdr->ctx_slots, sizeof(struct xio_stats_shm_ctx));
+	proc->conn_prev	= (struct xio_stats_shm_conn *)
+		calloc(hdr->conn_slots, sizeof(struct xio_stats_shm_conn));
+	if (!proc->ctx_prev || !proc->conn_prev) {
+		free(proc->ctx_prev);
+		free(proc->conn_prev);
+		free(proc);
+		goto cleanup;
+	}
+
+	return proc;
+
+cleanup:
+	munmap(hdr, st.st_size);
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* scan_procs								     */
+/*---------------------------------------------------------------------------*/
+static void scan_procs(void)
+{
+	struct xio_top_proc	*proc, **pproc;
+	struct dirent		*ent;
+	DIR			*dir;
+	size_t			plen = strlen(XIO_STATS_SHM_PREFIX);
+	uint32_t		pid;
+
+	for (proc = procs; proc; proc = proc->next)
+		proc->seen = 0;
+
+	dir = opendir(SHM_DIR);
+	if (dir) {
+		while ((ent = readdir(dir)) != NULL) {
+			if (strncmp(ent->d_name, XIO_STATS_SHM_PREFIX, plen))
+				continue;
+			pid = (uint32_t)strtoul(ent->d_name + plen, NULL, 10);
+			if (!pid || (opt_pid && pid != (uint32_t)opt_pid))
+				continue;
+			/* segments left behind by crashed processes */
+			if (kill((pid_t)pid, 0) && errno == ESRCH)
+				continue;
+			for (proc = procs; proc; proc = proc->next)
+				if (proc->pid == pid)
+					break;
+			if (!proc) {
+				proc = proc_attach(ent->d_name, pid);
+				if (!proc)
+					continue;
+				proc->next = procs;
+				procs = proc;
+			}
+			proc->seen = 1;
+		}
+		closedir(dir);
+	}
+
+	pproc = &procs;
+	while (*pproc) {
+		proc = *pproc;
+		if (proc->seen) {
+			pproc = &proc->next;
+			continue;
+		}
+		*pproc = proc->next;
+		proc_free(proc);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* rate									     */
+/*---------------------------------------------------------------------------*/
+static double rate(uint64_t curr, uint64_t prev, int fresh)
+{
+	/* first sample of a slot - no rate yet */
+	if (fresh || curr < prev)
+		return 0;
+
+	return (double)(curr - prev) / opt_interval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* show_proc								     */
+/*---------------------------------------------------------------------------*/
+static void show_proc(struct xio_top_proc *proc)
+{
+	struct xio_stats_shm_hdr	*hdr = proc->hdr;
+	struct xio_stats_shm_ctx	cs, *cp;
+	struct xio_stats_shm_conn	ns, *np;
+	uint32_t			i;
+	int				fresh;
+
+	printf("pid %u (%.*s)\n", proc->pid, (int)sizeof(hdr->comm),
+	       hdr->comm);
+	printf("  %4s %4s %10s %9s %10s %9s %9s %5s %13s\n",
+	       "ctx", "cpu", "tx msg/s", "tx MB/s", "rx msg/s", "rx MB/s",
+	       "eagain/s", "conns", "tasks used");
+	for (i = 0; i < hdr->ctx_slots; i++) {
+		cp = &proc->ctx_prev[i];
+		if (read_slot(&cs, &xio_stats_shm_ctx_slots(hdr)[i],
+			      sizeof(cs),
+			      &xio_stats_shm_ctx_slots(hdr)[i].gen)) {
+			cp->gen = 0;
+			continue;
+		}
+		fresh = cs.gen != cp->gen;
+		printf("  %4u %4d %10.0f %9.2f %10.0f %9.2f %9.0f %5llu "
+		       "%6llu/%-6llu\n", i, cs.cpu,
+		       rate(cs.counter[XIO_SHM_CTX_TX_MSGS],
+			    cp->counter[XIO_SHM_CTX_TX_MSGS], fresh),
+		       rate(cs.counter[XIO_SHM_CTX_TX_BYTES],
+			    cp->counter[XIO_SHM_CTX_TX_BYTES], fresh) / 1e6,
+		       rate(cs.counter[XIO_SHM_CTX_RX_MSGS],
+			    cp->counter[XIO_SHM_CTX_RX_MSGS], fresh),
+		       rate(cs.counter[XIO_SHM_CTX_RX_BYTES],
+			    cp->counter[XIO_SHM_CTX_RX_BYTES], fresh) / 1e6,
+		       rate(cs.counter[XIO_SHM_CTX_TRANSPORT_EAGAIN],
+			    cp->counter[XIO_SHM_CTX_TRANSPORT_EAGAIN], fresh),
+		       (unsigned long long)cs.counter[XIO_SHM_CTX_CONNECTIONS],
+		       (unsigned long long)cs.counter[XIO_SHM_CTX_POOL_USED],
+		       (unsigned long long)
+		       cs.counter[XIO_SHM_CTX_POOL_ALLOCED]);
+		*cp = cs;
+	}
+
+	if (opt_conns)
+		printf("\n  %4s %-24s %10s %10s %9s %9s %6s %6s %8s %7s "
+		       "%9s %7s\n",
+		       "ctx", "peer", "tx msg/s", "rx msg/s", "stalls/s",
+		       "eagain/s", "reconn", "queued", "inflight",
+		       "credits", "picks/s", "rtt us");
+	for (i = 0; i < hdr->conn_slots; i++) {
+		np = &proc->conn_prev[i];
+		if (read_slot(&ns, &xio_stats_shm_conn_slots(hdr)[i],
+			      sizeof(ns),
+			      &xio_stats_shm_conn_slots(hdr)[i].gen)) {
+			np->gen = 0;
+			continue;
+		}
+		fresh = ns.gen != np->gen;
+		if (opt_conns)
+			printf("  %4u %-24.24s %10.0f %10.0f %9.0f %9.0f "
+			       "%6llu %6llu %8llu %7llu %9.0f %7llu\n",
+			       ns.ctx_slot,
+			       ns.peer[0] ? ns.peer : "-",
+			       rate(ns.counter[XIO_SHM_CONN_TX_MSGS],
+				    np->counter[XIO_SHM_CONN_TX_MSGS], fresh),
+			       rate(ns.counter[XIO_SHM_CONN_RX_MSGS],
+				    np->counter[XIO_SHM_CONN_RX_MSGS], fresh),
+			       rate(ns.counter[XIO_SHM_CONN_CREDIT_STALLS],
+				    np->counter[XIO_SHM_CONN_CREDIT_STALLS],
+				    fresh),
+			       rate(ns.counter[XIO_SHM_CONN_EAGAIN],
+				    np->counter[XIO_SHM_CONN_EAGAIN], fresh),
+			       (unsigned long long)
+			       ns.counter[XIO_SHM_CONN_RECONNECTS],
+			       (unsigned long long)
+			       ns.counter[XIO_SHM_CONN_TX_QUEUED],
+			       (unsigned long long)
+			       ns.counter[XIO_SHM_CONN_IN_FLIGHT],
+			       (unsigned long long)
+			       ns.counter[XIO_SHM_CONN_PEER_CREDITS],
+			       rate(ns.counter[XIO_SHM_CONN_LB_PICKS],
+				    np->counter[XIO_SHM_CONN_LB_PICKS], fresh),
+			       (unsigned long long)
+			       ns.counter[XIO_SHM_CONN_LB_RTT_US]);
+		*np = ns;
+	}
+	printf("\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+	static struct option const long_options[] = {
+		{ .name = "pid",	 .has_arg = 1, .val = 'p'},
+		{ .name = "interval",	 .has_arg = 1, .val = 'i'},
+		{ .name = "count",	 .has_arg = 1, .val = 'n'},
+		{ .name = "connections", .has_arg = 0, .val = 'c'},
+		{ .name = "help",	 .has_arg = 0, .val = 'h'},
+		{0, 0, 0, 0},
+	};
+	struct xio_top_proc	*proc;
+	int			c;
+
+	while ((c = getopt_long(argc, argv, "p:i:n:ch",
+				long_options, NULL)) != -1) {
+		switch (c) {
+		case 'p':
+			opt_pid = atoi(optarg);
+			break;
+		case 'i':
+			opt_interval = atoi(optarg);
+			if (opt_interval <= 0)
+				opt_interval = 1;
+			break;
+		case 'n':
+			opt_count = atoi(optarg);
+			break;
+		case 'c':
+			opt_conns = 1;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			usage(argv[0]);
+			return -1;
+		}
+	}
+
+	while (opt_count) {
+		scan_procs();
+		if (!procs)
+			printf("no statistics segments found in %s\n",
+			       SHM_DIR);
+		for (proc = procs; proc; proc = proc->next)
+			show_proc(proc);
+		fflush(stdout);
+		if (opt_count > 0 && !--opt_count)
+			break;
+		sleep(opt_interval);
+	}
+
+	while (procs) {
+		proc = procs;
+		procs = proc->next;
+		proc_free(proc);
+	}
+
+	return 0;
+}
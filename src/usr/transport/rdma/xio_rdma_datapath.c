@@ -179,12 +179,20 @@ static int xio_post_send(struct xio_rdma_transport *rdma_hndl,
 /*---------------------------------------------------------------------------*/
 /* xio_rdma_write_sn							     */
 /*---------------------------------------------------------------------------*/
-static int xio_rdma_write_sn(struct xio_task *task,
+static int xio_rdma_write_sn(struct xio_rdma_transport *rdma_hndl,
+			     struct xio_task *task,
 			     uint16_t sn, uint16_t ack_sn, uint16_t credits)
 {
 	uint16_t		*psn;
 	struct xio_mbuf		*mbuf = &task->mbuf;
 
+	/* network order unless the peer runs in our byte order */
+	if (!rdma_hndl->native_hdr) {
+		sn	= htons(sn);
+		ack_sn	= htons(ack_sn);
+		credits	= htons(credits);
+	}
+
 	/* save the current place */
 	xio_mbuf_push(mbuf);
 	/* goto the first transport header*/
@@ -195,19 +203,19 @@ static int xio_rdma_write_sn(struct xio_task *task,
 
 	/* and set serial number */
 	psn = (uint16_t *)xio_mbuf_get_curr_ptr(mbuf);
-	*psn = htons(sn);
+	*psn = sn;
 
 	xio_mbuf_inc(mbuf, sizeof(uint16_t));
 
 	/* and set ack serial number */
 	psn = (uint16_t *)xio_mbuf_get_curr_ptr(mbuf);
-	*psn = htons(ack_sn);
+	*psn = ack_sn;
 
 	xio_mbuf_inc(mbuf, sizeof(uint16_t));
 
 	/* and set credits */
 	psn = (uint16_t *)xio_mbuf_get_curr_ptr(mbuf);
-	*psn = htons(credits);
+	*psn = credits;
 
 	/* pop to the original place */
 	xio_mbuf_pop(mbuf);
@@ -331,7 +339,7 @@ static int xio_rdma_xmit(struct xio_rdma_transport *rdma_hndl)
 		}
 		if (rdma_task->out_ib_op != XIO_IB_RDMA_WRITE_DIRECT &&
 		    rdma_task->out_ib_op != XIO_IB_RDMA_READ_DIRECT) {
-			xio_rdma_write_sn(task, rdma_hndl->sn,
+			xio_rdma_write_sn(rdma_hndl, task, rdma_hndl->sn,
 					  rdma_hndl->ack_sn,
 					  rdma_hndl->credits);
 			rdma_task->sn = rdma_hndl->sn;
@@ -1475,6 +1483,38 @@ void xio_rdma_poll_completions(struct xio_cq *tcq, int timeout_us)
 	}
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_rdma_write_sge							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_rdma_write_sge(struct xio_rdma_transport *rdma_hndl,
+				      struct xio_sge *tmp_sge,
+				      struct xio_sge *sge)
+{
+	if (rdma_hndl->native_hdr) {
+		memcpy(tmp_sge, sge, sizeof(*sge));
+		return;
+	}
+	PACK_LLVAL(sge, tmp_sge, addr);
+	PACK_LVAL(sge, tmp_sge, length);
+	PACK_LVAL(sge, tmp_sge, stag);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rdma_read_sge							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_rdma_read_sge(struct xio_rdma_transport *rdma_hndl,
+				     struct xio_sge *tmp_sge,
+				     struct xio_sge *sge)
+{
+	if (rdma_hndl->native_hdr) {
+		memcpy(sge, tmp_sge, sizeof(*sge));
+		return;
+	}
+	UNPACK_LLVAL(tmp_sge, sge, addr);
+	UNPACK_LVAL(tmp_sge, sge, length);
+	UNPACK_LVAL(tmp_sge, sge, stag);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_rdma_write_req_header						     */
 /*---------------------------------------------------------------------------*/
@@ -1503,21 +1543,28 @@ static int xio_rdma_write_req_header(struct xio_rdma_transport *rdma_hndl,
 				xio_mbuf_get_curr_ptr(&task->mbuf);
 
 	/* pack relevant values */
-	tmp_req_hdr->version  = req_hdr->version;
-	tmp_req_hdr->flags    = req_hdr->flags;
-	PACK_SVAL(req_hdr, tmp_req_hdr, req_hdr_len);
-	/* sn		shall be coded later */
-	/* ack_sn	shall be coded later */
-	/* credits	shall be coded later */
-	PACK_LVAL(req_hdr, tmp_req_hdr, ltid);
-	tmp_req_hdr->in_ib_op	   = req_hdr->in_ib_op;
-	tmp_req_hdr->out_ib_op	   = req_hdr->out_ib_op;
-	PACK_SVAL(req_hdr, tmp_req_hdr, in_num_sge);
-	PACK_SVAL(req_hdr, tmp_req_hdr, out_num_sge);
-	PACK_SVAL(req_hdr, tmp_req_hdr, ulp_hdr_len);
-	PACK_SVAL(req_hdr, tmp_req_hdr, ulp_pad_len);
-	/*remain_data_len is not used		*/
-	PACK_LLVAL(req_hdr, tmp_req_hdr, ulp_imm_len);
+	if (rdma_hndl->native_hdr) {
+		/* peer runs in our byte order - sn, ack_sn and credits
+		 * are coded later
+		 */
+		memcpy(tmp_req_hdr, req_hdr, sizeof(*req_hdr));
+	} else {
+		tmp_req_hdr->version  = req_hdr->version;
+		tmp_req_hdr->flags    = req_hdr->flags;
+		PACK_SVAL(req_hdr, tmp_req_hdr, req_hdr_len);
+		/* sn		shall be coded later */
+		/* ack_sn	shall be coded later */
+		/* credits	shall be coded later */
+		PACK_LVAL(req_hdr, tmp_req_hdr, ltid);
+		tmp_req_hdr->in_ib_op	   = req_hdr->in_ib_op;
+		tmp_req_hdr->out_ib_op	   = req_hdr->out_ib_op;
+		PACK_SVAL(req_hdr, tmp_req_hdr, in_num_sge);
+		PACK_SVAL(req_hdr, tmp_req_hdr, out_num_sge);
+		PACK_SVAL(req_hdr, tmp_req_hdr, ulp_hdr_len);
+		PACK_SVAL(req_hdr, tmp_req_hdr, ulp_pad_len);
+		/*remain_data_len is not used		*/
+		PACK_LLVAL(req_hdr, tmp_req_hdr, ulp_imm_len);
+	}
 
 	tmp_sge = (struct xio_sge *)((uint8_t *)tmp_req_hdr +
 			   sizeof(struct xio_rdma_req_hdr));
@@ -1529,9 +1576,7 @@ static int xio_rdma_write_req_header(struct xio_rdma_transport *rdma_hndl,
 			sge.addr = 0;
 			sge.length = sge_length(sgtbl_ops, sg);
 			sge.stag = 0;
-			PACK_LLVAL(&sge, tmp_sge, addr);
-			PACK_LVAL(&sge, tmp_sge, length);
-			PACK_LVAL(&sge, tmp_sge, stag);
+			xio_rdma_write_sge(rdma_hndl, tmp_sge, &sge);
 			tmp_sge++;
 			sg = sge_next(sgtbl_ops, sgtbl, sg);
 		}
@@ -1553,9 +1598,7 @@ static int xio_rdma_write_req_header(struct xio_rdma_transport *rdma_hndl,
 			} else {
 				sge.stag	= 0;
 			}
-			PACK_LLVAL(&sge, tmp_sge, addr);
-			PACK_LVAL(&sge, tmp_sge, length);
-			PACK_LVAL(&sge, tmp_sge, stag);
+			xio_rdma_write_sge(rdma_hndl, tmp_sge, &sge);
 			tmp_sge++;
 		}
 	}
@@ -1576,9 +1619,7 @@ static int xio_rdma_write_req_header(struct xio_rdma_transport *rdma_hndl,
 			} else {
 				sge.stag	= 0;
 			}
-			PACK_LLVAL(&sge, tmp_sge, addr);
-			PACK_LVAL(&sge, tmp_sge, length);
-			PACK_LVAL(&sge, tmp_sge, stag);
+			xio_rdma_write_sge(rdma_hndl, tmp_sge, &sge);
 			tmp_sge++;
 		}
 	}
@@ -1587,9 +1628,7 @@ static int xio_rdma_write_req_header(struct xio_rdma_transport *rdma_hndl,
 			sge.addr = 0;
 			sge.length = sge_length(sgtbl_ops, sg);
 			sge.stag = 0;
-			PACK_LLVAL(&sge, tmp_sge, addr);
-			PACK_LVAL(&sge, tmp_sge, length);
-			PACK_LVAL(&sge, tmp_sge, stag);
+			xio_rdma_write_sge(rdma_hndl, tmp_sge, &sge);
 			tmp_sge++;
 			sg = sge_next(sgtbl_ops, sgtbl, sg);
 		}
@@ -1628,9 +1667,27 @@ static int xio_rdma_read_req_header(struct xio_rdma_transport *rdma_hndl,
 	tmp_req_hdr = (struct xio_rdma_req_hdr *)
 				xio_mbuf_get_curr_ptr(&task->mbuf);
 
-	req_hdr->version  = tmp_req_hdr->version;
-	req_hdr->flags    = tmp_req_hdr->flags;
-	UNPACK_SVAL(tmp_req_hdr, req_hdr, req_hdr_len);
+	if (rdma_hndl->native_hdr) {
+		/* peer runs in our byte order */
+		memcpy(req_hdr, tmp_req_hdr, sizeof(*req_hdr));
+	} else {
+		req_hdr->version  = tmp_req_hdr->version;
+		req_hdr->flags    = tmp_req_hdr->flags;
+		UNPACK_SVAL(tmp_req_hdr, req_hdr, req_hdr_len);
+		UNPACK_SVAL(tmp_req_hdr, req_hdr, sn);
+		UNPACK_SVAL(tmp_req_hdr, req_hdr, credits);
+		UNPACK_LVAL(tmp_req_hdr, req_hdr, ltid);
+		req_hdr->in_ib_op = tmp_req_hdr->in_ib_op;
+		req_hdr->out_ib_op = tmp_req_hdr->out_ib_op;
+
+		UNPACK_SVAL(tmp_req_hdr, req_hdr, in_num_sge);
+		UNPACK_SVAL(tmp_req_hdr, req_hdr, out_num_sge);
+		UNPACK_SVAL(tmp_req_hdr, req_hdr, ulp_hdr_len);
+		UNPACK_SVAL(tmp_req_hdr, req_hdr, ulp_pad_len);
+
+		/* remain_data_len not in use */
+		UNPACK_LLVAL(tmp_req_hdr, req_hdr, ulp_imm_len);
+	}
 
 	if (unlikely(req_hdr->req_hdr_len != sizeof(struct xio_rdma_req_hdr))) {
 		ERROR_LOG(
@@ -1638,19 +1695,6 @@ static int xio_rdma_read_req_header(struct xio_rdma_transport *rdma_hndl,
 		req_hdr->req_hdr_len, sizeof(struct xio_rdma_req_hdr));
 		return -1;
 	}
-	UNPACK_SVAL(tmp_req_hdr, req_hdr, sn);
-	UNPACK_SVAL(tmp_req_hdr, req_hdr, credits);
-	UNPACK_LVAL(tmp_req_hdr, req_hdr, ltid);
-	req_hdr->in_ib_op = tmp_req_hdr->in_ib_op;
-	req_hdr->out_ib_op = tmp_req_hdr->out_ib_op;
-
-	UNPACK_SVAL(tmp_req_hdr, req_hdr, in_num_sge);
-	UNPACK_SVAL(tmp_req_hdr, req_hdr, out_num_sge);
-	UNPACK_SVAL(tmp_req_hdr, req_hdr, ulp_hdr_len);
-	UNPACK_SVAL(tmp_req_hdr, req_hdr, ulp_pad_len);
-
-	/* remain_data_len not in use */
-	UNPACK_LLVAL(tmp_req_hdr, req_hdr, ulp_imm_len);
 
 	tmp_sge = (struct xio_sge *)((uint8_t *)tmp_req_hdr +
 			   sizeof(struct xio_rdma_req_hdr));
@@ -1659,18 +1703,16 @@ static int xio_rdma_read_req_header(struct xio_rdma_transport *rdma_hndl,
 
 	/* params for SEND/RDMA WRITE */
 	for (i = 0;  i < req_hdr->in_num_sge; i++) {
-		UNPACK_LLVAL(tmp_sge, &rdma_task->req_in_sge[i], addr);
-		UNPACK_LVAL(tmp_sge, &rdma_task->req_in_sge[i], length);
-		UNPACK_LVAL(tmp_sge, &rdma_task->req_in_sge[i], stag);
+		xio_rdma_read_sge(rdma_hndl, tmp_sge,
+				  &rdma_task->req_in_sge[i]);
 		tmp_sge++;
 	}
 	rdma_task->req_in_num_sge	= i;
 
 	/* params for SEND/RDMA_READ */
 	for (i = 0;  i < req_hdr->out_num_sge; i++) {
-		UNPACK_LLVAL(tmp_sge, &rdma_task->req_out_sge[i], addr);
-		UNPACK_LVAL(tmp_sge, &rdma_task->req_out_sge[i], length);
-		UNPACK_LVAL(tmp_sge, &rdma_task->req_out_sge[i], stag);
+		xio_rdma_read_sge(rdma_hndl, tmp_sge,
+				  &rdma_task->req_out_sge[i]);
 		tmp_sge++;
 	}
 	rdma_task->req_out_num_sge	= i;
@@ -1706,21 +1748,28 @@ static int xio_rdma_write_rsp_header(struct xio_rdma_transport *rdma_hndl,
 				xio_mbuf_get_curr_ptr(&task->mbuf);
 
 	/* pack relevant values */
-	tmp_rsp_hdr->version  = rsp_hdr->version;
-	tmp_rsp_hdr->flags    = rsp_hdr->flags;
-	PACK_SVAL(rsp_hdr, tmp_rsp_hdr, rsp_hdr_len);
-	/* sn		shall be coded later */
-	/* ack_sn	shall be coded later */
-	/* credits	shall be coded later */
-	PACK_LVAL(rsp_hdr, tmp_rsp_hdr, rtid);
-	tmp_rsp_hdr->out_ib_op = rsp_hdr->out_ib_op;
-	PACK_LVAL(rsp_hdr, tmp_rsp_hdr, status);
-	PACK_SVAL(rsp_hdr, tmp_rsp_hdr, out_num_sge);
-	PACK_LVAL(rsp_hdr, tmp_rsp_hdr, ltid);
-	PACK_SVAL(rsp_hdr, tmp_rsp_hdr, ulp_hdr_len);
-	PACK_SVAL(rsp_hdr, tmp_rsp_hdr, ulp_pad_len);
-	/* remain_data_len not in use */
-	PACK_LLVAL(rsp_hdr, tmp_rsp_hdr, ulp_imm_len);
+	if (rdma_hndl->native_hdr) {
+		/* peer runs in our byte order - sn, ack_sn and credits
+		 * are coded later
+		 */
+		memcpy(tmp_rsp_hdr, rsp_hdr, sizeof(*rsp_hdr));
+	} else {
+		tmp_rsp_hdr->version  = rsp_hdr->version;
+		tmp_rsp_hdr->flags    = rsp_hdr->flags;
+		PACK_SVAL(rsp_hdr, tmp_rsp_hdr, rsp_hdr_len);
+		/* sn		shall be coded later */
+		/* ack_sn	shall be coded later */
+		/* credits	shall be coded later */
+		PACK_LVAL(rsp_hdr, tmp_rsp_hdr, rtid);
+		tmp_rsp_hdr->out_ib_op = rsp_hdr->out_ib_op;
+		PACK_LVAL(rsp_hdr, tmp_rsp_hdr, status);
+		PACK_SVAL(rsp_hdr, tmp_rsp_hdr, out_num_sge);
+		PACK_LVAL(rsp_hdr, tmp_rsp_hdr, ltid);
+		PACK_SVAL(rsp_hdr, tmp_rsp_hdr, ulp_hdr_len);
+		PACK_SVAL(rsp_hdr, tmp_rsp_hdr, ulp_pad_len);
+		/* remain_data_len not in use */
+		PACK_LLVAL(rsp_hdr, tmp_rsp_hdr, ulp_imm_len);
+	}
 
 	hdr_len	= sizeof(struct xio_rdma_rsp_hdr);
 
@@ -1731,7 +1780,9 @@ static int xio_rdma_write_rsp_header(struct xio_rdma_transport *rdma_hndl,
 
 		/* params for RDMA WRITE */
 		for (i = 0;  i < rsp_hdr->out_num_sge; i++) {
-			*wr_len = htonl(rdma_task->rsp_out_sge[i].length);
+			*wr_len = rdma_hndl->native_hdr ?
+				  rdma_task->rsp_out_sge[i].length :
+				  htonl(rdma_task->rsp_out_sge[i].length);
 			wr_len++;
 		}
 		hdr_len += sizeof(uint32_t) * rsp_hdr->out_num_sge;
@@ -1756,9 +1807,7 @@ static int xio_rdma_write_rsp_header(struct xio_rdma_transport *rdma_hndl,
 			} else {
 				sge.stag	= 0;
 			}
-			PACK_LLVAL(&sge, tmp_sge, addr);
-			PACK_LVAL(&sge, tmp_sge, length);
-			PACK_LVAL(&sge, tmp_sge, stag);
+			xio_rdma_write_sge(rdma_hndl, tmp_sge, &sge);
 			tmp_sge++;
 		}
 		hdr_len += sizeof(struct xio_sge) * rsp_hdr->out_num_sge;
@@ -1795,9 +1844,26 @@ static int xio_rdma_read_rsp_header(struct xio_rdma_transport *rdma_hndl,
 	tmp_rsp_hdr = (struct xio_rdma_rsp_hdr *)
 				xio_mbuf_get_curr_ptr(&task->mbuf);
 
-	rsp_hdr->version  = tmp_rsp_hdr->version;
-	rsp_hdr->flags    = tmp_rsp_hdr->flags;
-	UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, rsp_hdr_len);
+	if (rdma_hndl->native_hdr) {
+		/* peer runs in our byte order */
+		memcpy(rsp_hdr, tmp_rsp_hdr, sizeof(*rsp_hdr));
+	} else {
+		rsp_hdr->version  = tmp_rsp_hdr->version;
+		rsp_hdr->flags    = tmp_rsp_hdr->flags;
+		UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, rsp_hdr_len);
+		UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, sn);
+		/* ack_sn not used */
+		UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, credits);
+		UNPACK_LVAL(tmp_rsp_hdr, rsp_hdr, rtid);
+		rsp_hdr->out_ib_op = tmp_rsp_hdr->out_ib_op;
+		UNPACK_LVAL(tmp_rsp_hdr, rsp_hdr, status);
+		UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, out_num_sge);
+		UNPACK_LVAL(tmp_rsp_hdr, rsp_hdr, ltid);
+		UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, ulp_hdr_len);
+		UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, ulp_pad_len);
+		/* remain_data_len not in use */
+		UNPACK_LLVAL(tmp_rsp_hdr, rsp_hdr, ulp_imm_len);
+	}
 
 	if (unlikely(rsp_hdr->rsp_hdr_len != sizeof(struct xio_rdma_rsp_hdr))) {
 		ERROR_LOG(
@@ -1806,19 +1872,6 @@ static int xio_rdma_read_rsp_header(struct xio_rdma_transport *rdma_hndl,
 		return -1;
 	}
 
-	UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, sn);
-	/* ack_sn not used */
-	UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, credits);
-	UNPACK_LVAL(tmp_rsp_hdr, rsp_hdr, rtid);
-	rsp_hdr->out_ib_op = tmp_rsp_hdr->out_ib_op;
-	UNPACK_LVAL(tmp_rsp_hdr, rsp_hdr, status);
-	UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, out_num_sge);
-	UNPACK_LVAL(tmp_rsp_hdr, rsp_hdr, ltid);
-	UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, ulp_hdr_len);
-	UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, ulp_pad_len);
-	/* remain_data_len not in use */
-	UNPACK_LLVAL(tmp_rsp_hdr, rsp_hdr, ulp_imm_len);
-
 	hdr_len	= sizeof(struct xio_rdma_rsp_hdr);
 	if (rsp_hdr->out_ib_op == XIO_IB_RDMA_WRITE) {
 		wr_len = (uint32_t  *)((uint8_t *)tmp_rsp_hdr +
@@ -1826,7 +1879,9 @@ static int xio_rdma_read_rsp_header(struct xio_rdma_transport *rdma_hndl,
 
 		/* params for RDMA WRITE */
 		for (i = 0;  i < rsp_hdr->out_num_sge; i++) {
-			rdma_task->rsp_out_sge[i].length = ntohl(*wr_len);
+			rdma_task->rsp_out_sge[i].length =
+				rdma_hndl->native_hdr ? *wr_len :
+							ntohl(*wr_len);
 			wr_len++;
 		}
 		rdma_task->rsp_out_num_sge = rsp_hdr->out_num_sge;
@@ -1839,12 +1894,8 @@ static int xio_rdma_read_rsp_header(struct xio_rdma_transport *rdma_hndl,
 
 		/* params for RDMA_READ */
 		for (i = 0;  i < rsp_hdr->out_num_sge; i++) {
-			UNPACK_LLVAL(tmp_sge, &rdma_task->req_out_sge[i],
-				     addr);
-			UNPACK_LVAL(tmp_sge, &rdma_task->req_out_sge[i],
-				    length);
-			UNPACK_LVAL(tmp_sge, &rdma_task->req_out_sge[i],
-				    stag);
+			xio_rdma_read_sge(rdma_hndl, tmp_sge,
+					  &rdma_task->req_out_sge[i]);
 			tmp_sge++;
 		}
 		rdma_task->req_out_num_sge	= i;
@@ -4118,6 +4169,7 @@ static void xio_rdma_write_setup_msg(struct xio_rdma_transport *rdma_hndl,
 	PACK_LVAL(msg, tmp_msg, max_out_iovsz);
 	PACK_SVAL(msg, tmp_msg, rkey_tbl_size);
 	PACK_LVAL(msg, tmp_msg, max_header_len);
+	PACK_LVAL(msg, tmp_msg, flags);
 
 #ifdef EYAL_TODO
 	print_hex_dump_bytes("post_send: ", DUMP_PREFIX_ADDRESS,
@@ -4176,6 +4228,7 @@ static void xio_rdma_read_setup_msg(struct xio_rdma_transport *rdma_hndl,
 	UNPACK_LVAL(tmp_msg, msg, max_out_iovsz);
 	UNPACK_SVAL(tmp_msg, msg, rkey_tbl_size);
 	UNPACK_LVAL(tmp_msg, msg, max_header_len);
+	UNPACK_LVAL(tmp_msg, msg, flags);
 
 #ifdef EYAL_TODO
 	print_hex_dump_bytes("post_send: ", DUMP_PREFIX_ADDRESS,
@@ -4228,6 +4281,7 @@ static int xio_rdma_send_setup_req(struct xio_rdma_transport *rdma_hndl,
 	req.max_out_iovsz	= rdma_options.max_out_iovsz;
 	req.rkey_tbl_size	= rdma_hndl->rkey_tbl_size;
 	req.max_header_len	= g_options.max_inline_xio_hdr;
+	req.flags		= XIO_NATIVE_HDR;
 
 	xio_rdma_write_setup_msg(rdma_hndl, task, &req);
 
@@ -4348,6 +4402,9 @@ static int xio_rdma_on_setup_msg(struct xio_rdma_transport *rdma_hndl,
 		rsp->max_in_iovsz	= req.max_in_iovsz;
 		rsp->max_out_iovsz	= req.max_out_iovsz;
 		rsp->max_header_len	= req.max_header_len;
+		/* older peers leave garbage here - match exactly */
+		rsp->flags		= (req.flags == XIO_NATIVE_HDR) ?
+					  XIO_NATIVE_HDR : 0;
 	}
 
 	/* save the values */
@@ -4358,6 +4415,7 @@ static int xio_rdma_on_setup_msg(struct xio_rdma_transport *rdma_hndl,
 	rdma_hndl->peer_max_in_iovsz	= rsp->max_in_iovsz;
 	rdma_hndl->peer_max_out_iovsz	= rsp->max_out_iovsz;
 	rdma_hndl->peer_max_header	= rsp->max_header_len;
+	rdma_hndl->native_hdr		= (rsp->flags == XIO_NATIVE_HDR);
 
 	/* initialize send window */
 	rdma_hndl->sn = 0;
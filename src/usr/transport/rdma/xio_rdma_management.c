@@ -3414,6 +3414,23 @@ static void xio_rdma_init(void)
 {
 	int	retval = 0;
 
+	/* this must be before calling setenv as libibverbs may crash
+	 * see libibverbs/src/device.c clone_env
+	 */
+	xio_device_list_check();
+
+	/* Mellanox OFED's User Manual */
+	setenv("RDMAV_HUGEPAGES_SAFE", "1", 0);
+	setenv("MLX_QP_ALLOC_TYPE", "PREFER_CONTIG", 0);
+	setenv("MLX_CQ_ALLOC_TYPE", "PREFER_CONTIG", 0);
+
+	/* Mellanox OFED's User Manual */
+	/*
+	setenv("MLX_QP_ALLOC_TYPE","PREFER_CONTIG", 1);
+	setenv("MLX_CQ_ALLOC_TYPE","ALL", 1);
+	setenv("MLX_MR_ALLOC_TYPE","ALL", 1);
+	*/
+
 	INIT_LIST_HEAD(&cm_list);
 
 	spin_lock_init(&mngmt_lock);
@@ -3624,22 +3641,7 @@ static void xio_rdma_set_pools_cls(
 /*---------------------------------------------------------------------------*/
 void xio_rdma_transport_constructor(void)
 {
-	/* this must be before calling setenv as libibverbs may crash
-	 * see libibverbs/src/device.c clone_env
-	 */
-	xio_device_list_check();
-
-	/* Mellanox OFED's User Manual */
-	setenv("RDMAV_HUGEPAGES_SAFE", "1", 0);
-	setenv("MLX_QP_ALLOC_TYPE", "PREFER_CONTIG", 0);
-	setenv("MLX_CQ_ALLOC_TYPE", "PREFER_CONTIG", 0);
-
-	/* Mellanox OFED's User Manual */
-	/*
-	setenv("MLX_QP_ALLOC_TYPE","PREFER_CONTIG", 1);
-	setenv("MLX_CQ_ALLOC_TYPE","ALL", 1);
-	setenv("MLX_MR_ALLOC_TYPE","ALL", 1);
-	*/
+	/* devices are enumerated on first use - see xio_rdma_init */
 	if (0)
 		xio_rdma_enable_fork_support();
 
@@ -218,7 +218,7 @@ struct __attribute__((__packed__)) xio_rdma_setup_msg {
 	uint32_t		max_in_iovsz;
 	uint32_t		max_out_iovsz;
 	uint32_t                max_header_len;
-	uint32_t		pad;
+	uint32_t		flags;		/* XIO_NATIVE_HDR	*/
 };
 
 struct __attribute__((__packed__)) xio_nop_hdr {
@@ -471,7 +471,9 @@ struct xio_rdma_transport {
 	uint32_t			ignore_disconnect:1;
 	uint32_t			disconnect_nr:1; /* flag */
 	uint32_t                        beacon_sent:1;
-	uint32_t			reserved:27;
+	/* headers in host byte order - see XIO_NATIVE_HDR */
+	uint32_t			native_hdr:1;
+	uint32_t			reserved:26;
 
 	/* too big to be on stack - use as temporaries */
 	union {
@@ -36,6 +36,7 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 #include <xio_os.h>
+#include <linux/errqueue.h>
 #include "libxio.h"
 #include "xio_log.h"
 #include "xio_common.h"
@@ -55,6 +56,8 @@
 
 extern struct xio_tcp_options tcp_options;
 
+struct xio_tcp_zerocopy_stats tcp_zc_stats;
+
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_send_work                                                         */
 /*---------------------------------------------------------------------------*/
@@ -88,20 +91,56 @@ static int xio_tcp_send_work(int fd, void **buf, uint32_t *len, int block)
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_sock_sendmsg                                                      */
+/*---------------------------------------------------------------------------*/
+ssize_t xio_tcp_sock_sendmsg(struct xio_tcp_socket *sock, int fd,
+			     const struct msghdr *msg, int flags)
+{
+	return sendmsg(fd, msg, flags | MSG_NOSIGNAL);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_sock_recvmsg                                                      */
+/*---------------------------------------------------------------------------*/
+ssize_t xio_tcp_sock_recvmsg(struct xio_tcp_socket *sock, int fd,
+			     struct msghdr *msg)
+{
+	return recvmsg(fd, msg, 0);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_sock_wait_writable                                                */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_sock_wait_writable(struct xio_tcp_transport *tcp_hndl, int fd)
+{
+	/* for eagain, add event for ready for write*/
+	return xio_context_modify_ev_handler(tcp_hndl->base.ctx, fd,
+					     XIO_POLLIN | XIO_POLLRDHUP |
+					     XIO_POLLOUT);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_sendmsg_work                                                      */
 /*---------------------------------------------------------------------------*/
-static int xio_tcp_sendmsg_work(int fd,
+static int xio_tcp_sendmsg_work(struct xio_tcp_transport *tcp_hndl, int fd,
 				struct xio_tcp_work_req *xio_send,
-				int block)
+				int block, int flags)
 {
 	int			retval = 0, tmp_bytes, sent_bytes = 0;
 	int			eagain_count = TX_EAGAIN_RETRY;
 	unsigned int		i;
 
 	while (xio_send->tot_iov_byte_len) {
-		retval = sendmsg(fd, &xio_send->msg, MSG_NOSIGNAL);
+		retval = tcp_hndl->sock.ops->sendmsg(&tcp_hndl->sock, fd,
+						     &xio_send->msg, flags);
 		if (retval < 0) {
+			if ((flags & MSG_ZEROCOPY) &&
+			    xio_get_last_socket_error() == ENOBUFS) {
+				/* out of notification memory - copy instead */
+				flags &= ~MSG_ZEROCOPY;
+				continue;
+			}
 			if (xio_get_last_socket_error() != XIO_EAGAIN) {
 				xio_set_error(xio_get_last_socket_error());
 				DEBUG_LOG("sendmsg failed. (errno=%d)\n",
@@ -112,6 +151,16 @@ static int xio_tcp_sendmsg_work(int fd,
 				return -1;
 			}
 		} else {
+			if (flags & MSG_ZEROCOPY) {
+				tcp_hndl->zc_sent++;
+				__atomic_add_fetch(&tcp_zc_stats.zerocopy_bytes,
+						   retval, __ATOMIC_RELAXED);
+				__atomic_add_fetch(&tcp_zc_stats.zerocopy_sends,
+						   1, __ATOMIC_RELAXED);
+			} else {
+				__atomic_add_fetch(&tcp_zc_stats.copied_bytes,
+						   retval, __ATOMIC_RELAXED);
+			}
 			sent_bytes += retval;
 			xio_send->tot_iov_byte_len -= retval;
 
@@ -174,6 +223,7 @@ static void xio_tcp_write_setup_msg(struct xio_tcp_transport *tcp_hndl,
 	PACK_LVAL(msg, tmp_msg, max_in_iovsz);
 	PACK_LVAL(msg, tmp_msg, max_out_iovsz);
 	PACK_LVAL(msg, tmp_msg, max_header_len);
+	PACK_LVAL(msg, tmp_msg, flags);
 
 #ifdef EYAL_TODO
 	print_hex_dump_bytes("post_send: ", DUMP_PREFIX_ADDRESS,
@@ -211,6 +261,7 @@ static void xio_tcp_read_setup_msg(struct xio_tcp_transport *tcp_hndl,
 	UNPACK_LVAL(tmp_msg, msg, max_in_iovsz);
 	UNPACK_LVAL(tmp_msg, msg, max_out_iovsz);
 	UNPACK_LVAL(tmp_msg, msg, max_header_len);
+	UNPACK_LVAL(tmp_msg, msg, flags);
 
 #ifdef EYAL_TODO
 	print_hex_dump_bytes("post_send: ", DUMP_PREFIX_ADDRESS,
@@ -236,6 +287,7 @@ static int xio_tcp_send_setup_req(struct xio_tcp_transport *tcp_hndl,
 	req.max_in_iovsz	= tcp_options.max_in_iovsz;
 	req.max_out_iovsz	= tcp_options.max_out_iovsz;
 	req.max_header_len      = g_options.max_inline_xio_hdr;
+	req.flags		= XIO_NATIVE_HDR;
 
 	xio_tcp_write_setup_msg(tcp_hndl, task, &req);
 
@@ -258,7 +310,9 @@ static int xio_tcp_send_setup_req(struct xio_tcp_transport *tcp_hndl,
 
 	xio_task_addref(task);
 
-	xio_tcp_sendmsg_work(tcp_hndl->sock.cfd, &tcp_task->txd, 1);
+	xio_tcp_sendmsg_work(tcp_hndl, tcp_hndl->sock.cfd,
+			     &tcp_task->txd, 1, 0);
+	tcp_task->zc_seq = tcp_hndl->zc_sent;
 
 	list_move_tail(&task->tasks_list_entry, &tcp_hndl->in_flight_list);
 
@@ -301,7 +355,9 @@ static int xio_tcp_send_setup_rsp(struct xio_tcp_transport *tcp_hndl,
 
 	tcp_task->out_tcp_op		 = XIO_TCP_SEND;
 
-	xio_tcp_sendmsg_work(tcp_hndl->sock.cfd, &tcp_task->txd, 1);
+	xio_tcp_sendmsg_work(tcp_hndl, tcp_hndl->sock.cfd,
+			     &tcp_task->txd, 1, 0);
+	tcp_task->zc_seq = tcp_hndl->zc_sent;
 
 	list_move(&task->tasks_list_entry, &tcp_hndl->in_flight_list);
 
@@ -347,6 +403,9 @@ static int xio_tcp_on_setup_msg(struct xio_tcp_transport *tcp_hndl,
 		rsp->max_in_iovsz	= req.max_in_iovsz;
 		rsp->max_out_iovsz	= req.max_out_iovsz;
 		rsp->max_header_len     = req.max_header_len;
+		/* older peers leave garbage here - match exactly */
+		rsp->flags		= (req.flags == XIO_NATIVE_HDR) ?
+					  XIO_NATIVE_HDR : 0;
 	}
 
 	tcp_hndl->max_inline_buf_sz	= (size_t)rsp->buffer_sz;
@@ -354,6 +413,7 @@ static int xio_tcp_on_setup_msg(struct xio_tcp_transport *tcp_hndl,
 	tcp_hndl->peer_max_in_iovsz	= rsp->max_in_iovsz;
 	tcp_hndl->peer_max_out_iovsz	= rsp->max_out_iovsz;
 	tcp_hndl->peer_max_header      = rsp->max_header_len;
+	tcp_hndl->native_hdr		= (rsp->flags == XIO_NATIVE_HDR);
 
 	tcp_hndl->sn = 0;
 
@@ -399,6 +459,38 @@ int xio_tcp_send_connect_msg(int fd, struct xio_tcp_connect_msg *msg)
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_write_sge							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_tcp_write_sge(struct xio_tcp_transport *tcp_hndl,
+				     struct xio_sge *tmp_sge,
+				     struct xio_sge *sge)
+{
+	if (tcp_hndl->native_hdr) {
+		memcpy(tmp_sge, sge, sizeof(*sge));
+		return;
+	}
+	PACK_LLVAL(sge, tmp_sge, addr);
+	PACK_LVAL(sge, tmp_sge, length);
+	PACK_LVAL(sge, tmp_sge, stag);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_read_sge							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_tcp_read_sge(struct xio_tcp_transport *tcp_hndl,
+				    struct xio_sge *tmp_sge,
+				    struct xio_sge *sge)
+{
+	if (tcp_hndl->native_hdr) {
+		memcpy(sge, tmp_sge, sizeof(*sge));
+		return;
+	}
+	UNPACK_LLVAL(tmp_sge, sge, addr);
+	UNPACK_LVAL(tmp_sge, sge, length);
+	UNPACK_LVAL(tmp_sge, sge, stag);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_write_req_header						     */
 /*---------------------------------------------------------------------------*/
@@ -426,19 +518,24 @@ static int xio_tcp_write_req_header(struct xio_tcp_transport *tcp_hndl,
 			xio_mbuf_get_curr_ptr(&task->mbuf);
 
 	/* pack relevant values */
-	tmp_req_hdr->version  = req_hdr->version;
-	tmp_req_hdr->flags    = req_hdr->flags;
-	PACK_SVAL(req_hdr, tmp_req_hdr, req_hdr_len);
-	PACK_LVAL(req_hdr, tmp_req_hdr, ltid);
-	tmp_req_hdr->in_tcp_op	   = req_hdr->in_tcp_op;
-	tmp_req_hdr->out_tcp_op	   = req_hdr->out_tcp_op;
-
-	PACK_SVAL(req_hdr, tmp_req_hdr, in_num_sge);
-	PACK_SVAL(req_hdr, tmp_req_hdr, out_num_sge);
-	PACK_SVAL(req_hdr, tmp_req_hdr, ulp_hdr_len);
-	PACK_SVAL(req_hdr, tmp_req_hdr, ulp_pad_len);
-	/*remain_data_len is not used		*/
-	PACK_LLVAL(req_hdr, tmp_req_hdr, ulp_imm_len);
+	if (tcp_hndl->native_hdr) {
+		/* peer runs in our byte order - sn is coded later */
+		memcpy(tmp_req_hdr, req_hdr, sizeof(*req_hdr));
+	} else {
+		tmp_req_hdr->version  = req_hdr->version;
+		tmp_req_hdr->flags    = req_hdr->flags;
+		PACK_SVAL(req_hdr, tmp_req_hdr, req_hdr_len);
+		PACK_LVAL(req_hdr, tmp_req_hdr, ltid);
+		tmp_req_hdr->in_tcp_op	   = req_hdr->in_tcp_op;
+		tmp_req_hdr->out_tcp_op	   = req_hdr->out_tcp_op;
+
+		PACK_SVAL(req_hdr, tmp_req_hdr, in_num_sge);
+		PACK_SVAL(req_hdr, tmp_req_hdr, out_num_sge);
+		PACK_SVAL(req_hdr, tmp_req_hdr, ulp_hdr_len);
+		PACK_SVAL(req_hdr, tmp_req_hdr, ulp_pad_len);
+		/*remain_data_len is not used		*/
+		PACK_LLVAL(req_hdr, tmp_req_hdr, ulp_imm_len);
+	}
 
 	tmp_sge = (struct xio_sge *)((uint8_t *)tmp_req_hdr +
 			   sizeof(struct xio_tcp_req_hdr));
@@ -450,9 +547,7 @@ static int xio_tcp_write_req_header(struct xio_tcp_transport *tcp_hndl,
 			sge.addr = 0;
 			sge.length = sge_length(sgtbl_ops, sg);
 			sge.stag = 0;
-			PACK_LLVAL(&sge, tmp_sge, addr);
-			PACK_LVAL(&sge, tmp_sge, length);
-			PACK_LVAL(&sge, tmp_sge, stag);
+			xio_tcp_write_sge(tcp_hndl, tmp_sge, &sge);
 			tmp_sge++;
 			sg = sge_next(sgtbl_ops, sgtbl, sg);
 		}
@@ -463,9 +558,7 @@ static int xio_tcp_write_req_header(struct xio_tcp_transport *tcp_hndl,
 			sge.addr = uint64_from_ptr(tcp_task->read_reg_mem[i].addr);
 			sge.length = tcp_task->read_reg_mem[i].length;
 			sge.stag = 0;
-			PACK_LLVAL(&sge, tmp_sge, addr);
-			PACK_LVAL(&sge, tmp_sge, length);
-			PACK_LVAL(&sge, tmp_sge, stag);
+			xio_tcp_write_sge(tcp_hndl, tmp_sge, &sge);
 			tmp_sge++;
 		}
 	}
@@ -475,9 +568,7 @@ static int xio_tcp_write_req_header(struct xio_tcp_transport *tcp_hndl,
 			sge.addr = uint64_from_ptr(tcp_task->write_reg_mem[i].addr);
 			sge.length = tcp_task->write_reg_mem[i].length;
 			sge.stag = 0;
-			PACK_LLVAL(&sge, tmp_sge, addr);
-			PACK_LVAL(&sge, tmp_sge, length);
-			PACK_LVAL(&sge, tmp_sge, stag);
+			xio_tcp_write_sge(tcp_hndl, tmp_sge, &sge);
 			tmp_sge++;
 		}
 	}
@@ -486,9 +577,7 @@ static int xio_tcp_write_req_header(struct xio_tcp_transport *tcp_hndl,
 			sge.addr = 0;
 			sge.length = sge_length(sgtbl_ops, sg);
 			sge.stag = 0;
-			PACK_LLVAL(&sge, tmp_sge, addr);
-			PACK_LVAL(&sge, tmp_sge, length);
-			PACK_LVAL(&sge, tmp_sge, stag);
+			xio_tcp_write_sge(tcp_hndl, tmp_sge, &sge);
 			tmp_sge++;
 			sg = sge_next(sgtbl_ops, sgtbl, sg);
 		}
@@ -843,6 +932,47 @@ static int xio_tcp_on_req_send_comp(struct xio_tcp_transport *tcp_hndl,
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_zerocopy_drain						     */
+/*---------------------------------------------------------------------------*/
+static int xio_tcp_zerocopy_drain(struct xio_tcp_transport *tcp_hndl, int fd)
+{
+	char			control[128];
+	struct msghdr		msg;
+	struct cmsghdr		*cm;
+	struct sock_extended_err *serr;
+	int			reaped = 0;
+
+	while (1) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(fd, &msg, MSG_ERRQUEUE) < 0)
+			break;
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			if (!((cm->cmsg_level == SOL_IP &&
+			       cm->cmsg_type == IP_RECVERR) ||
+			      (cm->cmsg_level == SOL_IPV6 &&
+			       cm->cmsg_type == IPV6_RECVERR)))
+				continue;
+			serr = (struct sock_extended_err *)CMSG_DATA(cm);
+			if (serr->ee_errno != 0 ||
+			    serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+				continue;
+			/* tcp reports ranges in send order */
+			tcp_hndl->zc_done = serr->ee_data + 1;
+			if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+				__atomic_add_fetch(
+					&tcp_zc_stats.deferred_copies,
+					serr->ee_data - serr->ee_info + 1,
+					__ATOMIC_RELAXED);
+			reaped++;
+		}
+	}
+
+	return reaped;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_tx_comp_handler						     */
 /*---------------------------------------------------------------------------*/
@@ -851,12 +981,28 @@ static void xio_tcp_tx_completion_handler(void *xio_task)
 	struct xio_task		*ptask, *next_ptask;
 	int			found = 0;
 	int			removed = 0;
+	int			gated = 0;
 	struct xio_task		*task = (struct xio_task *)xio_task;
 
 	XIO_TO_TCP_HNDL(task, tcp_hndl);
 
 	list_for_each_entry_safe(ptask, next_ptask, &tcp_hndl->in_flight_list,
 				 tasks_list_entry) {
+		XIO_TO_TCP_TASK(ptask, tcp_ptask);
+
+		/* zero copy buffers belong to the kernel until it reports
+		 * the send done on the error queue. a flush on teardown
+		 * reaps what is already reported and holds the rest for
+		 * the POLLERR wakeups or the final close
+		 */
+		if (tcp_hndl->zc_enabled &&
+		    (int32_t)(tcp_hndl->zc_done - tcp_ptask->zc_seq) < 0 &&
+		    (tcp_hndl->state == XIO_TRANSPORT_STATE_CONNECTED ||
+		     !xio_tcp_zerocopy_drain(tcp_hndl, tcp_hndl->sock.dfd) ||
+		     (int32_t)(tcp_hndl->zc_done - tcp_ptask->zc_seq) < 0)) {
+			gated = 1;
+			break;
+		}
 		list_move_tail(&ptask->tasks_list_entry,
 			       &tcp_hndl->tx_comp_list);
 		removed++;
@@ -877,7 +1023,7 @@ static void xio_tcp_tx_completion_handler(void *xio_task)
 		}
 	}
 
-	if (!found && removed)
+	if (!found && removed && !gated)
 		ERROR_LOG("not found but removed %d type:0x%x\n",
 			  removed, task->tlv_type);
 
@@ -892,6 +1038,22 @@ static void xio_tcp_tx_completion_handler(void *xio_task)
     }
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_zerocopy_reap						     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_zerocopy_reap(struct xio_tcp_transport *tcp_hndl, int fd)
+{
+	int reaped = xio_tcp_zerocopy_drain(tcp_hndl, fd);
+
+	if (reaped && !list_empty(&tcp_hndl->in_flight_list))
+		xio_tcp_tx_completion_handler(
+				list_last_entry(&tcp_hndl->in_flight_list,
+						struct xio_task,
+						tasks_list_entry));
+
+	return reaped;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_disconnect_helper						     */
 /*---------------------------------------------------------------------------*/
@@ -929,7 +1091,8 @@ void xio_tcp_disconnect_helper(void *xio_tcp_hndl)
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_write_sn							     */
 /*---------------------------------------------------------------------------*/
-static int xio_tcp_write_sn(struct xio_task *task, uint16_t sn)
+static int xio_tcp_write_sn(struct xio_tcp_transport *tcp_hndl,
+			    struct xio_task *task, uint16_t sn)
 {
 	uint16_t *psn;
 
@@ -943,7 +1106,7 @@ static int xio_tcp_write_sn(struct xio_task *task, uint16_t sn)
 
 	/* and set serial number */
 	psn = (uint16_t *)xio_mbuf_get_curr_ptr(&task->mbuf);
-	*psn = htons(sn);
+	*psn = tcp_hndl->native_hdr ? sn : htons(sn);
 
 	/* pop to the original place */
 	xio_mbuf_pop(&task->mbuf);
@@ -951,6 +1114,20 @@ static int xio_tcp_write_sn(struct xio_task *task, uint16_t sn)
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_task_zc_flags						     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_tcp_task_zc_flags(struct xio_tcp_transport *tcp_hndl,
+					struct xio_tcp_task *tcp_task)
+{
+	/* pinning pages pays off for the large payload only, small ones
+	 * are cheaper to copy even if a batch of them adds up
+	 */
+	return (tcp_hndl->zc_enabled &&
+		tcp_task->txd.tot_iov_byte_len >= (uint64_t)
+		tcp_options.tcp_zerocopy_threshold) ? MSG_ZEROCOPY : 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_xmit								     */
 /*---------------------------------------------------------------------------*/
@@ -965,6 +1142,8 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 	unsigned int		i;
 	unsigned int		iov_len;
 	uint64_t		bytes_sent;
+	int			zc_flags = 0;
+	struct xio_tcp_work_req	*tmp_work = &tcp_hndl->scratch->tmp_work;
 
 	if (tcp_hndl->tx_ready_tasks_num == 0 ||
 	    tcp_hndl->tx_comp_cnt > COMPLETION_BATCH_MAX ||
@@ -989,7 +1168,7 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 
 		switch (tcp_task->txd.stage) {
 		case XIO_TCP_TX_BEFORE:
-			xio_tcp_write_sn(task, tcp_hndl->sn);
+			xio_tcp_write_sn(tcp_hndl, task, tcp_hndl->sn);
 			tcp_task->sn = tcp_hndl->sn;
 			tcp_hndl->sn++;
 			tcp_task->txd.stage = XIO_TCP_TX_IN_SEND_CTL;
@@ -1001,12 +1180,12 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 				break;
 			}
 
-			tcp_hndl->tmp_work.msg_iov[batch_count].iov_base =
+			tmp_work->msg_iov[batch_count].iov_base =
 					tcp_task->txd.ctl_msg;
-			tcp_hndl->tmp_work.msg_iov[batch_count].iov_len =
+			tmp_work->msg_iov[batch_count].iov_len =
 					tcp_task->txd.ctl_msg_len;
-			++tcp_hndl->tmp_work.msg_len;
-			tcp_hndl->tmp_work.tot_iov_byte_len +=
+			++tmp_work->msg_len;
+			tmp_work->tot_iov_byte_len +=
 					tcp_task->txd.ctl_msg_len;
 
 			++batch_count;
@@ -1019,19 +1198,20 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 				break;
 			}
 
-			tcp_hndl->tmp_work.msg.msg_iov =
-					tcp_hndl->tmp_work.msg_iov;
-			tcp_hndl->tmp_work.msg.msg_iovlen =
-					tcp_hndl->tmp_work.msg_len;
+			tmp_work->msg.msg_iov =
+					tmp_work->msg_iov;
+			tmp_work->msg.msg_iovlen =
+					tmp_work->msg_len;
 
-			retval = xio_tcp_sendmsg_work(tcp_hndl->sock.cfd,
-						      &tcp_hndl->tmp_work, 0);
+			retval = xio_tcp_sendmsg_work(tcp_hndl,
+						      tcp_hndl->sock.cfd,
+						      tmp_work, 0, 0);
 
 			task = list_first_entry(&tcp_hndl->tx_ready_list,
 						struct xio_task,
 						tasks_list_entry);
-			iov_len = tcp_hndl->tmp_work.msg_len -
-					tcp_hndl->tmp_work.msg.msg_iovlen;
+			iov_len = tmp_work->msg_len -
+					tmp_work->msg.msg_iovlen;
 			for (i = 0; i < iov_len; i++) {
 				tcp_task = (struct xio_tcp_task *)task->dd_data;
 				tcp_task->txd.stage = XIO_TCP_TX_IN_SEND_DATA;
@@ -1041,15 +1221,15 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 						struct xio_task,
 						tasks_list_entry);
 			}
-			if (tcp_hndl->tmp_work.msg.msg_iovlen) {
+			if (tmp_work->msg.msg_iovlen) {
 				tcp_task = (struct xio_tcp_task *)task->dd_data;
 				tcp_task->txd.ctl_msg =
-				tcp_hndl->tmp_work.msg.msg_iov[0].iov_base;
+				tmp_work->msg.msg_iov[0].iov_base;
 				tcp_task->txd.ctl_msg_len =
-				tcp_hndl->tmp_work.msg.msg_iov[0].iov_len;
+				tmp_work->msg.msg_iov[0].iov_len;
 			}
-			tcp_hndl->tmp_work.msg_len = 0;
-			tcp_hndl->tmp_work.tot_iov_byte_len = 0;
+			tmp_work->msg_len = 0;
+			tmp_work->tot_iov_byte_len = 0;
 			batch_count = 0;
 
 			if (retval < 0) {
@@ -1068,12 +1248,10 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 				if (xio_get_last_socket_error() != XIO_EAGAIN)
 					return -1;
 
-				/* for eagain, add event for ready for write*/
-				retval = xio_context_modify_ev_handler(
-						tcp_hndl->base.ctx,
-						tcp_hndl->sock.cfd,
-						XIO_POLLIN | XIO_POLLRDHUP |
-						XIO_POLLOUT);
+				/* for eagain, wait for ready for write */
+				retval = tcp_hndl->sock.ops->wait_writable(
+						tcp_hndl,
+						tcp_hndl->sock.cfd);
 				if (retval != 0)
 					ERROR_LOG("modify events failed.\n");
 
@@ -1087,17 +1265,23 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 
 			break;
 		case XIO_TCP_TX_IN_SEND_DATA:
+			/* a batch goes out with one set of flags, so copied
+			 * and zero copy payloads are not mixed
+			 */
+			if (!batch_count)
+				zc_flags = xio_tcp_task_zc_flags(tcp_hndl,
+								 tcp_task);
 
 			for (i = 0; i < tcp_task->txd.msg.msg_iovlen; i++) {
-				tcp_hndl->tmp_work.msg_iov
-				[tcp_hndl->tmp_work.msg_len].iov_base =
+				tmp_work->msg_iov
+				[tmp_work->msg_len].iov_base =
 					tcp_task->txd.msg.msg_iov[i].iov_base;
-				tcp_hndl->tmp_work.msg_iov
-				[tcp_hndl->tmp_work.msg_len].iov_len =
+				tmp_work->msg_iov
+				[tmp_work->msg_len].iov_len =
 					tcp_task->txd.msg.msg_iov[i].iov_len;
-				++tcp_hndl->tmp_work.msg_len;
+				++tmp_work->msg_len;
 			}
-			tcp_hndl->tmp_work.tot_iov_byte_len +=
+			tmp_work->tot_iov_byte_len +=
 					tcp_task->txd.tot_iov_byte_len;
 
 			++batch_count;
@@ -1107,26 +1291,30 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 			    (next_tcp_task->txd.stage ==
 			    XIO_TCP_TX_IN_SEND_DATA) &&
 			    (next_tcp_task->txd.msg.msg_iovlen +
-			    tcp_hndl->tmp_work.msg_len) < IOV_MAX) {
+			    tmp_work->msg_len) < IOV_MAX &&
+			    xio_tcp_task_zc_flags(tcp_hndl, next_tcp_task) ==
+			    zc_flags) {
 				task = next_task;
 				break;
 			}
 
-			tcp_hndl->tmp_work.msg.msg_iov =
-					tcp_hndl->tmp_work.msg_iov;
-			tcp_hndl->tmp_work.msg.msg_iovlen =
-					tcp_hndl->tmp_work.msg_len;
+			tmp_work->msg.msg_iov =
+					tmp_work->msg_iov;
+			tmp_work->msg.msg_iovlen =
+					tmp_work->msg_len;
 
-			bytes_sent = tcp_hndl->tmp_work.tot_iov_byte_len;
-			retval = xio_tcp_sendmsg_work(tcp_hndl->sock.dfd,
-						      &tcp_hndl->tmp_work, 0);
-			bytes_sent -= tcp_hndl->tmp_work.tot_iov_byte_len;
+			bytes_sent = tmp_work->tot_iov_byte_len;
+			retval = xio_tcp_sendmsg_work(tcp_hndl,
+						      tcp_hndl->sock.dfd,
+						      tmp_work, 0,
+						      zc_flags);
+			bytes_sent -= tmp_work->tot_iov_byte_len;
 
 			task = list_first_entry(&tcp_hndl->tx_ready_list,
 						struct xio_task,
 						tasks_list_entry);
-			iov_len = tcp_hndl->tmp_work.msg_len -
-					tcp_hndl->tmp_work.msg.msg_iovlen;
+			iov_len = tmp_work->msg_len -
+					tmp_work->msg.msg_iovlen;
 			tmp_count = batch_count;
 			while (tmp_count) {
 				tcp_task = (struct xio_tcp_task *)task->dd_data;
@@ -1141,6 +1329,7 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 
 				list_move_tail(&task->tasks_list_entry,
 					       &tcp_hndl->in_flight_list);
+				tcp_task->zc_seq = tcp_hndl->zc_sent;
 
 				task_success = task;
 
@@ -1157,20 +1346,20 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 					&tcp_hndl->tx_ready_list,
 					struct xio_task,  tasks_list_entry);
 			}
-			if (tcp_hndl->tmp_work.msg.msg_iovlen) {
+			if (tmp_work->msg.msg_iovlen) {
 				tcp_task = (struct xio_tcp_task *)task->dd_data;
 				tcp_task->txd.msg.msg_iov =
 				&tcp_task->txd.msg.msg_iov[iov_len];
 				tcp_task->txd.msg.msg_iov[0].iov_base =
-				tcp_hndl->tmp_work.msg.msg_iov[0].iov_base;
+				tmp_work->msg.msg_iov[0].iov_base;
 				tcp_task->txd.msg.msg_iov[0].iov_len =
-				tcp_hndl->tmp_work.msg.msg_iov[0].iov_len;
+				tmp_work->msg.msg_iov[0].iov_len;
 				tcp_task->txd.msg.msg_iovlen -= iov_len;
 				tcp_task->txd.tot_iov_byte_len -= bytes_sent;
 			}
 
-			tcp_hndl->tmp_work.msg_len = 0;
-			tcp_hndl->tmp_work.tot_iov_byte_len = 0;
+			tmp_work->msg_len = 0;
+			tmp_work->tot_iov_byte_len = 0;
 			batch_count = 0;
 
 			if (retval < 0) {
@@ -1189,12 +1378,10 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 				if (xio_get_last_socket_error() != XIO_EAGAIN)
 					return -1;
 
-				/* for eagain, add event for ready for write*/
-				retval = xio_context_modify_ev_handler(
-						tcp_hndl->base.ctx,
-						tcp_hndl->sock.dfd,
-						XIO_POLLIN | XIO_POLLRDHUP |
-						XIO_POLLOUT);
+				/* for eagain, wait for ready for write */
+				retval = tcp_hndl->sock.ops->wait_writable(
+						tcp_hndl,
+						tcp_hndl->sock.dfd);
 				if (retval != 0)
 					ERROR_LOG("modify events failed.\n");
 
@@ -1215,6 +1402,12 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 
 handle_completions:
 
+	/* an upper layer holds messages back until the list drains */
+	if (task_success && tcp_hndl->tx_drain_notify &&
+	    !tcp_hndl->tx_ready_tasks_num) {
+		tcp_hndl->tx_drain_notify = 0;
+		imm_comp = 1;
+	}
 	if (task_success &&
 	    (tcp_hndl->tx_comp_cnt >= COMPLETION_BATCH_MAX ||
 	     imm_comp)) {
@@ -1490,18 +1683,23 @@ static int xio_tcp_write_rsp_header(struct xio_tcp_transport *tcp_hndl,
 			xio_mbuf_get_curr_ptr(&task->mbuf);
 
 	/* pack relevant values */
-	tmp_rsp_hdr->version  = rsp_hdr->version;
-	tmp_rsp_hdr->flags    = rsp_hdr->flags;
-	PACK_SVAL(rsp_hdr, tmp_rsp_hdr, rsp_hdr_len);
-	PACK_LVAL(rsp_hdr, tmp_rsp_hdr, ltid);
-	PACK_LVAL(rsp_hdr, tmp_rsp_hdr, rtid);
-	tmp_rsp_hdr->out_tcp_op = rsp_hdr->out_tcp_op;
-	PACK_LVAL(rsp_hdr, tmp_rsp_hdr, status);
-	PACK_SVAL(rsp_hdr, tmp_rsp_hdr, out_num_sge);
-	PACK_SVAL(rsp_hdr, tmp_rsp_hdr, ulp_hdr_len);
-	PACK_SVAL(rsp_hdr, tmp_rsp_hdr, ulp_pad_len);
-	/* remain_data_len not in use */
-	PACK_LLVAL(rsp_hdr, tmp_rsp_hdr, ulp_imm_len);
+	if (tcp_hndl->native_hdr) {
+		/* peer runs in our byte order - sn is coded later */
+		memcpy(tmp_rsp_hdr, rsp_hdr, sizeof(*rsp_hdr));
+	} else {
+		tmp_rsp_hdr->version  = rsp_hdr->version;
+		tmp_rsp_hdr->flags    = rsp_hdr->flags;
+		PACK_SVAL(rsp_hdr, tmp_rsp_hdr, rsp_hdr_len);
+		PACK_LVAL(rsp_hdr, tmp_rsp_hdr, ltid);
+		PACK_LVAL(rsp_hdr, tmp_rsp_hdr, rtid);
+		tmp_rsp_hdr->out_tcp_op = rsp_hdr->out_tcp_op;
+		PACK_LVAL(rsp_hdr, tmp_rsp_hdr, status);
+		PACK_SVAL(rsp_hdr, tmp_rsp_hdr, out_num_sge);
+		PACK_SVAL(rsp_hdr, tmp_rsp_hdr, ulp_hdr_len);
+		PACK_SVAL(rsp_hdr, tmp_rsp_hdr, ulp_pad_len);
+		/* remain_data_len not in use */
+		PACK_LLVAL(rsp_hdr, tmp_rsp_hdr, ulp_imm_len);
+	}
 
 	if (rsp_hdr->out_num_sge) {
 		wr_len = (uint32_t *)((uint8_t *)tmp_rsp_hdr +
@@ -1509,7 +1707,9 @@ static int xio_tcp_write_rsp_header(struct xio_tcp_transport *tcp_hndl,
 
 		/* params for RDMA WRITE equivalent*/
 		for (i = 0;  i < rsp_hdr->out_num_sge; i++) {
-			*wr_len = htonl(tcp_task->rsp_out_sge[i].length);
+			*wr_len = tcp_hndl->native_hdr ?
+				  tcp_task->rsp_out_sge[i].length :
+				  htonl(tcp_task->rsp_out_sge[i].length);
 			wr_len++;
 		}
 	}
@@ -1839,9 +2039,26 @@ static int xio_tcp_read_req_header(struct xio_tcp_transport *tcp_hndl,
 	tmp_req_hdr = (struct xio_tcp_req_hdr *)
 			xio_mbuf_get_curr_ptr(&task->mbuf);
 
-	req_hdr->version  = tmp_req_hdr->version;
-	req_hdr->flags    = tmp_req_hdr->flags;
-	UNPACK_SVAL(tmp_req_hdr, req_hdr, req_hdr_len);
+	if (tcp_hndl->native_hdr) {
+		/* peer runs in our byte order */
+		memcpy(req_hdr, tmp_req_hdr, sizeof(*req_hdr));
+	} else {
+		req_hdr->version  = tmp_req_hdr->version;
+		req_hdr->flags    = tmp_req_hdr->flags;
+		UNPACK_SVAL(tmp_req_hdr, req_hdr, req_hdr_len);
+		UNPACK_SVAL(tmp_req_hdr, req_hdr, sn);
+		UNPACK_LVAL(tmp_req_hdr, req_hdr, ltid);
+		req_hdr->out_tcp_op = tmp_req_hdr->out_tcp_op;
+		req_hdr->in_tcp_op = tmp_req_hdr->in_tcp_op;
+
+		UNPACK_SVAL(tmp_req_hdr, req_hdr, in_num_sge);
+		UNPACK_SVAL(tmp_req_hdr, req_hdr, out_num_sge);
+		UNPACK_SVAL(tmp_req_hdr, req_hdr, ulp_hdr_len);
+		UNPACK_SVAL(tmp_req_hdr, req_hdr, ulp_pad_len);
+
+		/* remain_data_len not in use */
+		UNPACK_LLVAL(tmp_req_hdr, req_hdr, ulp_imm_len);
+	}
 
 	if (unlikely(req_hdr->req_hdr_len != sizeof(struct xio_tcp_req_hdr))) {
 		ERROR_LOG(
@@ -1850,19 +2067,6 @@ static int xio_tcp_read_req_header(struct xio_tcp_transport *tcp_hndl,
 		return -1;
 	}
 
-	UNPACK_SVAL(tmp_req_hdr, req_hdr, sn);
-	UNPACK_LVAL(tmp_req_hdr, req_hdr, ltid);
-	req_hdr->out_tcp_op = tmp_req_hdr->out_tcp_op;
-	req_hdr->in_tcp_op = tmp_req_hdr->in_tcp_op;
-
-	UNPACK_SVAL(tmp_req_hdr, req_hdr, in_num_sge);
-	UNPACK_SVAL(tmp_req_hdr, req_hdr, out_num_sge);
-	UNPACK_SVAL(tmp_req_hdr, req_hdr, ulp_hdr_len);
-	UNPACK_SVAL(tmp_req_hdr, req_hdr, ulp_pad_len);
-
-	/* remain_data_len not in use */
-	UNPACK_LLVAL(tmp_req_hdr, req_hdr, ulp_imm_len);
-
 	tmp_sge = (struct xio_sge *)((uint8_t *)tmp_req_hdr +
 			sizeof(struct xio_tcp_req_hdr));
 
@@ -1870,18 +2074,14 @@ static int xio_tcp_read_req_header(struct xio_tcp_transport *tcp_hndl,
 
 	/* params for SEND/RDMA_WRITE */
 	for (i = 0;  i < req_hdr->in_num_sge; i++) {
-		UNPACK_LLVAL(tmp_sge, &tcp_task->req_in_sge[i], addr);
-		UNPACK_LVAL(tmp_sge, &tcp_task->req_in_sge[i], length);
-		UNPACK_LVAL(tmp_sge, &tcp_task->req_in_sge[i], stag);
+		xio_tcp_read_sge(tcp_hndl, tmp_sge, &tcp_task->req_in_sge[i]);
 		tmp_sge++;
 	}
 	tcp_task->req_in_num_sge	= i;
 
 	/* params for RDMA_READ */
 	for (i = 0;  i < req_hdr->out_num_sge; i++) {
-		UNPACK_LLVAL(tmp_sge, &tcp_task->req_out_sge[i], addr);
-		UNPACK_LVAL(tmp_sge, &tcp_task->req_out_sge[i], length);
-		UNPACK_LVAL(tmp_sge, &tcp_task->req_out_sge[i], stag);
+		xio_tcp_read_sge(tcp_hndl, tmp_sge, &tcp_task->req_out_sge[i]);
 		tmp_sge++;
 	}
 	tcp_task->req_out_num_sge	= i;
@@ -1913,9 +2113,24 @@ static int xio_tcp_read_rsp_header(struct xio_tcp_transport *tcp_hndl,
 	tmp_rsp_hdr = (struct xio_tcp_rsp_hdr *)
 			xio_mbuf_get_curr_ptr(&task->mbuf);
 
-	rsp_hdr->version  = tmp_rsp_hdr->version;
-	rsp_hdr->flags    = tmp_rsp_hdr->flags;
-	UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, rsp_hdr_len);
+	if (tcp_hndl->native_hdr) {
+		/* peer runs in our byte order */
+		memcpy(rsp_hdr, tmp_rsp_hdr, sizeof(*rsp_hdr));
+	} else {
+		rsp_hdr->version  = tmp_rsp_hdr->version;
+		rsp_hdr->flags    = tmp_rsp_hdr->flags;
+		UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, rsp_hdr_len);
+		UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, sn);
+		UNPACK_LVAL(tmp_rsp_hdr, rsp_hdr, rtid);
+		UNPACK_LVAL(tmp_rsp_hdr, rsp_hdr, ltid);
+		rsp_hdr->out_tcp_op = tmp_rsp_hdr->out_tcp_op;
+		UNPACK_LVAL(tmp_rsp_hdr, rsp_hdr, status);
+		UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, out_num_sge);
+		UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, ulp_hdr_len);
+		UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, ulp_pad_len);
+		/* remain_data_len not in use */
+		UNPACK_LLVAL(tmp_rsp_hdr, rsp_hdr, ulp_imm_len);
+	}
 
 	if (unlikely(rsp_hdr->rsp_hdr_len != sizeof(struct xio_tcp_rsp_hdr))) {
 		ERROR_LOG(
@@ -1924,24 +2139,14 @@ static int xio_tcp_read_rsp_header(struct xio_tcp_transport *tcp_hndl,
 		return -1;
 	}
 
-	UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, sn);
-	UNPACK_LVAL(tmp_rsp_hdr, rsp_hdr, rtid);
-	UNPACK_LVAL(tmp_rsp_hdr, rsp_hdr, ltid);
-	rsp_hdr->out_tcp_op = tmp_rsp_hdr->out_tcp_op;
-	UNPACK_LVAL(tmp_rsp_hdr, rsp_hdr, status);
-	UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, out_num_sge);
-	UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, ulp_hdr_len);
-	UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, ulp_pad_len);
-	/* remain_data_len not in use */
-	UNPACK_LLVAL(tmp_rsp_hdr, rsp_hdr, ulp_imm_len);
-
 	if (rsp_hdr->out_num_sge) {
 		wr_len = (uint32_t *)((uint8_t *)tmp_rsp_hdr +
 				sizeof(struct xio_tcp_rsp_hdr));
 
 		/* params for RDMA WRITE */
 		for (i = 0;  i < rsp_hdr->out_num_sge; i++) {
-			tcp_task->rsp_out_sge[i].length = ntohl(*wr_len);
+			tcp_task->rsp_out_sge[i].length =
+				tcp_hndl->native_hdr ? *wr_len : ntohl(*wr_len);
 			wr_len++;
 		}
 		tcp_task->rsp_out_num_sge = rsp_hdr->out_num_sge;
@@ -1981,6 +2186,8 @@ int xio_tcp_recv_ctl_work(struct xio_tcp_transport *tcp_hndl, int fd,
 {
 	int			retval;
 	int			bytes_to_copy;
+	struct iovec		iov;
+	struct msghdr		msg;
 
 	if (xio_recv->tot_iov_byte_len == 0)
 		return 1;
@@ -1993,8 +2200,17 @@ int xio_tcp_recv_ctl_work(struct xio_tcp_transport *tcp_hndl, int fd,
 
 	while (xio_recv->tot_iov_byte_len) {
 		while (tcp_hndl->tmp_rx_buf_len == 0) {
-			retval = recv(fd, (char *)tcp_hndl->tmp_rx_buf,
-				      TMP_RX_BUF_SIZE, 0);
+			if (!tcp_hndl->tmp_rx_buf &&
+			    xio_tcp_rx_ring_attach(tcp_hndl))
+				return -1;
+			/* read all that is available into the ring */
+			iov.iov_base = tcp_hndl->tmp_rx_buf;
+			iov.iov_len = tcp_hndl->tmp_rx_buf_sz;
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = &iov;
+			msg.msg_iovlen = 1;
+			retval = tcp_hndl->sock.ops->recvmsg(&tcp_hndl->sock,
+							     fd, &msg);
 			if (retval > 0) {
 				tcp_hndl->tmp_rx_buf_len = retval;
 				tcp_hndl->tmp_rx_buf_cur = tcp_hndl->tmp_rx_buf;
@@ -2009,6 +2225,9 @@ int xio_tcp_recv_ctl_work(struct xio_tcp_transport *tcp_hndl, int fd,
 					if (!block) {
 						xio_set_error(
 						   xio_get_last_socket_error());
+						/* an idle handle holds no ring */
+						xio_tcp_rx_ring_detach(
+								tcp_hndl);
 						return -1;
 					}
 				} else if (xio_get_last_socket_error() ==
@@ -2041,12 +2260,38 @@ int xio_tcp_recv_ctl_work(struct xio_tcp_transport *tcp_hndl, int fd,
 		xio_recv->msg.msg_iov[0].iov_len -= bytes_to_copy;
 		xio_recv->tot_iov_byte_len -= bytes_to_copy;
 	}
+	if (!tcp_hndl->tmp_rx_buf_len)
+		xio_tcp_rx_ring_detach(tcp_hndl);
 
 	xio_recv->msg.msg_iovlen = 0;
 
 	return 1;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_rx_ring_read							     */
+/*---------------------------------------------------------------------------*/
+static int xio_tcp_rx_ring_read(struct xio_tcp_transport *tcp_hndl,
+				struct msghdr *msg)
+{
+	size_t			i, len;
+	int			copied = 0;
+
+	for (i = 0; i < msg->msg_iovlen && tcp_hndl->tmp_rx_buf_len; i++) {
+		len = min(msg->msg_iov[i].iov_len,
+			  (size_t)tcp_hndl->tmp_rx_buf_len);
+		memcpy(msg->msg_iov[i].iov_base, tcp_hndl->tmp_rx_buf_cur,
+		       len);
+		inc_ptr(tcp_hndl->tmp_rx_buf_cur, len);
+		tcp_hndl->tmp_rx_buf_len -= len;
+		copied += len;
+	}
+	if (!tcp_hndl->tmp_rx_buf_len)
+		xio_tcp_rx_ring_detach(tcp_hndl);
+
+	return copied;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_recvmsg_work							     */
 /*---------------------------------------------------------------------------*/
@@ -2061,7 +2306,14 @@ int xio_tcp_recvmsg_work(struct xio_tcp_transport *tcp_hndl, int fd,
 		return 1;
 
 	while (xio_recv->tot_iov_byte_len) {
-		retval = recvmsg(fd, &xio_recv->msg, 0);
+		/* bytes already staged in the rx ring precede the socket */
+		if (fd == tcp_hndl->sock.cfd && tcp_hndl->tmp_rx_buf_len)
+			retval = xio_tcp_rx_ring_read(tcp_hndl,
+						      &xio_recv->msg);
+		else
+			retval = tcp_hndl->sock.ops->recvmsg(&tcp_hndl->sock,
+							     fd,
+							     &xio_recv->msg);
 		if (retval > 0) {
 			recv_bytes += retval;
 			xio_recv->tot_iov_byte_len -= retval;
@@ -3018,6 +3270,7 @@ static int xio_tcp_send_cancel(struct xio_tcp_transport *tcp_hndl,
 	int			retval;
 	struct xio_task		*task;
 	struct xio_tcp_task	*tcp_task;
+	struct xio_msg		*dummy_msg = &tcp_hndl->scratch->dummy_msg;
 	void			*buff;
 
 	task = xio_tcp_primary_task_alloc(tcp_hndl);
@@ -3038,12 +3291,12 @@ static int xio_tcp_send_cancel(struct xio_tcp_transport *tcp_hndl,
 	tcp_task->read_num_reg_mem		= 0;
 
 	ulp_hdr_len = sizeof(*cancel_hdr) + sizeof(uint16_t) + ulp_msg_sz;
-	tcp_hndl->dummy_msg.out.header.iov_base = ucalloc(1, ulp_hdr_len);
-	tcp_hndl->dummy_msg.out.header.iov_len = ulp_hdr_len;
+	dummy_msg->out.header.iov_base = ucalloc(1, ulp_hdr_len);
+	dummy_msg->out.header.iov_len = ulp_hdr_len;
 
 	/* write the message */
 	/* get the pointer */
-	buff = tcp_hndl->dummy_msg.out.header.iov_base;
+	buff = dummy_msg->out.header.iov_base;
 
 	/* pack relevant values */
 	inc_ptr(buff, xio_write_uint16(cancel_hdr->hdr_len, 0,
@@ -3057,7 +3310,7 @@ static int xio_tcp_send_cancel(struct xio_tcp_transport *tcp_hndl,
 	inc_ptr(buff, xio_write_array((const uint8_t *)ulp_msg, ulp_msg_sz, 0,
 				      (uint8_t *)buff));
 
-	task->omsg = &tcp_hndl->dummy_msg;
+	task->omsg = dummy_msg;
 
 	/* write xio header to the buffer */
 	if (IS_REQUEST(task->tlv_type)) {
@@ -3087,7 +3340,7 @@ static int xio_tcp_send_cancel(struct xio_tcp_transport *tcp_hndl,
 		return  -1;
 
 	task->omsg = NULL;
-	free(tcp_hndl->dummy_msg.out.header.iov_base);
+	free(dummy_msg->out.header.iov_base);
 
 	tcp_hndl->tx_ready_tasks_num++;
 	list_move_tail(&task->tasks_list_entry, &tcp_hndl->tx_ready_list);
@@ -3097,6 +3350,21 @@ static int xio_tcp_send_cancel(struct xio_tcp_transport *tcp_hndl,
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_tx_backlog							     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_tx_backlog(struct xio_transport_base *transport)
+{
+	struct xio_tcp_transport *tcp_hndl =
+		(struct xio_tcp_transport *)transport;
+
+	/* the caller waits for the drain - do not batch its completion */
+	if (tcp_hndl->tx_ready_tasks_num)
+		tcp_hndl->tx_drain_notify = 1;
+
+	return tcp_hndl->tx_ready_tasks_num;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_send							     */
 /*---------------------------------------------------------------------------*/
@@ -3165,6 +3433,7 @@ int xio_tcp_rx_data_handler(struct xio_tcp_transport *tcp_hndl, int batch_nr)
 	unsigned int iov_len;
 	uint64_t bytes_recv;
 	struct xio_tcp_work_req *rxd_work, *next_rxd_work;
+	struct xio_tcp_work_req *tmp_work = &tcp_hndl->scratch->tmp_work;
 
 	task = list_first_entry_or_null(&tcp_hndl->rx_list,
 					struct xio_task,
@@ -3197,40 +3466,40 @@ int xio_tcp_rx_data_handler(struct xio_tcp_transport *tcp_hndl, int batch_nr)
 		}
 
 		for (i = 0; i < rxd_work->msg.msg_iovlen; i++) {
-			tcp_hndl->tmp_work.msg_iov
-			[tcp_hndl->tmp_work.msg_len].iov_base =
+			tmp_work->msg_iov
+			[tmp_work->msg_len].iov_base =
 				rxd_work->msg.msg_iov[i].iov_base;
-			tcp_hndl->tmp_work.msg_iov
-			[tcp_hndl->tmp_work.msg_len].iov_len =
+			tmp_work->msg_iov
+			[tmp_work->msg_len].iov_len =
 				rxd_work->msg.msg_iov[i].iov_len;
-			++tcp_hndl->tmp_work.msg_len;
+			++tmp_work->msg_len;
 		}
-		tcp_hndl->tmp_work.tot_iov_byte_len +=
+		tmp_work->tot_iov_byte_len +=
 				rxd_work->tot_iov_byte_len;
 
 		++batch_count;
 		++tmp_count;
 
 		if (batch_count != batch_nr && next_rxd_work &&
-		    (next_rxd_work->msg.msg_iovlen + tcp_hndl->tmp_work.msg_len)
+		    (next_rxd_work->msg.msg_iovlen + tmp_work->msg_len)
 		    < IOV_MAX) {
 			task = next_task;
 			continue;
 		}
 
-		tcp_hndl->tmp_work.msg.msg_iov = tcp_hndl->tmp_work.msg_iov;
-		tcp_hndl->tmp_work.msg.msg_iovlen = tcp_hndl->tmp_work.msg_len;
+		tmp_work->msg.msg_iov = tmp_work->msg_iov;
+		tmp_work->msg.msg_iovlen = tmp_work->msg_len;
 
-		bytes_recv = tcp_hndl->tmp_work.tot_iov_byte_len;
+		bytes_recv = tmp_work->tot_iov_byte_len;
 		recvmsg_retval = xio_tcp_recvmsg_work(tcp_hndl,
 						      tcp_hndl->sock.dfd,
-						      &tcp_hndl->tmp_work, 0);
-		bytes_recv -= tcp_hndl->tmp_work.tot_iov_byte_len;
+						      tmp_work, 0);
+		bytes_recv -= tmp_work->tot_iov_byte_len;
 
 		task = list_first_entry(&tcp_hndl->rx_list,
 					struct xio_task,  tasks_list_entry);
-		iov_len = tcp_hndl->tmp_work.msg_len -
-				tcp_hndl->tmp_work.msg.msg_iovlen;
+		iov_len = tmp_work->msg_len -
+				tmp_work->msg.msg_iovlen;
 		for (i = 0; i < (unsigned int)tmp_count; i++) {
 			tcp_task = (struct xio_tcp_task *)task->dd_data;
 			rxd_work = xio_tcp_get_data_rxd(task);
@@ -3245,20 +3514,20 @@ int xio_tcp_rx_data_handler(struct xio_tcp_transport *tcp_hndl, int batch_nr)
 						struct xio_task,
 						tasks_list_entry);
 		}
-		if (tcp_hndl->tmp_work.msg.msg_iovlen) {
+		if (tmp_work->msg.msg_iovlen) {
 			tcp_task = (struct xio_tcp_task *)task->dd_data;
 			rxd_work = xio_tcp_get_data_rxd(task);
 			rxd_work->msg.msg_iov = &rxd_work->msg.msg_iov[iov_len];
 			rxd_work->msg.msg_iov[0].iov_base =
-				tcp_hndl->tmp_work.msg.msg_iov[0].iov_base;
+				tmp_work->msg.msg_iov[0].iov_base;
 			rxd_work->msg.msg_iov[0].iov_len =
-				tcp_hndl->tmp_work.msg.msg_iov[0].iov_len;
+				tmp_work->msg.msg_iov[0].iov_len;
 			rxd_work->msg.msg_iovlen -= iov_len;
 			rxd_work->tot_iov_byte_len -= bytes_recv;
 		}
 
-		tcp_hndl->tmp_work.msg_len = 0;
-		tcp_hndl->tmp_work.tot_iov_byte_len = 0;
+		tmp_work->msg_len = 0;
+		tmp_work->tot_iov_byte_len = 0;
 
                 /* look for the maximum last in rxq index */
                 tmp_count = 0;
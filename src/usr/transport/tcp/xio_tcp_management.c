@@ -55,6 +55,7 @@
 #include "xio_workqueue.h"
 #include "xio_context.h"
 #include "xio_tcp_transport.h"
+#include "xio_tcp_shm.h"
 #include "xio_mem.h"
 
 /* default option values */
@@ -67,15 +68,22 @@
 #define XIO_OPTVAL_DEF_TCP_SO_SNDBUF			4194304
 #define XIO_OPTVAL_DEF_TCP_SO_RCVBUF			4194304
 #define XIO_OPTVAL_DEF_TCP_DUAL_SOCK			1
+#define XIO_OPTVAL_DEF_TCP_ZEROCOPY_THRESHOLD		0
+#define XIO_OPTVAL_DEF_TCP_RX_RING_SIZE			65536
 
 /*---------------------------------------------------------------------------*/
 /* globals								     */
 /*---------------------------------------------------------------------------*/
 static spinlock_t			mngmt_lock;
+static spinlock_t			shard_lock;
+static LIST_HEAD(shard_groups);
+static spinlock_t			scratch_lock;
+static LIST_HEAD(scratch_list);
 static thread_once_t			ctor_key_once = THREAD_ONCE_INIT;
 static thread_once_t			dtor_key_once = THREAD_ONCE_INIT;
 static struct xio_tcp_socket_ops	single_sock_ops;
 static struct xio_tcp_socket_ops	dual_sock_ops;
+static struct xio_tcp_socket_ops	shm_sock_ops;
 extern struct xio_transport		xio_tcp_transport;
 
 static int				cdl_fd = -1;
@@ -91,6 +99,8 @@ struct xio_tcp_options			tcp_options = {
 	XIO_OPTVAL_DEF_TCP_SO_SNDBUF,		/*tcp_so_sndbuf*/
 	XIO_OPTVAL_DEF_TCP_SO_RCVBUF,		/*tcp_so_rcvbuf*/
 	XIO_OPTVAL_DEF_TCP_DUAL_SOCK,		/*tcp_dual_sock*/
+	XIO_OPTVAL_DEF_TCP_ZEROCOPY_THRESHOLD,	/*tcp_zerocopy_threshold*/
+	XIO_OPTVAL_DEF_TCP_RX_RING_SIZE,	/*tcp_rx_ring_size*/
 	0					/*pad*/
 };
 
@@ -227,6 +237,232 @@ int xio_tcp_dual_sock_del_ev_handlers(struct xio_tcp_transport *tcp_hndl)
 	return retval1 | retval2;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shard_group_join						     */
+/*---------------------------------------------------------------------------*/
+static int xio_tcp_shard_group_join(struct xio_tcp_transport *tcp_hndl,
+				    union xio_sockaddr *sa, socklen_t sa_len)
+{
+	struct xio_tcp_shard_group *group;
+
+	spin_lock(&shard_lock);
+	list_for_each_entry(group, &shard_groups, groups_list_entry) {
+		if (!memcmp(&group->sa, sa, sa_len)) {
+			group->refcnt++;
+			goto found;
+		}
+	}
+	group = (struct xio_tcp_shard_group *)ucalloc(1, sizeof(*group));
+	if (!group) {
+		spin_unlock(&shard_lock);
+		xio_set_error(ENOMEM);
+		ERROR_LOG("ucalloc failed. %m\n");
+		return -1;
+	}
+	memcpy(&group->sa, sa, sa_len);
+	INIT_LIST_HEAD(&group->pending_conns);
+	group->refcnt = 1;
+	list_add(&group->groups_list_entry, &shard_groups);
+found:
+	tcp_hndl->shard_group = group;
+	spin_unlock(&shard_lock);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shard_close_parked						     */
+/*---------------------------------------------------------------------------*/
+static void xio_tcp_shard_close_parked(struct list_head *parked)
+{
+	struct xio_tcp_pending_conn *pconn, *next_pconn;
+
+	/* halves whose sibling never arrived */
+	list_for_each_entry_safe(pconn, next_pconn, parked,
+				 conns_list_entry) {
+		DEBUG_LOG("closing parked connection half fd=%d\n", pconn->fd);
+		xio_closesocket(pconn->fd);
+		list_del(&pconn->conns_list_entry);
+		ufree(pconn);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shard_expire							     */
+/*---------------------------------------------------------------------------*/
+static void xio_tcp_shard_expire(void *_tcp_hndl)
+{
+	struct xio_tcp_transport *tcp_hndl =
+					(struct xio_tcp_transport *)_tcp_hndl;
+	struct xio_tcp_shard_group *group = tcp_hndl->shard_group;
+	struct xio_tcp_pending_conn *pconn, *next_pconn;
+	uint64_t timeout = (uint64_t)(SHARD_PARK_MSEC * 1000 * g_mhz);
+	uint64_t now = get_cycles();
+	int parked = 0;
+	LIST_HEAD(expired);
+
+	if (!group)
+		return;
+
+	/* every shard expires the halves it parked itself */
+	spin_lock(&shard_lock);
+	list_for_each_entry_safe(pconn, next_pconn, &group->pending_conns,
+				 conns_list_entry) {
+		if (pconn->parked_by != tcp_hndl)
+			continue;
+		if (now - pconn->parked_at >= timeout)
+			list_move_tail(&pconn->conns_list_entry, &expired);
+		else
+			parked = 1;
+	}
+	spin_unlock(&shard_lock);
+
+	xio_tcp_shard_close_parked(&expired);
+	if (parked)
+		xio_ctx_add_delayed_work(tcp_hndl->base.ctx, SHARD_PARK_MSEC,
+					 tcp_hndl, xio_tcp_shard_expire,
+					 &tcp_hndl->shard_expire_work);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shard_group_leave						     */
+/*---------------------------------------------------------------------------*/
+static void xio_tcp_shard_group_leave(struct xio_tcp_transport *tcp_hndl)
+{
+	struct xio_tcp_shard_group *group = tcp_hndl->shard_group;
+	struct xio_tcp_pending_conn *pconn, *next_pconn;
+	LIST_HEAD(parked);
+
+	xio_ctx_del_delayed_work(tcp_hndl->base.ctx,
+				 &tcp_hndl->shard_expire_work);
+
+	spin_lock(&shard_lock);
+	tcp_hndl->shard_group = NULL;
+	if (--group->refcnt) {
+		/* no one would expire the halves this shard parked */
+		list_for_each_entry_safe(pconn, next_pconn,
+					 &group->pending_conns,
+					 conns_list_entry) {
+			if (pconn->parked_by == tcp_hndl)
+				list_move_tail(&pconn->conns_list_entry,
+					       &parked);
+		}
+		spin_unlock(&shard_lock);
+		xio_tcp_shard_close_parked(&parked);
+		return;
+	}
+	list_del(&group->groups_list_entry);
+	spin_unlock(&shard_lock);
+
+	xio_tcp_shard_close_parked(&group->pending_conns);
+	ufree(group);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_rx_ring_free							     */
+/*---------------------------------------------------------------------------*/
+static void xio_tcp_rx_ring_free(void *ring, uint32_t size)
+{
+	if (size >= HUGE_PAGE_SZ)
+		ufree_huge_pages(ring);
+	else
+		ufree(ring);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_scratch_down							     */
+/*---------------------------------------------------------------------------*/
+static void xio_tcp_scratch_down(struct kref *kref)
+{
+	struct xio_tcp_ctx_scratch *scratch =
+		container_of(kref, struct xio_tcp_ctx_scratch, kref);
+
+	spin_lock(&scratch_lock);
+	list_del(&scratch->scratch_list_entry);
+	spin_unlock(&scratch_lock);
+
+	if (scratch->ctx)
+		xio_context_unreg_observer(scratch->ctx, &scratch->observer);
+	XIO_OBSERVER_DESTROY(&scratch->observer);
+	if (scratch->rx_ring)
+		xio_tcp_rx_ring_free(scratch->rx_ring, scratch->rx_ring_sz);
+	ufree(scratch);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_scratch_release						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_tcp_scratch_release(struct xio_tcp_ctx_scratch *scratch)
+{
+	kref_put(&scratch->kref, xio_tcp_scratch_down);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_on_context_event						     */
+/*---------------------------------------------------------------------------*/
+static int xio_tcp_on_context_event(void *observer, void *sender,
+				    int event, void *event_data)
+{
+	struct xio_tcp_ctx_scratch *scratch =
+		(struct xio_tcp_ctx_scratch *)observer;
+
+	if (event == XIO_CONTEXT_EVENT_POST_CLOSE) {
+		TRACE_LOG("context: [close] ctx:%p\n", sender);
+		/* handles may outlive the context - forget it now */
+		spin_lock(&scratch_lock);
+		scratch->ctx = NULL;
+		spin_unlock(&scratch_lock);
+		xio_context_unreg_observer((struct xio_context *)sender,
+					   &scratch->observer);
+		xio_tcp_scratch_release(scratch);
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_scratch_get							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_tcp_ctx_scratch *xio_tcp_scratch_get(struct xio_context *ctx)
+{
+	struct xio_tcp_ctx_scratch *scratch;
+
+	spin_lock(&scratch_lock);
+	list_for_each_entry(scratch, &scratch_list, scratch_list_entry) {
+		if (scratch->ctx == ctx) {
+			kref_get(&scratch->kref);
+			spin_unlock(&scratch_lock);
+			return scratch;
+		}
+	}
+	spin_unlock(&scratch_lock);
+
+	scratch = (struct xio_tcp_ctx_scratch *)
+			ucalloc(1, sizeof(struct xio_tcp_ctx_scratch));
+	if (!scratch) {
+		xio_set_error(ENOMEM);
+		ERROR_LOG("ucalloc failed. %m\n");
+		return NULL;
+	}
+	scratch->ctx = ctx;
+	scratch->tmp_work.msg_iov = scratch->tmp_iovec;
+
+	/* One reference count for the context and one for the tcp handle */
+	kref_init(&scratch->kref);
+	kref_get(&scratch->kref);
+
+	/* the context is single threaded - nobody else can race the add */
+	spin_lock(&scratch_lock);
+	list_add(&scratch->scratch_list_entry, &scratch_list);
+	spin_unlock(&scratch_lock);
+
+	XIO_OBSERVER_INIT(&scratch->observer, scratch,
+			  xio_tcp_on_context_event);
+	xio_context_reg_observer(ctx, &scratch->observer);
+
+	return scratch;
+}
+
 /*---------------------------------------------------------------------------*/
 /* on_sock_disconnected							     */
 /*---------------------------------------------------------------------------*/
@@ -264,10 +500,14 @@ void on_sock_disconnected(struct xio_tcp_transport *tcp_hndl,
 				"removing conn handler failed.(errno=%d %m)\n",
 				xio_get_last_socket_error());
 			}
+			xio_tcp_shm_close_fds(pconn->shm_fds, pconn->shm_nfds);
 			list_del(&pconn->conns_list_entry);
 			ufree(pconn);
 		}
 
+		if (tcp_hndl->shard_group)
+			xio_tcp_shard_group_leave(tcp_hndl);
+
 		if (passive_close) {
 			xio_transport_notify_observer(
 					&tcp_hndl->base,
@@ -290,9 +530,13 @@ static void xio_tcp_post_close(struct xio_tcp_transport *tcp_hndl)
 	xio_observable_unreg_all_observers(&tcp_hndl->base.observable);
 
 	if (tcp_hndl->tmp_rx_buf) {
-		ufree(tcp_hndl->tmp_rx_buf);
+		xio_tcp_rx_ring_free(tcp_hndl->tmp_rx_buf,
+				     tcp_hndl->tmp_rx_buf_sz);
 		tcp_hndl->tmp_rx_buf = NULL;
 	}
+	xio_tcp_scratch_release(tcp_hndl->scratch);
+
+	xio_tcp_shm_channel_destroy(&tcp_hndl->sock);
 
 	ufree(tcp_hndl->base.portal_uri);
 
@@ -539,6 +783,87 @@ int xio_tcp_dual_sock_rx_ctl_handler(struct xio_tcp_transport *tcp_hndl)
 	return xio_tcp_rx_ctl_handler(tcp_hndl, RX_BATCH);
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_rx_ring_init							     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_rx_ring_init(struct xio_tcp_transport *tcp_hndl)
+{
+	size_t size = tcp_options.tcp_rx_ring_size > 0 ?
+		      (size_t)tcp_options.tcp_rx_ring_size : 0;
+
+	if (tcp_hndl->sock.cfd != tcp_hndl->sock.dfd) {
+		/* the control stream is always staged */
+		if (size < TMP_RX_BUF_SIZE)
+			size = TMP_RX_BUF_SIZE;
+	} else if (!size) {
+		return 0;
+	}
+
+	/* the ring itself is attached only when data is readable */
+	tcp_hndl->tmp_rx_buf	 = NULL;
+	tcp_hndl->tmp_rx_buf_cur = NULL;
+	tcp_hndl->tmp_rx_buf_len = 0;
+	tcp_hndl->tmp_rx_buf_sz	 = size;
+	tcp_hndl->tmp_rx_buf_huge = size >= HUGE_PAGE_SZ;
+
+	/* header and payload share the stream - parse both from the ring */
+	if (tcp_hndl->sock.cfd == tcp_hndl->sock.dfd)
+		tcp_hndl->sock.ops->rx_ctl_work = xio_tcp_recv_ctl_work;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_rx_ring_attach						     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_rx_ring_attach(struct xio_tcp_transport *tcp_hndl)
+{
+	struct xio_tcp_ctx_scratch *scratch = tcp_hndl->scratch;
+
+	/* handles of a context are read one at a time, and a drained
+	 * ring goes back to the context, so one spare serves them all
+	 */
+	if (scratch->rx_ring &&
+	    scratch->rx_ring_sz == tcp_hndl->tmp_rx_buf_sz) {
+		tcp_hndl->tmp_rx_buf = scratch->rx_ring;
+		scratch->rx_ring = NULL;
+	} else {
+		tcp_hndl->tmp_rx_buf = tcp_hndl->tmp_rx_buf_huge ?
+			umalloc_huge_pages(tcp_hndl->tmp_rx_buf_sz) :
+			umalloc(tcp_hndl->tmp_rx_buf_sz);
+		if (!tcp_hndl->tmp_rx_buf) {
+			xio_set_error(ENOMEM);
+			ERROR_LOG("allocating rx ring of %u bytes failed.\n",
+				  tcp_hndl->tmp_rx_buf_sz);
+			return -1;
+		}
+	}
+	tcp_hndl->tmp_rx_buf_cur = tcp_hndl->tmp_rx_buf;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_rx_ring_detach						     */
+/*---------------------------------------------------------------------------*/
+void xio_tcp_rx_ring_detach(struct xio_tcp_transport *tcp_hndl)
+{
+	struct xio_tcp_ctx_scratch *scratch = tcp_hndl->scratch;
+
+	if (!tcp_hndl->tmp_rx_buf)
+		return;
+
+	if (!scratch->rx_ring) {
+		scratch->rx_ring    = tcp_hndl->tmp_rx_buf;
+		scratch->rx_ring_sz = tcp_hndl->tmp_rx_buf_sz;
+	} else {
+		xio_tcp_rx_ring_free(tcp_hndl->tmp_rx_buf,
+				     tcp_hndl->tmp_rx_buf_sz);
+	}
+	tcp_hndl->tmp_rx_buf	 = NULL;
+	tcp_hndl->tmp_rx_buf_cur = NULL;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_consume_ctl_rx						     */
 /*---------------------------------------------------------------------------*/
@@ -570,6 +895,11 @@ void xio_tcp_ctl_ready_ev_handler(int fd, int events, void *user_context)
 	struct xio_tcp_transport	*tcp_hndl = (struct xio_tcp_transport *)
 							user_context;
 
+	/* zero copy completions are reported on the error queue */
+	if ((events & XIO_POLLERR) && tcp_hndl->zc_enabled &&
+	    xio_tcp_zerocopy_reap(tcp_hndl, fd) > 0)
+		events &= ~XIO_POLLERR;
+
 	if (events & XIO_POLLOUT) {
 		xio_context_modify_ev_handler(tcp_hndl->base.ctx, fd,
 					      XIO_POLLIN | XIO_POLLRDHUP);
@@ -597,6 +927,10 @@ void xio_tcp_data_ready_ev_handler(int fd, int events, void *user_context)
 							user_context;
 	int retval = 0, count = 0;
 
+	if ((events & XIO_POLLERR) && tcp_hndl->zc_enabled &&
+	    xio_tcp_zerocopy_reap(tcp_hndl, fd) > 0)
+		events &= ~XIO_POLLERR;
+
 	if (events & XIO_POLLOUT) {
 		xio_context_modify_ev_handler(tcp_hndl->base.ctx, fd,
 					      XIO_POLLIN | XIO_POLLRDHUP);
@@ -681,6 +1015,26 @@ int xio_tcp_dual_sock_add_ev_handlers(struct xio_tcp_transport *tcp_hndl)
 	return retval;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_zerocopy_enable		                                     */
+/*---------------------------------------------------------------------------*/
+static void xio_tcp_zerocopy_enable(struct xio_tcp_transport *tcp_hndl)
+{
+	int optval = 1;
+
+	if (tcp_options.tcp_zerocopy_threshold <= 0 ||
+	    tcp_hndl->base.proto != XIO_PROTO_TCP)
+		return;
+
+	if (setsockopt(tcp_hndl->sock.dfd, SOL_SOCKET, SO_ZEROCOPY,
+		       (char *)&optval, sizeof(optval))) {
+		DEBUG_LOG("SO_ZEROCOPY not supported. (errno=%d %m)\n",
+			  xio_get_last_socket_error());
+		return;
+	}
+	tcp_hndl->zc_enabled = 1;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_accept		                                             */
 /*---------------------------------------------------------------------------*/
@@ -693,6 +1047,7 @@ static int xio_tcp_accept(struct xio_transport_base *transport)
 		xio_transport_notify_observer_error(&tcp_hndl->base,
 						    XIO_E_UNSUCCESSFUL);
 	}
+	xio_tcp_zerocopy_enable(tcp_hndl);
 
 	TRACE_LOG("tcp transport: [accept] handle:%p\n", tcp_hndl);
 
@@ -834,8 +1189,13 @@ struct xio_tcp_transport *xio_tcp_transport_create(
 		}
 	}
 
+	tcp_hndl->scratch = xio_tcp_scratch_get(ctx);
+	if (!tcp_hndl->scratch)
+		goto cleanup;
+
 	tcp_hndl->base.portal_uri	= NULL;
-	tcp_hndl->base.proto		= XIO_PROTO_TCP;
+	tcp_hndl->base.proto		= (transport == &xio_shm_transport) ?
+					  XIO_PROTO_SHM : XIO_PROTO_TCP;
 	kref_init(&tcp_hndl->base.kref);
 	tcp_hndl->transport		= transport;
 	tcp_hndl->base.ctx		= ctx;
@@ -848,15 +1208,16 @@ struct xio_tcp_transport *xio_tcp_transport_create(
 	tcp_hndl->tx_ready_tasks_num = 0;
 	tcp_hndl->tx_comp_cnt = 0;
 
-	memset(&tcp_hndl->tmp_work, 0, sizeof(struct xio_tcp_work_req));
-	tcp_hndl->tmp_work.msg_iov = tcp_hndl->tmp_iovec;
-
 	/* create tcp socket */
 	if (create_socket) {
-		memcpy(tcp_hndl->sock.ops,
-		       (tcp_options.tcp_dual_sock ?
-			&dual_sock_ops : &single_sock_ops),
-		       sizeof(*tcp_hndl->sock.ops));
+		if (tcp_hndl->base.proto == XIO_PROTO_SHM)
+			memcpy(tcp_hndl->sock.ops, &shm_sock_ops,
+			       sizeof(*tcp_hndl->sock.ops));
+		else
+			memcpy(tcp_hndl->sock.ops,
+			       (tcp_options.tcp_dual_sock ?
+				&dual_sock_ops : &single_sock_ops),
+			       sizeof(*tcp_hndl->sock.ops));
 		if (tcp_hndl->sock.ops->open(&tcp_hndl->sock))
 			goto cleanup;
 	}
@@ -894,11 +1255,94 @@ struct xio_tcp_transport *xio_tcp_transport_create(
 	return tcp_hndl;
 
 cleanup:
+	if (tcp_hndl->scratch)
+		xio_tcp_scratch_release(tcp_hndl->scratch);
 	ufree(tcp_hndl);
 
 	return NULL;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_pending_conn_match						     */
+/*---------------------------------------------------------------------------*/
+static int xio_tcp_pending_conn_match(struct xio_tcp_pending_conn *pconn,
+				      struct xio_tcp_pending_conn *pending_conn)
+{
+	if (pconn->sa.sa.sa_family == AF_INET) {
+		if ((pconn->msg.second_port ==
+		    ntohs(pending_conn->sa.sa_in.sin_port)) &&
+		    (pconn->sa.sa_in.sin_addr.s_addr ==
+		    pending_conn->sa.sa_in.sin_addr.s_addr)) {
+			if (ntohs(pconn->sa.sa_in.sin_port) !=
+			    pending_conn->msg.second_port) {
+				ERROR_LOG("ports mismatch\n");
+				return -1;
+			}
+			return 1;
+		}
+	} else if (pconn->sa.sa.sa_family == AF_INET6) {
+		if ((pconn->msg.second_port ==
+		     ntohs(pending_conn->sa.sa_in6.sin6_port)) &&
+		     !memcmp(&pconn->sa.sa_in6.sin6_addr,
+			     &pending_conn->sa.sa_in6.sin6_addr,
+			     sizeof(pconn->sa.sa_in6.sin6_addr))) {
+			if (ntohs(pconn->sa.sa_in6.sin6_port) !=
+			    pending_conn->msg.second_port) {
+				ERROR_LOG("ports mismatch\n");
+				return -1;
+			}
+			return 1;
+		}
+	} else {
+		ERROR_LOG("unknown family %d\n", pconn->sa.sa.sa_family);
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shard_pending_conn						     */
+/*---------------------------------------------------------------------------*/
+static struct xio_tcp_pending_conn *xio_tcp_shard_pending_conn(
+		struct xio_tcp_transport *parent_hndl,
+		struct xio_tcp_pending_conn *pending_conn)
+{
+	struct xio_tcp_shard_group *group = parent_hndl->shard_group;
+	struct xio_tcp_pending_conn *pconn, *matching_conn = NULL;
+
+	/* the half is complete - take it off this shard */
+	list_del(&pending_conn->conns_list_entry);
+	if (xio_context_del_ev_handler(parent_hndl->base.ctx,
+				       pending_conn->fd)) {
+		ERROR_LOG("removing connection handler failed.(errno=%d %m)\n",
+			  xio_get_last_socket_error());
+	}
+
+	spin_lock(&shard_lock);
+	list_for_each_entry(pconn, &group->pending_conns, conns_list_entry) {
+		if (xio_tcp_pending_conn_match(pconn, pending_conn) > 0) {
+			matching_conn = pconn;
+			list_del(&pconn->conns_list_entry);
+			break;
+		}
+	}
+	if (!matching_conn) {
+		pending_conn->parked_by = parent_hndl;
+		pending_conn->parked_at = get_cycles();
+		list_add_tail(&pending_conn->conns_list_entry,
+			      &group->pending_conns);
+	}
+	spin_unlock(&shard_lock);
+
+	if (!matching_conn)
+		xio_ctx_add_delayed_work(parent_hndl->base.ctx,
+					 SHARD_PARK_MSEC, parent_hndl,
+					 xio_tcp_shard_expire,
+					 &parent_hndl->shard_expire_work);
+
+	return matching_conn;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_handle_pending_conn						     */
 /*---------------------------------------------------------------------------*/
@@ -911,10 +1355,11 @@ void xio_tcp_handle_pending_conn(int fd,
 	struct xio_tcp_pending_conn *pending_conn = NULL, *matching_conn = NULL;
 	struct xio_tcp_pending_conn *ctl_conn = NULL, *data_conn = NULL;
 	void *buf;
-	int cfd = 0, dfd = 0, is_single = 1;
+	int cfd = 0, dfd = 0, is_single = 1, detached = 0;
 	socklen_t len = 0;
 	struct xio_tcp_transport *child_hndl = NULL;
 	union xio_transport_event_data ev_data;
+	int shm_fds[XIO_TCP_SHM_NFDS], shm_nfds;
 
 	list_for_each_entry_safe(pconn, next_pconn,
 				 &parent_hndl->pending_conns,
@@ -940,8 +1385,15 @@ void xio_tcp_handle_pending_conn(int fd,
 	inc_ptr(buf, sizeof(struct xio_tcp_connect_msg) -
 			pending_conn->waiting_for_bytes);
 	while (pending_conn->waiting_for_bytes) {
-		retval = recv(fd, (char *)buf,
-			      pending_conn->waiting_for_bytes, 0);
+		if (parent_hndl->base.proto == XIO_PROTO_SHM)
+			retval = xio_tcp_shm_recv_connect_msg(
+					fd, buf,
+					pending_conn->waiting_for_bytes,
+					pending_conn->shm_fds,
+					&pending_conn->shm_nfds);
+		else
+			retval = recv(fd, (char *)buf,
+				      pending_conn->waiting_for_bytes, 0);
 		if (retval > 0) {
 			pending_conn->waiting_for_bytes -= retval;
 			inc_ptr(buf, retval);
@@ -968,44 +1420,32 @@ void xio_tcp_handle_pending_conn(int fd,
 		goto single_sock;
 	}
 
-	is_single = 0;
+	if (parent_hndl->base.proto == XIO_PROTO_SHM) {
+		ERROR_LOG("shm supports single socket connections only\n");
+		goto cleanup1;
+	}
 
-	list_for_each_entry_safe(pconn, next_pconn,
-				 &parent_hndl->pending_conns,
-				 conns_list_entry) {
-		if (pconn->waiting_for_bytes)
-			continue;
+	is_single = 0;
 
-		if (pconn->sa.sa.sa_family == AF_INET) {
-			if ((pconn->msg.second_port ==
-			    ntohs(pending_conn->sa.sa_in.sin_port)) &&
-			    (pconn->sa.sa_in.sin_addr.s_addr ==
-			    pending_conn->sa.sa_in.sin_addr.s_addr)) {
-				matching_conn = pconn;
-				if (ntohs(matching_conn->sa.sa_in.sin_port) !=
-				    pending_conn->msg.second_port) {
-					ERROR_LOG("ports mismatch\n");
-					return;
-				}
-				break;
-			}
-		} else if (pconn->sa.sa.sa_family == AF_INET6) {
-			if ((pconn->msg.second_port ==
-			     ntohs(pending_conn->sa.sa_in6.sin6_port)) &&
-			     !memcmp(&pconn->sa.sa_in6.sin6_addr,
-				     &pending_conn->sa.sa_in6.sin6_addr,
-				     sizeof(pconn->sa.sa_in6.sin6_addr))) {
+	if (parent_hndl->shard_group) {
+		/* the sibling may have been accepted by another shard */
+		matching_conn = xio_tcp_shard_pending_conn(parent_hndl,
+							   pending_conn);
+		detached = 1;
+	} else {
+		list_for_each_entry_safe(pconn, next_pconn,
+					 &parent_hndl->pending_conns,
+					 conns_list_entry) {
+			if (pconn->waiting_for_bytes)
+				continue;
+			retval = xio_tcp_pending_conn_match(pconn,
+							    pending_conn);
+			if (retval < 0)
+				return;
+			if (retval) {
 				matching_conn = pconn;
-				if (ntohs(matching_conn->sa.sa_in6.sin6_port)
-				    != pending_conn->msg.second_port) {
-					ERROR_LOG("ports mismatch\n");
-					return;
-				}
 				break;
 			}
-		} else {
-			ERROR_LOG("unknown family %d\n",
-				  pconn->sa.sa.sa_family);
 		}
 	}
 
@@ -1022,23 +1462,29 @@ void xio_tcp_handle_pending_conn(int fd,
 	cfd = ctl_conn->fd;
 	dfd = data_conn->fd;
 
-	retval = xio_context_del_ev_handler(parent_hndl->base.ctx,
-					    data_conn->fd);
-	list_del(&data_conn->conns_list_entry);
-	if (retval) {
-		ERROR_LOG("removing connection handler failed.(errno=%d %m)\n",
-			  xio_get_last_socket_error());
+	if (!detached) {
+		retval = xio_context_del_ev_handler(parent_hndl->base.ctx,
+						    data_conn->fd);
+		list_del(&data_conn->conns_list_entry);
+		if (retval) {
+			ERROR_LOG(
+			"removing connection handler failed.(errno=%d %m)\n",
+			xio_get_last_socket_error());
+		}
 	}
 	ufree(data_conn);
 
 single_sock:
 
-	list_del(&ctl_conn->conns_list_entry);
-	retval = xio_context_del_ev_handler(parent_hndl->base.ctx,
-					    ctl_conn->fd);
-	if (retval) {
-		ERROR_LOG("removing connection handler failed.(errno=%d %m)\n",
-			  xio_get_last_socket_error());
+	if (!detached) {
+		list_del(&ctl_conn->conns_list_entry);
+		retval = xio_context_del_ev_handler(parent_hndl->base.ctx,
+						    ctl_conn->fd);
+		if (retval) {
+			ERROR_LOG(
+			"removing connection handler failed.(errno=%d %m)\n",
+			xio_get_last_socket_error());
+		}
 	}
 
 	child_hndl = xio_tcp_transport_create(parent_hndl->transport,
@@ -1049,6 +1495,7 @@ single_sock:
 		ERROR_LOG("failed to create tcp child\n");
 		xio_transport_notify_observer_error(&parent_hndl->base,
 						    xio_errno());
+		xio_tcp_shm_close_fds(ctl_conn->shm_fds, ctl_conn->shm_nfds);
 		ufree(ctl_conn);
 		goto cleanup3;
 	}
@@ -1056,9 +1503,23 @@ single_sock:
 	memcpy(&child_hndl->base.peer_addr,
 	       &ctl_conn->sa.sa_stor,
 	       sizeof(child_hndl->base.peer_addr));
+	memcpy(shm_fds, ctl_conn->shm_fds, sizeof(shm_fds));
+	shm_nfds = ctl_conn->shm_nfds;
 	ufree(ctl_conn);
 
-	if (is_single) {
+	if (child_hndl->base.proto == XIO_PROTO_SHM) {
+		child_hndl->sock.cfd = fd;
+		child_hndl->sock.dfd = fd;
+		memcpy(child_hndl->sock.ops, &shm_sock_ops,
+		       sizeof(*child_hndl->sock.ops));
+		if (shm_nfds != XIO_TCP_SHM_NFDS) {
+			ERROR_LOG("shm connect message without descriptors\n");
+			xio_tcp_shm_close_fds(shm_fds, shm_nfds);
+			goto cleanup3;
+		}
+		if (xio_tcp_shm_channel_attach(&child_hndl->sock, shm_fds))
+			goto cleanup3;
+	} else if (is_single) {
 		child_hndl->sock.cfd = fd;
 		child_hndl->sock.dfd = fd;
 		memcpy(child_hndl->sock.ops, &single_sock_ops,
@@ -1069,16 +1530,11 @@ single_sock:
 		child_hndl->sock.dfd = dfd;
 		memcpy(child_hndl->sock.ops, &dual_sock_ops,
 		       sizeof(*child_hndl->sock.ops));
-
-		child_hndl->tmp_rx_buf = ucalloc(1, TMP_RX_BUF_SIZE);
-		if (!child_hndl->tmp_rx_buf) {
-			xio_set_error(ENOMEM);
-			ERROR_LOG("ucalloc failed. %m\n");
-			goto cleanup3;
-		}
-		child_hndl->tmp_rx_buf_cur = child_hndl->tmp_rx_buf;
 	}
 
+	if (xio_tcp_rx_ring_init(child_hndl))
+		goto cleanup3;
+
 	len = sizeof(child_hndl->base.local_addr);
 	retval = getsockname(child_hndl->sock.cfd,
 			     (struct sockaddr *)&child_hndl->base.local_addr,
@@ -1100,6 +1556,7 @@ single_sock:
 	return;
 
 cleanup1:
+	xio_tcp_shm_close_fds(pending_conn->shm_fds, pending_conn->shm_nfds);
 	list_del(&pending_conn->conns_list_entry);
 	ufree(pending_conn);
 cleanup2:
@@ -1227,6 +1684,19 @@ static int xio_tcp_listen(struct xio_transport_base *transport,
 	}
 	tcp_hndl->base.is_client = 0;
 
+	if (test_bits(XIO_TRANSPORT_ATTR_REUSEPORT,
+		      &tcp_hndl->trans_attr_mask) &&
+	    tcp_hndl->trans_attr.reuseport) {
+		retval = 1;
+		if (setsockopt(tcp_hndl->sock.cfd, SOL_SOCKET, SO_REUSEPORT,
+			       (char *)&retval, sizeof(retval))) {
+			xio_set_error(xio_get_last_socket_error());
+			ERROR_LOG("setsockopt SO_REUSEPORT failed. (errno=%d %m)\n",
+				  xio_get_last_socket_error());
+			goto exit1;
+		}
+	}
+
 	/* bind */
 	retval = bind(tcp_hndl->sock.cfd,
 		      (struct sockaddr *)&sa.sa_stor,
@@ -1288,6 +1758,12 @@ static int xio_tcp_listen(struct xio_transport_base *transport,
 	if (src_port)
 		*src_port = sport;
 
+	if (test_bits(XIO_TRANSPORT_ATTR_REUSEPORT,
+		      &tcp_hndl->trans_attr_mask) &&
+	    tcp_hndl->trans_attr.reuseport &&
+	    xio_tcp_shard_group_join(tcp_hndl, &sa, sa_len))
+		goto exit;
+
 	tcp_hndl->state = XIO_TRANSPORT_STATE_LISTEN;
 	DEBUG_LOG("listen on [%s] src_port:%d\n", portal_uri, sport);
 
@@ -1345,6 +1821,7 @@ void xio_tcp_conn_established_helper(int fd,
 			  xio_get_last_socket_error());
 		goto cleanup;
 	}
+	xio_tcp_zerocopy_enable(tcp_hndl);
 
 	len = sizeof(tcp_hndl->base.peer_addr);
 	retval = getpeername(tcp_hndl->sock.cfd,
@@ -1584,14 +2061,6 @@ int xio_tcp_dual_sock_connect(struct xio_tcp_transport *tcp_hndl,
 {
 	int retval;
 
-	tcp_hndl->tmp_rx_buf = ucalloc(1, TMP_RX_BUF_SIZE);
-	if (!tcp_hndl->tmp_rx_buf) {
-		xio_set_error(ENOMEM);
-		ERROR_LOG("ucalloc failed. %m\n");
-		return -1;
-	}
-	tcp_hndl->tmp_rx_buf_cur = tcp_hndl->tmp_rx_buf;
-
 	retval = xio_tcp_connect_helper(tcp_hndl->sock.cfd, sa, sa_len,
 					&tcp_hndl->sock.port_cfd,
 					&tcp_hndl->base.local_addr);
@@ -1671,6 +2140,10 @@ static int xio_tcp_connect(struct xio_transport_base *transport,
 		}
 	}
 
+	retval = xio_tcp_rx_ring_init(tcp_hndl);
+	if (retval)
+		goto exit;
+
 	/* connect */
 	retval = tcp_hndl->sock.ops->connect(tcp_hndl,
 					     (struct sockaddr *)&rsa.sa_stor,
@@ -1758,6 +2231,8 @@ static int xio_set_cpu_latency(int *fd)
 static void xio_tcp_init(void)
 {
 	spin_lock_init(&mngmt_lock);
+	spin_lock_init(&shard_lock);
+	spin_lock_init(&scratch_lock);
 
 	/* set cpu latency until process is down */
 	xio_set_cpu_latency(&cdl_fd);
@@ -2401,6 +2876,14 @@ static int xio_tcp_set_opt(void *xio_obj,
 		VALIDATE_SZ(sizeof(int));
 		tcp_options.tcp_dual_sock = *((int *)optval);
 		return 0;
+	case XIO_OPTNAME_TCP_ZEROCOPY_THRESHOLD:
+		VALIDATE_SZ(sizeof(int));
+		tcp_options.tcp_zerocopy_threshold = *((int *)optval);
+		return 0;
+	case XIO_OPTNAME_TCP_RX_RING_SIZE:
+		VALIDATE_SZ(sizeof(int));
+		tcp_options.tcp_rx_ring_size = *((int *)optval);
+		return 0;
 	default:
 		break;
 	}
@@ -2451,6 +2934,18 @@ static int xio_tcp_get_opt(void  *xio_obj,
 		*((int *)optval) = tcp_options.tcp_dual_sock;
 		*optlen = sizeof(int);
 		return 0;
+	case XIO_OPTNAME_TCP_ZEROCOPY_THRESHOLD:
+		*((int *)optval) = tcp_options.tcp_zerocopy_threshold;
+		*optlen = sizeof(int);
+		return 0;
+	case XIO_OPTNAME_TCP_RX_RING_SIZE:
+		*((int *)optval) = tcp_options.tcp_rx_ring_size;
+		*optlen = sizeof(int);
+		return 0;
+	case XIO_OPTNAME_TCP_ZEROCOPY_STATS:
+		memcpy(optval, &tcp_zc_stats, sizeof(tcp_zc_stats));
+		*optlen = sizeof(tcp_zc_stats);
+		return 0;
 	default:
 		break;
 	}
@@ -2590,6 +3085,9 @@ static void init_single_sock_ops(void)
 	single_sock_ops.rx_data_handler = xio_tcp_rx_data_handler;
 	single_sock_ops.shutdown = xio_tcp_single_sock_shutdown;
 	single_sock_ops.close = xio_tcp_single_sock_close;
+	single_sock_ops.sendmsg = xio_tcp_sock_sendmsg;
+	single_sock_ops.recvmsg = xio_tcp_sock_recvmsg;
+	single_sock_ops.wait_writable = xio_tcp_sock_wait_writable;
 };
 
 /*---------------------------------------------------------------------------*/
@@ -2606,6 +3104,28 @@ static void init_dual_sock_ops(void)
 	dual_sock_ops.rx_data_handler = xio_tcp_rx_data_handler;
 	dual_sock_ops.shutdown = xio_tcp_dual_sock_shutdown;
 	dual_sock_ops.close = xio_tcp_dual_sock_close;
+	dual_sock_ops.sendmsg = xio_tcp_sock_sendmsg;
+	dual_sock_ops.recvmsg = xio_tcp_sock_recvmsg;
+	dual_sock_ops.wait_writable = xio_tcp_sock_wait_writable;
+};
+
+/*---------------------------------------------------------------------------*/
+static void init_shm_sock_ops(void)
+{
+	shm_sock_ops.open = xio_tcp_shm_sock_create;
+	shm_sock_ops.add_ev_handlers = xio_tcp_shm_sock_add_ev_handlers;
+	shm_sock_ops.del_ev_handlers = xio_tcp_shm_sock_del_ev_handlers;
+	shm_sock_ops.connect = xio_tcp_shm_sock_connect;
+	shm_sock_ops.set_txd = xio_tcp_single_sock_set_txd;
+	shm_sock_ops.set_rxd = xio_tcp_single_sock_set_rxd;
+	shm_sock_ops.rx_ctl_work = xio_tcp_recvmsg_work;
+	shm_sock_ops.rx_ctl_handler = xio_tcp_single_sock_rx_ctl_handler;
+	shm_sock_ops.rx_data_handler = xio_tcp_rx_data_handler;
+	shm_sock_ops.shutdown = xio_tcp_shm_sock_shutdown;
+	shm_sock_ops.close = xio_tcp_shm_sock_close;
+	shm_sock_ops.sendmsg = xio_tcp_shm_sock_sendmsg;
+	shm_sock_ops.recvmsg = xio_tcp_shm_sock_recvmsg;
+	shm_sock_ops.wait_writable = xio_tcp_shm_sock_wait_writable;
 };
 
 struct xio_transport xio_tcp_transport;
@@ -2632,6 +3152,7 @@ static void init_xio_tcp_transport(void)
 	xio_tcp_transport.get_opt = xio_tcp_get_opt;
 	xio_tcp_transport.cancel_req = xio_tcp_cancel_req;
 	xio_tcp_transport.cancel_rsp = xio_tcp_cancel_rsp;
+	xio_tcp_transport.tx_backlog = xio_tcp_tx_backlog;
 	xio_tcp_transport.get_pools_setup_ops = xio_tcp_get_pools_ops;
 	xio_tcp_transport.set_pools_cls = xio_tcp_set_pools_cls;
 
@@ -2641,6 +3162,18 @@ static void init_xio_tcp_transport(void)
 						xio_tcp_is_valid_out_msg;
 }
 
+struct xio_transport xio_shm_transport;
+/*---------------------------------------------------------------------------*/
+static void init_xio_shm_transport(void)
+{
+	/* same framing and task pools as tcp - only the wire differs */
+	memcpy(&xio_shm_transport, &xio_tcp_transport,
+	       sizeof(xio_shm_transport));
+	xio_shm_transport.name = "shm";
+	xio_shm_transport.connect = xio_tcp_shm_connect;
+	xio_shm_transport.listen = xio_tcp_shm_listen;
+}
+
 /*---------------------------------------------------------------------------*/
 static void init_static_structs(void)
 {
@@ -2648,7 +3181,9 @@ static void init_static_structs(void)
 	init_primary_tasks_pool_ops();
 	init_single_sock_ops();
 	init_dual_sock_ops();
+	init_shm_sock_ops();
 	init_xio_tcp_transport();
+	init_xio_shm_transport();
 }
 
 /*---------------------------------------------------------------------------*/
@@ -2659,3 +3194,12 @@ struct xio_transport *xio_tcp_get_transport_func_list(void)
 	init_static_structs();
 	return &xio_tcp_transport;
 }
+
+/*---------------------------------------------------------------------------*/
+/* xio_shm_get_transport_func_list					     */
+/*---------------------------------------------------------------------------*/
+struct xio_transport *xio_shm_get_transport_func_list(void)
+{
+	init_static_structs();
+	return &xio_shm_transport;
+}
@@ -0,0 +1,956 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <xio_predefs.h>
+#include <xio_env.h>
+#include <xio_os.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include "libxio.h"
+#include "xio_log.h"
+#include "xio_common.h"
+#include "xio_observer.h"
+#include "xio_protocol.h"
+#include "xio_mbuf.h"
+#include "xio_task.h"
+#include "xio_mempool.h"
+#include "xio_sg_table.h"
+#include "xio_transport.h"
+#include "xio_usr_transport.h"
+#include "xio_ev_data.h"
+#include "xio_objpool.h"
+#include "xio_workqueue.h"
+#include "xio_context.h"
+#include "xio_tcp_transport.h"
+#include "xio_tcp_shm.h"
+
+#define XIO_TCP_SHM_RING_LEN	(sizeof(struct xio_tcp_shm_ring) + \
+				 XIO_TCP_SHM_RING_SIZE)
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_ring_data						     */
+/*---------------------------------------------------------------------------*/
+static inline char *xio_tcp_shm_ring_data(struct xio_tcp_shm_ring *ring)
+{
+	return (char *)(ring + 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_ring_used						     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t xio_tcp_shm_ring_used(struct xio_tcp_shm_ring *ring)
+{
+	return ring->tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_ring_write						     */
+/* the indices live in memory the peer can write: the ring size is the	     */
+/* one validated at setup and an occupancy beyond it fails the channel	     */
+/*---------------------------------------------------------------------------*/
+static ssize_t xio_tcp_shm_ring_write(struct xio_tcp_shm_ring *ring,
+				      uint64_t size,
+				      const struct iovec *iov, size_t iovlen)
+{
+	char		*data = xio_tcp_shm_ring_data(ring);
+	uint64_t	tail = ring->tail;
+	uint64_t	used = xio_tcp_shm_ring_used(ring);
+	uint64_t	room;
+	size_t		done = 0, n, first, off, i;
+
+	if (unlikely(used > size)) {
+		ERROR_LOG("shm ring corrupted. used:%" PRIu64 " size:%" PRIu64
+			  "\n", used, size);
+		return -1;
+	}
+	room = size - used;
+
+	for (i = 0; i < iovlen && room; i++) {
+		n = min(iov[i].iov_len, (size_t)room);
+		off = tail & (size - 1);
+		first = min(n, (size_t)(size - off));
+		memcpy(data + off, iov[i].iov_base, first);
+		memcpy(data, (char *)iov[i].iov_base + first, n - first);
+		tail += n;
+		room -= n;
+		done += n;
+	}
+	if (done)
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+	return done;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_ring_read						     */
+/*---------------------------------------------------------------------------*/
+static ssize_t xio_tcp_shm_ring_read(struct xio_tcp_shm_ring *ring,
+				     uint64_t size,
+				     const struct iovec *iov, size_t iovlen)
+{
+	char		*data = xio_tcp_shm_ring_data(ring);
+	uint64_t	head = ring->head;
+	uint64_t	avail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) -
+				head;
+	size_t		done = 0, n, first, off, i;
+
+	if (unlikely(avail > size)) {
+		ERROR_LOG("shm ring corrupted. avail:%" PRIu64
+			  " size:%" PRIu64 "\n", avail, size);
+		return -1;
+	}
+
+	for (i = 0; i < iovlen && avail; i++) {
+		n = min(iov[i].iov_len, (size_t)avail);
+		off = head & (size - 1);
+		first = min(n, (size_t)(size - off));
+		memcpy(iov[i].iov_base, data + off, first);
+		memcpy((char *)iov[i].iov_base + first, data, n - first);
+		head += n;
+		avail -= n;
+		done += n;
+	}
+	if (done)
+		__atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+
+	return done;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_doorbell							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_tcp_shm_doorbell(int efd)
+{
+	if (eventfd_write(efd, 1) && errno != EAGAIN)
+		ERROR_LOG("eventfd_write failed. (errno=%d %m)\n", errno);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_uri_to_sun						     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_shm_uri_to_sun(const char *uri, struct sockaddr_storage *ss)
+{
+	struct sockaddr_un	*sun = (struct sockaddr_un *)ss;
+	char			portal[256];
+	const char		*name;
+	size_t			len;
+
+	if (xio_uri_get_portal(uri, portal, sizeof(portal)) != 0)
+		return -1;
+
+	name = strstr(portal, "://");
+	if (!name)
+		return -1;
+	name += 3;
+
+	/* abstract namespace: leading nul, prefix, then the portal name */
+	len = strlen(name);
+	if (!len ||
+	    len + sizeof(XIO_TCP_SHM_NAME_PREFIX) > sizeof(sun->sun_path))
+		return -1;
+
+	memset(sun, 0, sizeof(*sun));
+	sun->sun_family = AF_UNIX;
+	memcpy(sun->sun_path + 1, XIO_TCP_SHM_NAME_PREFIX,
+	       sizeof(XIO_TCP_SHM_NAME_PREFIX) - 1);
+	memcpy(sun->sun_path + sizeof(XIO_TCP_SHM_NAME_PREFIX), name, len);
+
+	return offsetof(struct sockaddr_un, sun_path) +
+	       sizeof(XIO_TCP_SHM_NAME_PREFIX) + len;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_close_fds						     */
+/*---------------------------------------------------------------------------*/
+void xio_tcp_shm_close_fds(int *fds, int nfds)
+{
+	int i;
+
+	for (i = 0; i < nfds; i++)
+		close(fds[i]);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_channel_create						     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_shm_channel_create(struct xio_tcp_socket *sock,
+			       int fds[XIO_TCP_SHM_NFDS])
+{
+	struct xio_tcp_shm_channel	*chan;
+	struct xio_tcp_shm_ring		*c2s, *s2c;
+	int				memfd;
+
+	chan = (struct xio_tcp_shm_channel *)ucalloc(1, sizeof(*chan));
+	if (!chan) {
+		xio_set_error(ENOMEM);
+		ERROR_LOG("ucalloc failed. %m\n");
+		return -1;
+	}
+	chan->rx_efd = -1;
+	chan->tx_efd = -1;
+	chan->map_len = 2 * XIO_TCP_SHM_RING_LEN;
+
+	memfd = memfd_create("xio-shm", MFD_CLOEXEC);
+	if (memfd < 0) {
+		xio_set_error(errno);
+		ERROR_LOG("memfd_create failed. (errno=%d %m)\n", errno);
+		goto cleanup;
+	}
+	if (ftruncate(memfd, chan->map_len)) {
+		xio_set_error(errno);
+		ERROR_LOG("ftruncate failed. (errno=%d %m)\n", errno);
+		goto cleanup1;
+	}
+	chan->map = mmap(NULL, chan->map_len, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, memfd, 0);
+	if (chan->map == MAP_FAILED) {
+		xio_set_error(errno);
+		ERROR_LOG("mmap failed. (errno=%d %m)\n", errno);
+		chan->map = NULL;
+		goto cleanup1;
+	}
+
+	chan->rx_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	chan->tx_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (chan->rx_efd < 0 || chan->tx_efd < 0) {
+		xio_set_error(errno);
+		ERROR_LOG("eventfd failed. (errno=%d %m)\n", errno);
+		goto cleanup2;
+	}
+
+	c2s = (struct xio_tcp_shm_ring *)chan->map;
+	s2c = (struct xio_tcp_shm_ring *)sum_to_ptr(chan->map,
+						    XIO_TCP_SHM_RING_LEN);
+	c2s->size = XIO_TCP_SHM_RING_SIZE;
+	s2c->size = XIO_TCP_SHM_RING_SIZE;
+	c2s->rx_armed = 1;
+	s2c->rx_armed = 1;
+
+	chan->tx = c2s;
+	chan->rx = s2c;
+	chan->ring_size = XIO_TCP_SHM_RING_SIZE;
+	sock->shm = chan;
+
+	fds[0] = memfd;
+	fds[1] = chan->rx_efd;
+	fds[2] = chan->tx_efd;
+
+	return 0;
+
+cleanup2:
+	if (chan->rx_efd >= 0)
+		close(chan->rx_efd);
+	if (chan->tx_efd >= 0)
+		close(chan->tx_efd);
+	munmap(chan->map, chan->map_len);
+cleanup1:
+	close(memfd);
+cleanup:
+	ufree(chan);
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_channel_attach						     */
+/* consumes the descriptors received from the connecting peer		     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_shm_channel_attach(struct xio_tcp_socket *sock,
+			       int fds[XIO_TCP_SHM_NFDS])
+{
+	struct xio_tcp_shm_channel	*chan;
+	struct xio_tcp_shm_ring		*c2s;
+	struct stat			st;
+	uint64_t			size;
+
+	chan = (struct xio_tcp_shm_channel *)ucalloc(1, sizeof(*chan));
+	if (!chan) {
+		xio_set_error(ENOMEM);
+		ERROR_LOG("ucalloc failed. %m\n");
+		goto cleanup;
+	}
+
+	if (fstat(fds[0], &st)) {
+		xio_set_error(errno);
+		ERROR_LOG("fstat failed. (errno=%d %m)\n", errno);
+		goto cleanup;
+	}
+	chan->map_len = st.st_size;
+	if (chan->map_len < 2 * sizeof(struct xio_tcp_shm_ring)) {
+		xio_set_error(EINVAL);
+		ERROR_LOG("shm segment too small %zd\n", chan->map_len);
+		goto cleanup;
+	}
+	chan->map = mmap(NULL, chan->map_len, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, fds[0], 0);
+	if (chan->map == MAP_FAILED) {
+		xio_set_error(errno);
+		ERROR_LOG("mmap failed. (errno=%d %m)\n", errno);
+		chan->map = NULL;
+		goto cleanup;
+	}
+
+	c2s = (struct xio_tcp_shm_ring *)chan->map;
+	size = c2s->size;
+	if (!is_power_of_2(size) ||
+	    chan->map_len != 2 * (sizeof(struct xio_tcp_shm_ring) + size)) {
+		xio_set_error(EINVAL);
+		ERROR_LOG("invalid shm ring size %" PRIu64 "\n", size);
+		goto cleanup;
+	}
+
+	chan->rx = c2s;
+	chan->tx = (struct xio_tcp_shm_ring *)sum_to_ptr(
+			chan->map, sizeof(struct xio_tcp_shm_ring) + size);
+	if (chan->tx->size != size) {
+		xio_set_error(EINVAL);
+		ERROR_LOG("shm rings size mismatch\n");
+		goto cleanup;
+	}
+	chan->ring_size = size;
+	chan->rx_efd = fds[2];
+	chan->tx_efd = fds[1];
+	close(fds[0]);
+
+	sock->shm = chan;
+
+	return 0;
+
+cleanup:
+	if (chan && chan->map)
+		munmap(chan->map, chan->map_len);
+	ufree(chan);
+	xio_tcp_shm_close_fds(fds, XIO_TCP_SHM_NFDS);
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_channel_destroy						     */
+/*---------------------------------------------------------------------------*/
+void xio_tcp_shm_channel_destroy(struct xio_tcp_socket *sock)
+{
+	struct xio_tcp_shm_channel *chan = sock->shm;
+
+	if (!chan)
+		return;
+
+	sock->shm = NULL;
+	munmap(chan->map, chan->map_len);
+	close(chan->rx_efd);
+	close(chan->tx_efd);
+	ufree(chan);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_send_connect_msg						     */
+/*---------------------------------------------------------------------------*/
+static int xio_tcp_shm_send_connect_msg(int fd,
+					struct xio_tcp_connect_msg *msg,
+					int fds[XIO_TCP_SHM_NFDS])
+{
+	struct xio_tcp_connect_msg	smsg;
+	union {
+		struct cmsghdr		align;
+		char			buf[CMSG_SPACE(sizeof(int) *
+						       XIO_TCP_SHM_NFDS)];
+	} ctl;
+	struct iovec			iov;
+	struct msghdr			mh;
+	struct cmsghdr			*cmsg;
+	ssize_t				retval;
+
+	smsg.sock_type = (enum xio_tcp_sock_type)
+				htonl((uint32_t)msg->sock_type);
+	PACK_SVAL(msg, &smsg, second_port);
+	PACK_SVAL(msg, &smsg, pad);
+
+	iov.iov_base = &smsg;
+	iov.iov_len = sizeof(smsg);
+
+	memset(&mh, 0, sizeof(mh));
+	memset(&ctl, 0, sizeof(ctl));
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = ctl.buf;
+	mh.msg_controllen = sizeof(ctl.buf);
+
+	cmsg = CMSG_FIRSTHDR(&mh);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int) * XIO_TCP_SHM_NFDS);
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * XIO_TCP_SHM_NFDS);
+
+	retval = sendmsg(fd, &mh, MSG_NOSIGNAL);
+	if (retval != (ssize_t)sizeof(smsg)) {
+		xio_set_error(retval < 0 ? errno : EIO);
+		ERROR_LOG("sendmsg failed. (errno=%d %m)\n", errno);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_recv_connect_msg						     */
+/*---------------------------------------------------------------------------*/
+ssize_t xio_tcp_shm_recv_connect_msg(int fd, void *buf, size_t len,
+				     int *fds, int *nfds)
+{
+	union {
+		struct cmsghdr		align;
+		char			buf[CMSG_SPACE(sizeof(int) *
+						       XIO_TCP_SHM_NFDS)];
+	} ctl;
+	struct iovec			iov;
+	struct msghdr			mh;
+	struct cmsghdr			*cmsg;
+	ssize_t				retval;
+	int				*cfds;
+	int				i, n;
+
+	iov.iov_base = buf;
+	iov.iov_len = len;
+
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = ctl.buf;
+	mh.msg_controllen = sizeof(ctl.buf);
+
+	retval = recvmsg(fd, &mh, MSG_CMSG_CLOEXEC);
+	if (retval <= 0)
+		return retval;
+
+	for (cmsg = CMSG_FIRSTHDR(&mh); cmsg; cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+		    cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+		cfds = (int *)CMSG_DATA(cmsg);
+		n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (i = 0; i < n; i++) {
+			if (*nfds < XIO_TCP_SHM_NFDS)
+				fds[(*nfds)++] = cfds[i];
+			else
+				close(cfds[i]);
+		}
+	}
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_sock_create						     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_shm_sock_create(struct xio_tcp_socket *sock)
+{
+	sock->cfd = xio_socket_non_blocking(AF_UNIX, SOCK_STREAM, 0);
+	if (sock->cfd < 0) {
+		xio_set_error(xio_get_last_socket_error());
+		ERROR_LOG("create socket failed. (errno=%d %m)\n",
+			  xio_get_last_socket_error());
+		return -1;
+	}
+	sock->dfd = sock->cfd;
+	sock->shm = NULL;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_sock_ev_handler						     */
+/*---------------------------------------------------------------------------*/
+static void xio_tcp_shm_sock_ev_handler(int fd, int events,
+					void *user_context)
+{
+	struct xio_tcp_transport	*tcp_hndl = (struct xio_tcp_transport *)
+							user_context;
+
+	if (events & (XIO_POLLHUP | XIO_POLLRDHUP | XIO_POLLERR)) {
+		DEBUG_LOG("epoll returned with error events=%d for fd=%d\n",
+			  events, fd);
+		/* consume what the peer wrote before going away */
+		if (tcp_hndl->sock.shm)
+			xio_tcp_consume_ctl_rx(tcp_hndl);
+		xio_tcp_disconnect_helper(tcp_hndl);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_ready_ev_handler						     */
+/*---------------------------------------------------------------------------*/
+static void xio_tcp_shm_ready_ev_handler(int fd, int events,
+					 void *user_context)
+{
+	struct xio_tcp_transport	*tcp_hndl = (struct xio_tcp_transport *)
+							user_context;
+	struct xio_tcp_shm_channel	*chan = tcp_hndl->sock.shm;
+	eventfd_t			val;
+
+	if (!(events & XIO_POLLIN))
+		return;
+
+	(void)eventfd_read(fd, &val);
+
+	if (chan->tx_wanted) {
+		chan->tx_wanted = 0;
+		xio_tcp_xmit(tcp_hndl);
+	}
+
+	xio_tcp_consume_ctl_rx(tcp_hndl);
+
+	chan = tcp_hndl->sock.shm;
+	if (!chan)
+		return;
+
+	/* rearm the doorbell; data that slipped in keeps it raised */
+	__atomic_store_n(&chan->rx->rx_armed, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&chan->rx->tail, __ATOMIC_SEQ_CST) !=
+	    chan->rx->head)
+		xio_tcp_shm_doorbell(fd);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_sock_add_ev_handlers					     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_shm_sock_add_ev_handlers(struct xio_tcp_transport *tcp_hndl)
+{
+	int retval;
+
+	/* the socket only carries hangups from now on */
+	retval = xio_context_add_ev_handler(
+			tcp_hndl->base.ctx,
+			tcp_hndl->sock.cfd,
+			XIO_POLLRDHUP,
+			xio_tcp_shm_sock_ev_handler,
+			tcp_hndl);
+	if (retval) {
+		ERROR_LOG("setting connection handler failed. (errno=%d %m)\n",
+			  xio_get_last_socket_error());
+		return retval;
+	}
+	tcp_hndl->in_epoll[0] = 1;
+
+	retval = xio_context_add_ev_handler(
+			tcp_hndl->base.ctx,
+			tcp_hndl->sock.shm->rx_efd,
+			XIO_POLLIN,
+			xio_tcp_shm_ready_ev_handler,
+			tcp_hndl);
+	if (retval) {
+		ERROR_LOG("setting doorbell handler failed. (errno=%d %m)\n",
+			  xio_get_last_socket_error());
+		(void)xio_context_del_ev_handler(tcp_hndl->base.ctx,
+						 tcp_hndl->sock.cfd);
+		tcp_hndl->in_epoll[0] = 0;
+		return retval;
+	}
+	tcp_hndl->in_epoll[1] = 1;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_sock_del_ev_handlers					     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_shm_sock_del_ev_handlers(struct xio_tcp_transport *tcp_hndl)
+{
+	int retval1 = 0, retval2 = 0;
+
+	if (tcp_hndl->in_epoll[0]) {
+		retval1 = xio_context_del_ev_handler(tcp_hndl->base.ctx,
+						     tcp_hndl->sock.cfd);
+		if (retval1) {
+			ERROR_LOG("tcp_hndl:%p fd=%d del_ev_handler failed, %m\n",
+				  tcp_hndl, tcp_hndl->sock.cfd);
+		}
+		tcp_hndl->in_epoll[0] = 0;
+	}
+	if (tcp_hndl->in_epoll[1] && tcp_hndl->sock.shm) {
+		retval2 = xio_context_del_ev_handler(tcp_hndl->base.ctx,
+						     tcp_hndl->sock.shm->rx_efd);
+		if (retval2) {
+			ERROR_LOG("tcp_hndl:%p fd=%d del_ev_handler failed, %m\n",
+				  tcp_hndl, tcp_hndl->sock.shm->rx_efd);
+		}
+		tcp_hndl->in_epoll[1] = 0;
+	}
+
+	return retval1 | retval2;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_conn_established_ev_handler				     */
+/*---------------------------------------------------------------------------*/
+static void xio_tcp_shm_conn_established_ev_handler(int fd, int events,
+						    void *user_context)
+{
+	struct xio_tcp_transport	*tcp_hndl = (struct xio_tcp_transport *)
+							user_context;
+	struct xio_tcp_connect_msg	msg;
+	int				fds[XIO_TCP_SHM_NFDS];
+	int				retval;
+	int				so_error = 0;
+	socklen_t			len = sizeof(so_error);
+
+	/* remove from epoll */
+	retval = xio_context_del_ev_handler(tcp_hndl->base.ctx,
+					    tcp_hndl->sock.cfd);
+	if (retval) {
+		ERROR_LOG("removing connection handler failed.(errno=%d %m)\n",
+			  xio_get_last_socket_error());
+		goto cleanup;
+	}
+
+	retval = getsockopt(tcp_hndl->sock.cfd, SOL_SOCKET, SO_ERROR,
+			    (char *)&so_error, &len);
+	if (retval)
+		so_error = xio_get_last_socket_error();
+	if (so_error ||
+	    (events & (XIO_POLLERR | XIO_POLLHUP | XIO_POLLRDHUP))) {
+		DEBUG_LOG("fd=%d connection establishment failed\n",
+			  tcp_hndl->sock.cfd);
+		DEBUG_LOG("so_error=%d, epoll_events=%d\n", so_error, events);
+		tcp_hndl->sock.ops->del_ev_handlers = NULL;
+		goto cleanup;
+	}
+
+	if (xio_tcp_shm_channel_create(&tcp_hndl->sock, fds)) {
+		tcp_hndl->sock.ops->del_ev_handlers = NULL;
+		goto cleanup;
+	}
+
+	/* add to epoll */
+	retval = tcp_hndl->sock.ops->add_ev_handlers(tcp_hndl);
+	if (retval) {
+		close(fds[0]);
+		goto cleanup;
+	}
+
+	len = sizeof(tcp_hndl->base.peer_addr);
+	retval = getpeername(tcp_hndl->sock.cfd,
+			     (struct sockaddr *)&tcp_hndl->base.peer_addr,
+			     &len);
+	if (retval) {
+		xio_set_error(xio_get_last_socket_error());
+		ERROR_LOG("getpeername failed. (errno=%d %m)\n",
+			  xio_get_last_socket_error());
+	}
+	tcp_hndl->state = XIO_TRANSPORT_STATE_CONNECTING;
+
+	msg.sock_type = XIO_TCP_SINGLE_SOCK;
+	msg.second_port = 0;
+	msg.pad = 0;
+	retval = xio_tcp_shm_send_connect_msg(tcp_hndl->sock.cfd, &msg, fds);
+	/* the peer holds its own reference to the segment now */
+	close(fds[0]);
+	if (retval)
+		goto cleanup;
+
+	xio_transport_notify_observer(&tcp_hndl->base,
+				      XIO_TRANSPORT_EVENT_ESTABLISHED,
+				      NULL);
+
+	return;
+
+cleanup:
+	if  (so_error == XIO_ECONNREFUSED)
+		xio_transport_notify_observer(&tcp_hndl->base,
+					      XIO_TRANSPORT_EVENT_REFUSED,
+					      NULL);
+	else
+		xio_transport_notify_observer_error(&tcp_hndl->base,
+						    so_error ? so_error :
+						    XIO_E_CONNECT_ERROR);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_sock_connect						     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_shm_sock_connect(struct xio_tcp_transport *tcp_hndl,
+			     struct sockaddr *sa, socklen_t sa_len)
+{
+	int retval;
+
+	retval = connect(tcp_hndl->sock.cfd, sa, sa_len);
+	if (retval && xio_get_last_socket_error() != XIO_EINPROGRESS) {
+		xio_set_error(xio_get_last_socket_error());
+		ERROR_LOG("shm connect failed. (errno=%d %m)\n",
+			  xio_get_last_socket_error());
+		return retval;
+	}
+
+	/* add to epoll */
+	retval = xio_context_add_ev_handler(
+			tcp_hndl->base.ctx,
+			tcp_hndl->sock.cfd,
+			XIO_POLLOUT | XIO_POLLRDHUP,
+			xio_tcp_shm_conn_established_ev_handler,
+			tcp_hndl);
+	if (retval) {
+		ERROR_LOG("setting connection handler failed. (errno=%d %m)\n",
+			  xio_get_last_socket_error());
+		return retval;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_sock_shutdown						     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_shm_sock_shutdown(struct xio_tcp_socket *sock)
+{
+	int retval;
+
+	retval = shutdown(sock->cfd, SHUT_RDWR);
+	if (retval) {
+		xio_set_error(xio_get_last_socket_error());
+		DEBUG_LOG("shm shutdown failed. (errno=%d %m)\n",
+			  xio_get_last_socket_error());
+	}
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_sock_close						     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_shm_sock_close(struct xio_tcp_socket *sock)
+{
+	int retval;
+
+	xio_tcp_shm_channel_destroy(sock);
+
+	retval = xio_closesocket(sock->cfd);
+	if (retval) {
+		xio_set_error(xio_get_last_socket_error());
+		DEBUG_LOG("shm close failed. (errno=%d %m)\n",
+			  xio_get_last_socket_error());
+	}
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_sock_sendmsg						     */
+/*---------------------------------------------------------------------------*/
+ssize_t xio_tcp_shm_sock_sendmsg(struct xio_tcp_socket *sock, int fd,
+				 const struct msghdr *msg, int flags)
+{
+	struct xio_tcp_shm_channel	*chan = sock->shm;
+	ssize_t				n;
+
+	n = xio_tcp_shm_ring_write(chan->tx, chan->ring_size,
+				   msg->msg_iov, msg->msg_iovlen);
+	if (unlikely(n < 0)) {
+		errno = ECONNABORTED;
+		return -1;
+	}
+	if (!n) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	/* ring the peer only if it went to sleep */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (chan->tx->rx_armed &&
+	    __atomic_exchange_n(&chan->tx->rx_armed, 0, __ATOMIC_ACQ_REL))
+		xio_tcp_shm_doorbell(chan->tx_efd);
+
+	return n;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_sock_recvmsg						     */
+/*---------------------------------------------------------------------------*/
+ssize_t xio_tcp_shm_sock_recvmsg(struct xio_tcp_socket *sock, int fd,
+				 struct msghdr *msg)
+{
+	struct xio_tcp_shm_channel	*chan = sock->shm;
+	ssize_t				n;
+
+	n = xio_tcp_shm_ring_read(chan->rx, chan->ring_size,
+				  msg->msg_iov, msg->msg_iovlen);
+	if (unlikely(n < 0)) {
+		errno = ECONNABORTED;
+		return -1;
+	}
+	if (!n) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	/* wake the peer if it is blocked on a full ring */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (chan->rx->tx_waiting &&
+	    __atomic_exchange_n(&chan->rx->tx_waiting, 0, __ATOMIC_ACQ_REL))
+		xio_tcp_shm_doorbell(chan->tx_efd);
+
+	return n;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_sock_wait_writable					     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_shm_sock_wait_writable(struct xio_tcp_transport *tcp_hndl,
+				   int fd)
+{
+	struct xio_tcp_shm_channel *chan = tcp_hndl->sock.shm;
+
+	chan->tx_wanted = 1;
+	__atomic_store_n(&chan->tx->tx_waiting, 1, __ATOMIC_SEQ_CST);
+
+	/* the peer may have drained the ring before seeing the flag */
+	if (xio_tcp_shm_ring_used(chan->tx) != chan->ring_size)
+		xio_tcp_shm_doorbell(chan->rx_efd);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_listen							     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_shm_listen(struct xio_transport_base *transport,
+		       const char *portal_uri, uint16_t *src_port,
+		       int backlog)
+{
+	struct xio_tcp_transport *tcp_hndl =
+		(struct xio_tcp_transport *)transport;
+	struct sockaddr_storage	ss;
+	int			sa_len;
+	int			retval;
+
+	sa_len = xio_tcp_shm_uri_to_sun(portal_uri, &ss);
+	if (sa_len == -1) {
+		xio_set_error(XIO_E_ADDR_ERROR);
+		ERROR_LOG("address [%s] resolving failed\n", portal_uri);
+		goto exit1;
+	}
+	tcp_hndl->base.is_client = 0;
+
+	/* bind */
+	retval = bind(tcp_hndl->sock.cfd, (struct sockaddr *)&ss, sa_len);
+	if (retval) {
+		xio_set_error(xio_get_last_socket_error());
+		ERROR_LOG("shm bind failed. (errno=%d %m)\n",
+			  xio_get_last_socket_error());
+		goto exit1;
+	}
+
+	tcp_hndl->is_listen = 1;
+
+	retval  = listen(tcp_hndl->sock.cfd,
+			 backlog > 0 ? backlog : MAX_BACKLOG);
+	if (retval) {
+		xio_set_error(xio_get_last_socket_error());
+		ERROR_LOG("shm listen failed. (errno=%d %m)\n",
+			  xio_get_last_socket_error());
+		goto exit1;
+	}
+
+	/* add to epoll */
+	retval = xio_context_add_ev_handler(
+			tcp_hndl->base.ctx,
+			tcp_hndl->sock.cfd,
+			XIO_POLLIN,
+			xio_tcp_listener_ev_handler,
+			tcp_hndl);
+	if (retval) {
+		ERROR_LOG("xio_context_add_ev_handler failed.\n");
+		goto exit1;
+	}
+	tcp_hndl->in_epoll[0] = 1;
+
+	if (src_port)
+		*src_port = 0;
+
+	tcp_hndl->state = XIO_TRANSPORT_STATE_LISTEN;
+	DEBUG_LOG("listen on [%s]\n", portal_uri);
+
+	return 0;
+
+exit1:
+	tcp_hndl->sock.ops->del_ev_handlers = NULL;
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_shm_connect							     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_shm_connect(struct xio_transport_base *transport,
+			const char *portal_uri, const char *out_if_addr)
+{
+	struct xio_tcp_transport	*tcp_hndl =
+					(struct xio_tcp_transport *)transport;
+	struct sockaddr_storage		ss;
+	int				sa_len;
+
+	sa_len = xio_tcp_shm_uri_to_sun(portal_uri, &ss);
+	if (sa_len == -1) {
+		xio_set_error(XIO_E_ADDR_ERROR);
+		ERROR_LOG("address [%s] resolving failed\n", portal_uri);
+		goto exit1;
+	}
+	/* allocate memory for portal_uri */
+	tcp_hndl->base.portal_uri = strdup(portal_uri);
+	if (!tcp_hndl->base.portal_uri) {
+		xio_set_error(ENOMEM);
+		ERROR_LOG("strdup failed. %m\n");
+		goto exit1;
+	}
+	tcp_hndl->base.is_client = 1;
+
+	/* outgoing interface has no meaning on the local host */
+	if (out_if_addr)
+		DEBUG_LOG("shm ignores out_if_addr [%s]\n", out_if_addr);
+
+	if (xio_tcp_rx_ring_init(tcp_hndl))
+		goto exit;
+
+	/* connect */
+	if (tcp_hndl->sock.ops->connect(tcp_hndl, (struct sockaddr *)&ss,
+					sa_len))
+		goto exit;
+
+	return 0;
+
+exit:
+	ufree(tcp_hndl->base.portal_uri);
+	tcp_hndl->base.portal_uri = NULL;
+exit1:
+	tcp_hndl->sock.ops->del_ev_handlers = NULL;
+	return -1;
+}
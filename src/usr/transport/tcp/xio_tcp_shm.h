@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef XIO_TCP_SHM_H_
+#define XIO_TCP_SHM_H_
+
+/*
+ * shared memory flavor of the tcp transport ("shm://name").
+ *
+ * the peers rendezvous on an abstract AF_UNIX stream socket that stays
+ * open for the connection lifetime and serves only for liveness (HUP).
+ * the connecting side creates a memfd holding two single producer /
+ * single consumer byte rings, one per direction, and two eventfd
+ * doorbells, and passes all three descriptors in the connect message.
+ * the tcp framing and task machinery run unchanged on top of the rings,
+ * so a message costs one copy in and one copy out and no system call
+ * unless the peer sleeps.
+ */
+
+#define XIO_TCP_SHM_RING_SIZE		(1UL << 20)  /* per direction */
+#define XIO_TCP_SHM_NAME_PREFIX		"xio-shm:"
+#define XIO_TCP_SHM_NFDS		3
+
+/* shared between the peers - each index sits in its own cache line */
+struct xio_tcp_shm_ring {
+	volatile uint64_t		head;	    /* consumer position */
+	volatile uint32_t		tx_waiting; /* producer needs space */
+	uint32_t			pad0;
+	char				pad1[64 - 16];
+
+	volatile uint64_t		tail;	    /* producer position */
+	volatile uint32_t		rx_armed;   /* consumer sleeps */
+	uint32_t			pad2;
+	char				pad3[64 - 16];
+
+	uint64_t			size;
+	char				pad4[64 - 8];
+	/* ring data follows */
+};
+
+/* process local view of a connection's shared memory */
+struct xio_tcp_shm_channel {
+	struct xio_tcp_shm_ring		*tx;
+	struct xio_tcp_shm_ring		*rx;
+	void				*map;
+	size_t				map_len;
+	uint64_t			ring_size; /* validated at setup */
+	int				rx_efd;	 /* own doorbell - polled   */
+	int				tx_efd;	 /* peer doorbell - written */
+	int				tx_wanted;
+	int				pad;
+};
+
+extern struct xio_transport		xio_shm_transport;
+
+/*---------------------------------------------------------------------------*/
+/* channel setup							     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_shm_uri_to_sun(const char *uri, struct sockaddr_storage *ss);
+
+int xio_tcp_shm_channel_create(struct xio_tcp_socket *sock,
+			       int fds[XIO_TCP_SHM_NFDS]);
+
+int xio_tcp_shm_channel_attach(struct xio_tcp_socket *sock,
+			       int fds[XIO_TCP_SHM_NFDS]);
+
+void xio_tcp_shm_channel_destroy(struct xio_tcp_socket *sock);
+
+void xio_tcp_shm_close_fds(int *fds, int nfds);
+
+ssize_t xio_tcp_shm_recv_connect_msg(int fd, void *buf, size_t len,
+				     int *fds, int *nfds);
+
+/*---------------------------------------------------------------------------*/
+/* socket ops								     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_shm_sock_create(struct xio_tcp_socket *sock);
+
+int xio_tcp_shm_sock_add_ev_handlers(struct xio_tcp_transport *tcp_hndl);
+
+int xio_tcp_shm_sock_del_ev_handlers(struct xio_tcp_transport *tcp_hndl);
+
+int xio_tcp_shm_sock_connect(struct xio_tcp_transport *tcp_hndl,
+			     struct sockaddr *sa, socklen_t sa_len);
+
+int xio_tcp_shm_sock_shutdown(struct xio_tcp_socket *sock);
+
+int xio_tcp_shm_sock_close(struct xio_tcp_socket *sock);
+
+ssize_t xio_tcp_shm_sock_sendmsg(struct xio_tcp_socket *sock, int fd,
+				 const struct msghdr *msg, int flags);
+
+ssize_t xio_tcp_shm_sock_recvmsg(struct xio_tcp_socket *sock, int fd,
+				 struct msghdr *msg);
+
+int xio_tcp_shm_sock_wait_writable(struct xio_tcp_transport *tcp_hndl,
+				   int fd);
+
+/*---------------------------------------------------------------------------*/
+/* transport ops							     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_shm_listen(struct xio_transport_base *transport,
+		       const char *portal_uri, uint16_t *src_port,
+		       int backlog);
+
+int xio_tcp_shm_connect(struct xio_transport_base *transport,
+			const char *portal_uri, const char *out_if_addr);
+
+#endif /* XIO_TCP_SHM_H_ */
@@ -40,6 +40,7 @@
 
 struct xio_tcp_transport;
 struct xio_tcp_socket;
+struct xio_tcp_shm_channel;
 
 /*---------------------------------------------------------------------------*/
 /* externals								     */
@@ -74,7 +75,12 @@ extern double				g_mhz;
 
 #define MAX_BACKLOG			1024 /* listen socket max backlog   */
 
+#define SHARD_PARK_MSEC			5000 /* a parked half whose sibling
+					      * did not arrive is closed
+					      */
+
 #define TMP_RX_BUF_SIZE			(RX_BATCH * MAX_HDR_SZ)
+#define HUGE_PAGE_SZ			(2 * 1024 * 1024)
 
 #define XIO_TO_TCP_TASK(xt, tt)			\
 		struct xio_tcp_task *(tt) =		\
@@ -128,9 +134,24 @@ struct xio_tcp_options {
 	int			tcp_so_sndbuf;
 	int			tcp_so_rcvbuf;
 	int			tcp_dual_sock;
+	int			tcp_zerocopy_threshold;
+	int			tcp_rx_ring_size;
 	int			pad;
 };
 
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY			60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY			0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY		5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED	1
+#endif
+
 #define XIO_TCP_REQ_HEADER_VERSION	1
 
 PACKED_MEMORY(struct xio_tcp_req_hdr {
@@ -191,7 +212,7 @@ PACKED_MEMORY(struct xio_tcp_setup_msg {
 	uint32_t		max_in_iovsz;
 	uint32_t		max_out_iovsz;
 	uint32_t                max_header_len;
-	uint32_t		pad;
+	uint32_t		flags;		/* XIO_NATIVE_HDR	*/
 });
 
 PACKED_MEMORY(struct xio_tcp_cancel_hdr {
@@ -232,6 +253,10 @@ struct xio_tcp_task {
 	uint16_t			rsp_out_num_sge;
 	uint16_t			sn;
 
+	/* zero-copy sends issued when the task left the wire */
+	uint32_t			zc_seq;
+	uint32_t			pad1;
+
 	/* What this side got from the peer for SEND */
 	/* What this side got from the peer for RDMA equivalent R/W
 	 */
@@ -258,10 +283,51 @@ struct xio_tcp_pending_conn {
 	int				fd;
 	int				waiting_for_bytes;
 	struct xio_tcp_connect_msg	msg;
+	int				shm_fds[3];
+	int				shm_nfds;
 	union xio_sockaddr		sa;
+	/* parked on a shard group */
+	struct xio_tcp_transport	*parked_by;
+	uint64_t			parked_at;	/* get_cycles() */
 	struct list_head		conns_list_entry;
 };
 
+/* listeners bound to one address with SO_REUSEPORT. The two sockets of a
+ * dual stream connection may be accepted by different shards, so halves
+ * that arrive first are parked here until their sibling shows up.
+ */
+struct xio_tcp_shard_group {
+	union xio_sockaddr		sa;
+	struct list_head		pending_conns;
+	struct list_head		groups_list_entry;
+	int				refcnt;
+	int				pad;
+};
+
+/*
+ * Per context scratch space. All the tcp handles of a context run on the
+ * context's thread, so the batching temporaries live here once instead of
+ * in every handle.
+ */
+struct xio_tcp_ctx_scratch {
+	struct xio_context		*ctx;
+	struct list_head		scratch_list_entry;
+	struct xio_observer		observer;
+	struct kref			kref;
+	uint32_t			rx_ring_sz;
+
+	/* spare receive ring, lent to the handle being read */
+	void				*rx_ring;
+
+	/* too big to be on stack - use as temporaries */
+	union {
+		struct xio_msg		dummy_msg;
+	};
+
+	struct xio_tcp_work_req		tmp_work;
+	struct iovec			tmp_iovec[IOV_MAX];
+};
+
 struct xio_tcp_socket_ops {
 	int (*open)(struct xio_tcp_socket *sock);
 	int (*add_ev_handlers)(struct xio_tcp_transport *tcp_hndl);
@@ -278,6 +344,11 @@ struct xio_tcp_socket_ops {
 			       int batch_nr);
 	int (*shutdown)(struct xio_tcp_socket *sock);
 	int (*close)(struct xio_tcp_socket *sock);
+	ssize_t (*sendmsg)(struct xio_tcp_socket *sock, int fd,
+			   const struct msghdr *msg, int flags);
+	ssize_t (*recvmsg)(struct xio_tcp_socket *sock, int fd,
+			   struct msghdr *msg);
+	int (*wait_writable)(struct xio_tcp_transport *tcp_hndl, int fd);
 };
 
 struct xio_tcp_socket {
@@ -286,6 +357,7 @@ struct xio_tcp_socket {
 	uint16_t			port_cfd;
 	uint16_t			port_dfd;
 	int				pad;
+	struct xio_tcp_shm_channel	*shm;
 	struct xio_tcp_socket_ops	ops[1];
 };
 
@@ -317,11 +389,25 @@ struct xio_tcp_transport {
 
 	uint16_t			sn;	   /* serial number */
 
+	/* MSG_ZEROCOPY sends issued and reported done by the kernel */
+	uint32_t			zc_sent;
+	uint32_t			zc_done;
+	uint32_t			zc_enabled;
+	uint32_t			zc_pad;
+
+	/* complete at once when tx_ready_list drains */
+	uint32_t			tx_drain_notify;
+	uint32_t			tx_pad;
+
 	/* control path params */
 
 	uint32_t			peer_max_in_iovsz;
 	uint32_t			peer_max_out_iovsz;
 
+	/* headers in host byte order - see XIO_NATIVE_HDR */
+	uint32_t			native_hdr;
+	uint32_t			pad_hdr;
+
 	/* connection's flow control */
 	size_t				membuf_sz;
 
@@ -331,24 +417,22 @@ struct xio_tcp_transport {
 
 	struct xio_tcp_setup_msg	setup_rsp;
 
-	/* too big to be on stack - use as temporaries */
-	union {
-		struct xio_msg		dummy_msg;
-	};
+	struct xio_tcp_ctx_scratch	*scratch;
 
 	struct list_head		pending_conns;
+	struct xio_tcp_shard_group	*shard_group;
+	xio_ctx_delayed_work_t		shard_expire_work;
 
 	void				*tmp_rx_buf;
 	void				*tmp_rx_buf_cur;
 	uint32_t			tmp_rx_buf_len;
 	uint32_t			peer_max_header;
+	uint32_t			tmp_rx_buf_sz;
+	uint32_t			tmp_rx_buf_huge;
 
 	uint32_t			trans_attr_mask;
 	struct xio_transport_attr	trans_attr;
 
-	struct xio_tcp_work_req		tmp_work;
-	struct iovec			tmp_iovec[IOV_MAX];
-
 	struct xio_ev_data              flush_tx_event;
 	struct xio_ev_data		ctl_rx_event;
 	struct xio_ev_data		disconnect_event;
@@ -361,6 +445,8 @@ int xio_tcp_get_inline_buffer_size(void);
 int xio_tcp_send(struct xio_transport_base *transport,
 		 struct xio_task *task);
 
+int xio_tcp_tx_backlog(struct xio_transport_base *transport);
+
 int xio_tcp_rx_handler(struct xio_tcp_transport *tcp_hndl);
 
 int xio_tcp_poll(struct xio_transport_base *transport,
@@ -400,8 +486,28 @@ int xio_tcp_recv_ctl_work(struct xio_tcp_transport *tcp_hndl, int fd,
 int xio_tcp_recvmsg_work(struct xio_tcp_transport *tcp_hndl, int fd,
 			 struct xio_tcp_work_req *xio_recv, int block);
 
+ssize_t xio_tcp_sock_sendmsg(struct xio_tcp_socket *sock, int fd,
+			     const struct msghdr *msg, int flags);
+ssize_t xio_tcp_sock_recvmsg(struct xio_tcp_socket *sock, int fd,
+			     struct msghdr *msg);
+int xio_tcp_sock_wait_writable(struct xio_tcp_transport *tcp_hndl, int fd);
+
 void xio_tcp_disconnect_helper(void *xio_tcp_hndl);
 
+void xio_tcp_consume_ctl_rx(void *xio_tcp_hndl);
+
+int xio_tcp_rx_ring_init(struct xio_tcp_transport *tcp_hndl);
+
+int xio_tcp_rx_ring_attach(struct xio_tcp_transport *tcp_hndl);
+
+void xio_tcp_rx_ring_detach(struct xio_tcp_transport *tcp_hndl);
+
+void xio_tcp_listener_ev_handler(int fd, int events, void *user_context);
+
 int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl);
 
+int xio_tcp_zerocopy_reap(struct xio_tcp_transport *tcp_hndl, int fd);
+
+extern struct xio_tcp_zerocopy_stats	tcp_zc_stats;
+
 #endif /* XIO_TCP_TRANSPORT_H_ */
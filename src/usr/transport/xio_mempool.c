@@ -77,6 +77,19 @@ struct xio_mempool_config g_mempool_config = {
 	}
 };
 
+/* per thread magazines in front of the slabs' shared free lists
+ * (safe_mt pools only). a magazine caches at most XIO_MEM_MAG_MAX_NR
+ * blocks or XIO_MEM_MAG_MAX_BYTES of buffers, and all magazines of a slab
+ * together never hold more than the slab's max blocks. a thread's
+ * magazine slot is flushed and recycled when the thread exits; threads
+ * beyond XIO_MEM_MAG_THREADS_NR live ones go directly to the shared free
+ * list.
+ */
+#define XIO_MEM_MAG_THREADS_NR	64
+#define XIO_MEM_MAG_MAX_NR	32
+#define XIO_MEM_MAG_MIN_NR	2
+#define XIO_MEM_MAG_MAX_BYTES	(2 * 1024 * 1024)
+
 /* #define DEBUG_MEMPOOL_MT */
 
 /*---------------------------------------------------------------------------*/
@@ -101,11 +114,22 @@ struct xio_mem_region {
 	struct list_head		mem_region_entry;
 };
 
+struct xio_mem_magazine {
+	struct xio_mem_block		**blocks;
+	uint64_t			alloc_hits;	/* served from magazine */
+	uint64_t			alloc_misses;	/* required a refill */
+	uint64_t			free_hits;	/* kept in magazine */
+	uint64_t			free_flushes;	/* required a flush */
+	int				nr;
+	int				pad;
+};
+
 struct xio_mem_slab {
 	struct xio_mempool		*pool;
 	struct list_head		mem_regions_list;
 	struct xio_mem_block		*free_blocks_list;
 	struct list_head		blocks_list;
+	struct xio_mem_magazine		**mags;		/* indexed by thread */
 
 	size_t				mb_size;	/*memory block size */
 	spinlock_t			lock;
@@ -118,7 +142,7 @@ struct xio_mem_slab {
 							   per allocation */
 	int				used_mb_nr;
 	int				align;
-	int				pad;
+	int				mag_cap;	/* blocks per magazine */
 };
 
 struct xio_mempool {
@@ -127,6 +151,10 @@ struct xio_mempool {
 	int				nodeid;
 	int				safe_mt;
 	struct xio_mem_slab		*slab;
+	struct xio_mempool		**node_pools;	/* per node slab sets */
+	int				nodes_nr;
+	int				pad;
+	struct list_head		mag_pools_entry;
 };
 
 /* Lock free algorithm based on: Maged M. Michael & Michael L. Scott's
@@ -263,15 +291,267 @@ static struct xio_mem_block *non_safe_new_block(struct xio_mem_slab *slab)
 	return p;
 }
 
+/*---------------------------------------------------------------------------*/
+/* magazines								     */
+/*---------------------------------------------------------------------------*/
+static pthread_mutex_t		mag_lock = PTHREAD_MUTEX_INITIALIZER;
+static LIST_HEAD(mag_pools);			/* pools holding magazines */
+static int			mag_tid_free[XIO_MEM_MAG_THREADS_NR];
+static volatile int		mag_tid_free_nr;
+static volatile int		mag_tid_next;
+static pthread_key_t		mag_tid_key;
+static pthread_once_t		mag_tid_key_once = PTHREAD_ONCE_INIT;
+static int			mag_tid_key_valid;
+static xio_tls int		mag_tid;	/* 1 based, 0 - unassigned */
+
+/* last cpu seen by this thread and its numa node (per node pools) */
+static xio_tls int		node_cpu;	/* 1 based, 0 - unassigned */
+static xio_tls int		node_id;
+
+static void xio_mem_mag_flush(struct xio_mem_slab *slab,
+			      struct xio_mem_magazine *mag, int nr);
+
+/*---------------------------------------------------------------------------*/
+/* xio_mem_mag_tid_release						     */
+/*---------------------------------------------------------------------------*/
+static void xio_mem_mag_tid_release(void *data)
+{
+	struct xio_mempool	*p;
+	struct xio_mem_slab	*slab;
+	int			tid = (int)(long)data;
+	unsigned int		i;
+
+	/* thread exit - hand the cached blocks back before the slot
+	 * goes to another thread
+	 */
+	pthread_mutex_lock(&mag_lock);
+	list_for_each_entry(p, &mag_pools, mag_pools_entry) {
+		for (i = 0; i < p->slabs_nr; i++) {
+			slab = &p->slab[i];
+			if (slab->mags && slab->mags[tid - 1])
+				xio_mem_mag_flush(slab, slab->mags[tid - 1],
+						  slab->mags[tid - 1]->nr);
+		}
+	}
+	mag_tid_free[mag_tid_free_nr++] = tid;
+	pthread_mutex_unlock(&mag_lock);
+	mag_tid = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_mem_mag_tid_key_create						     */
+/*---------------------------------------------------------------------------*/
+static void xio_mem_mag_tid_key_create(void)
+{
+	if (pthread_key_create(&mag_tid_key, xio_mem_mag_tid_release))
+		ERROR_LOG("pthread_key_create failed. %m\n");
+	else
+		mag_tid_key_valid = 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_mem_mag_tid_get							     */
+/*---------------------------------------------------------------------------*/
+static int xio_mem_mag_tid_get(void)
+{
+	int tid = 0;
+
+	/* all slots taken - no need to lock */
+	if (mag_tid_next == XIO_MEM_MAG_THREADS_NR && !mag_tid_free_nr)
+		return 0;
+
+	pthread_once(&mag_tid_key_once, xio_mem_mag_tid_key_create);
+	if (!mag_tid_key_valid)
+		return 0;
+
+	pthread_mutex_lock(&mag_lock);
+	if (mag_tid_free_nr)
+		tid = mag_tid_free[--mag_tid_free_nr];
+	else if (mag_tid_next < XIO_MEM_MAG_THREADS_NR)
+		tid = ++mag_tid_next;
+	pthread_mutex_unlock(&mag_lock);
+
+	/* the key destructor returns the slot on thread exit */
+	if (tid && pthread_setspecific(mag_tid_key, (void *)(long)tid)) {
+		pthread_mutex_lock(&mag_lock);
+		mag_tid_free[mag_tid_free_nr++] = tid;
+		pthread_mutex_unlock(&mag_lock);
+		tid = 0;
+	}
+
+	return tid;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_mem_mag_tid							     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_mem_mag_tid(void)
+{
+	if (unlikely(!mag_tid))
+		mag_tid = xio_mem_mag_tid_get();
+
+	return mag_tid - 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_mem_mag_pool_add							     */
+/*---------------------------------------------------------------------------*/
+static void xio_mem_mag_pool_add(struct xio_mempool *p)
+{
+	pthread_mutex_lock(&mag_lock);
+	list_add(&p->mag_pools_entry, &mag_pools);
+	pthread_mutex_unlock(&mag_lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_mem_mag_cap							     */
+/*---------------------------------------------------------------------------*/
+static int xio_mem_mag_cap(size_t mb_size, int max_mb_nr)
+{
+	int cap = XIO_MEM_MAG_MAX_NR;
+
+	if (mb_size && mb_size < XIO_MEM_MAG_MAX_BYTES)
+		cap = min(cap, (int)(XIO_MEM_MAG_MAX_BYTES / mb_size));
+	else
+		cap = 0;
+	cap = min(cap, max_mb_nr / XIO_MEM_MAG_THREADS_NR);
+
+	return (cap < XIO_MEM_MAG_MIN_NR) ? 0 : cap;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_mem_slab_magazine						     */
+/*---------------------------------------------------------------------------*/
+static inline struct xio_mem_magazine *xio_mem_slab_magazine(
+						struct xio_mem_slab *slab)
+{
+	struct xio_mem_magazine *mag;
+	int			tid;
+
+	if (!slab->mags)
+		return NULL;
+
+	tid = xio_mem_mag_tid();
+	if (unlikely(tid < 0))
+		return NULL;
+
+	/* only the owner thread ever touches its slot */
+	mag = slab->mags[tid];
+	if (unlikely(!mag)) {
+		mag = (struct xio_mem_magazine *)ucalloc(
+				1, sizeof(*mag) +
+				slab->mag_cap * sizeof(struct xio_mem_block *));
+		if (!mag)
+			return NULL;
+		mag->blocks = (struct xio_mem_block **)(mag + 1);
+		slab->mags[tid] = mag;
+	}
+
+	return mag;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_mem_mag_flush							     */
+/*---------------------------------------------------------------------------*/
+static void xio_mem_mag_flush(struct xio_mem_slab *slab,
+			      struct xio_mem_magazine *mag, int nr)
+{
+	struct xio_mem_block	*first = NULL, *last = NULL;
+	struct xio_mem_block	*p, *q;
+	int			i;
+
+	nr = min(nr, mag->nr);
+
+	/* release the oldest blocks and keep the cache-hot ones */
+	for (i = 0; i < nr; i++) {
+		p = mag->blocks[i];
+		/* a stale reader still holds a reference and will reclaim
+		 * the block by itself
+		 */
+		if (decrement_and_test_and_set(&p->refcnt_claim) == 0)
+			continue;
+		p->next = first;
+		first = p;
+		if (!last)
+			last = p;
+	}
+	mag->nr -= nr;
+	if (mag->nr)
+		memmove(mag->blocks, mag->blocks + nr,
+			mag->nr * sizeof(struct xio_mem_block *));
+	if (!first)
+		return;
+
+	/* concatenate [first -- last] to the free list at once */
+	do {
+		q = slab->free_blocks_list;
+		last->next = q;
+	} while (!xio_sync_bool_compare_and_swap(&slab->free_blocks_list,
+						 q, first));
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_mem_mag_alloc							     */
+/*---------------------------------------------------------------------------*/
+static inline struct xio_mem_block *xio_mem_mag_alloc(
+					struct xio_mem_slab *slab,
+					struct xio_mem_magazine *mag)
+{
+	struct xio_mem_block *block;
+
+	if (likely(mag->nr)) {
+		mag->alloc_hits++;
+		return mag->blocks[--mag->nr];
+	}
+	mag->alloc_misses++;
+
+	/* refill half a magazine from the shared free list */
+	while (mag->nr < slab->mag_cap / 2) {
+		block = safe_new_block(slab);
+		if (!block)
+			break;
+		mag->blocks[mag->nr++] = block;
+	}
+	if (!mag->nr)
+		return NULL;
+
+	return mag->blocks[--mag->nr];
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_mem_mag_free							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_mem_mag_free(struct xio_mem_slab *slab,
+				    struct xio_mem_magazine *mag,
+				    struct xio_mem_block *block)
+{
+	if (unlikely(mag->nr == slab->mag_cap)) {
+		mag->free_flushes++;
+		xio_mem_mag_flush(slab, mag, slab->mag_cap / 2);
+	} else {
+		mag->free_hits++;
+	}
+	mag->blocks[mag->nr++] = block;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_mem_slab_free							     */
 /*---------------------------------------------------------------------------*/
 static int xio_mem_slab_free(struct xio_mem_slab *slab)
 {
 	struct xio_mem_region *r, *tmp_r;
+	int			i;
 
 	slab->free_blocks_list = NULL;
 
+	/* cached blocks are released along with their regions */
+	if (slab->mags) {
+		for (i = 0; i < XIO_MEM_MAG_THREADS_NR; i++)
+			ufree(slab->mags[i]);
+		ufree(slab->mags);
+		slab->mags = NULL;
+	}
+
 #ifdef DEBUG_MEMPOOL_MT
 	if (slab->used_mb_nr)
 		ERROR_LOG("buffers are still in use before free: " \
@@ -452,6 +732,19 @@ void xio_mempool_destroy(struct xio_mempool *p)
 	if (!p)
 		return;
 
+	if (p->node_pools) {
+		for (i = 0; i < (unsigned int)p->nodes_nr; i++)
+			xio_mempool_destroy(p->node_pools[i]);
+		ufree(p->node_pools);
+		ufree(p);
+		return;
+	}
+
+	/* no exiting thread may flush into the slabs anymore */
+	pthread_mutex_lock(&mag_lock);
+	list_del(&p->mag_pools_entry);
+	pthread_mutex_unlock(&mag_lock);
+
 	for (i = 0; i < p->slabs_nr; i++)
 		xio_mem_slab_free(&p->slab[i]);
 
@@ -465,11 +758,33 @@ void xio_mempool_destroy(struct xio_mempool *p)
 void xio_mempool_dump(struct xio_mempool *p)
 {
 	unsigned int		i;
+	int			j;
 	struct xio_mem_slab	*s;
+	struct xio_mem_magazine *mag;
+	uint64_t		hits, misses, frees, flushes;
+	int			cached;
+	size_t			used_sz, alloced_sz;
 
 	if (!p)
 		return;
 
+	if (p->node_pools) {
+		for (j = 0; j < p->nodes_nr; j++) {
+			used_sz = 0;
+			alloced_sz = 0;
+			for (i = 0; i < p->node_pools[j]->slabs_nr; i++) {
+				s = &p->node_pools[j]->slab[i];
+				used_sz += s->used_mb_nr * s->mb_size;
+				alloced_sz += s->curr_mb_nr * s->mb_size;
+			}
+			DEBUG_LOG("pool:%p - node[%d]: " \
+				  "used:%zd bytes, alloced:%zd bytes\n",
+				  p, j, used_sz, alloced_sz);
+			xio_mempool_dump(p->node_pools[j]);
+		}
+		return;
+	}
+
 	DEBUG_LOG("------------------------------------------------\n");
 	for (i = 0; i < p->slabs_nr; i++) {
 		s = &p->slab[i];
@@ -477,10 +792,86 @@ void xio_mempool_dump(struct xio_mempool *p)
 			  "size:%zd, used:%d, alloced:%d, max_alloc:%d\n",
 			  p, i, s->mb_size, s->used_mb_nr,
 			  s->curr_mb_nr, s->max_mb_nr);
+		if (!s->mags)
+			continue;
+		hits = 0;
+		misses = 0;
+		frees = 0;
+		flushes = 0;
+		cached = 0;
+		for (j = 0; j < XIO_MEM_MAG_THREADS_NR; j++) {
+			mag = s->mags[j];
+			if (!mag)
+				continue;
+			hits	+= mag->alloc_hits;
+			misses	+= mag->alloc_misses;
+			frees	+= mag->free_hits;
+			flushes += mag->free_flushes;
+			cached	+= mag->nr;
+		}
+		DEBUG_LOG("pool:%p - slab[%d]: magazines " \
+			  "cap:%d, cached:%d, alloc hit:%llu/%llu, " \
+			  "free hit:%llu/%llu\n",
+			  p, i, s->mag_cap, cached,
+			  (unsigned long long)hits,
+			  (unsigned long long)(hits + misses),
+			  (unsigned long long)frees,
+			  (unsigned long long)(frees + flushes));
 	}
 	DEBUG_LOG("------------------------------------------------\n");
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_mempool_create_per_node						     */
+/*---------------------------------------------------------------------------*/
+static struct xio_mempool *xio_mempool_create_per_node(uint32_t flags)
+{
+	struct xio_mempool	*p, *np;
+	int			i;
+
+	clr_bits(XIO_MEMPOOL_FLAG_PER_NODE, &flags);
+	clr_bits(XIO_MEMPOOL_FLAG_HUGE_PAGES_ALLOC, &flags);
+	clr_bits(XIO_MEMPOOL_FLAG_REGULAR_PAGES_ALLOC, &flags);
+	set_bits(XIO_MEMPOOL_FLAG_NUMA_ALLOC, &flags);
+
+	p = (struct xio_mempool *)ucalloc(1, sizeof(struct xio_mempool));
+	if (!p)
+		return NULL;
+
+	p->nodeid = -1;
+	p->flags = flags | XIO_MEMPOOL_FLAG_PER_NODE;
+	p->safe_mt = 1;
+	/* the node pools hold the magazines */
+	INIT_LIST_HEAD(&p->mag_pools_entry);
+	p->nodes_nr = xio_numa_max_node() + 1;
+	p->node_pools = (struct xio_mempool **)ucalloc(
+			p->nodes_nr, sizeof(struct xio_mempool *));
+	if (!p->node_pools)
+		goto cleanup;
+
+	/* node pools are not pinned - blocks are placed by unuma_alloc */
+	for (i = 0; i < p->nodes_nr; i++) {
+		np = (struct xio_mempool *)ucalloc(1,
+						   sizeof(struct xio_mempool));
+		if (!np)
+			goto cleanup;
+		np->nodeid = i;
+		np->flags = flags;
+		np->safe_mt = 1;
+		xio_mem_mag_pool_add(np);
+		p->node_pools[i] = np;
+	}
+	DEBUG_LOG("mempool: using per node allocator, nodes:%d\n",
+		  p->nodes_nr);
+
+	return p;
+
+cleanup:
+	xio_mempool_destroy(p);
+	xio_set_error(ENOMEM);
+	return NULL;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_mempool_create							     */
 /*---------------------------------------------------------------------------*/
@@ -488,6 +879,9 @@ struct xio_mempool *xio_mempool_create(int nodeid, uint32_t flags)
 {
 	struct xio_mempool *p;
 
+	if (test_bits(XIO_MEMPOOL_FLAG_PER_NODE, &flags))
+		return xio_mempool_create_per_node(flags);
+
 	if (test_bits(XIO_MEMPOOL_FLAG_HUGE_PAGES_ALLOC, &flags)) {
 		clr_bits(XIO_MEMPOOL_FLAG_REGULAR_PAGES_ALLOC, &flags);
 		clr_bits(XIO_MEMPOOL_FLAG_NUMA_ALLOC, &flags);
@@ -523,6 +917,7 @@ struct xio_mempool *xio_mempool_create(int nodeid, uint32_t flags)
 	p->slabs_nr = 0;
 	p->safe_mt = 1;
 	p->slab = NULL;
+	xio_mem_mag_pool_add(p);
 
 	return p;
 }
@@ -579,6 +974,23 @@ static inline int size2index(struct xio_mempool *p, size_t sz)
 	return (i == p->slabs_nr) ? -1 : (int)i;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_mempool_node_pool						     */
+/*---------------------------------------------------------------------------*/
+static inline struct xio_mempool *xio_mempool_node_pool(struct xio_mempool *p)
+{
+	int cpu = xio_get_cpu();
+
+	if (unlikely(cpu + 1 != node_cpu)) {
+		node_cpu = cpu + 1;
+		node_id = (cpu == -1) ? 0 : xio_numa_node_of_cpu(cpu);
+		if (node_id < 0)
+			node_id = 0;
+	}
+
+	return p->node_pools[(node_id < p->nodes_nr) ? node_id : 0];
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_mempool_alloc							     */
 /*---------------------------------------------------------------------------*/
@@ -588,8 +1000,13 @@ int xio_mempool_alloc(struct xio_mempool *p, size_t length,
 	int			index;
 	struct xio_mem_slab	*slab;
 	struct xio_mem_block	*block;
+	struct xio_mem_magazine	*mag;
 	int			ret = 0;
 
+	/* freed blocks find their home node through parent_slab */
+	if (p->node_pools)
+		p = xio_mempool_node_pool(p);
+
 	index = size2index(p, length);
 retry:
 	if (index == -1) {
@@ -603,10 +1020,15 @@ retry:
 	}
 	slab = &p->slab[index];
 
-	if (p->safe_mt)
-		block = safe_new_block(slab);
-	else
+	if (p->safe_mt) {
+		mag = xio_mem_slab_magazine(slab);
+		if (mag)
+			block = xio_mem_mag_alloc(slab, mag);
+		else
+			block = safe_new_block(slab);
+	} else {
 		block = non_safe_new_block(slab);
+	}
 	if (!block) {
 		if (p->safe_mt) {
 			spin_lock(&slab->lock);
@@ -666,6 +1088,7 @@ cleanup:
 void xio_mempool_free(struct xio_reg_mem *reg_mem)
 {
 	struct xio_mem_block	*block;
+	struct xio_mem_magazine	*mag;
 
 	if (!reg_mem || !reg_mem->priv)
 		return;
@@ -682,10 +1105,15 @@ void xio_mempool_free(struct xio_reg_mem *reg_mem)
 	block->parent_slab->used_mb_nr--;
 #endif
 
-	if (block->parent_slab->pool->safe_mt)
-		safe_release(block->parent_slab, block);
-	else
+	if (block->parent_slab->pool->safe_mt) {
+		mag = xio_mem_slab_magazine(block->parent_slab);
+		if (mag)
+			xio_mem_mag_free(block->parent_slab, mag, block);
+		else
+			safe_release(block->parent_slab, block);
+	} else {
 		non_safe_release(block->parent_slab, block);
+	}
 }
 
 /*---------------------------------------------------------------------------*/
@@ -697,8 +1125,22 @@ int xio_mempool_add_slab(struct xio_mempool *p,
 {
 	struct xio_mem_slab	*new_slab;
 	struct xio_mem_block	*block;
+	struct xio_mem_magazine	**mags = NULL;
 	unsigned int ix, slab_ix, slab_shift = 0;
 	int align = alignment;
+	int mag_cap = 0;
+	int i;
+
+	if (p->node_pools) {
+		for (i = 0; i < p->nodes_nr; i++) {
+			if (xio_mempool_add_slab(p->node_pools[i], size, min,
+						 max, alloc_quantum_nr,
+						 alignment))
+				return -1;
+		}
+		p->slabs_nr = p->node_pools[0]->slabs_nr;
+		return 0;
+	}
 
 	slab_ix = p->slabs_nr;
 	if (p->slabs_nr) {
@@ -722,10 +1164,23 @@ int xio_mempool_add_slab(struct xio_mempool *p,
 		return -1;
 	}
 
+	if (p->safe_mt)
+		mag_cap = xio_mem_mag_cap(size, (int)max);
+	if (mag_cap) {
+		mags = (struct xio_mem_magazine **)ucalloc(
+				XIO_MEM_MAG_THREADS_NR,
+				sizeof(struct xio_mem_magazine *));
+		if (!mags) {
+			xio_set_error(ENOMEM);
+			return -1;
+		}
+	}
+
 	/* expand */
 	new_slab = (struct xio_mem_slab *)ucalloc(p->slabs_nr + 2,
 						  sizeof(struct xio_mem_slab));
 	if (!new_slab) {
+		ufree(mags);
 		xio_set_error(ENOMEM);
 		return -1;
 	}
@@ -740,6 +1195,8 @@ int xio_mempool_add_slab(struct xio_mempool *p,
 			new_slab[ix].max_mb_nr = max;
 			new_slab[ix].alloc_quantum_nr = alloc_quantum_nr;
 			new_slab[ix].align = align;
+			new_slab[ix].mag_cap = mag_cap;
+			new_slab[ix].mags = mags;
 
 			spin_lock_init(&new_slab[ix].lock);
 			INIT_LIST_HEAD(&new_slab[ix].mem_regions_list);
@@ -771,11 +1228,13 @@ int xio_mempool_add_slab(struct xio_mempool *p,
 	new_slab[p->slabs_nr + 1].mb_size = SIZE_MAX;
 
 	/* swap slabs */
+	pthread_mutex_lock(&mag_lock);
 	ufree(p->slab);
 	p->slab = new_slab;
 
 	/* adjust length */
 	(p->slabs_nr)++;
+	pthread_mutex_unlock(&mag_lock);
 
 	return 0;
 }
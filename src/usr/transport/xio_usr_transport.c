@@ -142,6 +142,8 @@ int xio_mem_free(struct xio_reg_mem *reg_mem)
 struct xio_mempool *xio_transport_mempool_get(
 		struct xio_context *ctx, int reg_mr)
 {
+	uint32_t flags;
+
 	if (ctx->mempool)
 		return (struct xio_mempool *)ctx->mempool;
 
@@ -149,10 +151,14 @@ struct xio_mempool *xio_transport_mempool_get(
         if (ctx->register_internal_mempool && xio_get_transport("rdma"))
                 reg_mr = 1;
 
-	ctx->mempool = xio_mempool_create_prv(
-			ctx->nodeid,
-			(reg_mr ? XIO_MEMPOOL_FLAG_REG_MR : 0) |
-			XIO_MEMPOOL_FLAG_HUGE_PAGES_ALLOC);
+	flags = reg_mr ? XIO_MEMPOOL_FLAG_REG_MR : 0;
+	/* contexts placed by cpu_hint keep their buffers node local */
+	if (ctx->cpu_hinted && xio_numa_max_node() > 0)
+		flags |= XIO_MEMPOOL_FLAG_PER_NODE;
+	else
+		flags |= XIO_MEMPOOL_FLAG_HUGE_PAGES_ALLOC;
+
+	ctx->mempool = xio_mempool_create_prv(ctx->nodeid, flags);
 
 	if (!ctx->mempool) {
 		ERROR_LOG("xio_mempool_create failed (errno=%d %m)\n", errno);
@@ -42,6 +42,10 @@
 #include <xio_env.h>
 
 #include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
 
 #include "xio_usr_utils.h"
 #include "get_clock.h"
@@ -60,6 +64,9 @@
 #define USECSTEP 10
 #define USECSTART 100
 
+#define CALIBRATE_ROUNDS 5
+#define CALIBRATE_NSEC 100000
+
 /*
  Use linear regression to calculate cycles per microsecond.
  http://en.wikipedia.org/wiki/Linear_regression#Parameter_estimation
@@ -184,6 +191,103 @@ exit:
 	return mhz;
 }
 
+#if defined(__x86_64__) || defined(__i386__)
+/*
+ * TSC ticks at a constant rate regardless of P/C states, so its
+ * frequency may be read from cpuid or measured in a short window.
+ */
+static int tsc_is_invariant(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (__get_cpuid_max(0x80000000, NULL) < 0x80000007)
+		return 0;
+	__cpuid(0x80000007, eax, ebx, ecx, edx);
+
+	return !!(edx & (1U << 8));
+}
+
+/*
+ * TSC frequency as advertised by the CPU or the hypervisor.
+ */
+static double tsc_get_cpu_mhz(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+	unsigned long khz;
+	FILE *f;
+
+	if (!tsc_is_invariant())
+		return 0.0;
+
+	/* crystal clock and TSC/crystal ratio */
+	if (__get_cpuid_max(0, NULL) >= 0x15) {
+		__cpuid_count(0x15, 0, eax, ebx, ecx, edx);
+		if (eax && ebx && ecx)
+			return (double)ecx * ebx / eax / 1000000.0;
+	}
+	/* processor base frequency */
+	if (__get_cpuid_max(0, NULL) >= 0x16) {
+		__cpuid_count(0x16, 0, eax, ebx, ecx, edx);
+		if (eax & 0xffff)
+			return eax & 0xffff;
+	}
+	/* hypervisor timing leaf (KVM, VMware) */
+	__cpuid(1, eax, ebx, ecx, edx);
+	if (ecx & (1U << 31)) {
+		__cpuid(0x40000000, eax, ebx, ecx, edx);
+		if (eax >= 0x40000010) {
+			__cpuid(0x40000010, eax, ebx, ecx, edx);
+			if (eax)
+				return eax / 1000.0;
+		}
+	}
+
+	f = fopen("/sys/devices/system/cpu/cpu0/tsc_freq_khz", "r");
+	if (!f)
+		return 0.0;
+	if (fscanf(f, "%lu", &khz) != 1)
+		khz = 0;
+	fclose(f);
+
+	return khz / 1000.0;
+}
+
+/*
+ * Measure an invariant TSC against the raw monotonic clock.
+ * A few short windows are enough since neither clock drifts,
+ * the median drops a window that was preempted.
+ */
+static double clock_get_cpu_mhz(void)
+{
+	struct timespec ts1, ts2;
+	cycles_t c1, c2;
+	double mhz[CALIBRATE_ROUNDS], tmp;
+	long long ns;
+	int i, j;
+
+	for (i = 0; i < CALIBRATE_ROUNDS; i++) {
+		if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts1))
+			return 0.0;
+		c1 = get_cycles();
+		do {
+			clock_gettime(CLOCK_MONOTONIC_RAW, &ts2);
+			c2 = get_cycles();
+			ns = (ts2.tv_sec - ts1.tv_sec) * 1000000000LL +
+				ts2.tv_nsec - ts1.tv_nsec;
+		} while (ns < CALIBRATE_NSEC);
+
+		mhz[i] = (double)(c2 - c1) * 1000.0 / ns;
+		for (j = i; j > 0 && mhz[j - 1] > mhz[j]; j--) {
+			tmp = mhz[j];
+			mhz[j] = mhz[j - 1];
+			mhz[j - 1] = tmp;
+		}
+	}
+
+	return mhz[CALIBRATE_ROUNDS / 2];
+}
+#endif
+
 double get_core_freq(void)
 {
 	int cpu;
@@ -232,6 +336,13 @@ double get_cpu_mhz(int no_cpu_freq_fail)
 {
 	double freq, sample, proc, delta;
 
+#if defined(__x86_64__) || defined(__i386__)
+	freq = tsc_get_cpu_mhz();
+	if (freq)
+		return freq;
+	if (tsc_is_invariant())
+		return clock_get_cpu_mhz();
+#endif
 	freq = get_core_freq();
 	/* even with core freq cycles are at maximum */
 	if (freq)
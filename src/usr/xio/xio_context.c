@@ -35,10 +35,12 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <sys/hashtable.h>
 #include <xio_os.h>
 #include "libxio.h"
 #include "xio_log.h"
 #include "xio_common.h"
+#include "xio_hash.h"
 #include "xio_observer.h"
 #include "get_clock.h"
 #include "xio_ev_data.h"
@@ -52,9 +54,16 @@
 #include "xio_mbuf.h"
 #include "xio_task.h"
 #include "xio_transport.h"
+#include "xio_msg_list.h"
+#include "xio_sg_table.h"
 #include "xio_context.h"
+#include "xio_nexus.h"
+#include "xio_session.h"
+#include "xio_connection.h"
+#include "xio_mpsc_ring.h"
 #include "xio_usr_utils.h"
 #include "xio_init.h"
+#include "xio_stats_shm.h"
 
 #ifdef XIO_THREAD_SAFE_DEBUG
 #include <execinfo.h>
@@ -63,8 +72,22 @@
 #define MSGPOOL_INIT_NR	8
 #define MSGPOOL_GROW_NR	64
 
+/* idle task slabs are freed after this many reclaim sweeps */
+#define TASKS_POOL_RECLAIM_TICKS	4
+
 int xio_netlink(struct xio_context *ctx);
 
+/*---------------------------------------------------------------------------*/
+/* xio_context_spin_poll						     */
+/*---------------------------------------------------------------------------*/
+static void xio_context_spin_poll(void *data)
+{
+	struct xio_context *ctx = (struct xio_context *)data;
+
+	if (ctx->poll_completions_fn)
+		ctx->poll_completions_fn(ctx->poll_completions_ctx, 0);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_context_reg_observer						     */
 /*---------------------------------------------------------------------------*/
@@ -95,7 +118,7 @@ struct xio_context *xio_context_create(struct xio_context_params *ctx_params,
 {
 	struct xio_context		*ctx = NULL;
 	struct xio_transport		*transport;
-	int				cpu;
+	int				cpu, i;
 
 	/* check if user called xio_init() */
 	if (!xio_inited()) {
@@ -130,11 +153,16 @@ struct xio_context *xio_context_create(struct xio_context_params *ctx_params,
 		ERROR_LOG("calloc failed. %m\n");
 		return NULL;
 	}
-	ctx->ev_loop		= xio_ev_loop_create();
+	ctx->ev_loop		= xio_ev_loop_create_ex(
+					ctx_params ?
+					(enum xio_ev_loop_type)
+						ctx_params->ev_loop_type :
+					XIO_EV_LOOP_EPOLL);
 	ctx->run_private	= 0;
 
 	ctx->cpuid		= cpu;
 	ctx->nodeid		= xio_numa_node_of_cpu(cpu);
+	ctx->cpu_hinted		= (cpu_hint != -1);
 	ctx->polling_timeout	= polling_timeout_us;
 	ctx->worker		= xio_get_current_thread_id();
 
@@ -147,12 +175,18 @@ struct xio_context *xio_context_create(struct xio_context_params *ctx_params,
                 ctx->register_internal_mempool =
                         !!ctx_params->register_internal_mempool;
 		ctx->rq_depth = ctx_params->rq_depth;
+		ctx->tasks_pool_idle_ms =
+				max(ctx_params->tasks_pool_idle_ms, 0);
+		xio_ev_loop_set_spin(ctx->ev_loop, ctx_params->spin_us,
+				     ctx_params->spin_adaptive);
 	}
+	xio_ev_loop_set_spin_poll_fn(ctx->ev_loop, xio_context_spin_poll, ctx);
 	if (!ctx->max_conns_per_ctx)
 		ctx->max_conns_per_ctx = 100;
 
 	XIO_OBSERVABLE_INIT(&ctx->observable, ctx);
 	INIT_LIST_HEAD(&ctx->ctx_list);
+	INIT_LIST_HEAD(&ctx->ka_list);
 
 	ctx->workqueue = xio_workqueue_create(ctx);
 	if (!ctx->workqueue) {
@@ -171,9 +205,10 @@ struct xio_context *xio_context_create(struct xio_context_params *ctx_params,
 	if (-1 == xio_netlink(ctx))
 		goto cleanup2;
 
-	/* initialize rdma pools only */
-	transport = xio_get_transport("rdma");
-	if (transport && ctx->prealloc_xio_inline_bufs) {
+	/* initialize rdma pools only - rdma is brought up only if asked */
+	transport = ctx->prealloc_xio_inline_bufs ?
+			xio_get_transport("rdma") : NULL;
+	if (transport) {
 		int retval = xio_ctx_pool_create(ctx, XIO_PROTO_RDMA,
 					         XIO_CONTEXT_POOL_CLASS_INITIAL);
 		if (retval) {
@@ -191,6 +226,11 @@ struct xio_context *xio_context_create(struct xio_context_params *ctx_params,
 	pthread_mutex_init(&ctx->dbg_thread_mutex, NULL);
 #endif
 	spin_lock_init(&ctx->ctx_list_lock);
+	spin_lock_init(&ctx->nexus_index_lock);
+	for (i = 0; i < XIO_CTX_NEXUS_BUCKETS; i++)
+		INIT_LIST_HEAD(&ctx->nexus_index[i]);
+
+	xio_stats_shm_ctx_add(ctx);
 
 	DEBUG_LOG("context created. context:%p\n", ctx);
 
@@ -294,6 +334,8 @@ void xio_context_destroy(struct xio_context *ctx)
 		if (ctx->stats.name[i])
 			free(ctx->stats.name[i]);
 
+	xio_stats_shm_ctx_remove(ctx);
+	xio_ctx_del_delayed_work(ctx, &ctx->tasks_reclaim_work);
 	xio_workqueue_destroy(ctx->workqueue);
 
 	xio_objpool_destroy(ctx->msg_pool);
@@ -309,6 +351,7 @@ void xio_context_destroy(struct xio_context *ctx)
 #ifdef XIO_THREAD_SAFE_DEBUG
 	pthread_mutex_destroy(&ctx->dbg_thread_mutex);
 #endif
+	ufree(ctx->lat_stats);
 
 	XIO_OBSERVABLE_DESTROY(&ctx->observable);
 	ufree(ctx);
@@ -416,6 +459,13 @@ int xio_modify_context(struct xio_context *ctx,
 	if (attr_mask & XIO_CONTEXT_ATTR_USER_CTX)
 		ctx->user_context = attr->user_context;
 
+	if (attr_mask & XIO_CONTEXT_ATTR_SPIN)
+		xio_ev_loop_set_spin(ctx->ev_loop, attr->spin_us,
+				     attr->spin_adaptive);
+
+	if ((attr_mask & XIO_CONTEXT_ATTR_LATENCY_STATS) && ctx->lat_stats)
+		memset(ctx->lat_stats, 0, sizeof(*ctx->lat_stats));
+
 	return 0;
 }
 EXPORT_SYMBOL(xio_modify_context);
@@ -436,10 +486,68 @@ int xio_query_context(struct xio_context *ctx,
 	if (attr_mask & XIO_CONTEXT_ATTR_USER_CTX)
 		attr->user_context = ctx->user_context;
 
+	if (attr_mask & XIO_CONTEXT_ATTR_SPIN)
+		xio_ev_loop_get_spin(ctx->ev_loop, &attr->spin_us,
+				     &attr->spin_adaptive);
+
+	if (attr_mask & XIO_CONTEXT_ATTR_SPIN_STATS)
+		xio_ev_loop_get_spin_stats(ctx->ev_loop, &attr->spin_stats);
+
+	if (attr_mask & XIO_CONTEXT_ATTR_EV_LOOP_TYPE)
+		attr->ev_loop_type = xio_ev_loop_get_type(ctx->ev_loop);
+
+	if (attr_mask & XIO_CONTEXT_ATTR_LATENCY_STATS) {
+		if (!attr->latency_stats) {
+			xio_set_error(EINVAL);
+			ERROR_LOG("latency_stats buffer is NULL\n");
+			return -1;
+		}
+		if (ctx->lat_stats)
+			memcpy(attr->latency_stats, ctx->lat_stats,
+			       sizeof(*attr->latency_stats));
+		else
+			memset(attr->latency_stats, 0,
+			       sizeof(*attr->latency_stats));
+	}
+
 	return 0;
 }
 EXPORT_SYMBOL(xio_query_context);
 
+#ifdef XIO_CFLAG_STAT_COUNTERS
+/*---------------------------------------------------------------------------*/
+/* xio_ctx_lat_record							     */
+/*---------------------------------------------------------------------------*/
+void xio_ctx_lat_record(struct xio_context *ctx, int stage, uint64_t ns)
+{
+	struct xio_latency_hist	*hist;
+	unsigned int		b;
+	int			e;
+
+	if (unlikely(!ctx->lat_stats)) {
+		ctx->lat_stats = (struct xio_latency_stats *)
+				ucalloc(1, sizeof(*ctx->lat_stats));
+		if (!ctx->lat_stats)
+			return;
+	}
+	/* 4 linear buckets per power of two */
+	if (ns < 4) {
+		b = (unsigned int)ns;
+	} else {
+		e = 63 - __builtin_clzll(ns);
+		b = 4 * (e - 1) + (unsigned int)((ns >> (e - 2)) & 3);
+		if (b >= XIO_LATENCY_BUCKETS)
+			b = XIO_LATENCY_BUCKETS - 1;
+	}
+	hist = &ctx->lat_stats->stage[stage];
+	hist->count++;
+	hist->sum_ns += ns;
+	if (ns > hist->max_ns)
+		hist->max_ns = ns;
+	hist->bucket[b]++;
+}
+#endif
+
 /*---------------------------------------------------------------------------*/
 /* xio_context_get_poll_fd						     */
 /*---------------------------------------------------------------------------*/
@@ -525,6 +633,274 @@ void xio_context_stop_loop(struct xio_context *ctx)
 }
 EXPORT_SYMBOL(xio_context_stop_loop);
 
+/*---------------------------------------------------------------------------*/
+/* xio_context_post_work						     */
+/*---------------------------------------------------------------------------*/
+int xio_context_post_work(struct xio_context *ctx,
+			  void (*function)(void *data), void *data)
+{
+	struct xio_mpsc_entry entry = { NULL, function, NULL, data };
+
+	if (xio_workqueue_post(ctx->workqueue, &entry)) {
+		xio_set_error(errno);
+		return -1;
+	}
+	return 0;
+}
+EXPORT_SYMBOL(xio_context_post_work);
+
+/*---------------------------------------------------------------------------*/
+/* xio_post_request_send						     */
+/*---------------------------------------------------------------------------*/
+static void xio_post_request_send(struct xio_connection *connection,
+				  struct xio_msg *msg)
+{
+	/* the session may be gone with the connection, nobody to notify */
+	if (connection->post_closed)
+		ERROR_LOG("connection %p closed, posted request dropped\n",
+			  connection);
+	/* the poster already returned, report through the session */
+	else if (xio_send_request(connection, msg))
+		xio_session_notify_msg_error(connection, msg,
+					     (enum xio_status)xio_errno(),
+					     XIO_MSG_DIRECTION_OUT);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_post_request_handler						     */
+/*---------------------------------------------------------------------------*/
+static void xio_post_request_handler(void *obj, void *data)
+{
+	struct xio_connection *connection = (struct xio_connection *)obj;
+
+	xio_post_request_send(connection, (struct xio_msg *)data);
+	xio_connection_post_put(connection);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_post_msg_handler							     */
+/*---------------------------------------------------------------------------*/
+static void xio_post_msg_handler(void *obj, void *data)
+{
+	struct xio_connection	*connection = (struct xio_connection *)obj;
+	struct xio_msg		*msg = (struct xio_msg *)data;
+
+	if (connection->post_closed)
+		ERROR_LOG("connection %p closed, posted message dropped\n",
+			  connection);
+	else if (xio_send_msg(connection, msg))
+		xio_session_notify_msg_error(connection, msg,
+					     (enum xio_status)xio_errno(),
+					     XIO_MSG_DIRECTION_OUT);
+	xio_connection_post_put(connection);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_post_response_handler						     */
+/*---------------------------------------------------------------------------*/
+static void xio_post_response_handler(void *obj, void *data)
+{
+	struct xio_task		*task = (struct xio_task *)obj;
+	struct xio_connection	*connection = task->connection;
+	struct xio_msg		*msg = (struct xio_msg *)data;
+
+	if (connection->post_closed) {
+		/* the task pool may be gone with the nexus, its destroy
+		 * frees the task without our reference
+		 */
+		ERROR_LOG("connection %p closed, posted response dropped\n",
+			  connection);
+	} else {
+		/* discarded responses are notified by xio_send_response */
+		if (xio_send_response(msg))
+			ERROR_LOG("posted response send failed. %s\n",
+				  xio_strerror(xio_errno()));
+		xio_tasks_pool_put(task);
+	}
+	xio_connection_post_put(connection);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_post_nop								     */
+/*---------------------------------------------------------------------------*/
+static void xio_post_nop(void *data)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_post_put_handler							     */
+/*---------------------------------------------------------------------------*/
+static void xio_post_put_handler(void *obj, void *data)
+{
+	xio_connection_post_put((struct xio_connection *)obj);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_post_connection							     */
+/*---------------------------------------------------------------------------*/
+static int xio_post_connection(struct xio_connection *connection,
+			       void (*handler)(void *obj, void *data),
+			       struct xio_msg *msg)
+{
+	struct xio_workqueue	*workqueue = connection->ctx->workqueue;
+	struct xio_mpsc_cell	*cell;
+	struct xio_mpsc_entry	entry = { handler, NULL, connection, msg };
+
+	/* references are taken only once the entry has a slot, and are
+	 * dropped by the handler on the loop thread
+	 */
+	cell = xio_workqueue_post_claim(workqueue);
+	if (!cell) {
+		xio_set_error(errno);
+		return -1;
+	}
+	if (!xio_connection_post_get(connection)) {
+		entry.handler = NULL;
+		entry.function = xio_post_nop;
+		xio_workqueue_post_commit(workqueue, cell, &entry);
+		xio_set_error(ENOTCONN);
+		return -1;
+	}
+	/* a failed wakeup is logged, the entry runs on the next one */
+	xio_workqueue_post_commit(workqueue, cell, &entry);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_post_request							     */
+/*---------------------------------------------------------------------------*/
+int xio_post_request(struct xio_connection *connection, struct xio_msg *req)
+{
+	return xio_post_connection(connection, xio_post_request_handler, req);
+}
+EXPORT_SYMBOL(xio_post_request);
+
+/*---------------------------------------------------------------------------*/
+/* xio_post_msg								     */
+/*---------------------------------------------------------------------------*/
+int xio_post_msg(struct xio_connection *connection, struct xio_msg *msg)
+{
+	return xio_post_connection(connection, xio_post_msg_handler, msg);
+}
+EXPORT_SYMBOL(xio_post_msg);
+
+/*---------------------------------------------------------------------------*/
+/* xio_post_response							     */
+/*---------------------------------------------------------------------------*/
+int xio_post_response(struct xio_msg *rsp)
+{
+	struct xio_task		*task;
+	struct xio_connection	*connection;
+	struct xio_workqueue	*workqueue;
+	struct xio_mpsc_cell	*cell;
+	struct xio_mpsc_entry	entry = {
+		xio_post_response_handler, NULL, NULL, rsp };
+
+	task = container_of(rsp->request, struct xio_task, imsg);
+	connection = task->connection;
+	workqueue = connection->ctx->workqueue;
+
+	/* the task may only go back to its pool on the loop thread, so the
+	 * slot is claimed before any reference is taken and a full queue
+	 * never leaves one to drop here
+	 */
+	cell = xio_workqueue_post_claim(workqueue);
+	if (!cell) {
+		xio_set_error(errno);
+		return -1;
+	}
+	if (!xio_connection_post_get(connection)) {
+		entry.handler = NULL;
+		entry.function = xio_post_nop;
+		xio_workqueue_post_commit(workqueue, cell, &entry);
+		xio_set_error(ENOTCONN);
+		return -1;
+	}
+	if (!kref_get_unless_zero(&task->kref)) {
+		/* the request was already released */
+		entry.obj = connection;
+		entry.handler = xio_post_put_handler;
+		xio_workqueue_post_commit(workqueue, cell, &entry);
+		xio_set_error(EINVAL);
+		return -1;
+	}
+	entry.obj = task;
+	xio_workqueue_post_commit(workqueue, cell, &entry);
+
+	return 0;
+}
+EXPORT_SYMBOL(xio_post_response);
+
+/*---------------------------------------------------------------------------*/
+/* xio_session_send_request_handler					     */
+/*---------------------------------------------------------------------------*/
+static void xio_session_send_request_handler(void *obj, void *data)
+{
+#ifdef XIO_CFLAG_STAT_COUNTERS
+	struct xio_connection	*connection = (struct xio_connection *)obj;
+
+	if (!connection->post_closed)
+		xio_stats_shm_add(connection->shm_counters,
+				  XIO_SHM_CONN_LB_PICKS, 1);
+#endif
+	/* drops the post reference taken by the pick */
+	xio_post_request_handler(obj, data);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_session_send_request						     */
+/*---------------------------------------------------------------------------*/
+int xio_session_send_request(struct xio_session *session,
+			     struct xio_context *ctx,
+			     struct xio_msg *req)
+{
+	struct xio_connection	*connection;
+	struct xio_workqueue	*workqueue;
+	struct xio_mpsc_cell	*cell;
+	int			retval;
+	struct xio_mpsc_entry	entry = {
+		xio_session_send_request_handler, NULL, NULL, req };
+
+	if (!session || !req) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+
+	connection = xio_session_lb_pick(session);
+	if (!connection) {
+		xio_set_error(ENOTCONN);
+		return -1;
+	}
+	if (connection->ctx == ctx) {
+#ifdef XIO_CFLAG_STAT_COUNTERS
+		xio_stats_shm_add(connection->shm_counters,
+				  XIO_SHM_CONN_LB_PICKS, 1);
+#endif
+		retval = xio_send_request(connection, req);
+		xio_connection_post_put(connection);
+		return retval;
+	}
+
+	/* shm counters are written by the owner thread only */
+	workqueue = connection->ctx->workqueue;
+	cell = xio_workqueue_post_claim(workqueue);
+	if (!cell) {
+		retval = errno;
+		/* the post reference only pins memory, dropping the last
+		 * one here frees it and never runs connection teardown
+		 */
+		xio_connection_post_put(connection);
+		xio_set_error(retval);
+		return -1;
+	}
+	entry.obj = connection;
+	xio_workqueue_post_commit(workqueue, cell, &entry);
+
+	return 0;
+}
+EXPORT_SYMBOL(xio_session_send_request);
+
 /*---------------------------------------------------------------------------*/
 /* xio_context_is_loop_stopping						     */
 /*---------------------------------------------------------------------------*/
@@ -683,6 +1059,25 @@ void xio_context_set_poll_completions_fn(
 }
 EXPORT_SYMBOL(xio_context_set_poll_completions_fn);
 
+/*---------------------------------------------------------------------------*/
+/* xio_ctx_tasks_pools_reclaim						     */
+/*---------------------------------------------------------------------------*/
+static void xio_ctx_tasks_pools_reclaim(void *_ctx)
+{
+	struct xio_context *ctx = (struct xio_context *)_ctx;
+	int i;
+
+	xio_ctx_del_delayed_work(ctx, &ctx->tasks_reclaim_work);
+
+	for (i = 0; i < XIO_PROTO_LAST; i++)
+		xio_tasks_pool_reclaim(ctx->primary_tasks_pool[i]);
+
+	xio_ctx_add_delayed_work(
+		ctx,
+		max(ctx->tasks_pool_idle_ms / TASKS_POOL_RECLAIM_TICKS, 1),
+		ctx, xio_ctx_tasks_pools_reclaim, &ctx->tasks_reclaim_work);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_ctx_pool_create							     */
 /*---------------------------------------------------------------------------*/
@@ -767,6 +1162,9 @@ int xio_ctx_pool_create(struct xio_context *ctx, enum xio_proto proto,
 		params.start_nr = params.max_nr;
 		params.alloc_nr = 0;
 	}
+	else if (ctx->tasks_pool_idle_ms &&
+		 pool_cls == XIO_CONTEXT_POOL_CLASS_PRIMARY)
+		params.idle_reclaim_ticks = TASKS_POOL_RECLAIM_TICKS;
 	params.pool_hooks.slab_pre_create  =
 		(int (*)(void *, int, void *, void *))
 				pool_ops->slab_pre_create;
@@ -803,6 +1201,15 @@ int xio_ctx_pool_create(struct xio_context *ctx, enum xio_proto proto,
 		return -1;
 	}
 
+	/* one sweep per context reclaims idle slabs of all primary pools */
+	if (params.idle_reclaim_ticks)
+		xio_ctx_add_delayed_work(
+			ctx,
+			max(ctx->tasks_pool_idle_ms / TASKS_POOL_RECLAIM_TICKS,
+			    1),
+			ctx, xio_ctx_tasks_pools_reclaim,
+			&ctx->tasks_reclaim_work);
+
 	return 0;
 }
 
@@ -45,8 +45,20 @@
 #include "get_clock.h"
 #include "xio_ev_data.h"
 #include "xio_ev_loop.h"
+#include "xio_uring.h"
 
 #define MAX_DELETED_EVENTS	1024
+#define SPIN_MIN_BUDGET_US	2
+#define URING_ENTRIES		4096
+
+/* io_uring user_data: event pointer in the low bits and the event's
+ * generation in the high bits, so completions of superseded requests can be
+ * recognized without touching the (possibly freed) event
+ */
+#define URING_UDATA_WAKEUP	0ULL
+#define URING_UDATA_IGNORE	1ULL
+#define URING_GEN_SHIFT		48
+#define URING_PTR_MASK		((1ULL << URING_GEN_SHIFT) - 1)
 
 /*---------------------------------------------------------------------------*/
 /* structs                                                                   */
@@ -61,11 +73,36 @@ struct xio_ev_loop {
 
 	int				wakeup_event;
 	int				deleted_events_nr;
+
+	/* busy-poll phase preceding the blocking wait */
+	int				spin_budget_us;
+	int				spin_cur_us;
+	int				spin_adaptive;
+	int				spin_pad;
+	xio_event_handler_t		spin_poll_fn;
+	void				*spin_poll_data;
+	uint64_t			spin_hits;
+	uint64_t			spin_misses;
+	cycles_t			blocked_cycles;
+
+	/* io_uring backend, NULL when running over epoll */
+	struct xio_uring		*uring;
+	struct list_head		uring_zombies_list;
+
 	struct list_head		poll_events_list;
 	struct list_head		events_list;
 	struct xio_ev_data		*deleted_events[MAX_DELETED_EVENTS];
 };
 
+struct xio_ev_uring_data {
+	struct xio_ev_data		ev;
+	uint32_t			events;
+	uint16_t			armed;	/* requests in the ring */
+	uint16_t			gen;
+	uint32_t			deleted;
+	uint32_t			pad;
+};
+
 /*---------------------------------------------------------------------------*/
 /* epoll_to_xio_poll_events                                                  */
 /*---------------------------------------------------------------------------*/
@@ -116,6 +153,113 @@ static inline uint32_t xio_to_epoll_poll_events(uint32_t xio_events)
 	return epoll_events;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_ev_uring_udata							     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t xio_ev_uring_udata(struct xio_ev_uring_data *uev)
+{
+	return uint64_from_ptr(uev) | ((uint64_t)uev->gen << URING_GEN_SHIFT);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_uring_arm						     */
+/*---------------------------------------------------------------------------*/
+/* level-triggered events are armed as single-shot polls and re-armed after
+ * each dispatch, which re-evaluates readiness the same way epoll does.
+ * multishot polls are edge-triggered, thus used only for XIO_POLLET
+ */
+static int xio_ev_loop_uring_arm(struct xio_ev_loop *loop,
+				 struct xio_ev_uring_data *uev)
+{
+	uint32_t	mask;
+	int		multishot;
+
+	mask = xio_to_epoll_poll_events(uev->events) &
+		~(EPOLLET | EPOLLONESHOT);
+	if (!mask)
+		return 0;
+
+	multishot = (uev->events & XIO_POLLET) &&
+		    !(uev->events & XIO_ONESHOT);
+	if (xio_uring_poll_add(loop->uring, uev->ev.fd, mask, multishot,
+			       xio_ev_uring_udata(uev)))
+		return -1;
+	uev->armed++;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_uring_disarm						     */
+/*---------------------------------------------------------------------------*/
+static int xio_ev_loop_uring_disarm(struct xio_ev_loop *loop,
+				    struct xio_ev_uring_data *uev)
+{
+	int retval = 0;
+
+	if (uev->armed)
+		retval = xio_uring_poll_remove(loop->uring,
+					       xio_ev_uring_udata(uev),
+					       URING_UDATA_IGNORE);
+	/* completions of the old request are ignored from now on */
+	uev->gen++;
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_uring_free_zombies					     */
+/*---------------------------------------------------------------------------*/
+static void xio_ev_loop_uring_free_zombies(struct xio_ev_loop *loop)
+{
+	struct xio_ev_uring_data *uev, *tmp_uev;
+
+	list_for_each_entry_safe(uev, tmp_uev, &loop->uring_zombies_list,
+				 ev.events_list_entry) {
+		if (uev->armed)
+			continue;
+		list_del(&uev->ev.events_list_entry);
+		ufree(uev);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_uring_add						     */
+/*---------------------------------------------------------------------------*/
+static int xio_ev_loop_uring_add(struct xio_ev_loop *loop, int fd, int events,
+				 xio_ev_handler_t handler, void *data)
+{
+	struct xio_ev_uring_data	*uev;
+	struct xio_ev_data		*tev;
+
+	list_for_each_entry(tev, &loop->poll_events_list, events_list_entry) {
+		if (tev->fd == fd) {
+			xio_set_error(EEXIST);
+			DEBUG_LOG("event already exists fd:%d\n", fd);
+			return -1;
+		}
+	}
+
+	uev = (struct xio_ev_uring_data *)ucalloc(1, sizeof(*uev));
+	if (!uev) {
+		xio_set_error(errno);
+		ERROR_LOG("calloc failed, %m\n");
+		return -1;
+	}
+	uev->ev.data		= data;
+	uev->ev.ev_handler	= handler;
+	uev->ev.fd		= fd;
+	uev->events		= events;
+
+	if (xio_ev_loop_uring_arm(loop, uev)) {
+		ufree(uev);
+		return -1;
+	}
+	list_add(&uev->ev.events_list_entry, &loop->poll_events_list);
+
+	return 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_event_add                                                           */
 /*---------------------------------------------------------------------------*/
@@ -127,6 +271,13 @@ int xio_ev_loop_add(void *loop_hndl, int fd, int events,
 	struct xio_ev_data	*tev = NULL;
 	int			err;
 
+	if (loop->uring) {
+		/* wakeup event is armed on demand by xio_ev_loop_stop */
+		if (fd == loop->wakeup_event)
+			return 0;
+		return xio_ev_loop_uring_add(loop, fd, events, handler, data);
+	}
+
 	memset(&ev, 0, sizeof(ev));
 	ev.events = xio_to_epoll_poll_events(events);
 
@@ -182,8 +333,30 @@ int xio_ev_loop_del(void *loop_hndl, int fd)
 {
 	struct xio_ev_loop	*loop = (struct xio_ev_loop *)loop_hndl;
 	struct xio_ev_data	*tev;
+	struct xio_ev_uring_data *uev;
 	int ret;
 
+	if (loop->uring) {
+		if (fd == loop->wakeup_event)
+			return 0;
+		tev = xio_event_lookup(loop, fd);
+		if (!tev) {
+			xio_set_error(ENOENT);
+			ERROR_LOG("event lookup failed. fd:%d\n", fd);
+			return -1;
+		}
+		uev = container_of(tev, struct xio_ev_uring_data, ev);
+		list_move(&tev->events_list_entry, &loop->uring_zombies_list);
+		uev->deleted = 1;
+		ret = xio_ev_loop_uring_disarm(loop, uev);
+		/* submit now, so the ring drops its file reference before the
+		 * caller closes the fd
+		 */
+		if (!ret && uev->armed)
+			ret = xio_uring_submit(loop->uring) < 0 ? -1 : 0;
+		return ret;
+	}
+
 	if (fd != loop->wakeup_event) {
 		tev = xio_event_lookup(loop, fd);
 		if (!tev) {
@@ -217,6 +390,7 @@ int xio_ev_loop_modify(void *loop_hndl, int fd, int events)
 	struct xio_ev_loop	*loop = (struct xio_ev_loop *)loop_hndl;
 	struct epoll_event	ev;
 	struct xio_ev_data	*tev = NULL;
+	struct xio_ev_uring_data *uev;
 	int			retval;
 
 	if (fd != loop->wakeup_event) {
@@ -228,6 +402,18 @@ int xio_ev_loop_modify(void *loop_hndl, int fd, int events)
 		}
 	}
 
+	if (loop->uring) {
+		/* wakeup event is permanently armed, see xio_ev_loop_stop */
+		if (!tev)
+			return 0;
+		/* queued only, submitted with the next wait */
+		uev = container_of(tev, struct xio_ev_uring_data, ev);
+		if (xio_ev_loop_uring_disarm(loop, uev))
+			return -1;
+		uev->events = events;
+		return xio_ev_loop_uring_arm(loop, uev);
+	}
+
 	memset(&ev, 0, sizeof(ev));
 	ev.events	= xio_to_epoll_poll_events(events);
 	ev.data.ptr	= tev;
@@ -246,6 +432,14 @@ int xio_ev_loop_modify(void *loop_hndl, int fd, int events)
 /* xio_ev_loop_create							     */
 /*---------------------------------------------------------------------------*/
 void *xio_ev_loop_create()
+{
+	return xio_ev_loop_create_ex(XIO_EV_LOOP_EPOLL);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_create_ex						     */
+/*---------------------------------------------------------------------------*/
+void *xio_ev_loop_create_ex(enum xio_ev_loop_type type)
 {
 	struct xio_ev_loop	*loop;
 	int			retval;
@@ -260,11 +454,20 @@ void *xio_ev_loop_create()
 
 	INIT_LIST_HEAD(&loop->poll_events_list);
 	INIT_LIST_HEAD(&loop->events_list);
+	INIT_LIST_HEAD(&loop->uring_zombies_list);
 
 	loop->stop_loop		= 0;
 	loop->wakeup_armed	= 0;
 	loop->deleted_events_nr = 0;
-	loop->efd		= epoll_create(4096);
+	if (type == XIO_EV_LOOP_IO_URING) {
+		loop->uring = xio_uring_create(URING_ENTRIES);
+		if (!loop->uring)
+			WARN_LOG("io_uring not supported, using epoll\n");
+	}
+	if (loop->uring)
+		loop->efd	= xio_uring_get_fd(loop->uring);
+	else
+		loop->efd	= epoll_create(4096);
 	if (loop->efd == -1) {
 		xio_set_error(errno);
 		ERROR_LOG("epoll_create failed. %m\n");
@@ -278,6 +481,18 @@ void *xio_ev_loop_create()
 		ERROR_LOG("eventfd failed. %m\n");
 		goto cleanup1;
 	}
+	if (loop->uring) {
+		/* io_uring requests can't be queued from foreign threads,
+		 * so the wakeup eventfd is polled permanently and stop just
+		 * signals it
+		 */
+		retval = xio_uring_poll_add(loop->uring, loop->wakeup_event,
+					    EPOLLIN, 1, URING_UDATA_WAKEUP);
+		if (retval != 0 || xio_uring_submit(loop->uring) < 0)
+			goto cleanup2;
+		return loop;
+	}
+
 	/* ADD & SET the wakeup fd and once application wants to arm
 	 * just MODify the already prepared eventfd to the epoll */
 	xio_ev_loop_add(loop, loop->wakeup_event, 0, NULL, NULL);
@@ -290,7 +505,10 @@ void *xio_ev_loop_create()
 cleanup2:
 	close(loop->wakeup_event);
 cleanup1:
-	close(loop->efd);
+	if (loop->uring)
+		xio_uring_destroy(loop->uring);
+	else
+		close(loop->efd);
 cleanup:
 	ufree(loop);
 	return NULL;
@@ -390,20 +608,206 @@ static inline int xio_ev_loop_deleted_event_lookup(struct xio_ev_loop *loop,
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_epoll_dispatch						     */
+/*---------------------------------------------------------------------------*/
+static int xio_ev_loop_epoll_dispatch(struct xio_ev_loop *loop, int tmout)
+{
+	int			nevent, i;
+	struct epoll_event	events[1024];
+	struct xio_ev_data	*tev;
+	uint32_t		out_events;
+
+	nevent = epoll_wait(loop->efd, events, ARRAY_SIZE(events), tmout);
+	if (nevent <= 0)
+		return nevent;
+
+	/* save the epoll modify in "stop" while dispatching handlers */
+	loop->in_dispatch = 1;
+	for (i = 0; i < nevent; i++) {
+		tev = (struct xio_ev_data *)events[i].data.ptr;
+		if (likely(tev)) {
+			/* skip handlers deleted earlier in this batch; the
+			 * rest must run, edge-triggered events do not repeat
+			 */
+			if (unlikely(loop->deleted_events_nr) &&
+			    xio_ev_loop_deleted_event_lookup(loop, tev))
+				continue;
+			out_events = epoll_to_xio_poll_events(
+							events[i].events);
+			/* (fd != loop->wakeup_event) */
+			tev->ev_handler(tev->fd, out_events, tev->data);
+		} else {
+			/* wakeup event auto-removed from epoll
+			 * due to ONESHOT
+			 * */
+
+			/* check wakeup is armed to prevent false
+			 * wake ups
+			 * */
+			if (loop->wakeup_armed == 1) {
+				loop->wakeup_armed = 0;
+				loop->stop_loop = 1;
+			}
+		}
+	}
+	loop->in_dispatch = 0;
+
+	return nevent;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_uring_dispatch						     */
+/*---------------------------------------------------------------------------*/
+static int xio_ev_loop_uring_dispatch(struct xio_ev_loop *loop, int tmout)
+{
+	struct xio_uring_cqe		cqes[1024];
+	struct xio_ev_uring_data	*uev;
+	uint64_t			udata;
+	uint16_t			gen;
+	int				i, ncqe, final;
+
+	ncqe = xio_uring_wait(loop->uring, cqes, ARRAY_SIZE(cqes), tmout);
+	if (ncqe <= 0)
+		return ncqe;
+
+	loop->in_dispatch = 1;
+	for (i = 0; i < ncqe; i++) {
+		udata = cqes[i].user_data;
+		if (udata == URING_UDATA_IGNORE)
+			continue;
+		if (udata == URING_UDATA_WAKEUP) {
+			eventfd_t val;
+
+			(void)eventfd_read(loop->wakeup_event, &val);
+			if (!(cqes[i].flags & XIO_URING_CQE_F_MORE))
+				xio_uring_poll_add(loop->uring,
+						   loop->wakeup_event, EPOLLIN,
+						   1, URING_UDATA_WAKEUP);
+			/* check wakeup is armed to prevent false wake ups */
+			if (loop->wakeup_armed == 1) {
+				loop->wakeup_armed = 0;
+				loop->stop_loop = 1;
+			}
+			continue;
+		}
+		uev = (struct xio_ev_uring_data *)
+				ptr_from_int64(udata & URING_PTR_MASK);
+		final = !(cqes[i].flags & XIO_URING_CQE_F_MORE);
+		if (final)
+			uev->armed--;
+
+		/* deleted or superseded by xio_ev_loop_modify */
+		if (uev->deleted ||
+		    (uint16_t)(udata >> URING_GEN_SHIFT) != uev->gen)
+			continue;
+
+		if (unlikely(cqes[i].res < 0)) {
+			ERROR_LOG("io_uring poll failed. fd:%d, err:%d\n",
+				  uev->ev.fd, -cqes[i].res);
+			continue;
+		}
+
+		gen = uev->gen;
+		uev->ev.ev_handler(uev->ev.fd,
+				   epoll_to_xio_poll_events(cqes[i].res),
+				   uev->ev.data);
+
+		/* the handler may have deleted or modified the event */
+		if (final && !uev->deleted && uev->gen == gen &&
+		    !(uev->events & XIO_ONESHOT))
+			xio_ev_loop_uring_arm(loop, uev);
+	}
+	loop->in_dispatch = 0;
+
+	return ncqe;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_dispatch							     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_ev_loop_dispatch(struct xio_ev_loop *loop, int tmout)
+{
+	if (loop->uring)
+		return xio_ev_loop_uring_dispatch(loop, tmout);
+
+	return xio_ev_loop_epoll_dispatch(loop, tmout);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_free_deleted						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_ev_loop_free_deleted(struct xio_ev_loop *loop)
+{
+	while (loop->deleted_events_nr)
+		ufree(loop->deleted_events[--loop->deleted_events_nr]);
+
+	if (loop->uring && !list_empty(&loop->uring_zombies_list))
+		xio_ev_loop_uring_free_zombies(loop);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_spin							     */
+/*---------------------------------------------------------------------------*/
+/* busy-poll the transports hook and the event set without blocking, for at
+ * most the current spin budget. returns 1 on hit (nevent holds the dispatch
+ * result, which may be 0 if only scheduled work became pending) and 0 if the
+ * budget expired and the caller should block
+ */
+static int xio_ev_loop_spin(struct xio_ev_loop *loop, int timeout,
+			    int *nevent)
+{
+	cycles_t	start_cycle = get_cycles();
+	cycles_t	budget = (cycles_t)(loop->spin_cur_us * g_mhz);
+	int		hit = 0;
+
+	if (timeout > 0 && budget > (cycles_t)(timeout * 1000 * g_mhz))
+		budget = (cycles_t)(timeout * 1000 * g_mhz);
+
+	for (;;) {
+		if (loop->spin_poll_fn)
+			loop->spin_poll_fn(loop->spin_poll_data);
+
+		*nevent = xio_ev_loop_dispatch(loop, 0);
+		if (*nevent != 0 || !list_empty(&loop->events_list) ||
+		    loop->stop_loop) {
+			hit = 1;
+			break;
+		}
+		if (get_cycles() - start_cycle > budget)
+			break;
+	}
+
+	if (hit) {
+		loop->spin_hits++;
+		if (loop->spin_adaptive)
+			loop->spin_cur_us = min(loop->spin_cur_us * 2,
+						loop->spin_budget_us);
+	} else {
+		loop->spin_misses++;
+		/* never above the budget the application configured */
+		if (loop->spin_adaptive)
+			loop->spin_cur_us = max(loop->spin_cur_us / 2,
+						min(SPIN_MIN_BUDGET_US,
+						    loop->spin_budget_us));
+	}
+
+	return hit;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_ev_loop_run_helper                                                    */
 /*---------------------------------------------------------------------------*/
 static inline int xio_ev_loop_run_helper(void *loop_hndl, int timeout)
 {
 	struct xio_ev_loop	*loop = (struct xio_ev_loop *)loop_hndl;
-	int			nevent = 0, i, found = 0;
-	struct epoll_event	events[1024];
-	struct xio_ev_data	*tev;
+	int			nevent = 0;
 	int			work_remains;
 	int			tmout;
 	int			wait_time = timeout;
-	uint32_t		out_events;
+	int			spun;
 	cycles_t		start_cycle  = 0;
+	cycles_t		block_cycle;
 
 	if (timeout != -1)
 		start_cycle = get_cycles();
@@ -413,56 +817,28 @@ retry:
 	tmout = work_remains ? 0 : timeout;
 
 	/* free deleted event handlers */
-	if (unlikely(loop->deleted_events_nr))
-		while (loop->deleted_events_nr)
-			ufree(loop->deleted_events[--loop->deleted_events_nr]);
-
-	nevent = epoll_wait(loop->efd, events, ARRAY_SIZE(events), tmout);
+	xio_ev_loop_free_deleted(loop);
+
+	spun = 0;
+	if (tmout != 0 && loop->spin_cur_us)
+		spun = xio_ev_loop_spin(loop, tmout, &nevent);
+	if (!spun) {
+		if (tmout != 0) {
+			block_cycle = get_cycles();
+			nevent = xio_ev_loop_dispatch(loop, tmout);
+			loop->blocked_cycles += get_cycles() - block_cycle;
+		} else {
+			nevent = xio_ev_loop_dispatch(loop, 0);
+		}
+	}
 	if (unlikely(nevent < 0)) {
 		if (errno != EINTR) {
 			xio_set_error(errno);
-			ERROR_LOG("epoll_wait failed. %m\n");
+			ERROR_LOG("event dispatcher wait failed. %m\n");
 			return -1;
 		}
 		goto retry;
-	} else if (nevent > 0) {
-		/* save the epoll modify in "stop" while dispatching handlers */
-		loop->in_dispatch = 1;
-		for (i = 0; i < nevent; i++) {
-			tev = (struct xio_ev_data *)events[i].data.ptr;
-			if (likely(tev)) {
-				/* look for deleted event handlers */
-				if (unlikely(loop->deleted_events_nr)) {
-					found =
-					  xio_ev_loop_deleted_event_lookup(
-								   loop, tev);
-					if (found)
-						break;
-
-					continue;
-				}
-				out_events =
-					epoll_to_xio_poll_events(
-							events[i].events);
-				/* (fd != loop->wakeup_event) */
-				tev->ev_handler(tev->fd, out_events,
-						tev->data);
-			} else {
-				/* wakeup event auto-removed from epoll
-				 * due to ONESHOT
-				 * */
-
-				/* check wakeup is armed to prevent false
-				 * wake ups
-				 * */
-				if (loop->wakeup_armed == 1) {
-					loop->wakeup_armed = 0;
-					loop->stop_loop = 1;
-				}
-			}
-		}
-		loop->in_dispatch = 0;
-	} else {
+	} else if (nevent == 0 && !spun) {
 		/* timed out */
 		if (tmout || timeout == 0)
 			loop->stop_loop = 1;
@@ -488,16 +864,80 @@ retry:
 			xio_ev_loop_exec_scheduled(loop);
 
 		/* free deleted event handlers */
-		while (loop->deleted_events_nr)
-			ufree(loop->deleted_events[--loop->deleted_events_nr]);
+		xio_ev_loop_free_deleted(loop);
 	}
 
+	/* requests re-armed while dispatching must reach the kernel so an
+	 * external dispatcher polling the ring fd sees their completions
+	 */
+	if (loop->uring)
+		xio_uring_submit(loop->uring);
+
 	loop->stop_loop = 0;
 	loop->wakeup_armed = 0;
 
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_set_spin							     */
+/*---------------------------------------------------------------------------*/
+void xio_ev_loop_set_spin(void *loop_hndl, int budget_us, int adaptive)
+{
+	struct xio_ev_loop	*loop = (struct xio_ev_loop *)loop_hndl;
+
+	loop->spin_budget_us	= max(budget_us, 0);
+	loop->spin_cur_us	= loop->spin_budget_us;
+	loop->spin_adaptive	= !!adaptive;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_get_spin							     */
+/*---------------------------------------------------------------------------*/
+void xio_ev_loop_get_spin(void *loop_hndl, int *budget_us, int *adaptive)
+{
+	struct xio_ev_loop	*loop = (struct xio_ev_loop *)loop_hndl;
+
+	*budget_us	= loop->spin_budget_us;
+	*adaptive	= loop->spin_adaptive;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_set_spin_poll_fn						     */
+/*---------------------------------------------------------------------------*/
+void xio_ev_loop_set_spin_poll_fn(void *loop_hndl,
+				  xio_event_handler_t poll_fn, void *data)
+{
+	struct xio_ev_loop	*loop = (struct xio_ev_loop *)loop_hndl;
+
+	loop->spin_poll_fn	= poll_fn;
+	loop->spin_poll_data	= data;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_get_spin_stats						     */
+/*---------------------------------------------------------------------------*/
+void xio_ev_loop_get_spin_stats(void *loop_hndl,
+				struct xio_context_spin_stats *stats)
+{
+	struct xio_ev_loop	*loop = (struct xio_ev_loop *)loop_hndl;
+
+	stats->spin_hits	= loop->spin_hits;
+	stats->spin_misses	= loop->spin_misses;
+	stats->blocked_us	= (uint64_t)(loop->blocked_cycles / g_mhz);
+	stats->spin_cur_us	= loop->spin_cur_us;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_get_type							     */
+/*---------------------------------------------------------------------------*/
+enum xio_ev_loop_type xio_ev_loop_get_type(void *loop_hndl)
+{
+	struct xio_ev_loop	*loop = (struct xio_ev_loop *)loop_hndl;
+
+	return loop->uring ? XIO_EV_LOOP_IO_URING : XIO_EV_LOOP_EPOLL;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_ev_loop_run_timeout						     */
 /*---------------------------------------------------------------------------*/
@@ -533,8 +973,11 @@ inline void xio_ev_loop_stop(void *loop_hndl)
 		return; /* wakeup is still armed, probably left loop in previous
 			   cycle due to other reasons (timeout, events) */
 	loop->wakeup_armed = 1;
-	xio_ev_loop_modify(loop, loop->wakeup_event,
-			   XIO_POLLIN | XIO_ONESHOT);
+	if (loop->uring)
+		eventfd_write(loop->wakeup_event, 1);
+	else
+		xio_ev_loop_modify(loop, loop->wakeup_event,
+				   XIO_POLLIN | XIO_ONESHOT);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -566,7 +1009,19 @@ void xio_ev_loop_destroy(void *loop_hndl)
 
 	xio_ev_loop_del(loop, loop->wakeup_event);
 
-	close(loop->efd);
+	if (loop->uring) {
+		/* closing the ring cancels all outstanding requests */
+		xio_uring_destroy(loop->uring);
+		loop->uring = NULL;
+		list_for_each_entry_safe(tev, tmp_tev,
+					 &loop->uring_zombies_list,
+					 events_list_entry) {
+			list_del(&tev->events_list_entry);
+			ufree(container_of(tev, struct xio_ev_uring_data, ev));
+		}
+	} else {
+		close(loop->efd);
+	}
 	loop->efd = -1;
 
 	close(loop->wakeup_event);
@@ -52,6 +52,25 @@
  */
 void *xio_ev_loop_create(void);
 
+/**
+ * initializes event loop handle of the requested type
+ *
+ * @param[in] type	the dispatcher implementation. io_uring falls back
+ *			to epoll if not supported by the running kernel
+ *
+ * @returns event loop handle or NULL upon error
+ */
+void *xio_ev_loop_create_ex(enum xio_ev_loop_type type);
+
+/**
+ * get the dispatcher implementation actually in use
+ *
+ * @param[in] loop	Pointer to the event dispatcher
+ *
+ * @returns the event loop type
+ */
+enum xio_ev_loop_type xio_ev_loop_get_type(void *loop);
+
 /**
  * xio_ev_loop_run - event loop main loop
  *
@@ -204,5 +223,51 @@ void xio_ev_loop_remove_event(struct xio_ev_data *evt);
  */
 int xio_ev_loop_is_pending_event(struct xio_ev_data *evt);
 
+/**
+ * configure the busy-poll phase that precedes each blocking wait
+ *
+ * @param[in] loop	  the dispatcher context
+ * @param[in] budget_us	  maximum spin duration in microseconds, 0 disables
+ * @param[in] adaptive	  adjust the spin duration by the recent hit/miss
+ *			  history, bounded by budget_us
+ *
+ * @returns none
+ */
+void xio_ev_loop_set_spin(void *loop, int budget_us, int adaptive);
+
+/**
+ * get the busy-poll phase configuration
+ *
+ * @param[in] loop	  the dispatcher context
+ * @param[out] budget_us  maximum spin duration in microseconds
+ * @param[out] adaptive	  whether the spin duration is adaptive
+ *
+ * @returns none
+ */
+void xio_ev_loop_get_spin(void *loop, int *budget_us, int *adaptive);
+
+/**
+ * set a hook that is invoked on every spin iteration (e.g. poll hw queues)
+ *
+ * @param[in] loop	  the dispatcher context
+ * @param[in] poll_fn	  the poll hook
+ * @param[in] data	  the hook's private data
+ *
+ * @returns none
+ */
+void xio_ev_loop_set_spin_poll_fn(void *loop,
+				  xio_event_handler_t poll_fn, void *data);
+
+/**
+ * get busy-poll statistics
+ *
+ * @param[in] loop	  the dispatcher context
+ * @param[out] stats	  the statistics
+ *
+ * @returns none
+ */
+void xio_ev_loop_get_spin_stats(void *loop,
+				struct xio_context_spin_stats *stats);
+
 #endif
 
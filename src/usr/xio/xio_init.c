@@ -46,6 +46,7 @@
 #include "xio_transport.h"
 #include "xio_idr.h"
 #include "xio_init.h"
+#include "xio_stats_shm.h"
 
 int		page_size;
 double		g_mhz;
@@ -57,6 +58,7 @@ extern struct xio_transport xio_rdma_transport;
 
 struct xio_transport *xio_rdma_get_transport_func_list(void);
 struct xio_transport *xio_tcp_get_transport_func_list(void);
+struct xio_transport *xio_shm_get_transport_func_list(void);
 
 typedef struct xio_transport *(*get_transport_func_list_t)(void);
 
@@ -64,7 +66,8 @@ static get_transport_func_list_t  transport_func_list_tbl[] = {
 #ifdef HAVE_INFINIBAND_VERBS_H
 	xio_rdma_get_transport_func_list,
 #endif
-	xio_tcp_get_transport_func_list
+	xio_tcp_get_transport_func_list,
+	xio_shm_get_transport_func_list
 };
 
 #define  transport_tbl_sz (sizeof(transport_func_list_tbl) \
@@ -96,6 +99,8 @@ static void xio_dtor(void)
 		xio_unreg_transport(transport_tbl[i]);
 	}
 	xio_idr_destroy(usr_idr);
+	xio_stats_shm_destroy();
+	xio_log_async_cleanup();
 	xio_thread_data_destruct();
 	xio_env_cleanup();
 }
@@ -38,40 +38,34 @@
 #include <xio_os.h>
 #include "libxio.h"
 #include "xio_log.h"
+#include "xio_common.h"
+#include "xio_tls.h"
 
 void xio_vlog(const char *file, unsigned line, const char *function,
 	      unsigned level, const char *fmt, ...);
 
 enum xio_log_level	xio_logging_level = XIO_LOG_LEVEL_ERROR;
 xio_log_fn		xio_vlog_fn = xio_vlog;
+xio_log_fn		xio_log_sink = xio_vlog;
 
 #define LOG_TIME_FMT "%04d/%02d/%02d-%02d:%02d:%02d.%05ld"
 
+static const char * const level_str[] = {
+	"FATAL", "ERROR", "WARN", "INFO", "DEBUG", "TRACE"
+};
+
 /*---------------------------------------------------------------------------*/
-/* xio_vlog								     */
+/* xio_vlog_print							     */
 /*---------------------------------------------------------------------------*/
-void xio_vlog(const char *file, unsigned line, const char *function,
-	      unsigned level, const char *fmt, ...)
+static void xio_vlog_print(const struct timeval *tv, const char *file,
+			   unsigned line, unsigned level, const char *msg)
 {
-	va_list			args;
 	const char		*short_file;
-	struct timeval		tv;
 	struct tm		t;
-	char			buf[2048];
 	char			buf2[256];
-	int			length = 0;
-	static const char * const level_str[] = {
-		"FATAL", "ERROR", "WARN", "INFO", "DEBUG", "TRACE"
-	};
-	time_t time1;
-
-	va_start(args, fmt);
-	length = vsnprintf(buf, sizeof(buf), fmt, args);
-	va_end(args);
-	buf[length] = 0;
+	time_t			time1;
 
-	gettimeofday(&tv, NULL);
-	time1 = (time_t)tv.tv_sec;
+	time1 = (time_t)tv->tv_sec;
 	localtime_r(&time1, &t);
 
 	short_file = strrchr(file, '/');
@@ -86,21 +80,599 @@ void xio_vlog(const char *file, unsigned line, const char *function,
 	fprintf(stderr,
 		"[" LOG_TIME_FMT "] %-28s [%-5s] - %s",
 		t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-		t.tm_hour, t.tm_min, t.tm_sec, tv.tv_usec,
+		t.tm_hour, t.tm_min, t.tm_sec, (long)tv->tv_usec,
 		buf2,
-		level_str[level], buf);
+		level_str[level], msg);
 
 	fflush(stderr);
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_vlog								     */
+/*---------------------------------------------------------------------------*/
+void xio_vlog(const char *file, unsigned line, const char *function,
+	      unsigned level, const char *fmt, ...)
+{
+	va_list			args;
+	struct timeval		tv;
+	char			buf[2048];
+	int			length = 0;
+
+	va_start(args, fmt);
+	length = vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+	if (length >= (int)sizeof(buf))
+		length = sizeof(buf) - 1;
+	buf[length] = 0;
+
+	gettimeofday(&tv, NULL);
+	xio_vlog_print(&tv, file, line, level, buf);
+}
+
+/*
+ * Asynchronous logging. xio_vlog_fn is pointed at xio_vlog_async, which
+ * copies the format pointer and the raw arguments into a record of the
+ * calling thread's ring - strings are copied, nothing is formatted. A
+ * flusher thread drains all rings, formats the records and hands them
+ * to xio_log_sink (xio_vlog or the user's XIO_OPTNAME_LOG_FN). When a
+ * ring is full the record is dropped and counted, the flusher reports
+ * the drops. FATAL messages bypass the rings. Records still queued are
+ * flushed when async logging is disabled or by xio_shutdown.
+ */
+#define XIO_LOG_REC_SIZE	256
+#define XIO_LOG_REC_WORDS	((XIO_LOG_REC_SIZE - 48) / sizeof(uint64_t))
+#define XIO_LOG_RING_DEPTH	512	/* power of 2 */
+#define XIO_LOG_FLUSH_USECS	10000
+
+struct xio_log_rec {
+	const char		*file;
+	const char		*function;
+	const char		*fmt;		/* NULL - data is text */
+	uint64_t		cycles;		/* converted at flush */
+	uint32_t		line;
+	uint16_t		level;
+	uint16_t		pad;
+	int32_t			err;		/* errno, for %m */
+	int32_t			pad1;
+	uint64_t		data[XIO_LOG_REC_WORDS];
+};
+
+struct xio_log_ring {
+	struct list_head	ring_list_entry;
+	/* consumer */
+	uint64_t		head;
+	uint64_t		reported;
+	char			pad0[64 - 2 * sizeof(uint64_t) -
+				     sizeof(struct list_head)];
+	/* producer */
+	uint64_t		tail;
+	uint64_t		dropped;
+	int			dead;		/* owner thread exited */
+	int			pad1;
+	char			pad2[64 - 3 * sizeof(uint64_t)];
+	struct xio_log_rec	recs[XIO_LOG_RING_DEPTH];
+};
+
+enum xio_log_arg {
+	XIO_LOG_ARG_NONE,		/* %% */
+	XIO_LOG_ARG_INT,
+	XIO_LOG_ARG_LONG,
+	XIO_LOG_ARG_LLONG,
+	XIO_LOG_ARG_SIZE,
+	XIO_LOG_ARG_DOUBLE,
+	XIO_LOG_ARG_PTR,
+	XIO_LOG_ARG_STR,
+	XIO_LOG_ARG_ERRNO,		/* %m */
+	XIO_LOG_ARG_BAD
+};
+
+static pthread_mutex_t		log_rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static LIST_HEAD(log_rings);
+static pthread_key_t		log_ring_key;
+static int			log_ring_key_valid;
+static pthread_t		log_flusher;
+static int			log_async;
+static volatile int		log_flusher_stop;
+static uint64_t			log_dropped_dead;
+static uint32_t			log_ring_gen;	/* bumped when rings are freed */
+static xio_tls struct xio_log_ring *log_ring;
+static xio_tls uint32_t		log_ring_tls_gen;
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_parse_spec							     */
+/*---------------------------------------------------------------------------*/
+/* fmt points after '%'. returns the end of the conversion specification */
+static const char *xio_log_parse_spec(const char *fmt, int *stars,
+				      enum xio_log_arg *arg)
+{
+	int lng = 0, size = 0, dbl_long = 0;
+
+	*stars = 0;
+	while (*fmt && strchr("-+ #0'", *fmt))
+		fmt++;
+	if (*fmt == '*') {
+		(*stars)++;
+		fmt++;
+	}
+	while (isdigit((unsigned char)*fmt))
+		fmt++;
+	if (*fmt == '.') {
+		fmt++;
+		if (*fmt == '*') {
+			(*stars)++;
+			fmt++;
+		}
+		while (isdigit((unsigned char)*fmt))
+			fmt++;
+	}
+	while (*fmt && strchr("hlLqjzt", *fmt)) {
+		if (*fmt == 'l' || *fmt == 'q')
+			lng++;
+		else if (*fmt == 'L')
+			dbl_long = 1;
+		else if (*fmt != 'h')
+			size = 1;
+		fmt++;
+	}
+	switch (*fmt) {
+	case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+		if (size)
+			*arg = XIO_LOG_ARG_SIZE;
+		else
+			*arg = lng > 1 ? XIO_LOG_ARG_LLONG :
+			       lng ? XIO_LOG_ARG_LONG : XIO_LOG_ARG_INT;
+		break;
+	case 'e': case 'E': case 'f': case 'F': case 'g': case 'G':
+	case 'a': case 'A':
+		*arg = dbl_long ? XIO_LOG_ARG_BAD : XIO_LOG_ARG_DOUBLE;
+		break;
+	case 'p':
+		*arg = XIO_LOG_ARG_PTR;
+		break;
+	case 's':
+		*arg = lng ? XIO_LOG_ARG_BAD : XIO_LOG_ARG_STR;
+		break;
+	case 'm':
+		*arg = XIO_LOG_ARG_ERRNO;
+		break;
+	case '%':
+		*arg = XIO_LOG_ARG_NONE;
+		break;
+	default:
+		*arg = XIO_LOG_ARG_BAD;
+		return fmt;
+	}
+
+	return fmt + 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_pack								     */
+/*---------------------------------------------------------------------------*/
+/* copies the arguments of fmt into rec->data. returns -1 if they do not
+ * fit or fmt uses a conversion the formatter cannot replay
+ */
+static int xio_log_pack(struct xio_log_rec *rec, const char *fmt,
+			va_list args)
+{
+	uint64_t		*word = rec->data;
+	uint64_t		*end = rec->data + XIO_LOG_REC_WORDS;
+	enum xio_log_arg	arg;
+	const char		*str;
+	size_t			len;
+	int			stars;
+	double			dbl;
+
+	while ((fmt = strchr(fmt, '%')) != NULL) {
+		fmt = xio_log_parse_spec(fmt + 1, &stars, &arg);
+		if (arg == XIO_LOG_ARG_BAD)
+			return -1;
+		if (word + stars + (arg > XIO_LOG_ARG_NONE) > end)
+			return -1;
+		while (stars--)
+			*word++ = (uint64_t)va_arg(args, int);
+		switch (arg) {
+		case XIO_LOG_ARG_INT:
+			*word++ = (uint64_t)va_arg(args, int);
+			break;
+		case XIO_LOG_ARG_LONG:
+			*word++ = (uint64_t)va_arg(args, long);
+			break;
+		case XIO_LOG_ARG_LLONG:
+			*word++ = (uint64_t)va_arg(args, long long);
+			break;
+		case XIO_LOG_ARG_SIZE:
+			*word++ = (uint64_t)va_arg(args, size_t);
+			break;
+		case XIO_LOG_ARG_DOUBLE:
+			dbl = va_arg(args, double);
+			memcpy(word++, &dbl, sizeof(dbl));
+			break;
+		case XIO_LOG_ARG_PTR:
+			*word++ = (uint64_t)(uintptr_t)va_arg(args, void *);
+			break;
+		case XIO_LOG_ARG_STR:
+			/* the string may be gone by flush time - copy it */
+			str = va_arg(args, const char *);
+			if (!str)
+				str = "(null)";
+			len = strlen(str) + 1;
+			if (len > (size_t)(end - word) * sizeof(uint64_t))
+				return -1;
+			memcpy(word, str, len);
+			word += (len + sizeof(uint64_t) - 1) /
+				sizeof(uint64_t);
+			break;
+		default:
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_unpack							     */
+/*---------------------------------------------------------------------------*/
+/* replays rec->fmt over the packed arguments into buf */
+static void xio_log_unpack(const struct xio_log_rec *rec, char *buf,
+			   size_t size)
+{
+	const uint64_t		*word = rec->data;
+	const char		*fmt = rec->fmt, *spec, *p;
+	enum xio_log_arg	arg;
+	char			sfmt[64], *s;
+	size_t			len = 0;
+	int			stars, n = 0;
+	double			dbl;
+
+	if (!fmt) {
+		snprintf(buf, size, "%s", (const char *)rec->data);
+		return;
+	}
+	while (*fmt && len < size - 1) {
+		if (*fmt != '%') {
+			buf[len++] = *fmt++;
+			continue;
+		}
+		spec = fmt;
+		fmt = xio_log_parse_spec(fmt + 1, &stars, &arg);
+
+		/* rebuild the specification with '*' replaced by the
+		 * packed width/precision
+		 */
+		s = sfmt;
+		for (p = spec; p < fmt && s < sfmt + sizeof(sfmt) - 24; p++) {
+			if (*p == '*')
+				s += sprintf(s, "%d", (int)*word++);
+			else
+				*s++ = *p;
+		}
+		*s = 0;
+
+		switch (arg) {
+		case XIO_LOG_ARG_NONE:
+			n = snprintf(buf + len, size - len, "%%");
+			break;
+		case XIO_LOG_ARG_INT:
+			n = snprintf(buf + len, size - len, sfmt, (int)*word++);
+			break;
+		case XIO_LOG_ARG_LONG:
+			n = snprintf(buf + len, size - len, sfmt,
+				     (long)*word++);
+			break;
+		case XIO_LOG_ARG_LLONG:
+			n = snprintf(buf + len, size - len, sfmt,
+				     (long long)*word++);
+			break;
+		case XIO_LOG_ARG_SIZE:
+			n = snprintf(buf + len, size - len, sfmt,
+				     (size_t)*word++);
+			break;
+		case XIO_LOG_ARG_DOUBLE:
+			memcpy(&dbl, word++, sizeof(dbl));
+			n = snprintf(buf + len, size - len, sfmt, dbl);
+			break;
+		case XIO_LOG_ARG_PTR:
+			n = snprintf(buf + len, size - len, sfmt,
+				     (void *)(uintptr_t)*word++);
+			break;
+		case XIO_LOG_ARG_STR:
+			n = snprintf(buf + len, size - len, sfmt,
+				     (const char *)word);
+			word += (strlen((const char *)word) + sizeof(uint64_t)) /
+				sizeof(uint64_t);
+			break;
+		case XIO_LOG_ARG_ERRNO:
+			n = snprintf(buf + len, size - len, "%s",
+				     strerror(rec->err));
+			break;
+		default:
+			n = 0;
+			break;
+		}
+		if (n < 0)
+			break;
+		len += n;
+		if (len > size - 1)
+			len = size - 1;
+	}
+	buf[len] = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_ring_release							     */
+/*---------------------------------------------------------------------------*/
+static void xio_log_ring_release(void *ring)
+{
+	/* thread exit - the flusher frees the ring once drained */
+	__atomic_store_n(&((struct xio_log_ring *)ring)->dead, 1,
+			 __ATOMIC_RELEASE);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_ring_get							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_log_ring *xio_log_ring_get(void)
+{
+	struct xio_log_ring *ring;
+
+	/* a ring from before the last cleanup was freed under us */
+	if (likely(log_ring && log_ring_tls_gen ==
+		   __atomic_load_n(&log_ring_gen, __ATOMIC_ACQUIRE)))
+		return log_ring;
+
+	ring = (struct xio_log_ring *)ucalloc(1, sizeof(*ring));
+	if (!ring)
+		return NULL;
+
+	pthread_mutex_lock(&log_rings_lock);
+	list_add_tail(&ring->ring_list_entry, &log_rings);
+	log_ring_tls_gen = log_ring_gen;
+	pthread_mutex_unlock(&log_rings_lock);
+	pthread_setspecific(log_ring_key, ring);
+	log_ring = ring;
+
+	return ring;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_vlog_async							     */
+/*---------------------------------------------------------------------------*/
+void xio_vlog_async(const char *file, unsigned line, const char *function,
+		    unsigned level, const char *fmt, ...)
+{
+	struct xio_log_ring	*ring;
+	struct xio_log_rec	*rec;
+	va_list			args;
+	int			err = errno;
+	char			buf[2048];
+
+	ring = (level == XIO_LOG_LEVEL_FATAL) ? NULL : xio_log_ring_get();
+	if (unlikely(!ring)) {
+		va_start(args, fmt);
+		vsnprintf(buf, sizeof(buf), fmt, args);
+		va_end(args);
+		xio_log_sink(file, line, function, level, "%s", buf);
+		return;
+	}
+	if (unlikely(ring->tail - __atomic_load_n(&ring->head,
+						  __ATOMIC_ACQUIRE) ==
+		     XIO_LOG_RING_DEPTH)) {
+		ring->dropped++;
+		return;
+	}
+	rec = &ring->recs[ring->tail & (XIO_LOG_RING_DEPTH - 1)];
+
+	rec->cycles	= get_cycles();
+	rec->file	= file;
+	rec->function	= function;
+	rec->fmt	= fmt;
+	rec->line	= line;
+	rec->level	= level;
+	rec->err	= err;
+
+	va_start(args, fmt);
+	if (xio_log_pack(rec, fmt, args)) {
+		/* too long to defer - format now, it is rare */
+		va_end(args);
+		va_start(args, fmt);
+		vsnprintf((char *)rec->data, sizeof(rec->data), fmt, args);
+		rec->fmt = NULL;
+	}
+	va_end(args);
+
+	__atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_ring_drain							     */
+/*---------------------------------------------------------------------------*/
+static void xio_log_ring_drain(struct xio_log_ring *ring)
+{
+	struct xio_log_rec	*rec;
+	struct timeval		now, tv;
+	cycles_t		now_cycles;
+	uint64_t		tail, dropped, usecs;
+	char			buf[2048];
+
+	tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	if (ring->head == tail)
+		goto dropped;
+
+	/* rebase on every pass - the tsc rate is only approximately known */
+	gettimeofday(&now, NULL);
+	now_cycles = get_cycles();
+	while (ring->head != tail) {
+		rec = &ring->recs[ring->head & (XIO_LOG_RING_DEPTH - 1)];
+		xio_log_unpack(rec, buf, sizeof(buf));
+		if (xio_log_sink == xio_vlog) {
+			/* keep the time the message was logged */
+			usecs = g_mhz > 0 ?
+				(uint64_t)((now_cycles - rec->cycles) / g_mhz) : 0;
+			usecs = now.tv_sec * 1000000ULL + now.tv_usec - usecs;
+			tv.tv_sec	= usecs / 1000000;
+			tv.tv_usec	= usecs % 1000000;
+			xio_vlog_print(&tv, rec->file, rec->line,
+				       rec->level, buf);
+		} else {
+			xio_log_sink(rec->file, rec->line, rec->function,
+				     rec->level, "%s", buf);
+		}
+		__atomic_store_n(&ring->head, ring->head + 1,
+				 __ATOMIC_RELEASE);
+	}
+dropped:
+	dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+	if (dropped != ring->reported) {
+		snprintf(buf, sizeof(buf),
+			 "log ring full, %llu messages dropped\n",
+			 (unsigned long long)(dropped - ring->reported));
+		xio_log_sink(__FILE__, __LINE__, __func__,
+			     XIO_LOG_LEVEL_WARN, "%s", buf);
+		ring->reported = dropped;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_flush							     */
+/*---------------------------------------------------------------------------*/
+static void xio_log_flush(void)
+{
+	struct xio_log_ring *ring, *tmp;
+
+	pthread_mutex_lock(&log_rings_lock);
+	list_for_each_entry_safe(ring, tmp, &log_rings, ring_list_entry) {
+		if (__atomic_load_n(&ring->dead, __ATOMIC_ACQUIRE)) {
+			xio_log_ring_drain(ring);
+			log_dropped_dead += ring->dropped;
+			list_del(&ring->ring_list_entry);
+			ufree(ring);
+			continue;
+		}
+		xio_log_ring_drain(ring);
+	}
+	pthread_mutex_unlock(&log_rings_lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_flusher							     */
+/*---------------------------------------------------------------------------*/
+static void *xio_log_flusher(void *data)
+{
+	while (!log_flusher_stop) {
+		xio_log_flush();
+		usleep(XIO_LOG_FLUSH_USECS);
+	}
+	xio_log_flush();
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_set_log_async							     */
+/*---------------------------------------------------------------------------*/
+int xio_set_log_async(int enable)
+{
+	static pthread_mutex_t	async_lock = PTHREAD_MUTEX_INITIALIZER;
+	int			retval = 0;
+
+	pthread_mutex_lock(&async_lock);
+	if (enable && !log_async) {
+		if (!log_ring_key_valid) {
+			if (pthread_key_create(&log_ring_key,
+					       xio_log_ring_release)) {
+				xio_set_error(EAGAIN);
+				retval = -1;
+				goto unlock;
+			}
+			log_ring_key_valid = 1;
+		}
+		log_flusher_stop = 0;
+		if (pthread_create(&log_flusher, NULL, xio_log_flusher,
+				   NULL)) {
+			xio_set_error(EAGAIN);
+			retval = -1;
+			goto unlock;
+		}
+		log_async = 1;
+		xio_vlog_fn = xio_vlog_async;
+	} else if (!enable && log_async) {
+		/* messages recorded from now on are not flushed */
+		xio_vlog_fn = xio_log_sink;
+		log_flusher_stop = 1;
+		pthread_join(log_flusher, NULL);
+		log_async = 0;
+	}
+unlock:
+	pthread_mutex_unlock(&async_lock);
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_get_log_async							     */
+/*---------------------------------------------------------------------------*/
+int xio_get_log_async(void)
+{
+	return log_async;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_get_log_dropped							     */
+/*---------------------------------------------------------------------------*/
+uint64_t xio_get_log_dropped(void)
+{
+	struct xio_log_ring	*ring;
+	uint64_t		dropped;
+
+	pthread_mutex_lock(&log_rings_lock);
+	dropped = log_dropped_dead;
+	list_for_each_entry(ring, &log_rings, ring_list_entry)
+		dropped += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&log_rings_lock);
+
+	return dropped;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_async_cleanup						     */
+/*---------------------------------------------------------------------------*/
+void xio_log_async_cleanup(void)
+{
+	struct xio_log_ring *ring, *tmp;
+
+	xio_set_log_async(0);
+
+	/* library unload - live threads must not touch their rings or
+	 * run the key destructor anymore. the new generation makes every
+	 * thread drop its cached ring and get a fresh one on next use
+	 */
+	pthread_mutex_lock(&log_rings_lock);
+	__atomic_store_n(&log_ring_gen, log_ring_gen + 1, __ATOMIC_RELEASE);
+	list_for_each_entry_safe(ring, tmp, &log_rings, ring_list_entry) {
+		list_del(&ring->ring_list_entry);
+		ufree(ring);
+	}
+	pthread_mutex_unlock(&log_rings_lock);
+	if (log_ring_key_valid)
+		pthread_key_delete(log_ring_key);
+	log_ring_key_valid = 0;
+	log_ring = NULL;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_read_logging_level						     */
 /*---------------------------------------------------------------------------*/
 void xio_read_logging_level(void)
 {
-	char *val = getenv("XIO_TRACE");
+	char *val = getenv("XIO_LOG_ASYNC");
 	int level  = 0;
 
+	if (val && atoi(val))
+		xio_set_log_async(1);
+
+	val = getenv("XIO_TRACE");
 	if (!val)
 		return;
 
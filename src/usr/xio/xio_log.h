@@ -56,10 +56,16 @@ extern "C" {
 /*---------------------------------------------------------------------------*/
 extern enum xio_log_level	xio_logging_level;
 extern xio_log_fn		xio_vlog_fn;
+/* formats the messages, xio_vlog_fn is set to it unless logging async */
+extern xio_log_fn		xio_log_sink;
 
 extern void xio_vlog(const char *file, unsigned line, const char *function,
 		     unsigned level, const char *fmt, ...);
 
+extern void xio_vlog_async(const char *file, unsigned line,
+			   const char *function, unsigned level,
+			   const char *fmt, ...);
+
 #define xio_log(level, fmt, ...) \
 	do { \
 		if (unlikely(((level) < XIO_LOG_LEVEL_LAST) &&  \
@@ -84,6 +90,14 @@ extern void xio_vlog(const char *file, unsigned line, const char *function,
 
 void xio_read_logging_level(void);
 
+int xio_set_log_async(int enable);
+
+int xio_get_log_async(void);
+
+uint64_t xio_get_log_dropped(void);
+
+void xio_log_async_cleanup(void);
+
 static inline int xio_set_log_level(enum xio_log_level level)
 {
 	xio_logging_level = level;
@@ -99,9 +113,11 @@ static inline enum xio_log_level xio_get_log_level(void)
 static inline int xio_set_log_fn(xio_log_fn fn)
 {
 	if (!fn)
-		xio_vlog_fn = xio_vlog;
+		xio_log_sink = xio_vlog;
 	else
-		xio_vlog_fn = fn;
+		xio_log_sink = fn;
+	if (xio_vlog_fn != xio_vlog_async)
+		xio_vlog_fn = xio_log_sink;
 
 	return 0;
 }
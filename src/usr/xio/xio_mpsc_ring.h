@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef XIO_MPSC_RING_H
+#define XIO_MPSC_RING_H
+
+/*
+ * Bounded lock-free multi producer / single consumer ring. Producers
+ * claim a cell by advancing the tail with CAS and publish it through the
+ * cell's sequence number; the single consumer needs no atomics beyond
+ * the acquire load of that sequence.
+ */
+struct xio_mpsc_entry {
+	/* either handler(obj, data) or function(data) is set */
+	void			(*handler)(void *obj, void *data);
+	void			(*function)(void *data);
+	void			*obj;
+	void			*data;
+};
+
+struct xio_mpsc_cell {
+	volatile uint64_t	seq;
+	struct xio_mpsc_entry	entry;
+};
+
+struct xio_mpsc_ring {
+	struct xio_mpsc_cell	*cells;
+	uint64_t		mask;
+	/* producers and consumer indices on separate cache lines */
+	char			pad0[64 - 2 * sizeof(uint64_t)];
+	volatile uint64_t	tail;
+	char			pad1[64 - sizeof(uint64_t)];
+	uint64_t		head;
+	char			pad2[64 - sizeof(uint64_t)];
+};
+
+/*---------------------------------------------------------------------------*/
+/* xio_mpsc_ring_init							     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_mpsc_ring_init(struct xio_mpsc_ring *ring,
+				     uint64_t depth)
+{
+	uint64_t i;
+
+	/* depth must be a power of 2 */
+	if (!depth || (depth & (depth - 1))) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+	ring->cells = (struct xio_mpsc_cell *)
+			ucalloc(depth, sizeof(*ring->cells));
+	if (!ring->cells) {
+		xio_set_error(ENOMEM);
+		return -1;
+	}
+	for (i = 0; i < depth; i++)
+		ring->cells[i].seq = i;
+	ring->mask = depth - 1;
+	ring->tail = 0;
+	ring->head = 0;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_mpsc_ring_close							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_mpsc_ring_close(struct xio_mpsc_ring *ring)
+{
+	ufree(ring->cells);
+	ring->cells = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_mpsc_ring_claim							     */
+/*---------------------------------------------------------------------------*/
+/* may be called from any thread. reserves the next cell, which the
+ * consumer does not pass until it is published. returns NULL if the ring
+ * is full
+ */
+static inline struct xio_mpsc_cell *xio_mpsc_ring_claim(
+		struct xio_mpsc_ring *ring)
+{
+	struct xio_mpsc_cell	*cell;
+	uint64_t		pos, seq;
+	int64_t			dif;
+
+	while (1) {
+		pos = xio_sync_load_relaxed64(&ring->tail);
+		cell = &ring->cells[pos & ring->mask];
+		seq = xio_sync_load_acquire64(&cell->seq);
+		dif = (int64_t)(seq - pos);
+		if (dif == 0) {
+			if (xio_sync_bool_compare_and_swap64(&ring->tail, pos,
+							     pos + 1))
+				return cell;
+		} else if (dif < 0) {
+			return NULL;
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_mpsc_ring_publish						     */
+/*---------------------------------------------------------------------------*/
+/* hands a claimed cell to the consumer, must be called exactly once */
+static inline void xio_mpsc_ring_publish(struct xio_mpsc_cell *cell,
+					 const struct xio_mpsc_entry *entry)
+{
+	cell->entry = *entry;
+	/* the claimed seq equals the position, nobody else moves it */
+	xio_sync_store_release64(&cell->seq, cell->seq + 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_mpsc_ring_push							     */
+/*---------------------------------------------------------------------------*/
+/* may be called from any thread. returns -1 if the ring is full */
+static inline int xio_mpsc_ring_push(struct xio_mpsc_ring *ring,
+				     const struct xio_mpsc_entry *entry)
+{
+	struct xio_mpsc_cell *cell = xio_mpsc_ring_claim(ring);
+
+	if (!cell)
+		return -1;
+	xio_mpsc_ring_publish(cell, entry);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_mpsc_ring_pop							     */
+/*---------------------------------------------------------------------------*/
+/* consumer only. returns -1 if the ring is empty */
+static inline int xio_mpsc_ring_pop(struct xio_mpsc_ring *ring,
+				    struct xio_mpsc_entry *entry)
+{
+	struct xio_mpsc_cell	*cell = &ring->cells[ring->head & ring->mask];
+
+	if (xio_sync_load_acquire64(&cell->seq) != ring->head + 1)
+		return -1;
+
+	*entry = cell->entry;
+	xio_sync_store_release64(&cell->seq, ring->head + ring->mask + 1);
+	ring->head++;
+
+	return 0;
+}
+
+#endif /* XIO_MPSC_RING_H */
@@ -0,0 +1,358 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sys/hashtable.h>
+#include <xio_os.h>
+#include "libxio.h"
+#include "xio_log.h"
+#include "xio_common.h"
+#include "xio_hash.h"
+#include "xio_observer.h"
+#include "xio_ev_data.h"
+#include "xio_objpool.h"
+#include "xio_workqueue.h"
+#include "xio_protocol.h"
+#include "xio_mbuf.h"
+#include "xio_task.h"
+#include "xio_transport.h"
+#include "xio_msg_list.h"
+#include "xio_sg_table.h"
+#include "xio_context.h"
+#include "xio_nexus.h"
+#include "xio_session.h"
+#include "xio_connection.h"
+#include "xio_stats_shm.h"
+
+static pthread_mutex_t			shm_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct xio_stats_shm_hdr		*shm_hdr;
+static size_t				shm_size;
+static int				shm_failed;
+static uint32_t				shm_conn_hint;
+static char				shm_name[32];
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_enabled						     */
+/*---------------------------------------------------------------------------*/
+static int xio_stats_shm_enabled(void)
+{
+	const char *val = getenv("XIO_STATS_SHM");
+
+	if (val)
+		return atoi(val) != 0;
+
+	return g_options.enable_stats_shm;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_create							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_stats_shm_hdr *xio_stats_shm_create(void)
+{
+	struct xio_stats_shm_hdr	*hdr;
+	size_t				size;
+	ssize_t				len;
+	int				fd;
+
+	size = xio_stats_shm_size(XIO_STATS_SHM_CTX_SLOTS,
+				  XIO_STATS_SHM_CONN_SLOTS);
+	snprintf(shm_name, sizeof(shm_name), "/%s%d",
+		 XIO_STATS_SHM_PREFIX, getpid());
+
+	/* readable by anyone - the reader needs no privileges */
+	fd = shm_open(shm_name, O_CREAT | O_TRUNC | O_RDWR, 0644);
+	if (fd < 0) {
+		WARN_LOG("stats segment %s open failed. %m\n", shm_name);
+		return NULL;
+	}
+	if (ftruncate(fd, (off_t)size)) {
+		WARN_LOG("stats segment %s truncate failed. %m\n", shm_name);
+		goto cleanup;
+	}
+	hdr = (struct xio_stats_shm_hdr *)mmap(NULL, size,
+					       PROT_READ | PROT_WRITE,
+					       MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED) {
+		WARN_LOG("stats segment %s mmap failed. %m\n", shm_name);
+		goto cleanup;
+	}
+	close(fd);
+
+	hdr->version	= XIO_STATS_SHM_VERSION;
+	hdr->pid	= (uint32_t)getpid();
+	hdr->ctx_slots	= XIO_STATS_SHM_CTX_SLOTS;
+	hdr->conn_slots	= XIO_STATS_SHM_CONN_SLOTS;
+	hdr->sample_ms	= XIO_STATS_SHM_SAMPLE_MS;
+
+	fd = open("/proc/self/comm", O_RDONLY);
+	if (fd >= 0) {
+		len = read(fd, hdr->comm, sizeof(hdr->comm) - 1);
+		if (len > 0 && hdr->comm[len - 1] == '\n')
+			hdr->comm[len - 1] = 0;
+		close(fd);
+	}
+	/* readers ignore the segment until the magic shows up */
+	__atomic_store_n(&hdr->magic, XIO_STATS_SHM_MAGIC, __ATOMIC_RELEASE);
+	shm_size = size;
+
+	return hdr;
+
+cleanup:
+	close(fd);
+	shm_unlink(shm_name);
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_get							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_stats_shm_hdr *xio_stats_shm_get(void)
+{
+	if (!shm_hdr && !shm_failed && xio_stats_shm_enabled()) {
+		shm_hdr = xio_stats_shm_create();
+		shm_failed = !shm_hdr;
+	}
+
+	return shm_hdr;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_slot_take						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_stats_shm_slot_take(uint32_t *gen)
+{
+	/* odd generation - live, counters were zeroed by the caller */
+	__atomic_store_n(gen, *gen + 1, __ATOMIC_RELEASE);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_sample							     */
+/*---------------------------------------------------------------------------*/
+static void xio_stats_shm_sample(void *_ctx)
+{
+	struct xio_context	*ctx = (struct xio_context *)_ctx;
+	struct xio_connection	*connection;
+	struct xio_msg		*msg;
+	uint64_t		*counters = ctx->shm_counters;
+	uint64_t		nconns = 0, used = 0, alloced = 0;
+	uint64_t		queued, in_flight;
+	int			i;
+
+	xio_ctx_del_delayed_work(ctx, &ctx->shm_sample_work);
+
+#ifdef XIO_CFLAG_STAT_COUNTERS
+	counters[XIO_SHM_CTX_TX_MSGS]	= ctx->stats.counter[XIO_STAT_TX_MSG];
+	counters[XIO_SHM_CTX_TX_BYTES]	= ctx->stats.counter[XIO_STAT_TX_BYTES];
+	counters[XIO_SHM_CTX_RX_MSGS]	= ctx->stats.counter[XIO_STAT_RX_MSG];
+	counters[XIO_SHM_CTX_RX_BYTES]	= ctx->stats.counter[XIO_STAT_RX_BYTES];
+#endif
+	for (i = 0; i < XIO_PROTO_LAST; i++) {
+		if (ctx->primary_tasks_pool[i]) {
+			used	+= ctx->primary_tasks_pool[i]->curr_used;
+			alloced	+= ctx->primary_tasks_pool[i]->curr_alloced;
+		}
+		if (ctx->initial_tasks_pool[i]) {
+			used	+= ctx->initial_tasks_pool[i]->curr_used;
+			alloced	+= ctx->initial_tasks_pool[i]->curr_alloced;
+		}
+	}
+
+	spin_lock(&ctx->ctx_list_lock);
+	list_for_each_entry(connection, &ctx->ctx_list, ctx_list_entry) {
+		nconns++;
+		if (!connection->shm_counters)
+			continue;
+		queued = 0;
+		xio_msg_list_foreach(msg, &connection->reqs_msgq, pdata)
+			queued++;
+		xio_msg_list_foreach(msg, &connection->rsps_msgq, pdata)
+			queued++;
+		in_flight = 0;
+		xio_msg_list_foreach(msg, &connection->in_flight_reqs_msgq,
+				     pdata)
+			in_flight++;
+		xio_msg_list_foreach(msg, &connection->in_flight_rsps_msgq,
+				     pdata)
+			in_flight++;
+		connection->shm_counters[XIO_SHM_CONN_TX_QUEUED] = queued;
+		connection->shm_counters[XIO_SHM_CONN_IN_FLIGHT] = in_flight;
+		connection->shm_counters[XIO_SHM_CONN_PEER_CREDITS] =
+			connection->enable_flow_control ?
+			connection->peer_credits_msgs : 0;
+		connection->shm_counters[XIO_SHM_CONN_LB_RTT_US] =
+			(uint64_t)(connection->lb_rtt_cycles / g_mhz);
+	}
+	spin_unlock(&ctx->ctx_list_lock);
+	counters[XIO_SHM_CTX_CONNECTIONS]	= nconns;
+	counters[XIO_SHM_CTX_POOL_USED]		= used;
+	counters[XIO_SHM_CTX_POOL_ALLOCED]	= alloced;
+
+	xio_ctx_add_delayed_work(ctx, XIO_STATS_SHM_SAMPLE_MS, ctx,
+				 xio_stats_shm_sample, &ctx->shm_sample_work);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_ctx_add						     */
+/*---------------------------------------------------------------------------*/
+void xio_stats_shm_ctx_add(struct xio_context *ctx)
+{
+	struct xio_stats_shm_hdr	*hdr;
+	struct xio_stats_shm_ctx	*slot = NULL;
+	uint32_t			i;
+
+	pthread_mutex_lock(&shm_lock);
+	hdr = xio_stats_shm_get();
+	if (hdr) {
+		for (i = 0; i < hdr->ctx_slots; i++) {
+			if (!(xio_stats_shm_ctx_slots(hdr)[i].gen & 1)) {
+				slot = &xio_stats_shm_ctx_slots(hdr)[i];
+				break;
+			}
+		}
+	}
+	if (slot) {
+		memset(slot->counter, 0, sizeof(slot->counter));
+		slot->cpu = ctx->cpuid;
+		xio_stats_shm_slot_take(&slot->gen);
+		ctx->shm_counters = slot->counter;
+	}
+	pthread_mutex_unlock(&shm_lock);
+
+	if (!slot) {
+		if (hdr)
+			DEBUG_LOG("stats segment has no free context slot\n");
+		return;
+	}
+	xio_ctx_add_delayed_work(ctx, XIO_STATS_SHM_SAMPLE_MS, ctx,
+				 xio_stats_shm_sample, &ctx->shm_sample_work);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_ctx_remove						     */
+/*---------------------------------------------------------------------------*/
+void xio_stats_shm_ctx_remove(struct xio_context *ctx)
+{
+	struct xio_stats_shm_ctx *slot;
+
+	if (!ctx->shm_counters)
+		return;
+
+	xio_ctx_del_delayed_work(ctx, &ctx->shm_sample_work);
+	slot = container_of(ctx->shm_counters, struct xio_stats_shm_ctx,
+			    counter[0]);
+	ctx->shm_counters = NULL;
+
+	pthread_mutex_lock(&shm_lock);
+	__atomic_store_n(&slot->gen, slot->gen + 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&shm_lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_conn_add						     */
+/*---------------------------------------------------------------------------*/
+void xio_stats_shm_conn_add(struct xio_connection *connection)
+{
+	struct xio_stats_shm_ctx	*ctx_slot;
+	struct xio_stats_shm_conn	*slots, *slot = NULL;
+	uint32_t			i, n;
+
+	/* connections of an unlisted context are not listed either */
+	if (!connection->ctx->shm_counters)
+		return;
+
+	ctx_slot = container_of(connection->ctx->shm_counters,
+				struct xio_stats_shm_ctx, counter[0]);
+
+	pthread_mutex_lock(&shm_lock);
+	slots = xio_stats_shm_conn_slots(shm_hdr);
+	n = shm_hdr->conn_slots;
+	for (i = 0; i < n; i++) {
+		if (!(slots[(shm_conn_hint + i) % n].gen & 1)) {
+			slot = &slots[(shm_conn_hint + i) % n];
+			shm_conn_hint = (shm_conn_hint + i + 1) % n;
+			break;
+		}
+	}
+	if (slot) {
+		memset(slot->counter, 0, sizeof(slot->counter));
+		memset(slot->peer, 0, sizeof(slot->peer));
+		if (connection->session && connection->session->uri)
+			strncpy(slot->peer, connection->session->uri,
+				sizeof(slot->peer) - 1);
+		slot->ctx_slot = (uint32_t)
+			(ctx_slot - xio_stats_shm_ctx_slots(shm_hdr));
+		xio_stats_shm_slot_take(&slot->gen);
+		connection->shm_counters = slot->counter;
+	}
+	pthread_mutex_unlock(&shm_lock);
+
+	if (!slot)
+		DEBUG_LOG("stats segment has no free connection slot\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_conn_remove						     */
+/*---------------------------------------------------------------------------*/
+void xio_stats_shm_conn_remove(struct xio_connection *connection)
+{
+	struct xio_stats_shm_conn *slot;
+
+	if (!connection->shm_counters)
+		return;
+
+	slot = container_of(connection->shm_counters,
+			    struct xio_stats_shm_conn, counter[0]);
+	connection->shm_counters = NULL;
+
+	pthread_mutex_lock(&shm_lock);
+	__atomic_store_n(&slot->gen, slot->gen + 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&shm_lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_destroy						     */
+/*---------------------------------------------------------------------------*/
+void xio_stats_shm_destroy(void)
+{
+	pthread_mutex_lock(&shm_lock);
+	if (shm_hdr) {
+		munmap(shm_hdr, shm_size);
+		shm_unlink(shm_name);
+		shm_hdr = NULL;
+	}
+	shm_failed = 0;
+	pthread_mutex_unlock(&shm_lock);
+}
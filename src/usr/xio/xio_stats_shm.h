@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef XIO_STATS_SHM_H
+#define XIO_STATS_SHM_H
+
+/*
+ * Per process statistics segment, /dev/shm/xio-stats.<pid>. A header is
+ * followed by an array of context slots and an array of connection
+ * slots. Every slot has a single writer, the thread running its context,
+ * which updates the counters with plain stores. A slot's generation is
+ * odd while the slot is live and is bumped on each assignment and
+ * release, so readers copy a slot and retry or skip it if the generation
+ * moved meanwhile. Gauges are sampled by the owning context once a
+ * second.
+ *
+ * The layout is shared with xio_top - bump XIO_STATS_SHM_VERSION on any
+ * change.
+ */
+#define XIO_STATS_SHM_MAGIC		0x78696f73	/* "xios" */
+#define XIO_STATS_SHM_VERSION		2
+#define XIO_STATS_SHM_PREFIX		"xio-stats."
+#define XIO_STATS_SHM_CTX_SLOTS		256
+#define XIO_STATS_SHM_CONN_SLOTS	4096
+#define XIO_STATS_SHM_PEER_LEN		56
+#define XIO_STATS_SHM_SAMPLE_MS		1000
+
+enum xio_stats_shm_ctx_counter {
+	XIO_SHM_CTX_TX_MSGS,
+	XIO_SHM_CTX_TX_BYTES,
+	XIO_SHM_CTX_RX_MSGS,
+	XIO_SHM_CTX_RX_BYTES,
+	XIO_SHM_CTX_TRANSPORT_EAGAIN,	/* transport send backpressure */
+	/* gauges */
+	XIO_SHM_CTX_CONNECTIONS,
+	XIO_SHM_CTX_POOL_USED,		/* tasks in use, all pools */
+	XIO_SHM_CTX_POOL_ALLOCED,	/* tasks allocated, all pools */
+	XIO_SHM_CTX_LAST
+};
+
+enum xio_stats_shm_conn_counter {
+	XIO_SHM_CONN_TX_MSGS,
+	XIO_SHM_CONN_TX_BYTES,
+	XIO_SHM_CONN_RX_MSGS,
+	XIO_SHM_CONN_RX_BYTES,
+	XIO_SHM_CONN_CREDIT_STALLS,	/* sends held back by peer credits */
+	XIO_SHM_CONN_EAGAIN,		/* sends refused by the nexus */
+	XIO_SHM_CONN_RECONNECTS,
+	XIO_SHM_CONN_LB_PICKS,		/* xio_session_send_request picks */
+	/* gauges */
+	XIO_SHM_CONN_TX_QUEUED,		/* messages waiting to be sent */
+	XIO_SHM_CONN_IN_FLIGHT,		/* messages sent, not completed */
+	XIO_SHM_CONN_PEER_CREDITS,	/* flow control only */
+	XIO_SHM_CONN_LB_RTT_US,		/* rsp latency ewma, p2c policy */
+	XIO_SHM_CONN_LAST
+};
+
+struct xio_stats_shm_hdr {
+	uint32_t		magic;
+	uint32_t		version;
+	uint32_t		pid;
+	uint32_t		ctx_slots;
+	uint32_t		conn_slots;
+	uint32_t		sample_ms;
+	char			comm[16];	/* process name */
+};
+
+struct xio_stats_shm_ctx {
+	uint32_t		gen;
+	int32_t			cpu;
+	uint64_t		counter[XIO_SHM_CTX_LAST];
+};
+
+struct xio_stats_shm_conn {
+	uint32_t		gen;
+	uint32_t		ctx_slot;
+	char			peer[XIO_STATS_SHM_PEER_LEN];
+	uint64_t		counter[XIO_SHM_CONN_LAST];
+};
+
+static inline struct xio_stats_shm_ctx *xio_stats_shm_ctx_slots(
+		struct xio_stats_shm_hdr *hdr)
+{
+	return (struct xio_stats_shm_ctx *)(hdr + 1);
+}
+
+static inline struct xio_stats_shm_conn *xio_stats_shm_conn_slots(
+		struct xio_stats_shm_hdr *hdr)
+{
+	return (struct xio_stats_shm_conn *)
+		(xio_stats_shm_ctx_slots(hdr) + hdr->ctx_slots);
+}
+
+static inline size_t xio_stats_shm_size(uint32_t ctx_slots,
+					uint32_t conn_slots)
+{
+	return sizeof(struct xio_stats_shm_hdr) +
+	       ctx_slots * sizeof(struct xio_stats_shm_ctx) +
+	       conn_slots * sizeof(struct xio_stats_shm_conn);
+}
+
+#ifndef XIO_STATS_SHM_READER
+struct xio_context;
+struct xio_connection;
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_add							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_stats_shm_add(uint64_t *counters, int counter,
+				     uint64_t val)
+{
+	/* NULL - segment disabled or full */
+	if (counters)
+		counters[counter] += val;
+}
+
+void xio_stats_shm_ctx_add(struct xio_context *ctx);
+
+void xio_stats_shm_ctx_remove(struct xio_context *ctx);
+
+void xio_stats_shm_conn_add(struct xio_connection *connection);
+
+void xio_stats_shm_conn_remove(struct xio_connection *connection);
+
+void xio_stats_shm_destroy(void);
+#endif
+
+#endif /* XIO_STATS_SHM_H */
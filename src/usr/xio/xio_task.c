@@ -174,6 +174,11 @@ int xio_tasks_pool_alloc_slab(struct xio_tasks_pool *q, void *context)
 	}
 	q->curr_alloced += alloc_nr;
 
+	/* the newest slab ranks last - its tasks go to the stack's tail */
+	s->first_free = s->array[0];
+	s->free_nr = alloc_nr;
+	s->idle_ticks = 0;
+
 	list_add_tail(&s->slabs_list_entry, &q->slabs_list);
 	list_splice_tail(&tmp_list, &q->stack);
 
@@ -197,6 +202,36 @@ cleanup:
 }
 EXPORT_SYMBOL(xio_tasks_pool_alloc_slab);
 
+/*---------------------------------------------------------------------------*/
+/* xio_tasks_pool_push_ordered						     */
+/*---------------------------------------------------------------------------*/
+void xio_tasks_pool_push_ordered(struct xio_tasks_pool *q,
+				 struct xio_tasks_slab *s,
+				 struct xio_task *task)
+{
+	struct xio_tasks_slab	*n = s;
+	struct list_head	*pos = &q->stack;
+
+	/* older slabs' tasks are taken first, so the newest slabs drain */
+	if (s->free_nr) {
+		pos = &s->first_free->tasks_list_entry;
+	} else {
+		list_for_each_entry_continue(n, &q->slabs_list,
+					     slabs_list_entry) {
+			if (n->free_nr) {
+				pos = &n->first_free->tasks_list_entry;
+				break;
+			}
+		}
+	}
+	/* insert in front of pos */
+	list_move_tail(&task->tasks_list_entry, pos);
+
+	s->first_free = task;
+	s->free_nr++;
+}
+EXPORT_SYMBOL(xio_tasks_pool_push_ordered);
+
 /*---------------------------------------------------------------------------*/
 /* xio_tasks_pool_create						     */
 /*---------------------------------------------------------------------------*/
@@ -244,39 +279,48 @@ struct xio_tasks_pool *xio_tasks_pool_create(
 EXPORT_SYMBOL(xio_tasks_pool_create);
 
 /*---------------------------------------------------------------------------*/
-/* xio_tasks_pool_destroy						     */
+/* xio_tasks_pool_free_slab						     */
 /*---------------------------------------------------------------------------*/
-void xio_tasks_pool_destroy(struct xio_tasks_pool *q)
+static void xio_tasks_pool_free_slab(struct xio_tasks_pool *q,
+				     struct xio_tasks_slab *pslab)
 {
-	struct xio_tasks_slab	*pslab, *next_pslab;
 	unsigned int		i;
 
-	list_for_each_entry_safe(pslab, next_pslab, &q->slabs_list,
-				 slabs_list_entry) {
-		list_del(&pslab->slabs_list_entry);
+	list_del(&pslab->slabs_list_entry);
 
-		if (q->params.pool_hooks.slab_uninit_task) {
-			for (i = 0; i < pslab->nr; i++)
-				q->params.pool_hooks.slab_uninit_task(
-						pslab->array[i]->context,
-						q->dd_data,
-						pslab->dd_data,
-						pslab->array[i]);
-		}
+	if (q->params.pool_hooks.slab_uninit_task) {
+		for (i = 0; i < pslab->nr; i++)
+			q->params.pool_hooks.slab_uninit_task(
+					pslab->array[i]->context,
+					q->dd_data,
+					pslab->dd_data,
+					pslab->array[i]);
+	}
 
-		if (q->params.pool_hooks.slab_destroy)
-			q->params.pool_hooks.slab_destroy(
-				q->params.pool_hooks.context,
-				q->dd_data,
-				pslab->dd_data);
+	if (q->params.pool_hooks.slab_destroy)
+		q->params.pool_hooks.slab_destroy(
+			q->params.pool_hooks.context,
+			q->dd_data,
+			pslab->dd_data);
 
-		/* the tmp tasks are returned back to pool */
+	/* the tmp tasks are returned back to pool */
 
-		if (pslab->huge_alloc)
-			ufree_huge_pages(pslab->array[0]);
-		else
-			ufree(pslab->array[0]);
-	}
+	if (pslab->huge_alloc)
+		ufree_huge_pages(pslab->array[0]);
+	else
+		ufree(pslab->array[0]);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tasks_pool_destroy						     */
+/*---------------------------------------------------------------------------*/
+void xio_tasks_pool_destroy(struct xio_tasks_pool *q)
+{
+	struct xio_tasks_slab	*pslab, *next_pslab;
+
+	list_for_each_entry_safe(pslab, next_pslab, &q->slabs_list,
+				 slabs_list_entry)
+		xio_tasks_pool_free_slab(q, pslab);
 
 	if (q->params.pool_hooks.pool_destroy)
 		q->params.pool_hooks.pool_destroy(
@@ -289,6 +333,47 @@ void xio_tasks_pool_destroy(struct xio_tasks_pool *q)
 }
 EXPORT_SYMBOL(xio_tasks_pool_destroy);
 
+/*---------------------------------------------------------------------------*/
+/* xio_tasks_pool_reclaim						     */
+/*---------------------------------------------------------------------------*/
+int xio_tasks_pool_reclaim(struct xio_tasks_pool *q)
+{
+	struct xio_tasks_slab	*pslab, *next_pslab;
+	struct xio_task		*task;
+	unsigned int		i;
+	int			reclaimed = 0;
+
+	if (!q || !q->params.idle_reclaim_ticks)
+		return 0;
+
+	list_for_each_entry_safe(pslab, next_pslab, &q->slabs_list,
+				 slabs_list_entry) {
+		/* any get in between restarts the count */
+		if (pslab->free_nr != pslab->nr ||
+		    ++pslab->idle_ticks < q->params.idle_reclaim_ticks)
+			continue;
+		if (q->curr_alloced - pslab->nr < q->params.start_nr)
+			continue;
+
+		/* all of its tasks are free - take them off the stack */
+		for (i = 0; i < pslab->nr; i++) {
+			task = pslab->array[i];
+			list_del_init(&task->tasks_list_entry);
+		}
+		q->curr_alloced -= pslab->nr;
+		q->reclaimed_slabs++;
+		q->reclaimed_tasks += pslab->nr;
+		reclaimed++;
+
+		DEBUG_LOG("%s - reclaimed idle slab. tasks:%d alloced:%d\n",
+			  q->params.pool_name, pslab->nr, q->curr_alloced);
+
+		xio_tasks_pool_free_slab(q, pslab);
+	}
+
+	return reclaimed;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tasks_pool_remap							     */
 /*---------------------------------------------------------------------------*/
@@ -330,6 +415,14 @@ void xio_tasks_pool_dump_used(struct xio_tasks_pool *q)
 	unsigned int		i;
 	char			*pool_name;
 
+	if (q->params.idle_reclaim_ticks)
+		DEBUG_LOG("pool_name:%s: alloced:%d, max_used:%d, " \
+			  "reclaimed slabs:%llu, reclaimed tasks:%llu\n",
+			  q->params.pool_name ? q->params.pool_name : "unknown",
+			  q->curr_alloced, q->max_used,
+			  (unsigned long long)q->reclaimed_slabs,
+			  (unsigned long long)q->reclaimed_tasks);
+
 	list_for_each_entry(pslab, &q->slabs_list, slabs_list_entry) {
 		for (i = 0; i < pslab->nr; i++)
 			if (pslab->array[i]->tlv_type != 0xdead) {
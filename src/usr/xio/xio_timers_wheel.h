@@ -0,0 +1,393 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef XIO_TIMERS_WHEEL_H
+#define XIO_TIMERS_WHEEL_H
+
+/*
+ * Hierarchical timing wheel: four levels of 64 slots with a 1 msec tick
+ * cover ~4.6 hours, later timers are parked in the last level and
+ * cascaded again. Insert and cancel are O(1); expiry walks only the
+ * elapsed ticks and moves whole slots at once.
+ *
+ * The entry's "expires" field holds the absolute expiry tick.
+ */
+#define XIO_TIMERS_WHEEL_TICK_NS	XIO_NS_IN_MSEC
+#define XIO_TIMERS_WHEEL_BITS		6
+#define XIO_TIMERS_WHEEL_SLOTS		(1 << XIO_TIMERS_WHEEL_BITS)
+#define XIO_TIMERS_WHEEL_MASK		(XIO_TIMERS_WHEEL_SLOTS - 1)
+#define XIO_TIMERS_WHEEL_LEVELS		4
+#define XIO_TIMERS_WHEEL_MAX_TICKS	\
+		((1ULL << (XIO_TIMERS_WHEEL_BITS * XIO_TIMERS_WHEEL_LEVELS)) - 1)
+
+struct xio_timers_wheel {
+	struct list_head	vec[XIO_TIMERS_WHEEL_LEVELS]
+				   [XIO_TIMERS_WHEEL_SLOTS];
+	/* non empty slots, bits may be stale after del */
+	uint64_t		bitmap[XIO_TIMERS_WHEEL_LEVELS];
+	uint64_t		base_ns;
+	uint64_t		cur_tick;	/* next tick to expire */
+	uint64_t		count;
+	spinlock_t		lock; /* timers wheel lock */
+	int			pad;
+};
+
+static inline void xio_timers_wheel_lock(struct xio_timers_wheel *wheel)
+{
+	spin_lock(&wheel->lock);
+}
+
+static inline void xio_timers_wheel_unlock(struct xio_timers_wheel *wheel)
+{
+	spin_unlock(&wheel->lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_timers_wheel_ns_current_get					     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t xio_timers_wheel_ns_current_get(void)
+{
+	struct timespec ts;
+
+	xio_clock_gettime(&ts);
+
+	return (ts.tv_sec*XIO_NS_IN_SEC) + (uint64_t)ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_timers_wheel_now_tick						     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t xio_timers_wheel_now_tick(struct xio_timers_wheel *wheel)
+{
+	return (xio_timers_wheel_ns_current_get() - wheel->base_ns) /
+		XIO_TIMERS_WHEEL_TICK_NS;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_timers_wheel_init						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_timers_wheel_init(struct xio_timers_wheel *wheel)
+{
+	int i, j;
+
+	for (i = 0; i < XIO_TIMERS_WHEEL_LEVELS; i++) {
+		for (j = 0; j < XIO_TIMERS_WHEEL_SLOTS; j++)
+			INIT_LIST_HEAD(&wheel->vec[i][j]);
+		wheel->bitmap[i] = 0;
+	}
+	wheel->base_ns	= xio_timers_wheel_ns_current_get();
+	wheel->cur_tick	= 0;
+	wheel->count	= 0;
+	spin_lock_init(&wheel->lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_timers_wheel_enqueue						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_timers_wheel_enqueue(
+				       struct xio_timers_wheel *wheel,
+				       struct xio_timers_list_entry *tentry)
+{
+	uint64_t	expires = tentry->expires;
+	uint64_t	idx;
+	int		level = 0;
+	int		slot;
+
+	if (time_before64(expires, wheel->cur_tick))
+		expires = wheel->cur_tick;
+	idx = expires - wheel->cur_tick;
+	if (idx > XIO_TIMERS_WHEEL_MAX_TICKS) {
+		/* parked and cascaded again until in range */
+		idx = XIO_TIMERS_WHEEL_MAX_TICKS;
+		expires = wheel->cur_tick + idx;
+	}
+	while (idx >= XIO_TIMERS_WHEEL_SLOTS) {
+		idx >>= XIO_TIMERS_WHEEL_BITS;
+		level++;
+	}
+	slot = (expires >> (level * XIO_TIMERS_WHEEL_BITS)) &
+		XIO_TIMERS_WHEEL_MASK;
+
+	list_add_tail(&tentry->entry, &wheel->vec[level][slot]);
+	wheel->bitmap[level] |= 1ULL << slot;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_timers_wheel_add_duration					     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_timers_wheel_add_duration(
+			struct xio_timers_wheel *wheel,
+			uint64_t ns_duration,
+			struct xio_timers_list_entry *tentry)
+{
+	uint64_t ns_expires = xio_timers_wheel_ns_current_get() +
+			      ns_duration - wheel->base_ns;
+
+	/* round up, timers never fire early */
+	tentry->expires = (ns_expires + XIO_TIMERS_WHEEL_TICK_NS - 1) /
+			  XIO_TIMERS_WHEEL_TICK_NS;
+
+	xio_timers_wheel_enqueue(wheel, tentry);
+	wheel->count++;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_timers_wheel_del							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_timers_wheel_del(struct xio_timers_wheel *wheel,
+					struct xio_timers_list_entry *tentry)
+{
+	/* slot bit is cleared lazily by the next scan */
+	list_del_init(&tentry->entry);
+	wheel->count--;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_timers_wheel_is_empty						     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_timers_wheel_is_empty(struct xio_timers_wheel *wheel)
+{
+	return wheel->count == 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_timers_wheel_close						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_timers_wheel_close(struct xio_timers_wheel *wheel)
+{
+	struct xio_timers_list_entry	*tentry;
+	int				i, j;
+
+	xio_timers_wheel_lock(wheel);
+	for (i = 0; i < XIO_TIMERS_WHEEL_LEVELS; i++) {
+		for (j = 0; j < XIO_TIMERS_WHEEL_SLOTS; j++) {
+			while (!list_empty(&wheel->vec[i][j])) {
+				tentry = list_first_entry(
+						&wheel->vec[i][j],
+						struct xio_timers_list_entry,
+						entry);
+				list_del_init(&tentry->entry);
+			}
+		}
+		wheel->bitmap[i] = 0;
+	}
+	wheel->count = 0;
+	xio_timers_wheel_unlock(wheel);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_timers_wheel_next_slot						     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_timers_wheel_next_slot(struct xio_timers_wheel *wheel,
+					     int level, int start)
+{
+	uint64_t	bits;
+	int		slot;
+
+	while (wheel->bitmap[level]) {
+		bits = wheel->bitmap[level];
+		if (start)
+			bits = (bits >> start) |
+			       (bits << (XIO_TIMERS_WHEEL_SLOTS - start));
+		slot = (start + __builtin_ctzll(bits)) & XIO_TIMERS_WHEEL_MASK;
+		if (!list_empty(&wheel->vec[level][slot]))
+			return (slot - start) & XIO_TIMERS_WHEEL_MASK;
+		/* stale bit left by del */
+		wheel->bitmap[level] &= ~(1ULL << slot);
+	}
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_timers_wheel_next_tick						     */
+/*---------------------------------------------------------------------------*/
+/* returns the tick by which the timer must fire: the earliest expiry or
+ * the earliest cascade of a higher level, (uint64_t)-1 when empty
+ */
+static inline uint64_t xio_timers_wheel_next_tick(
+				       struct xio_timers_wheel *wheel)
+{
+	uint64_t	next = (uint64_t)-1;
+	uint64_t	base, tick;
+	int		level, shift, start, off;
+
+	if (wheel->count == 0)
+		return next;
+
+	off = xio_timers_wheel_next_slot(
+			wheel, 0, (int)(wheel->cur_tick & XIO_TIMERS_WHEEL_MASK));
+	if (off >= 0)
+		next = wheel->cur_tick + off;
+
+	for (level = 1; level < XIO_TIMERS_WHEEL_LEVELS; level++) {
+		shift = level * XIO_TIMERS_WHEEL_BITS;
+		base  = wheel->cur_tick >> shift;
+		start = (int)(base & XIO_TIMERS_WHEEL_MASK);
+		/* current slot cascades now only on its boundary */
+		if (wheel->cur_tick & ((1ULL << shift) - 1))
+			start = (start + 1) & XIO_TIMERS_WHEEL_MASK;
+		off = xio_timers_wheel_next_slot(wheel, level, start);
+		if (off < 0)
+			continue;
+		if (start != (int)(base & XIO_TIMERS_WHEEL_MASK))
+			off++;
+		tick = (base + off) << shift;
+		if (tick < next)
+			next = tick;
+	}
+
+	return next;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_timers_wheel_next_expires					     */
+/*---------------------------------------------------------------------------*/
+/* absolute time in nsec for the next timer fire, 0 when empty */
+static inline uint64_t xio_timers_wheel_next_expires(
+				       struct xio_timers_wheel *wheel)
+{
+	uint64_t tick = xio_timers_wheel_next_tick(wheel);
+
+	if (tick == (uint64_t)-1)
+		return 0;
+
+	return wheel->base_ns + tick * XIO_TIMERS_WHEEL_TICK_NS;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_timers_wheel_cascade						     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_timers_wheel_cascade(struct xio_timers_wheel *wheel,
+					   int level)
+{
+	struct xio_timers_list_entry	*tentry, *tmp;
+	struct list_head		head;
+	int				slot;
+
+	slot = (wheel->cur_tick >> (level * XIO_TIMERS_WHEEL_BITS)) &
+		XIO_TIMERS_WHEEL_MASK;
+
+	INIT_LIST_HEAD(&head);
+	list_splice_init(&wheel->vec[level][slot], &head);
+	wheel->bitmap[level] &= ~(1ULL << slot);
+
+	list_for_each_entry_safe(tentry, tmp, &head, entry) {
+		list_del(&tentry->entry);
+		xio_timers_wheel_enqueue(wheel, tentry);
+	}
+
+	return slot;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_timers_wheel_collect						     */
+/*---------------------------------------------------------------------------*/
+/* moves all timers expired up to now_tick to the expired list */
+static inline void xio_timers_wheel_collect(struct xio_timers_wheel *wheel,
+					    uint64_t now_tick,
+					    struct list_head *expired)
+{
+	int slot, level;
+
+	if (wheel->count == 0) {
+		if (time_after_eq64(now_tick, wheel->cur_tick))
+			wheel->cur_tick = now_tick + 1;
+		return;
+	}
+
+	while (time_after_eq64(now_tick, wheel->cur_tick)) {
+		slot = wheel->cur_tick & XIO_TIMERS_WHEEL_MASK;
+		if (slot == 0) {
+			for (level = 1; level < XIO_TIMERS_WHEEL_LEVELS;
+			     level++) {
+				if (xio_timers_wheel_cascade(wheel, level))
+					break;
+			}
+		} else if (wheel->bitmap[0] == 0) {
+			/* nothing left in level 0, skip to the boundary */
+			wheel->cur_tick = (wheel->cur_tick |
+					   XIO_TIMERS_WHEEL_MASK) + 1;
+			if (time_after64(wheel->cur_tick, now_tick + 1))
+				wheel->cur_tick = now_tick + 1;
+			continue;
+		}
+		if (!list_empty(&wheel->vec[0][slot]))
+			list_splice_tail_init(&wheel->vec[0][slot], expired);
+		wheel->bitmap[0] &= ~(1ULL << slot);
+		wheel->cur_tick++;
+	}
+}
+
+/*
+ * Expires any timers that should be expired
+ */
+/*---------------------------------------------------------------------------*/
+/* xio_timers_wheel_expire						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_timers_wheel_expire(struct xio_timers_wheel *wheel)
+{
+	struct xio_timers_list_entry	*tentry;
+	struct list_head		expired;
+	xio_delayed_work_handle_t	*dwork;
+	xio_work_handle_t		*work;
+
+	INIT_LIST_HEAD(&expired);
+
+	xio_timers_wheel_lock(wheel);
+	xio_timers_wheel_collect(wheel, xio_timers_wheel_now_tick(wheel),
+				 &expired);
+	/* handlers may cancel batched entries, so pop one at a time */
+	while (!list_empty(&expired)) {
+		tentry = list_first_entry(&expired,
+					  struct xio_timers_list_entry, entry);
+		list_del_init(&tentry->entry);
+		wheel->count--;
+		xio_timers_wheel_unlock(wheel);
+
+		dwork = container_of(tentry, xio_delayed_work_handle_t, timer);
+		work = &dwork->work;
+		work->flags &= ~XIO_WORK_PENDING;
+
+		work->function(work->data);
+
+		xio_timers_wheel_lock(wheel);
+	}
+	xio_timers_wheel_unlock(wheel);
+}
+
+#endif /* XIO_TIMERS_WHEEL_H */
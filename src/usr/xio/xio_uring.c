@@ -0,0 +1,427 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <xio_os.h>
+#include "libxio.h"
+#include "xio_log.h"
+#include "xio_common.h"
+#include "xio_uring.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+
+/* multishot poll (5.13) and timed getevents (5.11) are mandatory */
+#define XIO_URING_REQUIRED_FEATURES	(IORING_FEAT_SINGLE_MMAP | \
+					 IORING_FEAT_EXT_ARG |	   \
+					 IORING_FEAT_RSRC_TAGS)
+
+/*---------------------------------------------------------------------------*/
+/* structs                                                                   */
+/*---------------------------------------------------------------------------*/
+struct xio_uring {
+	int			fd;
+	unsigned int		sq_entries;
+
+	/* submission queue */
+	unsigned int		*sq_head;
+	unsigned int		*sq_tail;
+	unsigned int		*sq_mask;
+	unsigned int		*sq_array;
+	struct io_uring_sqe	*sqes;
+	unsigned int		sqe_tail;	/* local, not yet published */
+	unsigned int		sqe_head;	/* published, not submitted */
+
+	/* completion queue */
+	unsigned int		*cq_head;
+	unsigned int		*cq_tail;
+	unsigned int		*cq_mask;
+	struct io_uring_cqe	*cqes;
+
+	void			*ring_ptr;
+	size_t			ring_sz;
+	void			*sqes_ptr;
+	size_t			sqes_sz;
+};
+
+/*---------------------------------------------------------------------------*/
+/* syscall wrappers                                                          */
+/*---------------------------------------------------------------------------*/
+static inline int xio_sys_io_uring_setup(unsigned int entries,
+					 struct io_uring_params *p)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int xio_sys_io_uring_enter(int fd, unsigned int to_submit,
+					 unsigned int min_complete,
+					 unsigned int flags, void *arg,
+					 size_t argsz)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+			    flags, arg, argsz);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_uring_create							     */
+/*---------------------------------------------------------------------------*/
+struct xio_uring *xio_uring_create(unsigned int entries)
+{
+	struct xio_uring	*ring;
+	struct io_uring_params	p;
+	size_t			sq_sz, cq_sz;
+	char			*ptr;
+
+	ring = (struct xio_uring *)ucalloc(1, sizeof(*ring));
+	if (!ring) {
+		xio_set_error(ENOMEM);
+		ERROR_LOG("calloc failed. %m\n");
+		return NULL;
+	}
+
+	memset(&p, 0, sizeof(p));
+	ring->fd = xio_sys_io_uring_setup(entries, &p);
+	if (ring->fd < 0) {
+		xio_set_error(errno);
+		DEBUG_LOG("io_uring_setup failed. %m\n");
+		goto cleanup;
+	}
+	if ((p.features & XIO_URING_REQUIRED_FEATURES) !=
+	    XIO_URING_REQUIRED_FEATURES) {
+		xio_set_error(ENOTSUP);
+		DEBUG_LOG("io_uring lacks required features:0x%x\n",
+			  p.features);
+		goto cleanup1;
+	}
+
+	sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->ring_sz = max(sq_sz, cq_sz);
+	ring->ring_ptr = mmap(NULL, ring->ring_sz, PROT_READ | PROT_WRITE,
+			      MAP_SHARED | MAP_POPULATE, ring->fd,
+			      IORING_OFF_SQ_RING);
+	if (ring->ring_ptr == MAP_FAILED) {
+		xio_set_error(errno);
+		ERROR_LOG("mmap of io_uring rings failed. %m\n");
+		goto cleanup1;
+	}
+
+	ring->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes_ptr = mmap(NULL, ring->sqes_sz, PROT_READ | PROT_WRITE,
+			      MAP_SHARED | MAP_POPULATE, ring->fd,
+			      IORING_OFF_SQES);
+	if (ring->sqes_ptr == MAP_FAILED) {
+		xio_set_error(errno);
+		ERROR_LOG("mmap of io_uring sqes failed. %m\n");
+		goto cleanup2;
+	}
+
+	ptr = (char *)ring->ring_ptr;
+	ring->sq_entries = p.sq_entries;
+	ring->sq_head	= (unsigned int *)(ptr + p.sq_off.head);
+	ring->sq_tail	= (unsigned int *)(ptr + p.sq_off.tail);
+	ring->sq_mask	= (unsigned int *)(ptr + p.sq_off.ring_mask);
+	ring->sq_array	= (unsigned int *)(ptr + p.sq_off.array);
+	ring->sqes	= (struct io_uring_sqe *)ring->sqes_ptr;
+	ring->cq_head	= (unsigned int *)(ptr + p.cq_off.head);
+	ring->cq_tail	= (unsigned int *)(ptr + p.cq_off.tail);
+	ring->cq_mask	= (unsigned int *)(ptr + p.cq_off.ring_mask);
+	ring->cqes	= (struct io_uring_cqe *)(ptr + p.cq_off.cqes);
+	ring->sqe_head	= *ring->sq_tail;
+	ring->sqe_tail	= ring->sqe_head;
+
+	return ring;
+
+cleanup2:
+	munmap(ring->ring_ptr, ring->ring_sz);
+cleanup1:
+	close(ring->fd);
+cleanup:
+	ufree(ring);
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_uring_destroy							     */
+/*---------------------------------------------------------------------------*/
+void xio_uring_destroy(struct xio_uring *ring)
+{
+	if (!ring)
+		return;
+
+	munmap(ring->sqes_ptr, ring->sqes_sz);
+	munmap(ring->ring_ptr, ring->ring_sz);
+	close(ring->fd);
+	ufree(ring);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_uring_get_fd							     */
+/*---------------------------------------------------------------------------*/
+int xio_uring_get_fd(struct xio_uring *ring)
+{
+	return ring->fd;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_uring_flush_sq							     */
+/*---------------------------------------------------------------------------*/
+static unsigned int xio_uring_flush_sq(struct xio_uring *ring)
+{
+	unsigned int	tail = *ring->sq_tail;
+	unsigned int	mask = *ring->sq_mask;
+
+	while (ring->sqe_head != ring->sqe_tail) {
+		ring->sq_array[tail & mask] = ring->sqe_head & mask;
+		tail++;
+		ring->sqe_head++;
+	}
+	/* publish the new tail to the kernel */
+	__atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+	return tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_uring_submit							     */
+/*---------------------------------------------------------------------------*/
+int xio_uring_submit(struct xio_uring *ring)
+{
+	unsigned int	to_submit = xio_uring_flush_sq(ring);
+	int		retval;
+
+	if (!to_submit)
+		return 0;
+
+	retval = xio_sys_io_uring_enter(ring->fd, to_submit, 0, 0, NULL, 0);
+	if (retval < 0) {
+		xio_set_error(errno);
+		if (errno != EINTR)
+			ERROR_LOG("io_uring_enter failed. %m\n");
+	}
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_uring_get_sqe							     */
+/*---------------------------------------------------------------------------*/
+static struct io_uring_sqe *xio_uring_get_sqe(struct xio_uring *ring)
+{
+	struct io_uring_sqe *sqe;
+
+	/* submission queue full - push it to the kernel */
+	if (ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)
+	    >= ring->sq_entries) {
+		if (xio_uring_submit(ring) < 0)
+			return NULL;
+		if (ring->sqe_tail -
+		    __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >=
+		    ring->sq_entries) {
+			xio_set_error(EBUSY);
+			ERROR_LOG("io_uring submission queue is full\n");
+			return NULL;
+		}
+	}
+	sqe = &ring->sqes[ring->sqe_tail & *ring->sq_mask];
+	ring->sqe_tail++;
+	memset(sqe, 0, sizeof(*sqe));
+
+	return sqe;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_uring_poll_add							     */
+/*---------------------------------------------------------------------------*/
+int xio_uring_poll_add(struct xio_uring *ring, int fd, uint32_t poll_mask,
+		       int multishot, uint64_t user_data)
+{
+	struct io_uring_sqe *sqe = xio_uring_get_sqe(ring);
+
+	if (!sqe)
+		return -1;
+
+#if __BYTE_ORDER == __BIG_ENDIAN
+	poll_mask = (poll_mask << 16) | (poll_mask >> 16);
+#endif
+	sqe->opcode		= IORING_OP_POLL_ADD;
+	sqe->fd			= fd;
+	sqe->poll32_events	= poll_mask;
+	sqe->len		= multishot ? IORING_POLL_ADD_MULTI : 0;
+	sqe->user_data		= user_data;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_uring_poll_remove						     */
+/*---------------------------------------------------------------------------*/
+int xio_uring_poll_remove(struct xio_uring *ring, uint64_t target,
+			  uint64_t user_data)
+{
+	struct io_uring_sqe *sqe = xio_uring_get_sqe(ring);
+
+	if (!sqe)
+		return -1;
+
+	sqe->opcode		= IORING_OP_POLL_REMOVE;
+	sqe->fd			= -1;
+	sqe->addr		= target;
+	sqe->user_data		= user_data;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_uring_reap							     */
+/*---------------------------------------------------------------------------*/
+static int xio_uring_reap(struct xio_uring *ring, struct xio_uring_cqe *cqes,
+			  int max_cqes)
+{
+	unsigned int	head = *ring->cq_head;
+	unsigned int	tail = __atomic_load_n(ring->cq_tail,
+					       __ATOMIC_ACQUIRE);
+	unsigned int	mask = *ring->cq_mask;
+	int		nr = 0;
+
+	while (head != tail && nr < max_cqes) {
+		struct io_uring_cqe *cqe = &ring->cqes[head & mask];
+
+		cqes[nr].user_data	= cqe->user_data;
+		cqes[nr].res		= cqe->res;
+		cqes[nr].flags		= cqe->flags;
+		nr++;
+		head++;
+	}
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+	return nr;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_uring_wait							     */
+/*---------------------------------------------------------------------------*/
+int xio_uring_wait(struct xio_uring *ring, struct xio_uring_cqe *cqes,
+		   int max_cqes, int timeout_ms)
+{
+	struct io_uring_getevents_arg	arg;
+	struct __kernel_timespec	ts;
+	unsigned int			to_submit;
+	unsigned int			flags = IORING_ENTER_EXT_ARG;
+	unsigned int			min_complete = 0;
+	int				nr, retval;
+
+	to_submit = xio_uring_flush_sq(ring);
+	nr = xio_uring_reap(ring, cqes, max_cqes);
+	if (nr || (!to_submit && timeout_ms == 0))
+		goto submit;
+
+	memset(&arg, 0, sizeof(arg));
+	if (timeout_ms != 0) {
+		flags |= IORING_ENTER_GETEVENTS;
+		min_complete = 1;
+		if (timeout_ms > 0) {
+			ts.tv_sec	= timeout_ms / 1000;
+			ts.tv_nsec	= (timeout_ms % 1000) * 1000000LL;
+			arg.ts		= uint64_from_ptr(&ts);
+		}
+	}
+	retval = xio_sys_io_uring_enter(ring->fd, to_submit, min_complete,
+					flags, &arg, sizeof(arg));
+	if (retval < 0 && errno != ETIME) {
+		xio_set_error(errno);
+		if (errno != EINTR)
+			ERROR_LOG("io_uring_enter failed. %m\n");
+		return -1;
+	}
+
+	return xio_uring_reap(ring, cqes, max_cqes);
+
+submit:
+	if (to_submit && xio_uring_submit(ring) < 0 && errno != EINTR)
+		return -1;
+
+	return nr;
+}
+
+#else
+
+/*---------------------------------------------------------------------------*/
+/* no io_uring headers - xio_ev_loop falls back to epoll		     */
+/*---------------------------------------------------------------------------*/
+struct xio_uring *xio_uring_create(unsigned int entries)
+{
+	xio_set_error(ENOTSUP);
+	return NULL;
+}
+
+void xio_uring_destroy(struct xio_uring *ring)
+{
+}
+
+int xio_uring_get_fd(struct xio_uring *ring)
+{
+	return -1;
+}
+
+int xio_uring_poll_add(struct xio_uring *ring, int fd, uint32_t poll_mask,
+		       int multishot, uint64_t user_data)
+{
+	xio_set_error(ENOTSUP);
+	return -1;
+}
+
+int xio_uring_poll_remove(struct xio_uring *ring, uint64_t target,
+			  uint64_t user_data)
+{
+	xio_set_error(ENOTSUP);
+	return -1;
+}
+
+int xio_uring_submit(struct xio_uring *ring)
+{
+	xio_set_error(ENOTSUP);
+	return -1;
+}
+
+int xio_uring_wait(struct xio_uring *ring, struct xio_uring_cqe *cqes,
+		   int max_cqes, int timeout_ms)
+{
+	xio_set_error(ENOTSUP);
+	return -1;
+}
+
+#endif /* HAVE_LINUX_IO_URING_H */
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef XIO_URING_H
+#define XIO_URING_H
+
+/*---------------------------------------------------------------------------*/
+/* minimal io_uring wrapper used by the event loop io_uring backend.	     */
+/* only poll requests are supported; the ring is accessed directly through   */
+/* the raw system calls, no liburing dependency				     */
+/*---------------------------------------------------------------------------*/
+struct xio_uring;
+
+struct xio_uring_cqe {
+	uint64_t	user_data;
+	int32_t		res;
+	uint32_t	flags;
+};
+
+#define XIO_URING_CQE_F_MORE		(1U << 1)
+
+/**
+ * create io_uring instance
+ *
+ * @param[in] entries	submission queue size
+ *
+ * @returns ring handle or NULL if io_uring is not supported by the kernel
+ */
+struct xio_uring *xio_uring_create(unsigned int entries);
+
+/**
+ * destroy io_uring instance, pending requests are cancelled
+ *
+ * @param[in] ring	the ring handle
+ */
+void xio_uring_destroy(struct xio_uring *ring);
+
+/**
+ * get ring file descriptor, readable when completions are available
+ *
+ * @param[in] ring	the ring handle
+ *
+ * @returns the file descriptor
+ */
+int xio_uring_get_fd(struct xio_uring *ring);
+
+/**
+ * queue poll request. the request is submitted on next xio_uring_submit or
+ * xio_uring_wait
+ *
+ * @param[in] ring	the ring handle
+ * @param[in] fd	file descriptor to poll
+ * @param[in] poll_mask	epoll events mask (EPOLLIN, EPOLLOUT ...)
+ * @param[in] multishot	keep the request armed after completion
+ * @param[in] user_data	returned in the request completions
+ *
+ * @returns 0 on success, -1 on error
+ */
+int xio_uring_poll_add(struct xio_uring *ring, int fd, uint32_t poll_mask,
+		       int multishot, uint64_t user_data);
+
+/**
+ * queue cancellation of a poll request
+ *
+ * @param[in] ring	the ring handle
+ * @param[in] target	user_data of the poll request to cancel
+ * @param[in] user_data	returned in the cancel request completion
+ *
+ * @returns 0 on success, -1 on error
+ */
+int xio_uring_poll_remove(struct xio_uring *ring, uint64_t target,
+			  uint64_t user_data);
+
+/**
+ * submit all queued requests without waiting
+ *
+ * @param[in] ring	the ring handle
+ *
+ * @returns number of submitted requests, -1 on error
+ */
+int xio_uring_submit(struct xio_uring *ring);
+
+/**
+ * submit all queued requests and reap completions
+ *
+ * @param[in] ring	  the ring handle
+ * @param[out] cqes	  array of reaped completions
+ * @param[in] max_cqes	  array size
+ * @param[in] timeout_ms  wait for at least one completion up to timeout_ms
+ *			  milliseconds. 0 - don't wait, -1 - infinite
+ *
+ * @returns number of reaped completions, 0 on timeout, -1 on error
+ */
+int xio_uring_wait(struct xio_uring *ring, struct xio_uring_cqe *cqes,
+		   int max_cqes, int timeout_ms);
+
+#endif /* XIO_URING_H */
@@ -43,13 +43,17 @@
 #include "xio_common.h"
 #include "xio_observer.h"
 #include "xio_ev_data.h"
+#include "xio_ev_loop.h"
 #include "xio_objpool.h"
 #include "xio_workqueue.h"
 #include "xio_timers_list.h"
+#include "xio_timers_wheel.h"
+#include "xio_mpsc_ring.h"
 #include "xio_context.h"
 
 #define NSEC_PER_SEC		1000000000L
 #define MAX_DELETED_WORKS	1024
+#define POST_RING_DEPTH		8192
 
 enum xio_workqueue_flags {
 	XIO_WORKQUEUE_IN_POLL		= 1 << 0,
@@ -58,14 +62,18 @@ enum xio_workqueue_flags {
 
 struct xio_workqueue {
 	struct xio_context		*ctx;
-	struct xio_timers_list		timers_list;
+	struct xio_mpsc_ring		post_ring;
+	struct xio_timers_wheel		timers_wheel;
 	int				timer_fd;
-	socket_t			pipe_fd[2];
+	/* wakeup pipe: the loop polls [0], posters write [1] */
+	socket_t			post_fd[2];
+	/* set while a wakeup is outstanding, posts don't signal again */
+	volatile uint32_t		post_signaled;
 
 	volatile uint32_t		flags;
-	uint64_t			deleted_works[MAX_DELETED_WORKS];
 	uint32_t			deleted_works_nr;
-	uint32_t			pad;
+	uint64_t			armed_expires;
+	uint64_t			deleted_works[MAX_DELETED_WORKS];
 };
 
 /**
@@ -106,19 +114,23 @@ static int xio_workqueue_rearm(struct xio_workqueue *work_queue)
 	struct itimerspec new_t = { {0, 0}, {0, 0} };
 	int		  err;
 	int64_t		  ns_to_expire;
+	uint64_t	  expires;
 
 	if (work_queue->flags & XIO_WORKQUEUE_IN_POLL)
 		return 0;
-	if (xio_timers_list_is_empty(&work_queue->timers_list))
+	if (xio_timers_wheel_is_empty(&work_queue->timers_wheel))
 		return 0;
 
-	ns_to_expire =
-		xio_timerlist_ns_duration_to_expire(
-			&work_queue->timers_list);
+	expires = xio_timers_wheel_next_expires(&work_queue->timers_wheel);
+	if (expires == 0)
+		return 0;
 
-	if (ns_to_expire == -1)
+	/* already armed to fire no later than required */
+	if ((work_queue->flags & XIO_WORKQUEUE_TIMER_ARMED) &&
+	    time_before_eq64(work_queue->armed_expires, expires))
 		return 0;
 
+	ns_to_expire = (int64_t)(expires - xio_timers_wheel_ns_current_get());
 	if (ns_to_expire < 1) {
 		new_t.it_value.tv_nsec = 1;
 	} else {
@@ -132,6 +144,7 @@ static int xio_workqueue_rearm(struct xio_workqueue *work_queue)
 		return -1;
 	}
 	work_queue->flags |= XIO_WORKQUEUE_TIMER_ARMED;
+	work_queue->armed_expires = expires;
 
 	return 0;
 }
@@ -176,11 +189,57 @@ static void xio_delayed_action_handler(int fd, int events, void *user_context)
 	}
 
 	work_queue->flags |= XIO_WORKQUEUE_IN_POLL;
-	xio_timers_list_expire(&work_queue->timers_list);
-	xio_timers_list_lock(&work_queue->timers_list);
-	work_queue->flags &= ~XIO_WORKQUEUE_IN_POLL;
+	xio_timers_wheel_expire(&work_queue->timers_wheel);
+	xio_timers_wheel_lock(&work_queue->timers_wheel);
+	work_queue->flags &= ~(XIO_WORKQUEUE_IN_POLL |
+			       XIO_WORKQUEUE_TIMER_ARMED);
 	xio_workqueue_rearm(work_queue);
-	xio_timers_list_unlock(&work_queue->timers_list);
+	xio_timers_wheel_unlock(&work_queue->timers_wheel);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_workqueue_signal							     */
+/*---------------------------------------------------------------------------*/
+static int xio_workqueue_signal(struct xio_workqueue *work_queue)
+{
+	char	c = 0;
+
+	/* coalesce: only the first post after a drain pays the syscall */
+	if (xio_sync_exchange32(&work_queue->post_signaled, 1))
+		return 0;
+
+	if (xio_write(work_queue->post_fd[1], &c, sizeof(c)) < 0) {
+		ERROR_LOG("failed to write to wakeup pipe, %m\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_workqueue_run_work						     */
+/*---------------------------------------------------------------------------*/
+static void xio_workqueue_run_work(void *obj, void *data)
+{
+	struct xio_workqueue	*work_queue = (struct xio_workqueue *)obj;
+	xio_work_handle_t	*work = (xio_work_handle_t *)data;
+	uint64_t		exp = uint64_from_ptr(work);
+	unsigned int		i;
+
+	/* scan for deleted work that may be inside the ring */
+	for (i = 0; i < work_queue->deleted_works_nr; i++) {
+		if (work_queue->deleted_works[i] == exp)
+			return;
+	}
+
+	if (test_bits(XIO_WORK_PENDING, &work->flags)) {
+		clr_bits(XIO_WORK_PENDING, &work->flags);
+
+		set_bits(XIO_WORK_IN_HANDLER, &work->flags);
+		work->function(work->data);
+		clr_bits(XIO_WORK_IN_HANDLER, &work->flags);
+		if (work->destructor)
+			work->destructor(work->destructor_data);
+	}
 }
 
 /*---------------------------------------------------------------------------*/
@@ -189,52 +248,28 @@ static void xio_delayed_action_handler(int fd, int events, void *user_context)
 static void xio_work_action_handler(int fd, int events, void *user_context)
 {
 	struct xio_workqueue *work_queue = (struct xio_workqueue *)user_context;
-	uint64_t		exp;
-	ssize_t			s;
-	xio_work_handle_t	*work;
-	unsigned int		i, found = 0;
-
-	/* drain the pipe data */
-	while (1) {
-		s = xio_read(work_queue->pipe_fd[0], &exp, sizeof(exp));
-		if (s < 0) {
-			if (xio_get_last_socket_error() != XIO_EAGAIN)
-				ERROR_LOG("failed to read from pipe, %m\n");
+	struct xio_mpsc_entry	entry;
+	char			buf[64];
+	unsigned int		i;
+
+	while (xio_read(work_queue->post_fd[0], buf, sizeof(buf)) > 0)
+		;
+	xio_sync_exchange32(&work_queue->post_signaled, 0);
+
+	/* drain in a batch bounded by the ring depth, so that entries
+	 * reposted by the handlers run on the next loop iteration
+	 */
+	for (i = 0; i < POST_RING_DEPTH; i++) {
+		if (xio_mpsc_ring_pop(&work_queue->post_ring, &entry)) {
 			work_queue->deleted_works_nr = 0;
 			return;
 		}
-		if (s != sizeof(uint64_t)) {
-			ERROR_LOG("failed to read from pipe, %m\n");
-			return;
-		}
-		work = (xio_work_handle_t *)ptr_from_int64(exp);
-		if (!work) {
-			ERROR_LOG("null work\n");
-			return;
-		}
-
-		/* scan for deleted work the may be inside the pipe */
-		for (i = 0; i < work_queue->deleted_works_nr; i++) {
-			if (work_queue->deleted_works[i] == exp) {
-				found = 1;
-				break;
-			}
-		}
-		if (found) {
-			found = 0;
-			continue;
-		}
-
-		if (test_bits(XIO_WORK_PENDING, &work->flags)) {
-			clr_bits(XIO_WORK_PENDING, &work->flags);
-
-			set_bits(XIO_WORK_IN_HANDLER, &work->flags);
-			work->function(work->data);
-			clr_bits(XIO_WORK_IN_HANDLER, &work->flags);
-			if (work->destructor)
-				work->destructor(work->destructor_data);
-		}
+		if (entry.handler)
+			entry.handler(entry.obj, entry.data);
+		else
+			entry.function(entry.data);
 	}
+	xio_workqueue_signal(work_queue);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -244,6 +279,7 @@ struct xio_workqueue *xio_workqueue_create(struct xio_context *ctx)
 {
 	struct xio_workqueue	*work_queue;
 	int			retval;
+	int			ev_flags = XIO_POLLIN;
 
 	work_queue = (struct xio_workqueue *)ucalloc(1, sizeof(*work_queue));
 	if (!work_queue) {
@@ -251,7 +287,7 @@ struct xio_workqueue *xio_workqueue_create(struct xio_context *ctx)
 		return NULL;
 	}
 
-	xio_timers_list_init(&work_queue->timers_list);
+	xio_timers_wheel_init(&work_queue->timers_wheel);
 	work_queue->ctx = ctx;
 
 	work_queue->timer_fd = xio_timerfd_create();
@@ -260,42 +296,55 @@ struct xio_workqueue *xio_workqueue_create(struct xio_context *ctx)
 		goto exit;
 	}
 
-	retval = xio_pipe(work_queue->pipe_fd, 0);
-
-	if (retval < 0) {
-		ERROR_LOG("pipe failed. %m\n");
+	if (xio_mpsc_ring_init(&work_queue->post_ring, POST_RING_DEPTH)) {
+		ERROR_LOG("ring init failed. %m\n");
 		goto exit1;
 	}
 
+	if (xio_pipe(work_queue->post_fd, 0)) {
+		ERROR_LOG("xio_pipe failed. %m\n");
+		goto exit2;
+	}
+
+	/* the handlers drain their fds, so io_uring may poll them
+	 * multishot. epoll stays level-triggered: an event dropped from
+	 * a dispatch batch is reported again on the next wait
+	 */
+	if (xio_ev_loop_get_type(ctx->ev_loop) == XIO_EV_LOOP_IO_URING)
+		ev_flags |= XIO_POLLET;
+
 	/* add to epoll */
 	retval = xio_context_add_ev_handler(
 			ctx,
 			work_queue->timer_fd,
-			XIO_POLLIN,
+			ev_flags,
 			xio_delayed_action_handler,
 			work_queue);
 	if (retval) {
 		ERROR_LOG("ev_loop_add_cb failed. %m\n");
-		goto exit2;
+		goto exit3;
 	}
 
 	/* add to epoll */
 	retval = xio_context_add_ev_handler(
 			ctx,
-			work_queue->pipe_fd[0],
-			XIO_POLLIN,
+			(int)work_queue->post_fd[0],
+			ev_flags,
 			xio_work_action_handler,
 			work_queue);
 	if (retval) {
 		ERROR_LOG("ev_loop_add_cb failed. %m\n");
-		goto exit2;
+		xio_context_del_ev_handler(ctx, work_queue->timer_fd);
+		goto exit3;
 	}
 
 	return work_queue;
 
+exit3:
+	xio_closesocket(work_queue->post_fd[0]);
+	xio_closesocket(work_queue->post_fd[1]);
 exit2:
-	xio_closesocket(work_queue->pipe_fd[0]);
-	xio_closesocket(work_queue->pipe_fd[1]);
+	xio_mpsc_ring_close(&work_queue->post_ring);
 exit1:
 	xio_closesocket(work_queue->timer_fd);
 exit:
@@ -320,14 +369,15 @@ int xio_workqueue_destroy(struct xio_workqueue *work_queue)
 
 	retval = xio_context_del_ev_handler(
 			work_queue->ctx,
-			work_queue->pipe_fd[0]);
+			(int)work_queue->post_fd[0]);
 	if (retval)
 		ERROR_LOG("ev_loop_del_cb failed. %m\n");
 
-	xio_timers_list_close(&work_queue->timers_list);
+	xio_timers_wheel_close(&work_queue->timers_wheel);
 
-	xio_closesocket(work_queue->pipe_fd[0]);
-	xio_closesocket(work_queue->pipe_fd[1]);
+	xio_closesocket(work_queue->post_fd[0]);
+	xio_closesocket(work_queue->post_fd[1]);
+	xio_mpsc_ring_close(&work_queue->post_ring);
 	xio_closesocket(work_queue->timer_fd);
 	ufree(work_queue);
 
@@ -343,7 +393,6 @@ int xio_workqueue_add_delayed_work(struct xio_workqueue *work_queue,
 				   xio_delayed_work_handle_t *dwork)
 {
 	int			retval = 0;
-	enum timers_list_rc	rc;
 	xio_work_handle_t	*work = &dwork->work;
 
 	if (xio_is_delayed_work_pending(dwork)) {
@@ -352,30 +401,23 @@ int xio_workqueue_add_delayed_work(struct xio_workqueue *work_queue,
 		return -1;
 	}
 
-	xio_timers_list_lock(&work_queue->timers_list);
+	xio_timers_wheel_lock(&work_queue->timers_wheel);
 
 	work->function	= function;
 	work->data	= data;
 	work->flags	|= XIO_WORK_PENDING;
 
-	rc = xio_timers_list_add_duration(
-			&work_queue->timers_list,
+	xio_timers_wheel_add_duration(
+			&work_queue->timers_wheel,
 			((uint64_t)msec_duration) * 1000000ULL,
 			&dwork->timer);
-	if (rc == TIMERS_LIST_RC_ERROR) {
-		ERROR_LOG("adding to timer failed\n");
-		retval = -1;
-		goto unlock;
-	}
 
-	/* if the recently add timer is now the first in list, rearm */
-		/* rearm the timer */
+	/* rearm the timer only if it must fire earlier */
 	retval = xio_workqueue_rearm(work_queue);
 	if (unlikely(retval))
 		ERROR_LOG("xio_workqueue_rearm failed. %m\n");
 
-unlock:
-	xio_timers_list_unlock(&work_queue->timers_list);
+	xio_timers_wheel_unlock(&work_queue->timers_wheel);
 	return retval;
 }
 
@@ -385,34 +427,21 @@ unlock:
 int xio_workqueue_del_delayed_work(struct xio_workqueue *work_queue,
 				   xio_delayed_work_handle_t *dwork)
 {
-	int			retval = 0;
-	enum timers_list_rc	rc;
-
 	if (!xio_is_delayed_work_pending(dwork)) {
 		ERROR_LOG("work not pending\n");
 		xio_set_error(EEXIST);
 		return -1;
 	}
 
-	/* stop the timer */
-	xio_workqueue_disarm(work_queue);
-
-	xio_timers_list_lock(&work_queue->timers_list);
+	xio_timers_wheel_lock(&work_queue->timers_wheel);
 
 	dwork->work.flags &= ~XIO_WORK_PENDING;
 
-	rc = xio_timers_list_del(&work_queue->timers_list, &dwork->timer);
-	if (rc == TIMERS_LIST_RC_ERROR) {
-		ERROR_LOG("deleting work from queue failed. queue is empty\n");
-		goto unlock;
-	}
-	/* rearm the timer */
-	retval = xio_workqueue_rearm(work_queue);
-	if (unlikely(retval))
-		ERROR_LOG("xio_workqueue_rearm failed. %m\n");
-unlock:
-	xio_timers_list_unlock(&work_queue->timers_list);
-	return retval;
+	/* the armed timer is left alone, an early fire just rearms it */
+	xio_timers_wheel_del(&work_queue->timers_wheel, &dwork->timer);
+
+	xio_timers_wheel_unlock(&work_queue->timers_wheel);
+	return 0;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -423,23 +452,55 @@ int xio_workqueue_add_work(struct xio_workqueue *work_queue,
 			   void (*function)(void *data),
 			   xio_work_handle_t *work)
 {
-	uint64_t	exp = uint64_from_ptr(work);
-	int		s;
+	struct xio_mpsc_entry entry = {
+		xio_workqueue_run_work, NULL, work_queue, work };
 
 	work->function	= function;
 	work->data	= data;
 	work->flags	|= XIO_WORK_PENDING;
 
-	s = xio_write(work_queue->pipe_fd[1], &exp, sizeof(exp));
-	if (s < 0) {
-		ERROR_LOG("failed to write to pipe, %m\n");
-		return -1;
-	}
-	if (s != sizeof(exp)) {
-		ERROR_LOG("failed to write to pipe, %m\n");
+	return xio_workqueue_post(work_queue, &entry);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_workqueue_post							     */
+/*---------------------------------------------------------------------------*/
+int xio_workqueue_post(struct xio_workqueue *work_queue,
+		       const struct xio_mpsc_entry *entry)
+{
+	struct xio_mpsc_cell *cell = xio_workqueue_post_claim(work_queue);
+
+	if (!cell)
 		return -1;
-	}
-	return 0;
+
+	return xio_workqueue_post_commit(work_queue, cell, entry);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_workqueue_post_claim						     */
+/*---------------------------------------------------------------------------*/
+struct xio_mpsc_cell *xio_workqueue_post_claim(
+		struct xio_workqueue *work_queue)
+{
+	struct xio_mpsc_cell *cell = xio_mpsc_ring_claim(&work_queue->post_ring);
+
+	/* full ring is back pressure, let the poster retry */
+	if (!cell)
+		errno = EAGAIN;
+
+	return cell;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_workqueue_post_commit						     */
+/*---------------------------------------------------------------------------*/
+int xio_workqueue_post_commit(struct xio_workqueue *work_queue,
+			      struct xio_mpsc_cell *cell,
+			      const struct xio_mpsc_entry *entry)
+{
+	xio_mpsc_ring_publish(cell, entry);
+
+	return xio_workqueue_signal(work_queue);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -80,4 +80,38 @@ static inline int xio_is_delayed_work_pending(xio_delayed_work_handle_t *dwork)
 	return dwork->work.flags & XIO_WORK_PENDING;
 }
 
+struct xio_workqueue;
+struct xio_mpsc_entry;
+
+/*---------------------------------------------------------------------------*/
+/* xio_workqueue_post							     */
+/*---------------------------------------------------------------------------*/
+/* queues an entry to be run by the loop thread, may be called from any
+ * thread. wakeups are coalesced so a burst of posts costs one syscall
+ */
+int xio_workqueue_post(struct xio_workqueue *work_queue,
+		       const struct xio_mpsc_entry *entry);
+
+struct xio_mpsc_cell;
+
+/*---------------------------------------------------------------------------*/
+/* xio_workqueue_post_claim						     */
+/*---------------------------------------------------------------------------*/
+/* reserves a queue slot for a later xio_workqueue_post_commit, so posters
+ * that take references can fail before taking them. returns NULL with
+ * errno EAGAIN if the queue is full
+ */
+struct xio_mpsc_cell *xio_workqueue_post_claim(
+		struct xio_workqueue *work_queue);
+
+/*---------------------------------------------------------------------------*/
+/* xio_workqueue_post_commit						     */
+/*---------------------------------------------------------------------------*/
+/* fills a claimed slot and wakes the loop thread. every claimed slot
+ * must be committed, the loop does not run later entries before it
+ */
+int xio_workqueue_post_commit(struct xio_workqueue *work_queue,
+			      struct xio_mpsc_cell *cell,
+			      const struct xio_mpsc_entry *entry);
+
 #endif /* XIO_WORKQUEUE_PRIV_H */
@@ -74,7 +74,7 @@ struct xio_test_config {
 	uint32_t	data_len;
 	uint32_t	poll_timeout;
 	uint32_t	finite_run;
-	uint32_t	pad;
+	uint32_t	sharded;
 };
 
 struct portals_vec {
@@ -133,7 +133,7 @@ static struct xio_test_config  test_config = {
 	.data_len = XIO_DEF_DATA_SIZE,
 	.poll_timeout = XIO_DEF_POLL,
 	.finite_run = 0,
-	.pad = 0,
+	.sharded = 0,
 };
 
 static struct portals_vec *portals_get(struct server_data *server_data,
@@ -311,6 +311,78 @@ struct xio_session_ops  portal_server_ops = {
 	.assign_data_in_buf		=  assign_data_in_buf
 };
 
+/*---------------------------------------------------------------------------*/
+/* on_shard_session_event						     */
+/*---------------------------------------------------------------------------*/
+static int on_shard_session_event(struct xio_session *session,
+				  struct xio_session_event_data *event_data,
+				  void *cb_user_context)
+{
+	struct thread_data *tdata = (struct thread_data *)cb_user_context;
+	struct server_data *sdata = tdata->sdata;
+	int		   i;
+
+	printf("thread [%d] - session event: %s. session:%p, " \
+	       "connection:%p, reason: %s\n",
+	       tdata->affinity,
+	       xio_session_event_str(event_data->event),
+	       session, event_data->conn,
+	       xio_strerror(event_data->reason));
+
+	switch (event_data->event) {
+	case XIO_SESSION_NEW_CONNECTION_EVENT:
+		tdata->connection = event_data->conn;
+		break;
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		tdata->connection = NULL;
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		if (!sdata->finite_run)
+			break;
+		for (i = 0; i < sdata->tdata_nr; i++) {
+			process_request(&sdata->tdata[i], NULL);
+			xio_context_stop_loop(sdata->tdata[i].ctx);
+		}
+		xio_context_stop_loop((struct xio_context *)sdata->ctx);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_shard_new_session							     */
+/*---------------------------------------------------------------------------*/
+static int on_shard_new_session(struct xio_session *session,
+				struct xio_new_session_req *req,
+				void *cb_user_context)
+{
+	struct thread_data *tdata = (struct thread_data *)cb_user_context;
+
+	printf("thread [%d] - [%p] on_new_session :%s:%d\n",
+	       tdata->affinity, session,
+	       get_ip((struct sockaddr *)&req->src_addr),
+	       get_port((struct sockaddr *)&req->src_addr));
+
+	/* the session stays on the shard that accepted it */
+	xio_accept(session, NULL, 0, NULL, 0);
+
+	return 0;
+}
+
+struct xio_session_ops  shard_server_ops = {
+	.on_session_event		=  on_shard_session_event,
+	.on_new_session			=  on_shard_new_session,
+	.on_msg_send_complete		=  on_send_response_complete,
+	.on_msg				=  on_request,
+	.on_msg_error			=  on_msg_error,
+	.assign_data_in_buf		=  assign_data_in_buf
+};
+
 /*---------------------------------------------------------------------------*/
 /* worker thread callback						     */
 /*---------------------------------------------------------------------------*/
@@ -341,8 +413,12 @@ static void *portal_server_cb(void *data)
 
 	/* bind a listener server to a portal/url */
 	printf("thread [%d] - listen:%s\n", tdata->affinity, tdata->portal);
-	server = xio_bind(tdata->ctx, &portal_server_ops, tdata->portal,
-			  NULL, 0, tdata);
+	if (test_config.sharded)
+		server = xio_bind_sharded(tdata->ctx, &shard_server_ops,
+					  tdata->portal, NULL, 0, tdata);
+	else
+		server = xio_bind(tdata->ctx, &portal_server_ops,
+				  tdata->portal, NULL, 0, tdata);
 	if (server == NULL) {
 		printf("**** Error - xio_bind failed. %s\n",
 		       xio_strerror(xio_errno()));
@@ -491,6 +567,10 @@ static void usage(const char *argv0, int status)
 	printf("\t0 for infinite run, 1 for infinite run" \
 			"(default 0)\n");
 
+	printf("\t-s, --sharded ");
+	printf("\t\t\tAll threads listen on <port>, no portals " \
+			"(tcp only)\n");
+
 	printf("\t-v, --version ");
 	printf("\t\t\tPrint the version and exit\n");
 
@@ -516,6 +596,7 @@ int parse_cmdline(struct xio_test_config *test_config, int argc, char **argv)
 			{ .name = "data-len",	.has_arg = 1, .val = 'w'},
 			{ .name = "timeout",	.has_arg = 0, .val = 't'},
 			{ .name = "finite",	.has_arg = 1, .val = 'f'},
+			{ .name = "sharded",	.has_arg = 0, .val = 's'},
 			{ .name = "version",	.has_arg = 0, .val = 'v'},
 			{ .name = "help",	.has_arg = 0, .val = 'h'},
 			{0, 0, 0, 0},
@@ -556,6 +637,9 @@ int parse_cmdline(struct xio_test_config *test_config, int argc, char **argv)
 			test_config->poll_timeout =
 				(uint32_t)strtol(optarg, NULL, 0);
 			break;
+		case 's':
+			test_config->sharded = 1;
+			break;
 		case 'v':
 			printf("version: %s\n", XIO_TEST_VERSION);
 			exit(0);
@@ -599,6 +683,7 @@ static void print_test_config(
 	printf(" CPU Affinity		: %x\n", test_config_p->cpu);
 	printf(" Poll Timeout		: %d\n", test_config_p->poll_timeout);
 	printf(" Finite run		: %u\n", test_config_p->finite_run);
+	printf(" Sharded		: %u\n", test_config_p->sharded);
 	printf(" =============================================\n");
 }
 
@@ -607,7 +692,7 @@ static void print_test_config(
 /*---------------------------------------------------------------------------*/
 int main(int argc, char *argv[])
 {
-	struct xio_server	*server;	/* server portal */
+	struct xio_server	*server = NULL;	/* server portal */
 	struct server_data	server_data;
 	char			url[256];
 	int			i;
@@ -667,12 +752,16 @@ int main(int argc, char *argv[])
 		test_config.server_addr,
 		test_config.server_port);
 
-	/* bind a listener server to a portal/url */
-	server = xio_bind((struct xio_context *)server_data.ctx, &server_ops,
-			  url, NULL, 0, &server_data);
-	if (server == NULL) {
-		exit_code = -1;
-		goto cleanup;
+	/* bind a listener server to a portal/url - sharded threads
+	 * listen on the url themselves
+	 */
+	if (!test_config.sharded) {
+		server = xio_bind((struct xio_context *)server_data.ctx,
+				  &server_ops, url, NULL, 0, &server_data);
+		if (server == NULL) {
+			exit_code = -1;
+			goto cleanup;
+		}
 	}
 
 	/* spawn portals */
@@ -686,7 +775,8 @@ int main(int argc, char *argv[])
 		}
 		server_data.tdata[i].affinity = cpu;
 		server_data.tdata[i].sdata = &server_data;
-		port++;
+		if (!test_config.sharded)
+			port++;
 		sprintf(server_data.tdata[i].portal, "%s://%s:%d",
 			test_config.transport,
 			test_config.server_addr, port);
@@ -709,7 +799,8 @@ int main(int argc, char *argv[])
 	fprintf(stdout, "joined all threads\n");
 
 	/* free the server */
-	xio_unbind(server);
+	if (server)
+		xio_unbind(server);
 cleanup:
 	/* free the context */
 	xio_context_destroy((struct xio_context *)server_data.ctx);
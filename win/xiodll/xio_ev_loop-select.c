@@ -232,6 +232,23 @@ cleanup1:
 	return NULL;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_create_ex						     */
+/*---------------------------------------------------------------------------*/
+void *xio_ev_loop_create_ex(enum xio_ev_loop_type type)
+{
+	/* a single dispatcher here - the requested type is ignored */
+	return xio_ev_loop_create();
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_get_type							     */
+/*---------------------------------------------------------------------------*/
+enum xio_ev_loop_type xio_ev_loop_get_type(void *loop)
+{
+	return XIO_EV_LOOP_EPOLL;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_ev_loop_init_event						     */
 /*---------------------------------------------------------------------------*/
@@ -609,3 +626,36 @@ void xio_ev_loop_reset_stop(void *loop_hndl)
 	loop->stop_loop = 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_set_spin							     */
+/* busy polling is not supported - the loop always blocks		     */
+/*---------------------------------------------------------------------------*/
+void xio_ev_loop_set_spin(void *loop, int budget_us, int adaptive)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_get_spin							     */
+/*---------------------------------------------------------------------------*/
+void xio_ev_loop_get_spin(void *loop, int *budget_us, int *adaptive)
+{
+	*budget_us = 0;
+	*adaptive = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_set_spin_poll_fn						     */
+/*---------------------------------------------------------------------------*/
+void xio_ev_loop_set_spin_poll_fn(void *loop,
+				  xio_event_handler_t poll_fn, void *data)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_get_spin_stats						     */
+/*---------------------------------------------------------------------------*/
+void xio_ev_loop_get_spin_stats(void *loop,
+				struct xio_context_spin_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+}